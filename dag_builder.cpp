@@ -1,46 +1,177 @@
-// File: dag_builder.cpp (V3 - Ignores Control Flow)
+// File: dag_builder.cpp (V4 - One DAG per basic block)
 #include <iostream>
 #include <vector>
 #include <string>
-#include <sstream>
 #include <fstream>
-#include <map>
 #include <set>
-#include <list>
-#include <memory>
 #include <vector>
-#include <tuple>
 #include <algorithm> // For sort, replace
 #include <cctype> // For isdigit
+#include <charconv> // For to_chars
+#include <chrono>
+#include <cstdint>
+#include <queue> // For the list scheduler
+#include <tuple>
+#include <unordered_map>
+#include "tac_ir.h"
+#include "tac_binary.h"
+#include "tac_callgraph.h"
+#include "tac_cfg.h"
+#include "tac_dataflow.h"
+#include "tac_passes.h"
+#include "thread_pool.h"
+
+// --- Hash-Consing Table ---
+// Open addressing with linear probing over a power-of-two array of (key, node) slots. A key is three 32-bit
+// words: (opcode, left node, right node) for an operation, (operand bits, 0, 0) for a variable slot, so local
+// value numbering is one hash and usually one probe, with no string compares.
+class NodeHashTable {
+public:
+    static constexpr uint32_t kNone = UINT32_MAX; // Missing child, and "not found"
+    struct Key {
+        uint32_t op, left, right;
+        bool operator==(const Key& o) const { return op == o.op && left == o.left && right == o.right; }
+    };
 
-// --- Node Structure (same) ---
-struct DagNode {
-    std::string op; // Operation or initial identifier/literal
-    std::shared_ptr<DagNode> left = nullptr;
-    std::shared_ptr<DagNode> right = nullptr;
-    std::list<std::string> labels; // Variables currently holding this node's value
-    bool is_leaf = false;
-    int node_id = -1; // Unique ID for DOT output
+    explicit NodeHashTable(size_t expected = 0) { rehash(std::max<size_t>(16, expected * 2)); }
 
-    // Constructor for leaves (variables/literals)
-    DagNode(std::string initial_label_or_op) : op(std::move(initial_label_or_op)), is_leaf(true) {
-        // If it's not a temporary/label, add it as an initial label
-        if (!op.empty() && !(op[0] == 't' && op.length() > 1 && std::isdigit(op[1])) && !(op[0] == 'L' && op.length() > 1 && std::isdigit(op[1]))) {
-             labels.push_back(op);
+    uint32_t find(const Key& key) const {
+        for (size_t i = hash(key) & mask_;; i = (i + 1) & mask_) {
+            if (slots_[i].node == kNone) return kNone;
+            if (slots_[i].key == key) return slots_[i].node;
         }
     }
-    // Constructor for internal nodes (operations/calls)
-    DagNode(std::string o, std::shared_ptr<DagNode> l, std::shared_ptr<DagNode> r) : op(std::move(o)), left(std::move(l)), right(std::move(r)), is_leaf(false) {}
+    // Maps key to node; an existing entry is overwritten
+    void assign(const Key& key, uint32_t node) {
+        if ((used_ + 1) * 4 > slots_.size() * 3) rehash(slots_.size() * 2);
+        size_t i = hash(key) & mask_;
+        while (slots_[i].node != kNone && !(slots_[i].key == key)) i = (i + 1) & mask_;
+        if (slots_[i].node == kNone) used_++;
+        slots_[i] = {key, node};
+    }
+    size_t size() const { return used_; }
 
-    // Comparison not strictly needed for vector storage but good practice
-    bool operator<(const DagNode& other) const {
-        // Simple comparison based on operation and children addresses for ordering if needed
-        if (op != other.op) return op < other.op;
-        if (left.get() != other.left.get()) return left.get() < other.left.get();
-        return right.get() < other.right.get();
+private:
+    struct Slot { Key key; uint32_t node; };
+    static size_t hash(const Key& k) {
+        uint64_t h = (static_cast<uint64_t>(k.left) << 32 | k.right) * 0x9E3779B97F4A7C15ull;
+        h ^= (h >> 29) + k.op * 0xBF58476D1CE4E5B9ull;
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+    void rehash(size_t capacity) {
+        size_t n = 16;
+        while (n < capacity) n <<= 1;
+        std::vector<Slot> old = std::move(slots_);
+        slots_.assign(n, Slot{{0, 0, 0}, kNone});
+        mask_ = n - 1;
+        used_ = 0;
+        for (const Slot& slot : old) if (slot.node != kNone) assign(slot.key, slot.node);
     }
+
+    std::vector<Slot> slots_;
+    size_t mask_ = 0, used_ = 0;
 };
 
+// --- Node Arena ---
+// One basic block's DAG. Nodes live in parallel arrays indexed by node id, children as ids. Every operand the
+// block touches gets a variable slot: the node holding its current value, and the node whose label list names
+// it (the value last assigned to it in the block). A variable labels at most one node, so moving a label is an
+// O(1) unlink and push. A call kills the globals, since the callee may change them: their current values are
+// dropped (lazily, by epoch) but labels stay, and the next read loads a fresh Reload leaf.
+struct DagArena {
+    static constexpr uint32_t kNone = NodeHashTable::kNone;
+    enum Kind : uint8_t {
+        Leaf,       // Value on entry to the block
+        Reload,     // Value read again after a call
+        Input,      // Value from a read
+        Operation,
+        Arg,        // One argument of a call: left = value, right = the remaining arguments
+        Call,       // left = first Arg; value = callee symbol bits
+        PureCall,   // Call to a function with no effects that reads no globals: shared like an operation
+    };
+
+    // Per node
+    std::vector<uint8_t> kind;
+    std::vector<uint8_t> op;            // TacOp of an Operation
+    std::vector<uint32_t> left, right;  // Child node ids (kNone if absent)
+    std::vector<uint32_t> value;        // Leaf/Reload/Input: operand bits; Call/PureCall: callee symbol bits
+    std::vector<uint32_t> label_head;   // First variable slot labelling the node
+    // Per variable slot
+    std::vector<uint32_t> var_operand, var_node, var_label_node, var_prev, var_next;
+    std::vector<uint32_t> var_epoch, var_label_epoch; // kill_epoch when var_node / var_label_node was bound
+    std::vector<uint8_t> var_killable;                // Globals: a call may change them
+    std::vector<uint32_t> killable_slots;
+    NodeHashTable var_index;            // (operand bits, 0, 0) -> slot
+    NodeHashTable value_numbers;        // (op, left id, right id) -> operation node; (Param, ...) -> Arg;
+                                        // (Call, first Arg, callee) -> PureCall
+    uint32_t kill_epoch = 0;
+    size_t reused = 0;                  // Operations found in value_numbers instead of created
+
+    size_t size() const { return kind.size(); }
+
+    uint32_t addNode(Kind k, TacOp o, uint32_t l, uint32_t r, uint32_t v) {
+        kind.push_back(k); op.push_back(static_cast<uint8_t>(o));
+        left.push_back(l); right.push_back(r); value.push_back(v);
+        label_head.push_back(kNone);
+        return static_cast<uint32_t>(kind.size() - 1);
+    }
+
+    uint32_t variable(uint32_t operand, bool killable) {
+        uint32_t slot = var_index.find({operand, 0, 0});
+        if (slot != kNone) return slot;
+        slot = static_cast<uint32_t>(var_operand.size());
+        var_operand.push_back(operand); var_node.push_back(kNone); var_label_node.push_back(kNone);
+        var_prev.push_back(kNone); var_next.push_back(kNone);
+        var_epoch.push_back(0); var_label_epoch.push_back(0); var_killable.push_back(killable);
+        if (killable) killable_slots.push_back(slot);
+        var_index.assign({operand, 0, 0}, slot);
+        return slot;
+    }
+    uint32_t slotOf(uint32_t operand) const { return var_index.find({operand, 0, 0}); }
+    bool killed(uint32_t slot) const { return var_killable[slot] && var_epoch[slot] < kill_epoch; }
+    // The variable's current value, kNone if it has none (never seen, or killed)
+    uint32_t current(uint32_t slot) const { return killed(slot) ? kNone : var_node[slot]; }
+
+    // Makes node the variable's current value; with label, the variable is also listed on the node
+    void bind(uint32_t slot, uint32_t node, bool label) {
+        var_node[slot] = node;
+        var_epoch[slot] = kill_epoch;
+        if (!label) return;
+        if (var_label_node[slot] != kNone) unlink(slot);
+        var_label_node[slot] = node;
+        var_label_epoch[slot] = kill_epoch;
+        var_prev[slot] = kNone;
+        var_next[slot] = label_head[node];
+        if (label_head[node] != kNone) var_prev[label_head[node]] = slot;
+        label_head[node] = slot;
+    }
+    void killGlobals() { kill_epoch++; }
+
+    // Hash-consed nodes
+    uint32_t operation(TacOp o, uint32_t l, uint32_t r) { return consed(Operation, o, l, r, 0, {static_cast<uint32_t>(o), l, r}); }
+    uint32_t argument(uint32_t value_node, uint32_t rest) {
+        return consed(Arg, TacOp::Param, value_node, rest, 0, {static_cast<uint32_t>(TacOp::Param), value_node, rest});
+    }
+    uint32_t pureCall(uint32_t callee, uint32_t args) {
+        return consed(PureCall, TacOp::Call, args, kNone, callee, {static_cast<uint32_t>(TacOp::Call), args, callee});
+    }
+
+private:
+    uint32_t consed(Kind k, TacOp o, uint32_t l, uint32_t r, uint32_t v, const NodeHashTable::Key& key) {
+        uint32_t node = value_numbers.find(key);
+        if (node != kNone) { reused++; return node; }
+        node = addNode(k, o, l, r, v);
+        value_numbers.assign(key, node);
+        return node;
+    }
+    void unlink(uint32_t slot) {
+        const uint32_t node = var_label_node[slot];
+        if (var_prev[slot] != kNone) var_next[var_prev[slot]] = var_next[slot];
+        else label_head[node] = var_next[slot];
+        if (var_next[slot] != kNone) var_prev[var_next[slot]] = var_prev[slot];
+        var_label_node[slot] = kNone;
+    }
+};
 
 // --- Function to read variable names (same) ---
 std::set<std::string> readVariableNames(const std::string& filename) {
@@ -80,245 +211,1308 @@ std::vector<std::string> read3AC(const std::string& filename) {
     return code;
 }
 
-// --- Function to build DAG and generate DOT output ---
-void buildAndGenerateDot(const std::vector<std::string>& three_addr_code,
-                         const std::set<std::string>& initial_variables,
-                         std::vector<std::string>& dot_output)
-{
-    dot_output.push_back("digraph G {");
-    dot_output.push_back("  rankdir=TB;");
-    dot_output.push_back("  node [shape=box, fontname=Consolas, fontsize=10];");
-    dot_output.push_back("  edge [fontname=Consolas, fontsize=9];");
-    dot_output.push_back("");
-
-    // Tracks the node representing the most recent value for each variable/temporary
-    std::map<std::string, std::shared_ptr<DagNode>> current_node_map;
-    // Stores all unique nodes created to avoid duplicates
-    std::vector<std::shared_ptr<DagNode>> dag_nodes;
-    // Map to find existing internal nodes: <op, left_child_ptr, right_child_ptr> -> node_index_in_dag_nodes
-    std::map<std::tuple<std::string, std::shared_ptr<DagNode>, std::shared_ptr<DagNode>>, size_t> existing_op_nodes;
-    int next_node_id = 0; // For DOT N# identifiers
-
-    // Helper to get or create a leaf node (for variables or literals)
-    auto get_or_create_leaf_node = [&](const std::string& name) -> std::shared_ptr<DagNode> {
-        // If we already know the current node for this name, return it
-        if (current_node_map.count(name)) {
-            return current_node_map[name];
-        }
-        // Check if a leaf node with this name already exists anywhere in the DAG
-        for (const auto& existing_node : dag_nodes) {
-            if (existing_node->is_leaf && existing_node->op == name) {
-                current_node_map[name] = existing_node; // Update map
-                return existing_node;
-            }
-        }
-        // Create a new leaf node
-        auto new_node = std::make_shared<DagNode>(name);
-        new_node->node_id = next_node_id++;
-        dag_nodes.push_back(new_node);
-        current_node_map[name] = new_node;
-        return new_node;
+// --- Canonicalization ---
+// Applied to every operation before it is value numbered, with the 32-bit int semantics the back ends run:
+// constant operands are folded (foldInteger refuses anything C++ leaves undefined), commutative operands are
+// put in one order (constant last, else lower node first) and > / >= become < / <=, identities and
+// annihilators reduce to an existing node, and multiplication and division by powers of two become shifts.
+// Values of opaque (non-int) variables, and values computed from them, are left alone.
+struct CanonicalStats {
+    size_t folded = 0, simplified = 0, reordered = 0, shifts = 0;
+    void add(const CanonicalStats& o) { folded += o.folded; simplified += o.simplified; reordered += o.reordered; shifts += o.shifts; }
+};
+
+inline bool isCommutative(TacOp op) {
+    switch (op) {
+        case TacOp::Add: case TacOp::Mul: case TacOp::BitAnd: case TacOp::BitOr: case TacOp::BitXor:
+        case TacOp::Eq: case TacOp::Ne: case TacOp::LogAnd: case TacOp::LogOr: return true;
+        default: return false;
+    }
+}
+
+// log2 of v if it is a power of two above 1, else -1
+inline int powerOfTwo(int64_t v) {
+    if (v < 2 || (v & (v - 1)) != 0) return -1;
+    int k = 0;
+    while ((int64_t(1) << k) != v) ++k;
+    return k;
+}
+
+// The node for op(l, r) (r is kNone for a unary op). constant(v) returns the leaf of an int constant.
+template <typename ConstantLeaf>
+uint32_t canonicalOperation(const TacProgram& program, DagArena& dag, TacOp op, uint32_t l, uint32_t r,
+                            ConstantLeaf constant, CanonicalStats& stats) {
+    auto valueOf = [&](uint32_t node, int64_t& v) {
+        if (dag.kind[node] != DagArena::Leaf) return false;
+        Operand o;
+        o.bits = dag.value[node];
+        return integerValue(program, o, v);
     };
+    int64_t a = 0, b = 0, folded = 0;
+    bool ca = valueOf(l, a);
+    if (r == DagArena::kNone) {
+        if (ca && foldInteger(op, a, 0, folded) && Operand::fitsImmediate(folded)) { stats.folded++; return constant(folded); }
+        if ((op == TacOp::Neg || op == TacOp::BitNot) && dag.kind[l] == DagArena::Operation && dag.op[l] == static_cast<uint8_t>(op)) {
+            stats.simplified++; // -(-x), ~~x (ints wrap)
+            return dag.left[l];
+        }
+        return dag.operation(op, l, DagArena::kNone);
+    }
+    bool cb = valueOf(r, b);
+    if (ca && cb && foldInteger(op, a, b, folded) && Operand::fitsImmediate(folded)) { stats.folded++; return constant(folded); }
+
+    if (op == TacOp::Gt || op == TacOp::Ge) {
+        op = op == TacOp::Gt ? TacOp::Lt : TacOp::Le;
+        std::swap(l, r); std::swap(a, b); std::swap(ca, cb);
+        stats.reordered++;
+    } else if (isCommutative(op) && ((ca && !cb) || (ca == cb && l > r))) {
+        std::swap(l, r); std::swap(a, b); std::swap(ca, cb);
+        stats.reordered++;
+    }
 
-    // Initialize leaf nodes for all known variables from the start
-    for (const auto& var : initial_variables) {
-        get_or_create_leaf_node(var);
+    // Identities and annihilators; constants are on the right except for Sub, Div, Mod, shifts and <, <=
+    auto simplified = [&](uint32_t node) { stats.simplified++; return node; };
+    if (cb) {
+        switch (op) {
+            case TacOp::Add: case TacOp::Sub: case TacOp::BitOr: case TacOp::BitXor: case TacOp::Shl: case TacOp::Shr:
+                if (b == 0) return simplified(l);
+                break;
+            case TacOp::Mul:
+                if (b == 0) return simplified(r);
+                if (b == 1) return simplified(l);
+                break;
+            case TacOp::Div: if (b == 1) return simplified(l); break;
+            case TacOp::Mod: if (b == 1 || b == -1) return simplified(constant(0)); break;
+            case TacOp::BitAnd:
+                if (b == 0) return simplified(r);
+                if (b == -1) return simplified(l);
+                break;
+            case TacOp::LogAnd: if (b == 0) return simplified(constant(0)); break;
+            case TacOp::LogOr: if (b != 0) return simplified(constant(1)); break;
+            default: break;
+        }
+    }
+    if (ca && a == 0 && (op == TacOp::Shl || op == TacOp::Shr)) return simplified(l);
+    if (ca && a == 0 && op == TacOp::Sub) return simplified(dag.operation(TacOp::Neg, r, DagArena::kNone));
+    if (l == r) {
+        switch (op) {
+            case TacOp::Sub: case TacOp::BitXor: case TacOp::Ne: case TacOp::Lt: return simplified(constant(0));
+            case TacOp::Eq: case TacOp::Le: return simplified(constant(1));
+            case TacOp::BitAnd: case TacOp::BitOr: return simplified(l);
+            default: break;
+        }
     }
 
-    // Process 3AC instructions
-    for (const std::string& instruction : three_addr_code) {
-        std::stringstream ss(instruction);
-        std::string part1, part2, part3, part4, part5;
-        ss >> part1;
+    // Strength reduction: x * 2^k -> x << k; x / 2^k -> (x + ((x >> 31) & (2^k - 1))) >> k, rounding towards zero
+    const int k = cb ? powerOfTwo(b) : -1;
+    if (k > 0 && op == TacOp::Mul) { stats.shifts++; return dag.operation(TacOp::Shl, l, constant(k)); }
+    if (k > 0 && op == TacOp::Div && Operand::fitsImmediate(b - 1)) {
+        stats.shifts++;
+        const uint32_t sign = dag.operation(TacOp::Shr, l, constant(31));
+        const uint32_t bias = dag.operation(TacOp::BitAnd, sign, constant(b - 1));
+        return dag.operation(TacOp::Shr, dag.operation(TacOp::Add, l, bias), constant(k));
+    }
+    return dag.operation(op, l, r);
+}
+
+// --- Block DAG Construction ---
+// An instruction that stays in place when the block is regenerated: I/O, params, calls and the closing jump
+struct DagEffect {
+    TacInstr instr;
+    uint32_t node;          // Value it reads (Param, Write, Return, branches) or produces (Read, Call); kNone if none
+    uint32_t limit;         // Nodes created before it
+    uint32_t stores_end;    // Call: end of its globals in BlockDag::stores
+};
+
+struct BlockDag {
+    uint32_t function = 0;
+    uint32_t block = 0;                     // Index among the function's blocks (and CFG blocks)
+    BasicBlock range;
+    Operand label;                          // Label leading the block, if any
+    DagArena dag;
+    CanonicalStats canonical;
+    std::vector<DagEffect> effects;
+    std::vector<std::pair<uint32_t, uint32_t>> stores;  // (slot, node): globals assigned since the last call, per call
+    std::vector<std::pair<uint32_t, uint32_t>> reloads; // (kill epoch, Reload node)
+    std::vector<std::string> warnings;
+    bool verbatim = false;                  // Regenerate as the original code (unparsed instructions, unmatched params)
+    size_t shared_calls = 0;                // Pure calls found already in the DAG
+};
+
+// Builds the DAG of code[range]. Jumps, writes and returns only make sure the values they read exist; params
+// become the argument list of the call they feed. variables: symbols declared as variables (sorted); a leaf for
+// one starts out labelled with its own name. pure: function symbols whose calls can be shared (sorted).
+void buildBlockDag(const TacProgram& program, const TacFunction& function, const std::vector<uint32_t>& variables,
+                   const std::vector<uint32_t>& pure, BlockDag& out) {
+    DagArena& dag = out.dag;
+    auto isVariable = [&](Operand o) {
+        return o.isSymbol() && (variables.empty() || std::binary_search(variables.begin(), variables.end(), o.id()));
+    };
+    auto slotOf = [&](Operand o) { return dag.variable(o.bits, program.isGlobal(o)); };
+    // Per node: holds a non-int value (an opaque variable's, or one computed from it), which canonicalOperation
+    // must leave alone
+    std::vector<uint8_t> opaque;
+    auto markOpaque = [&](uint32_t node, bool is_opaque) {
+        if (opaque.size() < dag.size()) opaque.resize(dag.size(), 0);
+        if (is_opaque) opaque[node] = 1;
+    };
+    auto isOpaqueNode = [&](uint32_t node) { return node < opaque.size() && opaque[node]; };
+    // The node holding an operand's value, loading a leaf when the block has none for it yet
+    auto load = [&](Operand o) -> uint32_t {
+        int64_t v;
+        if (o.isConst() && integerValue(program, o, v) && Operand::fitsImmediate(v)) o = Operand::immediate(v); // One leaf per value
+        const uint32_t slot = slotOf(o);
+        uint32_t node = dag.current(slot);
+        if (node != DagArena::kNone) return node;
+        const bool reload = dag.var_killable[slot] && dag.kill_epoch > 0;
+        node = dag.addNode(reload ? DagArena::Reload : DagArena::Leaf, TacOp::Nop, DagArena::kNone, DagArena::kNone, o.bits);
+        if (reload) out.reloads.emplace_back(dag.kill_epoch, node);
+        dag.bind(slot, node, !reload && isVariable(o));
+        markOpaque(node, program.isOpaque(o));
+        return node;
+    };
+    std::vector<uint32_t> params; // Values of the params not yet claimed by a call
+    auto effect = [&](const TacInstr& instr, uint32_t node) {
+        out.effects.push_back({instr, node, static_cast<uint32_t>(dag.size()), static_cast<uint32_t>(out.stores.size())});
+    };
 
-        // --- Skip Control Flow and Informational Instructions ---
-        if (part1 == "ifFalse" || part1 == "goto" || part1 == "func" || part1.back() == ':') {
-             // Labels end with ':', func begin/end are informational
-             continue;
+    for (uint32_t k = out.range.begin; k < out.range.end; ++k) {
+        const TacInstr& instr = function.code[k];
+        switch (instr.op) {
+            case TacOp::Label: if (out.label.isNone()) out.label = instr.arg1; continue;
+            case TacOp::Nop: continue;
+            case TacOp::Goto: effect(instr, DagArena::kNone); continue;
+            case TacOp::IfFalse: case TacOp::IfTrue: case TacOp::JumpTable: case TacOp::Write:
+                effect(instr, load(instr.arg1));
+                continue;
+            case TacOp::Param: params.push_back(load(instr.arg1)); continue;
+            case TacOp::Return:
+                effect(instr, instr.arg1.isNone() ? DagArena::kNone : load(instr.arg1));
+                continue;
+            case TacOp::Read: { // A fresh value, whatever the variable held before
+                const uint32_t node = dag.addNode(DagArena::Input, TacOp::Read, DagArena::kNone, DagArena::kNone, instr.arg1.bits);
+                effect(instr, node);
+                dag.bind(slotOf(instr.arg1), node, true);
+                markOpaque(node, program.isOpaque(instr.arg1));
+                continue;
+            }
+            default: break;
         }
-        // Param is informational for DAG data flow, handle optionally later maybe
-        if (part1 == "param") {
-            // Ensure the parameter variable/temp exists as a node
-             if(ss >> part2) get_or_create_leaf_node(part2);
+
+        uint32_t result_node = DagArena::kNone;
+        if (instr.op == TacOp::Call) {
+            // The last argc params, in order (params of calls made in between were claimed by those calls)
+            int32_t argc = 0;
+            if (!callArgumentCount(program, instr, argc) || params.size() < static_cast<size_t>(argc)) {
+                out.verbatim = true;
+                argc = static_cast<int32_t>(params.size());
+            }
+            uint32_t args = DagArena::kNone;
+            for (int32_t a = 0; a < argc; ++a) { args = dag.argument(params.back(), args); params.pop_back(); }
+            if (instr.arg1.isSymbol() && std::binary_search(pure.begin(), pure.end(), instr.arg1.id())) {
+                const size_t before = dag.size();
+                result_node = dag.pureCall(instr.arg1.bits, args);
+                if (dag.size() == before) out.shared_calls++;
+            } else { // Other calls always create a new node (side effects), and may read or change any global
+                for (uint32_t slot : dag.killable_slots) {
+                    if (dag.var_label_node[slot] != DagArena::kNone && dag.var_label_epoch[slot] == dag.kill_epoch) {
+                        out.stores.emplace_back(slot, dag.var_label_node[slot]);
+                    }
+                }
+                result_node = dag.addNode(DagArena::Call, TacOp::Call, args, DagArena::kNone, instr.arg1.bits);
+                effect(instr, result_node);
+                out.effects.back().limit = result_node;
+                dag.killGlobals();
+            }
+            if (instr.result.isNone()) continue;
+        } else if (isBinaryOp(instr.op) || isUnaryOp(instr.op)) {
+            const uint32_t node1 = load(instr.arg1);
+            const uint32_t node2 = isBinaryOp(instr.op) ? load(instr.arg2) : DagArena::kNone;
+            if (program.isOpaque(instr.result) || program.isOpaque(instr.arg1) || program.isOpaque(instr.arg2) ||
+                isOpaqueNode(node1) || isOpaqueNode(node2)) {
+                result_node = dag.operation(instr.op, node1, node2);
+                markOpaque(result_node, true);
+            } else {
+                auto constant = [&](int64_t v) { return load(Operand::immediate(v)); };
+                result_node = canonicalOperation(program, dag, instr.op, node1, node2, constant, out.canonical);
+            }
+        } else if (instr.op == TacOp::Copy) {
+            result_node = load(instr.arg1); // Just point to the existing node for op1
+        } else { // Unhandled instruction (opaque text kept by the parser)
+            out.warnings.push_back("DAG Warning: Skipping unparsed 3AC instruction: " + instrToString(program, instr));
+            out.verbatim = true;
             continue;
         }
-        // Handle read/write placeholders (ensure variable exists)
-        if (part1 == "read" || part1 == "write") {
-             if(ss >> part2) get_or_create_leaf_node(part2);
-            continue; // No data dependency edges created for these simple placeholders
+        // 'lhs' moves to the result node
+        dag.bind(slotOf(instr.result), result_node, true);
+    }
+    if (!params.empty()) out.verbatim = true; // Params for a call in another block
+}
+
+// --- Latency Model ---
+// Cycles until a result can be used, per opcode class, and how many instructions issue per cycle. "add" covers
+// every other arithmetic, logic, compare and copy; reading a symbol the block has not written yet is a "load";
+// calls, reads and writes go to the runtime and are all "call". Set with --latency add=1,mul=3,...,issue=2.
+struct LatencyModel {
+    uint32_t add = 1, mul = 3, div = 20, load = 4, call = 25, issue = 2;
+
+    static bool isCall(TacOp op) { return op == TacOp::Call || op == TacOp::Read || op == TacOp::Write; }
+    uint32_t of(TacOp op) const {
+        if (isCall(op)) return call;
+        if (op == TacOp::Mul) return mul;
+        if (op == TacOp::Div || op == TacOp::Mod) return div;
+        return add;
+    }
+    // "class=cycles" pairs separated by commas; false on an unknown class or a bad count
+    bool parse(const std::string& spec) {
+        size_t start = 0;
+        while (start < spec.size()) {
+            size_t end = spec.find(',', start);
+            if (end == std::string::npos) end = spec.size();
+            const std::string item = spec.substr(start, end - start);
+            const size_t eq = item.find('=');
+            if (eq == std::string::npos || eq + 1 == item.size()) return false;
+            const std::string key = item.substr(0, eq), count = item.substr(eq + 1);
+            uint32_t v;
+            if (!parseCount(count, v)) return false;
+            if (key == "add") add = v; else if (key == "mul") mul = v; else if (key == "div") div = v;
+            else if (key == "load") load = v; else if (key == "call") call = v; else if (key == "issue" && v > 0) issue = v;
+            else return false;
+            start = end + 1;
+        }
+        return true;
+    }
+};
+
+// Estimated cycles for one block's code on an in-order machine: an instruction issues once its operands are
+// ready, at most model.issue per cycle; a call waits for everything before it and nothing issues until it returns.
+inline uint64_t estimateCycles(const TacInstr* begin, const TacInstr* end, const LatencyModel& model) {
+    std::unordered_map<uint32_t, uint64_t> ready; // Operand bits -> cycle its value is available
+    uint64_t cycle = 0, finish = 0;
+    uint32_t issued = 0;
+    Operand uses[2];
+    for (const TacInstr* in = begin; in != end; ++in) {
+        if (in->op == TacOp::Label || in->op == TacOp::Nop || in->op == TacOp::Comment) continue;
+        uint64_t t = LatencyModel::isCall(in->op) ? std::max(cycle, finish) : cycle;
+        for (int u = 0, n = usedOperands(*in, uses); u < n; ++u) {
+            auto it = ready.find(uses[u].bits);
+            t = std::max<uint64_t>(t, it != ready.end() ? it->second : uses[u].isSymbol() ? model.load : 0);
         }
+        if (t == cycle && issued == model.issue) t++;
+        if (t > cycle) { cycle = t; issued = 0; }
+        issued++;
+        const uint64_t done = t + model.of(in->op);
+        const Operand d = definedOperand(*in);
+        if (isVariable(d)) ready[d.bits] = done;
+        finish = std::max(finish, done);
+        if (LatencyModel::isCall(in->op)) { cycle = done; issued = 0; }
+    }
+    return finish;
+}
 
-        // --- Process Computational and Assignment Instructions ---
-        ss >> part2; // Should be '=' for assignments, or the value for return
-        bool p3 = static_cast<bool>(ss >> part3); // op1 or function name
-        bool p4 = static_cast<bool>(ss >> part4); // operator or param count
-        bool p5 = static_cast<bool>(ss >> part5); // op2
+// --- Code Regeneration ---
+// Turns a block DAG back into 3AC. Effects go out in their original order; before each one, the values it
+// reads are evaluated with children in Sethi-Ullman order (the child needing more temporaries first), so
+// fewer values are live at once. A call first evaluates every live value created before it, writes the
+// globals assigned since the last call (the callee may read them), pushes its params and moves values held in
+// globals to scratch temps (it may change them). Pure calls are emitted like operations, where first needed.
+// Nodes nothing needs are never emitted. With list scheduling (the default) the nodes each point needs are
+// ordered by the latency model instead: see schedule(). A value goes straight into one
+// of its live labels where that does not clobber anything; each other live label costs one copy at the end.
+// Scratch temps are the function's temps that are dead at every block boundary (liveness gives them no bit),
+// lowest first, then new ones: whatever the old code kept in them is gone with it.
+class BlockEmitter {
+public:
+    BlockEmitter(const BlockDag& block, const std::vector<uint8_t>& live_out, const VariableIndex& live_vars,
+                 const LatencyModel& model, bool list_schedule, std::vector<TacInstr>& out)
+        : block_(block), dag_(block.dag), out_(out), live_vars_(live_vars), model_(model), list_schedule_(list_schedule) {
+        const size_t n = dag_.size(), slots = dag_.var_operand.size();
+        need_.assign(n, 0); home_.assign(n, 0); su_.assign(n, 0); done_.assign(n, 0);
+        height_.assign(n, 0); in_region_.assign(n, 0); local_.assign(n, 0);
+        content_.assign(slots, DagArena::kNone);
+        final_.assign(slots, 0);
+        for (uint32_t v = 0; v < slots; ++v) {
+            final_[v] = dag_.var_label_node[v] != DagArena::kNone && live_out[v] &&
+                        (!dag_.var_killable[v] || dag_.var_label_epoch[v] == dag_.kill_epoch);
+            if (final_[v]) need_[dag_.var_label_node[v]]++;
+        }
+        for (const DagEffect& e : block.effects) {
+            if (e.node == DagArena::kNone) continue;
+            if (!produces(e.instr.op)) need_[e.node]++;
+            else if (e.instr.op == TacOp::Call && dag_.left[e.node] != DagArena::kNone) need_[dag_.left[e.node]]++; // Its arguments
+        }
+        for (const auto& store : block.stores) need_[store.second]++;
+        for (uint32_t node = static_cast<uint32_t>(n); node-- > 0;) {
+            if (computed(node) && need_[node]) {
+                if (dag_.left[node] != DagArena::kNone) need_[dag_.left[node]]++;
+                if (dag_.right[node] != DagArena::kNone) need_[dag_.right[node]]++;
+            }
+        }
+        for (uint32_t node = 0; node < n; ++node) {
+            if (computed(node)) {
+                const uint32_t l = dag_.left[node] == DagArena::kNone ? 0 : su_[dag_.left[node]];
+                const uint32_t r = dag_.right[node] == DagArena::kNone ? 0 : su_[dag_.right[node]];
+                su_[node] = l == r ? l + 1 : std::max(l, r);
+            } else if (dag_.kind[node] == DagArena::Leaf || dag_.kind[node] == DagArena::Reload) {
+                done_[node] = 1; // Already in its variable (a Reload from its call on)
+                home_[node] = dag_.value[node];
+                if (dag_.kind[node] == DagArena::Leaf) content_[dag_.slotOf(dag_.value[node])] = node;
+            }
+        }
+        // Critical path: the longest chain of latencies from the node to the end of the block
+        for (uint32_t node = static_cast<uint32_t>(n); node-- > 0;) {
+            height_[node] += latency(node);
+            if (!computed(node)) continue;
+            for (uint32_t c : {dag_.left[node], dag_.right[node]}) if (c != DagArena::kNone) height_[c] = std::max(height_[c], height_[node]);
+        }
+    }
 
-        std::shared_ptr<DagNode> result_node = nullptr;
-        std::string lhs = ""; // Variable being defined (if any)
+    void run() {
+        if (!block_.label.isNone()) out_.push_back(TacInstr(TacOp::Label, Operand(), block_.label));
+        size_t store = 0, reload = 0;
+        const DagEffect* jump = nullptr;
+        for (const DagEffect& e : block_.effects) {
+            const TacOp op = e.instr.op;
+            if (op == TacOp::Goto || op == TacOp::IfFalse || op == TacOp::IfTrue || op == TacOp::JumpTable || op == TacOp::Return) {
+                jump = &e; // Always last
+            } else if (op == TacOp::Write) {
+                evaluate(e.node);
+                out_.push_back(TacInstr(op, Operand(), operandAt(home_[e.node]), e.instr.arg2)); // arg2 keeps writechar
+                release(e.node);
+            } else if (op == TacOp::Read) {
+                Operand target = labelTarget(e.node);
+                if (target.isNone()) target = e.instr.arg1;
+                place(e.node, target);
+                out_.push_back(TacInstr(TacOp::Read, Operand(), target));
+            } else if (op == TacOp::Call) {
+                flush(e.limit);
+                for (; store < e.stores_end; ++store) assign(block_.stores[store].first, block_.stores[store].second);
+                pushArguments(dag_.left[e.node]);
+                for (uint32_t v : dag_.killable_slots) {
+                    const uint32_t c = content_[v];
+                    if (c != DagArena::kNone && need_[c] && home_[c] == dag_.var_operand[v]) save(c);
+                    content_[v] = DagArena::kNone;
+                }
+                epoch_++;
+                for (; reload < block_.reloads.size() && block_.reloads[reload].first == epoch_; ++reload) {
+                    const uint32_t node = block_.reloads[reload].second;
+                    content_[dag_.slotOf(dag_.value[node])] = node;
+                }
+                Operand target = labelTarget(e.node);
+                if (target.isNone() && need_[e.node]) target = scratch();
+                place(e.node, target);
+                out_.push_back(TacInstr(TacOp::Call, target, e.instr.arg1, e.instr.arg2));
+            }
+        }
+        flush(static_cast<uint32_t>(dag_.size())); // The jump's value and the final labels
+        for (uint32_t v = 0; v < final_.size(); ++v) {
+            if (final_[v] && content_[v] != dag_.var_label_node[v]) assign(v, dag_.var_label_node[v]);
+        }
+        if (jump) {
+            TacInstr in = jump->instr;
+            if (jump->node != DagArena::kNone) in.arg1 = operandAt(home_[jump->node]);
+            out_.push_back(in);
+        }
+    }
+    uint32_t tempLimit() const { return next_scratch_; } // Above every scratch temp used
 
-        // 1. Return statement: return VALUE
-        if (part1 == "return") {
-            if (!part2.empty()) { // return t1, return 1 etc.
-                result_node = get_or_create_leaf_node(part2); // Node already exists or is created
-                // Optionally add a special 'return' label/node? Skipping for simplicity.
-            } else {
-                // return; (void return) - no node created/modified
+private:
+    static bool produces(TacOp op) { return op == TacOp::Read || op == TacOp::Call; }
+    // Emitted by evaluate(), children first
+    bool computed(uint32_t node) const {
+        return dag_.kind[node] == DagArena::Operation || dag_.kind[node] == DagArena::Arg || dag_.kind[node] == DagArena::PureCall;
+    }
+    static Operand operandAt(uint32_t bits) { Operand o; o.bits = bits; return o; }
+    bool isScratch(uint32_t bits) const {
+        const Operand o = operandAt(bits);
+        return o.isTemp() && live_vars_.of(o) == VariableIndex::kNone;
+    }
+    Operand scratch() {
+        if (!free_scratch_.empty()) { Operand o = free_scratch_.back(); free_scratch_.pop_back(); return o; }
+        while (!isScratch(Operand::temp(next_scratch_).bits)) next_scratch_++;
+        return Operand::temp(next_scratch_++);
+    }
+    // One use of node is out; an argument list lets go of its values when its last call is out
+    void release(uint32_t node) {
+        for (; node != DagArena::kNone; node = dag_.right[node]) {
+            if (--need_[node]) return;
+            if (isScratch(home_[node])) free_scratch_.push_back(operandAt(home_[node]));
+            if (dag_.kind[node] != DagArena::Arg) return;
+            release(dag_.left[node]);
+        }
+    }
+    // Emits the params of an argument list, all evaluated, and returns how many
+    uint32_t pushArguments(uint32_t args) {
+        uint32_t count = 0;
+        for (uint32_t a = args; a != DagArena::kNone; a = dag_.right[a], ++count) {
+            out_.push_back(TacInstr(TacOp::Param, Operand(), operandAt(home_[dag_.left[a]])));
+        }
+        if (args != DagArena::kNone) release(args);
+        return count;
+    }
+
+    // A label the node can be computed into now: one the block leaves holding it or a global stored before a
+    // call, written no earlier than the original code did (globals: after the last call before the assignment),
+    // and holding nothing needed
+    Operand labelTarget(uint32_t node) const {
+        for (uint32_t v = dag_.label_head[node]; v != DagArena::kNone; v = dag_.var_next[v]) {
+            const bool stored = dag_.var_killable[v] && dag_.var_label_epoch[v] < dag_.kill_epoch;
+            if (!(final_[v] || stored) || (dag_.var_killable[v] && dag_.var_label_epoch[v] != epoch_)) continue;
+            const uint32_t c = content_[v];
+            if (c == DagArena::kNone || c == node || !need_[c] || home_[c] != dag_.var_operand[v]) return operandAt(dag_.var_operand[v]);
+        }
+        return Operand();
+    }
+    // Moves a value out of the variable that holds it
+    void save(uint32_t node) {
+        const Operand s = scratch();
+        out_.push_back(TacInstr(TacOp::Copy, s, operandAt(home_[node])));
+        home_[node] = s.bits;
+    }
+    // Records that target now holds node, saving whatever value it held that is still needed
+    void place(uint32_t node, Operand target) {
+        done_[node] = 1;
+        home_[node] = target.bits;
+        if (target.isNone() || isScratch(target.bits)) return;
+        const uint32_t v = dag_.slotOf(target.bits);
+        const uint32_t c = content_[v];
+        if (c != DagArena::kNone && c != node && need_[c] && home_[c] == target.bits) save(c);
+        content_[v] = node;
+    }
+    // Emits v = node
+    void assign(uint32_t v, uint32_t node) {
+        evaluate(node);
+        const Operand target = operandAt(dag_.var_operand[v]);
+        if (content_[v] != node) {
+            const uint32_t c = content_[v];
+            if (c != DagArena::kNone && need_[c] && home_[c] == target.bits) save(c);
+            out_.push_back(TacInstr(TacOp::Copy, target, operandAt(home_[node])));
+            content_[v] = node;
+            if (isScratch(home_[node])) { free_scratch_.push_back(operandAt(home_[node])); home_[node] = target.bits; }
+        }
+        release(node);
+    }
+
+    // Emits every live node created before limit that is not out yet
+    void flush(uint32_t limit) {
+        roots_.clear();
+        for (uint32_t node = limit; node-- > flushed_;) if (need_[node] && !done_[node]) roots_.push_back(node);
+        flushed_ = std::max(flushed_, limit);
+        if (list_schedule_) schedule();
+        else for (uint32_t root : roots_) evaluateInOrder(root);
+    }
+    // Emits node and whatever it depends on
+    void evaluate(uint32_t root) {
+        if (done_[root]) return;
+        if (!list_schedule_) { evaluateInOrder(root); return; }
+        roots_.assign(1, root);
+        schedule();
+    }
+    uint32_t latency(uint32_t node) const {
+        switch (dag_.kind[node]) {
+            case DagArena::Operation: return model_.of(static_cast<TacOp>(dag_.op[node]));
+            case DagArena::PureCall: return model_.call;
+            case DagArena::Leaf: case DagArena::Reload: return operandAt(dag_.value[node]).isSymbol() ? model_.load : 0;
+            default: return 0;
+        }
+    }
+
+    // List scheduling of everything roots_ need that is not out yet. A node is ready once its children are out
+    // and available once their results are, by the latency model; each cycle issues up to model_.issue
+    // available nodes, the one with the longest path to the end of the block first, then the one leaving fewer
+    // values live (register pressure), then the earliest in the source.
+    void schedule() {
+        region_.clear();
+        for (uint32_t root : roots_) if (!done_[root] && !in_region_[root]) { in_region_[root] = 1; region_.push_back(root); }
+        for (size_t k = 0; k < region_.size(); ++k) {
+            for (uint32_t c : {dag_.left[region_[k]], dag_.right[region_[k]]}) {
+                if (c != DagArena::kNone && !done_[c] && !in_region_[c]) { in_region_[c] = 1; region_.push_back(c); }
+            }
+        }
+        const uint32_t m = static_cast<uint32_t>(region_.size());
+        for (uint32_t k = 0; k < m; ++k) local_[region_[k]] = k;
+        // Parents of each region node, compressed
+        pending_.assign(m, 0); parent_offsets_.assign(m + 1, 0); available_at_.assign(m, 0);
+        auto inRegionChildren = [&](uint32_t node, uint32_t out[2]) {
+            int count = 0;
+            const uint32_t l = dag_.left[node], r = dag_.right[node];
+            if (l != DagArena::kNone && in_region_[l] && !done_[l]) out[count++] = l;
+            if (r != DagArena::kNone && r != l && in_region_[r] && !done_[r]) out[count++] = r;
+            return count;
+        };
+        uint32_t children[2];
+        for (uint32_t k = 0; k < m; ++k) {
+            const int count = inRegionChildren(region_[k], children);
+            pending_[k] = static_cast<uint32_t>(count);
+            for (int c = 0; c < count; ++c) parent_offsets_[local_[children[c]] + 1]++;
+        }
+        for (uint32_t k = 0; k < m; ++k) parent_offsets_[k + 1] += parent_offsets_[k];
+        parents_.resize(parent_offsets_[m]);
+        std::vector<uint32_t> fill(parent_offsets_.begin(), parent_offsets_.end() - 1);
+        for (uint32_t k = 0; k < m; ++k) {
+            const int count = inRegionChildren(region_[k], children);
+            for (int c = 0; c < count; ++c) parents_[fill[local_[children[c]]]++] = region_[k];
+        }
+
+        auto earliest = [&](uint32_t node) {
+            uint64_t t = 0;
+            for (uint32_t c : {dag_.left[node], dag_.right[node]}) {
+                if (c == DagArena::kNone) continue;
+                t = std::max<uint64_t>(t, in_region_[c] ? available_at_[local_[c]] : latency(c));
             }
-            continue; // Returns don't create new nodes in this simplified DAG model
-        }
-        // 2. Assignment statement: LHS = ...
-        else if (!part1.empty() && part2 == "=") {
-            lhs = part1; // The variable being assigned to
-
-            // Case 2a: Assignment from function call: lhs = call func, N
-            if (p3 && part3 == "call") {
-                std::string func_name = p4 ? part4 : "unknown_func";
-                // Calls always create a new node (side effects)
-                result_node = std::make_shared<DagNode>("call " + func_name, nullptr, nullptr); // Treat call like an op node
-                result_node->node_id = next_node_id++;
-                dag_nodes.push_back(result_node);
-                // We could try and find the preceding 'param' instructions and add dotted edges here
+            return t;
+        };
+        using Waiting = std::pair<uint64_t, uint32_t>;   // (earliest cycle, node)
+        using Ready = std::tuple<uint32_t, int, uint32_t>; // (critical path, -pressure delta, -node)
+        std::priority_queue<Waiting, std::vector<Waiting>, std::greater<Waiting>> waiting;
+        std::priority_queue<Ready> available;
+        for (uint32_t k = 0; k < m; ++k) if (!pending_[k]) waiting.emplace(earliest(region_[k]), region_[k]);
+        uint64_t cycle = 0;
+        uint32_t issued = 0;
+        while (!waiting.empty() || !available.empty()) {
+            while (!waiting.empty() && waiting.top().first <= cycle) {
+                const uint32_t node = waiting.top().second;
+                waiting.pop();
+                int delta = dag_.kind[node] == DagArena::Arg ? 0 : 1;
+                const uint32_t l = dag_.left[node], r = dag_.right[node];
+                if (l != DagArena::kNone && need_[l] == 1) delta--;
+                if (r != DagArena::kNone && r != l && need_[r] == 1) delta--;
+                available.emplace(static_cast<uint32_t>(height_[node]), -delta, ~node);
             }
-            // Case 2b: Assignment with binary operation: lhs = op1 OP op2
-            else if (p3 && p4 && p5) {
-                std::string op1_name = part3;
-                std::string op = part4;
-                std::string op2_name = part5;
-
-                std::shared_ptr<DagNode> node1 = get_or_create_leaf_node(op1_name);
-                std::shared_ptr<DagNode> node2 = get_or_create_leaf_node(op2_name);
-
-                // Check if this exact operation node already exists
-                auto key = std::make_tuple(op, node1, node2);
-                auto it = existing_op_nodes.find(key);
-                if (it != existing_op_nodes.end()) {
-                    result_node = dag_nodes[it->second]; // Reuse existing node
-                } else {
-                    // Create a new operation node
-                    result_node = std::make_shared<DagNode>(op, node1, node2);
-                    result_node->node_id = next_node_id++;
-                    dag_nodes.push_back(result_node);
-                    existing_op_nodes[key] = dag_nodes.size() - 1; // Store index
+            if (available.empty()) { cycle = waiting.top().first; issued = 0; continue; }
+            const uint32_t node = ~std::get<2>(available.top());
+            available.pop();
+            emitNode(node);
+            available_at_[local_[node]] = cycle + latency(node);
+            if (dag_.kind[node] != DagArena::Arg && ++issued == model_.issue) { cycle++; issued = 0; }
+            for (uint32_t p = parent_offsets_[local_[node]]; p < parent_offsets_[local_[node] + 1]; ++p) {
+                const uint32_t parent = parents_[p];
+                if (--pending_[local_[parent]] == 0) waiting.emplace(std::max(cycle, earliest(parent)), parent);
+            }
+        }
+        for (uint32_t node : region_) in_region_[node] = 0;
+    }
+
+    // Sethi-Ullman order, with an explicit stack (blocks can hold chains of 100k operations)
+    void evaluateInOrder(uint32_t root) {
+        if (done_[root]) return;
+        stack_.push_back(root);
+        while (!stack_.empty()) {
+            const uint32_t node = stack_.back();
+            if (done_[node]) { stack_.pop_back(); continue; }
+            uint32_t first = dag_.left[node], second = dag_.right[node];
+            if (second != DagArena::kNone && su_[second] > su_[first]) std::swap(first, second);
+            if (first != DagArena::kNone && !done_[first]) { stack_.push_back(first); continue; }
+            if (second != DagArena::kNone && !done_[second]) { stack_.push_back(second); continue; }
+            stack_.pop_back();
+            emitNode(node);
+        }
+    }
+    // Emits one node whose children are out
+    void emitNode(uint32_t node) {
+        if (dag_.kind[node] == DagArena::Arg) { done_[node] = 1; return; } // Pushed by its calls
+        if (dag_.kind[node] == DagArena::PureCall) {
+            const uint32_t argc = pushArguments(dag_.left[node]);
+            Operand target = labelTarget(node);
+            if (target.isNone()) target = scratch();
+            place(node, target);
+            out_.push_back(TacInstr(TacOp::Call, target, operandAt(dag_.value[node]), Operand::immediate(argc)));
+            return;
+        }
+        const uint32_t l = dag_.left[node], r = dag_.right[node];
+        const Operand a1 = operandAt(home_[l]), a2 = r == DagArena::kNone ? Operand() : operandAt(home_[r]);
+        release(l);
+        if (r != DagArena::kNone) release(r);
+        Operand target = labelTarget(node);
+        if (target.isNone()) target = scratch();
+        place(node, target);
+        out_.push_back(TacInstr(static_cast<TacOp>(dag_.op[node]), target, a1, a2));
+    }
+
+    const BlockDag& block_;
+    const DagArena& dag_;
+    std::vector<TacInstr>& out_;
+    const VariableIndex& live_vars_;
+    const LatencyModel& model_;
+    const bool list_schedule_;
+    uint32_t next_scratch_ = 0, epoch_ = 0, flushed_ = 0;
+    std::vector<uint32_t> need_;    // Uses not emitted yet: parents, effects, stores, final labels
+    std::vector<uint32_t> home_;    // Operand bits of where the node's value is
+    std::vector<uint32_t> su_;      // Sethi-Ullman number
+    std::vector<uint64_t> height_;  // Critical path to the end of the block, in cycles
+    std::vector<uint8_t> done_;
+    std::vector<uint32_t> content_; // Per slot: the node whose value the variable holds (kNone: unknown)
+    std::vector<uint8_t> final_;    // Per slot: must hold its label node at the end of the block
+    std::vector<Operand> free_scratch_;
+    std::vector<uint32_t> stack_;
+    // schedule() scratch space
+    std::vector<uint32_t> roots_, region_, local_, pending_, parent_offsets_, parents_;
+    std::vector<uint64_t> available_at_;
+    std::vector<uint8_t> in_region_;
+};
+
+// Distinct temps in the program
+size_t countTemps(const TacProgram& program) {
+    std::vector<uint8_t> seen;
+    size_t count = 0;
+    auto see = [&](Operand o) {
+        if (!o.isTemp()) return;
+        if (o.id() >= seen.size()) seen.resize(o.id() + 1, 0);
+        if (!seen[o.id()]) { seen[o.id()] = 1; count++; }
+    };
+    Operand uses[2];
+    for (const TacFunction& f : program.functions) {
+        for (const TacInstr& in : f.code) {
+            see(definedOperand(in));
+            for (int u = 0, n = usedOperands(in, uses); u < n; ++u) see(uses[u]);
+        }
+    }
+    return count;
+}
+
+size_t countInstructions(const TacProgram& program) {
+    size_t n = 0;
+    for (const TacFunction& f : program.functions) {
+        for (const TacInstr& in : f.code) n += in.op != TacOp::Comment ? 1 : 0;
+    }
+    return n;
+}
+
+struct ScheduleStats {
+    uint64_t cycles_before = 0, cycles_after = 0; // Estimated by the latency model, summed over the blocks
+};
+
+// The program rebuilt from its block DAGs. Blocks it could not model are copied unchanged. Each rebuilt block
+// is preceded by a comment with its estimated cycles before and after.
+TacProgram regenerateProgram(const TacProgram& program, const std::vector<BlockDag>& blocks, const LatencyModel& model,
+                             bool list_schedule, ThreadPool& pool, ScheduleStats& stats) {
+    std::vector<LivenessInfo> liveness(program.functions.size());
+    pool.parallelFor(program.functions.size(), [&](size_t f) {
+        const TacFunction& function = program.functions[f];
+        liveness[f] = computeLiveness(program, function, buildCFG(function.code, function.jump_tables));
+    });
+
+    std::vector<std::vector<TacInstr>> code(blocks.size());
+    std::vector<uint32_t> scratch(blocks.size(), 0); // Temp limit per block
+    std::vector<std::pair<uint64_t, uint64_t>> cycles(blocks.size()); // Estimated (before, after) per block
+    pool.parallelFor(blocks.size(), [&](size_t b) {
+        const BlockDag& block = blocks[b];
+        const TacFunction& function = program.functions[block.function];
+        const TacInstr* original = function.code.data();
+        cycles[b].first = estimateCycles(original + block.range.begin, original + block.range.end, model);
+        if (block.verbatim) {
+            code[b].assign(function.code.begin() + block.range.begin, function.code.begin() + block.range.end);
+            cycles[b].second = cycles[b].first;
+            return;
+        }
+        const LivenessInfo& live = liveness[block.function];
+        std::vector<uint8_t> live_out(block.dag.var_operand.size(), 0);
+        for (uint32_t v = 0; v < live_out.size(); ++v) {
+            Operand o;
+            o.bits = block.dag.var_operand[v];
+            const uint32_t id = isVariable(o) ? live.vars.of(o) : VariableIndex::kNone;
+            live_out[v] = id != VariableIndex::kNone && live.result.out[block.block].test(id);
+        }
+        BlockEmitter emitter(block, live_out, live.vars, model, list_schedule, code[b]);
+        emitter.run();
+        scratch[b] = emitter.tempLimit();
+        cycles[b].second = estimateCycles(code[b].data(), code[b].data() + code[b].size(), model);
+    });
+
+    TacProgram result = program;
+    for (TacFunction& f : result.functions) f.code.clear();
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        std::vector<TacInstr>& dest = result.functions[blocks[b].function].code;
+        stats.cycles_before += cycles[b].first;
+        stats.cycles_after += cycles[b].second;
+        // The comment goes after the block's label, so jumps still land on the block
+        const bool labelled = !code[b].empty() && code[b].front().op == TacOp::Label;
+        if (labelled) dest.push_back(code[b].front());
+        if (!blocks[b].verbatim && !code[b].empty()) {
+            const std::string note = "# B" + std::to_string(b) + ": " + std::to_string(cycles[b].second) + " cycle(s) (was " +
+                                     std::to_string(cycles[b].first) + ")";
+            dest.push_back(TacInstr(TacOp::Comment, Operand(), result.constant(note)));
+        }
+        dest.insert(dest.end(), code[b].begin() + (labelled ? 1 : 0), code[b].end());
+    }
+    for (uint32_t limit : scratch) result.temp_count = std::max(result.temp_count, limit);
+    return result;
+}
+
+// --- Graph Views ---
+// Graphviz cannot lay out hundreds of thousands of nodes, so the graph can be written in part:
+//   --function NAME / --block K   only those functions ("(top level)" for top-level code) or blocks
+//   --root ID                     only what node N<ID> of the full graph depends on
+//   --max-nodes N                 breadth-first from the roots (the nodes nothing in the block uses, latest
+//                                 first, or --root), one root at a time, until N nodes are in; nodes that
+//                                 lost children to the cap are marked
+//   --collapse                    patterns of two or more operations (up to kPatternDepth deep) that repeat
+//                                 in a block, whatever their leaves, become one summary node with the number
+//                                 of occurrences
+// Node ids stay those of the full graph; summary nodes are numbered after all of them.
+struct ViewOptions {
+    std::vector<std::string> functions;
+    std::vector<uint32_t> blocks;
+    uint32_t root = DagArena::kNone;
+    size_t max_nodes = 0; // 0: no cap
+    bool collapse = false;
+
+    bool scoped() const { return !functions.empty() || !blocks.empty() || root != DagArena::kNone || max_nodes || collapse; }
+};
+
+struct BlockView {
+    struct Summary {
+        uint32_t node;  // First occurrence, for its label
+        uint32_t size;  // Operations per occurrence
+        uint32_t count; // Occurrences
+    };
+    bool selected = false;
+    std::vector<uint8_t> hidden;    // Per node
+    std::vector<uint8_t> cut;       // Per node: some children were dropped by the cap
+    std::vector<uint32_t> summary;  // Per hidden node: the summary standing for it, or kNone
+    std::vector<Summary> summaries;
+    uint32_t first_summary_id = 0;
+    size_t shown = 0; // Visible nodes and summaries
+
+    bool visible(uint32_t node) const { return !hidden[node]; }
+};
+
+namespace view_detail {
+constexpr int kPatternDepth = 3;
+inline uint64_t mix(uint64_t h, uint64_t v) { return (h ^ v) * 0x9E3779B97F4A7C15ull + (h >> 29); }
+inline bool operationLike(uint8_t kind) { return kind == DagArena::Operation || kind == DagArena::PureCall || kind == DagArena::Arg; }
+
+// Replaces repeated visible patterns with summary nodes. A node's shape at depth d hashes its kind and
+// operation with its children's shapes at depth d - 1, every leaf alike; parents are visited before
+// children, so each occurrence is absorbed whole before its parts could count as occurrences of their own.
+inline void collapse(const DagArena& dag, BlockView& view) {
+    const uint32_t n = static_cast<uint32_t>(dag.size());
+    std::vector<uint64_t> shape(n), below(n);
+    std::vector<uint32_t> size(n), size_below(n); // Visible operations in the pattern
+    for (int depth = 0; depth <= kPatternDepth; ++depth) {
+        shape.swap(below); size.swap(size_below);
+        for (uint32_t node = 0; node < n; ++node) {
+            uint64_t h = mix(dag.kind[node] + 1, 0);
+            uint32_t ops = 0;
+            if (operationLike(dag.kind[node]) && view.visible(node)) {
+                h = mix(h, dag.kind[node] == DagArena::PureCall ? dag.value[node] : dag.op[node]);
+                ops = 1;
+                for (uint32_t c : {dag.left[node], dag.right[node]}) {
+                    if (c == DagArena::kNone || !depth) continue;
+                    h = mix(h, below[c]);
+                    ops += size_below[c];
                 }
             }
-            // Case 2c: Simple assignment: lhs = op1
-            else if (p3 && !p4) {
-                 std::string op1_name = part3;
-                 result_node = get_or_create_leaf_node(op1_name); // Just point to the existing node for op1
+            shape[node] = h;
+            size[node] = ops;
+        }
+    }
+    std::unordered_map<uint64_t, uint32_t> count;
+    for (uint32_t node = 0; node < n; ++node) if (size[node] >= 2) count[shape[node]]++;
+    std::unordered_map<uint64_t, uint32_t> summary_of; // shape -> index into view.summaries
+    std::vector<std::pair<uint32_t, int>> stack;        // (node, depth below the occurrence)
+    for (uint32_t node = n; node-- > 0;) {
+        if (!view.visible(node) || size[node] < 2 || count[shape[node]] < 2) continue;
+        auto it = summary_of.emplace(shape[node], static_cast<uint32_t>(view.summaries.size())).first;
+        if (it->second == view.summaries.size()) view.summaries.push_back({node, size[node], 0});
+        view.summaries[it->second].count++;
+        stack.assign(1, {node, 0});
+        while (!stack.empty()) {
+            const auto [x, depth] = stack.back();
+            stack.pop_back();
+            view.hidden[x] = 1;
+            view.summary[x] = it->second;
+            if (depth == kPatternDepth) continue;
+            for (uint32_t c : {dag.left[x], dag.right[x]}) {
+                if (c != DagArena::kNone && view.visible(c) && operationLike(dag.kind[c])) stack.emplace_back(c, depth + 1);
             }
-            // Case 2d: Unhandled assignment form
-            else {
-                 std::cerr << "DAG Warning: Unhandled assignment form: " << instruction << std::endl;
-                 continue;
+        }
+    }
+    // Leaves only the summarized subtrees used go too
+    std::vector<uint8_t> used(n, 0), used_visibly(n, 0);
+    for (uint32_t node = 0; node < n; ++node) {
+        for (uint32_t c : {dag.left[node], dag.right[node]}) {
+            if (c == DagArena::kNone) continue;
+            used[c] = 1;
+            if (view.visible(node)) used_visibly[c] = 1;
+        }
+    }
+    for (uint32_t node = 0; node < n; ++node) {
+        if (view.visible(node) && !operationLike(dag.kind[node]) && used[node] && !used_visibly[node]) view.hidden[node] = 1;
+    }
+}
+} // namespace view_detail
+
+// Which blocks and nodes to write; empty when the whole graph is wanted
+std::vector<BlockView> buildViews(const TacProgram& program, const std::vector<BlockDag>& blocks, const ViewOptions& options) {
+    std::vector<BlockView> views;
+    if (!options.scoped()) return views;
+    views.resize(blocks.size());
+    std::vector<uint32_t> first_id(blocks.size() + 1, 0);
+    for (size_t b = 0; b < blocks.size(); ++b) first_id[b + 1] = first_id[b] + static_cast<uint32_t>(blocks[b].dag.size());
+
+    for (uint32_t b = 0; b < blocks.size(); ++b) {
+        BlockView& view = views[b];
+        const std::string& name = program.functionName(program.functions[blocks[b].function]);
+        const bool by_function = std::find(options.functions.begin(), options.functions.end(), name.empty() ? "(top level)" : name) !=
+                                 options.functions.end();
+        const bool by_block = std::find(options.blocks.begin(), options.blocks.end(), b) != options.blocks.end();
+        view.selected = (options.functions.empty() && options.blocks.empty()) || by_function || by_block;
+        const size_t n = blocks[b].dag.size();
+        view.hidden.assign(n, view.selected ? 0 : 1);
+        view.cut.assign(n, 0);
+        view.summary.assign(n, DagArena::kNone);
+    }
+
+    uint32_t root_block = DagArena::kNone;
+    if (options.root != DagArena::kNone) {
+        root_block = static_cast<uint32_t>(std::upper_bound(first_id.begin(), first_id.end(), options.root) - first_id.begin()) - 1;
+        if (root_block >= blocks.size() || !views[root_block].selected) {
+            std::cerr << "DAG Warning: --root " << options.root << " is not a node of the selected blocks; ignored." << std::endl;
+            root_block = DagArena::kNone;
+        }
+    }
+    if (root_block != DagArena::kNone || options.max_nodes) {
+        // Breadth-first from each root in turn, a level at a time, until the cap
+        std::vector<std::pair<uint32_t, uint32_t>> roots, level, next; // (block, node)
+        std::vector<std::vector<uint8_t>> reached(blocks.size());
+        for (uint32_t b = 0; b < blocks.size(); ++b) {
+            if (!views[b].selected) continue;
+            const DagArena& dag = blocks[b].dag;
+            reached[b].assign(dag.size(), 0);
+            if (root_block != DagArena::kNone) {
+                if (b == root_block) roots.emplace_back(b, options.root - first_id[b]);
+                continue;
+            }
+            std::vector<uint8_t> used(dag.size(), 0);
+            for (uint32_t node = 0; node < dag.size(); ++node) {
+                if (dag.left[node] != DagArena::kNone) used[dag.left[node]] = 1;
+                if (dag.right[node] != DagArena::kNone) used[dag.right[node]] = 1;
+            }
+            for (uint32_t node = dag.size(); node-- > 0;) if (!used[node]) roots.emplace_back(b, node);
+        }
+        const size_t cap = options.max_nodes ? options.max_nodes : SIZE_MAX;
+        size_t taken = 0;
+        for (size_t r = 0; r < roots.size() && taken < cap; ++r) {
+            level.assign(1, roots[r]);
+            reached[roots[r].first][roots[r].second] = 1;
+            while (!level.empty() && taken < cap) {
+                if (level.size() > cap - taken) {
+                    for (size_t k = cap - taken; k < level.size(); ++k) reached[level[k].first][level[k].second] = 0;
+                    level.resize(cap - taken);
+                }
+                taken += level.size();
+                next.clear();
+                for (auto [b, node] : level) {
+                    const DagArena& dag = blocks[b].dag;
+                    for (uint32_t c : {dag.left[node], dag.right[node]}) {
+                        if (c != DagArena::kNone && !reached[b][c]) { reached[b][c] = 1; next.emplace_back(b, c); }
+                    }
+                }
+                level.swap(next);
+            }
+            for (auto [b, node] : level) reached[b][node] = 0; // Reached, but past the cap
+        }
+        for (uint32_t b = 0; b < blocks.size(); ++b) {
+            if (!views[b].selected) continue;
+            const DagArena& dag = blocks[b].dag;
+            for (uint32_t node = 0; node < dag.size(); ++node) {
+                views[b].hidden[node] = !reached[b][node];
+                for (uint32_t c : {dag.left[node], dag.right[node]}) {
+                    if (c != DagArena::kNone && reached[b][node] && !reached[b][c]) views[b].cut[node] = 1;
+                }
             }
         }
-        // 3. Unhandled Instruction Format
+    }
+    uint32_t next_summary_id = first_id.back();
+    for (uint32_t b = 0; b < blocks.size(); ++b) {
+        if (views[b].selected && options.collapse) view_detail::collapse(blocks[b].dag, views[b]);
+        views[b].first_summary_id = next_summary_id;
+        next_summary_id += static_cast<uint32_t>(views[b].summaries.size());
+        views[b].shown = views[b].summaries.size() + std::count(views[b].hidden.begin(), views[b].hidden.end(), 0);
+    }
+    return views;
+}
+
+// --- Graph Output ---
+// The block DAGs go straight from the arenas to the file through one fixed-size buffer, block by block, so
+// memory stays flat however large the program is. Node ids are global: a block's local ids offset by the
+// number of nodes before it. A node has at most two children, so dropping duplicate edges only needs the
+// left == right check (a node using one value twice gets one edge).
+//   dot     the Graphviz file the frontend renders, one cluster per block
+//   ndjson  one JSON object per line: {"type":"block",...}, then its {"type":"node",...} and {"type":"edge",...}
+//   bin     little-endian: "DAGEDGE1", u32 version, u32 block count, u64 node id count (summaries included),
+//           u64 edge count, u32 first node id per block (block count + 1 of them), then (u32 child, u32 parent)
+//           per edge
+// With views (see Graph Views) only the selected blocks and their visible nodes are written; an edge from a
+// node a summary stands for comes from the summary.
+enum class GraphFormat { Dot, Json, Binary };
+
+class GraphWriter {
+public:
+    static constexpr uint32_t kBinaryVersion = 1;
+    size_t nodes = 0, edges = 0, summaries = 0;
+    uint64_t bytes = 0;
+
+    GraphWriter(GraphFormat format, std::ostream& os) : format_(format), os_(os) { buf_.reserve(kBufferSize + 4096); }
+
+    void write(const TacProgram& program, const std::vector<BlockDag>& blocks, const std::vector<BlockView>& views) {
+        uint32_t first_id = 0;
+        for (uint32_t b = 0; b < blocks.size(); ++b) {
+            const BlockView* view = views.empty() ? nullptr : &views[b];
+            if (view && !view->shown) { first_id += static_cast<uint32_t>(blocks[b].dag.size()); continue; }
+            for (uint32_t node = 0; node < blocks[b].dag.size(); ++node) nodes += !view || view->visible(node);
+            if (view) summaries += view->summaries.size();
+            forEachEdge(blocks[b].dag, view, first_id, [&](uint32_t, uint32_t) { edges++; });
+            first_id += static_cast<uint32_t>(blocks[b].dag.size());
+        }
+        if (format_ == GraphFormat::Binary) writeBinary(blocks, views);
         else {
-             std::cerr << "DAG Warning: Skipping unparsed 3AC instruction: " << instruction << std::endl;
-             continue;
-        }
-
-        // --- Update Labels and Map ---
-        if (!lhs.empty() && result_node != nullptr) {
-            // Remove 'lhs' label from any node that currently has it
-             if(current_node_map.count(lhs)) {
-                 current_node_map[lhs]->labels.remove(lhs);
-             }
-            // Add 'lhs' label to the new result node (if not already present)
-            bool found = false;
-            for(const auto& lbl : result_node->labels) if(lbl == lhs) found=true;
-            if (!found) result_node->labels.push_back(lhs);
-
-            // Update the map: 'lhs' now points to this result node
-            current_node_map[lhs] = result_node;
-        }
-    } // End processing 3AC
-
-    // --- Generate DOT Output ---
-    dot_output.push_back("  // Nodes");
-    std::set<int> defined_node_ids; // Keep track of nodes already defined in DOT
-
-    for (const auto& node : dag_nodes) {
-         if(node->node_id < 0) continue; // Skip nodes that weren't properly assigned an ID (shouldn't happen)
-         if(defined_node_ids.count(node->node_id)) continue; // Already defined
-
-        std::stringstream node_def_ss;
-        std::string label_str = node->op; // Start with the operation/leaf name
-
-        // Sort and add variable labels associated with this node
-        if (!node->labels.empty()) {
-            label_str += "\\n["; // Newline before labels
-            node->labels.sort(); // Consistent output order
-            bool first_label = true;
-            for (const auto& label : node->labels) {
-                if (!first_label) label_str += ",";
-                label_str += label; first_label = false;
+            if (format_ == GraphFormat::Dot) {
+                if (!nodes && !summaries) buf_ += "digraph G {}\n";
+                else buf_ += "digraph G {\n  rankdir=TB;\n  node [shape=box, fontname=Consolas, fontsize=10];\n"
+                             "  edge [fontname=Consolas, fontsize=9];\n\n";
             }
-            label_str += "]";
+            first_id = 0;
+            for (uint32_t b = 0; b < blocks.size(); ++b) {
+                const BlockView* view = views.empty() ? nullptr : &views[b];
+                if (blocks[b].dag.size() && (!view || view->shown)) writeBlock(program, blocks[b], view, b, first_id);
+                first_id += static_cast<uint32_t>(blocks[b].dag.size());
+            }
+            if (format_ == GraphFormat::Dot && (nodes || summaries)) buf_ += "}\n";
         }
-        // Escape quotes in the final label string for DOT
-        std::replace(label_str.begin(), label_str.end(), '"', '\'');
+        drain();
+        os_.flush();
+    }
 
-        node_def_ss << "  N" << node->node_id << " [label=\"" << label_str << "\"];";
-        dot_output.push_back(node_def_ss.str());
-        defined_node_ids.insert(node->node_id);
+private:
+    static constexpr size_t kBufferSize = 1 << 20;
+    GraphFormat format_;
+    std::ostream& os_;
+    std::string buf_, text_;
+    std::vector<std::string> labels_; // One node's variable labels
+
+    // fn(child id, parent id) for each edge into a visible node
+    template <typename Fn>
+    static void forEachEdge(const DagArena& dag, const BlockView* view, uint32_t first_id, Fn fn) {
+        for (uint32_t node = 0; node < dag.size(); ++node) {
+            if (view && !view->visible(node)) continue;
+            uint32_t from[2];
+            int count = 0;
+            for (uint32_t c : {dag.left[node], dag.right[node]}) {
+                if (c == DagArena::kNone) continue;
+                uint32_t id = first_id + c;
+                if (view && !view->visible(c)) {
+                    if (view->summary[c] == DagArena::kNone) continue;
+                    id = view->first_summary_id + view->summary[c];
+                }
+                if (count == 1 && from[0] == id) continue;
+                from[count++] = id;
+            }
+            for (int k = 0; k < count; ++k) fn(from[k], first_id + node);
+        }
+    }
+    void drain() {
+        os_.write(buf_.data(), static_cast<std::streamsize>(buf_.size()));
+        bytes += buf_.size();
+        buf_.clear();
+    }
+    void number(uint64_t v) {
+        char digits[24];
+        buf_.append(digits, std::to_chars(digits, digits + sizeof digits, v).ptr);
+    }
+    void littleEndian(uint64_t v, int width) {
+        for (int k = 0; k < width; ++k) buf_ += static_cast<char>((v >> (8 * k)) & 0xFF);
+    }
+    void jsonString(const std::string& str) {
+        buf_ += '"';
+        for (char c : str) {
+            if (c == '"' || c == '\\') { buf_ += '\\'; buf_ += c; }
+            else if (static_cast<unsigned char>(c) < 0x20) {
+                static const char hex[] = "0123456789abcdef";
+                buf_ += "\\u00"; buf_ += hex[(c >> 4) & 0xF]; buf_ += hex[c & 0xF];
+            }
+            else buf_ += c;
+        }
+        buf_ += '"';
     }
 
-    dot_output.push_back("");
-    dot_output.push_back("  // Edges");
-    std::set<std::pair<int, int>> defined_edges; // Avoid duplicate edges
+    // The node's text (operation or leaf name) into text_, and its sorted variable labels into labels_
+    void describe(const TacProgram& program, const DagArena& dag, uint32_t node) {
+        auto operandOf = [](uint32_t bits) { Operand o; o.bits = bits; return o; };
+        text_.clear();
+        const bool named = dag.kind[node] != DagArena::Operation && dag.kind[node] != DagArena::Arg;
+        if (dag.kind[node] == DagArena::Input) text_ += "read ";
+        else if (dag.kind[node] == DagArena::Call || dag.kind[node] == DagArena::PureCall) text_ += "call ";
+        if (named) appendOperand(program, operandOf(dag.value[node]), text_);
+        if (dag.kind[node] == DagArena::Reload) text_ += " (reload)";
+        else if (dag.kind[node] == DagArena::PureCall) text_ += " (pure)";
+        else if (dag.kind[node] == DagArena::Arg) text_ += "param";
+        else if (dag.kind[node] == DagArena::Operation) text_ += tacOpSymbol(static_cast<TacOp>(dag.op[node]));
+        labels_.clear();
+        for (uint32_t slot = dag.label_head[node]; slot != DagArena::kNone; slot = dag.var_next[slot]) {
+            labels_.push_back(operandName(program, operandOf(dag.var_operand[slot])));
+        }
+        std::sort(labels_.begin(), labels_.end());
+    }
+    static const char* kindName(uint8_t kind) {
+        switch (kind) {
+            case DagArena::Leaf: return "leaf";
+            case DagArena::Reload: return "reload";
+            case DagArena::Input: return "read";
+            case DagArena::Call: return "call";
+            case DagArena::PureCall: return "pure_call";
+            case DagArena::Arg: return "param";
+            default: return "op";
+        }
+    }
 
-    for (const auto& node : dag_nodes) {
-         if(node->node_id < 0) continue;
+    void writeBlock(const TacProgram& program, const BlockDag& block, const BlockView* view, uint32_t index, uint32_t first_id) {
+        const DagArena& dag = block.dag;
+        const std::string& function_name = program.functionName(program.functions[block.function]);
+        const bool dot = format_ == GraphFormat::Dot;
+        if (dot) {
+            buf_ += "  subgraph cluster_"; number(index);
+            buf_ += " {\n    label=\""; buf_ += function_name.empty() ? "(top level)" : function_name; buf_ += " B"; number(index);
+            if (!block.label.isNone()) { buf_ += ' '; appendOperand(program, block.label, buf_); }
+            buf_ += "\";\n";
+        } else {
+            buf_ += "{\"type\":\"block\",\"id\":"; number(index);
+            buf_ += ",\"function\":"; jsonString(function_name);
+            buf_ += ",\"label\":"; jsonString(block.label.isNone() ? std::string() : operandName(program, block.label));
+            buf_ += ",\"first_node\":"; number(first_id);
+            buf_ += ",\"nodes\":"; number(dag.size());
+            buf_ += "}\n";
+        }
+        for (uint32_t node = 0; node < dag.size(); ++node) {
+            if (view && !view->visible(node)) continue;
+            describe(program, dag, node);
+            const bool cut = view && view->cut[node];
+            if (dot) {
+                if (!labels_.empty()) {
+                    text_ += "\\n[";
+                    for (size_t k = 0; k < labels_.size(); ++k) { if (k) text_ += ','; text_ += labels_[k]; }
+                    text_ += ']';
+                }
+                if (cut) text_ += "\\n(more)";
+                std::replace(text_.begin(), text_.end(), '"', '\''); // Escape quotes for DOT
+                buf_ += "    N"; number(first_id + node); buf_ += " [label=\""; buf_ += text_; buf_ += "\"];\n";
+            } else {
+                buf_ += "{\"type\":\"node\",\"id\":"; number(first_id + node);
+                buf_ += ",\"block\":"; number(index);
+                buf_ += ",\"kind\":\""; buf_ += kindName(dag.kind[node]);
+                buf_ += "\",\"text\":"; jsonString(text_);
+                buf_ += ",\"vars\":[";
+                for (size_t k = 0; k < labels_.size(); ++k) { if (k) buf_ += ','; jsonString(labels_[k]); }
+                buf_ += cut ? "],\"cut\":true}\n" : "]}\n";
+            }
+            if (buf_.size() >= kBufferSize) drain();
+        }
+        if (view) {
+            for (uint32_t s = 0; s < view->summaries.size(); ++s) {
+                const BlockView::Summary& summary = view->summaries[s];
+                describe(program, dag, summary.node);
+                if (dot) {
+                    buf_ += "    N"; number(view->first_summary_id + s); buf_ += " [shape=box3d, label=\""; buf_ += text_;
+                    buf_ += " pattern\\n"; number(summary.size); buf_ += " op(s) x"; number(summary.count); buf_ += "\"];\n";
+                } else {
+                    buf_ += "{\"type\":\"summary\",\"id\":"; number(view->first_summary_id + s);
+                    buf_ += ",\"block\":"; number(index);
+                    buf_ += ",\"text\":"; jsonString(text_);
+                    buf_ += ",\"size\":"; number(summary.size);
+                    buf_ += ",\"count\":"; number(summary.count); buf_ += "}\n";
+                }
+                if (buf_.size() >= kBufferSize) drain();
+            }
+        }
+        forEachEdge(dag, view, first_id, [&](uint32_t from, uint32_t to) {
+            if (dot) { buf_ += "    N"; number(from); buf_ += " -> N"; number(to); buf_ += ";\n"; }
+            else {
+                buf_ += "{\"type\":\"edge\",\"from\":"; number(from);
+                buf_ += ",\"to\":"; number(to); buf_ += "}\n";
+            }
+            if (buf_.size() >= kBufferSize) drain();
+        });
+        if (dot) buf_ += "  }\n";
+    }
 
-        // Add edges from children to parent (internal operation nodes)
-        if (node->left && node->left->node_id >= 0) {
-            auto edge = std::make_pair(node->left->node_id, node->node_id);
-            if (defined_edges.find(edge) == defined_edges.end()) {
-                dot_output.push_back("  N" + std::to_string(node->left->node_id) + " -> N" + std::to_string(node->node_id) + ";");
-                defined_edges.insert(edge);
+    void writeBinary(const std::vector<BlockDag>& blocks, const std::vector<BlockView>& views) {
+        uint64_t ids = summaries;
+        for (const BlockDag& block : blocks) ids += block.dag.size();
+        buf_ += "DAGEDGE1";
+        littleEndian(kBinaryVersion, 4);
+        littleEndian(blocks.size(), 4);
+        littleEndian(ids, 8);
+        littleEndian(edges, 8);
+        uint32_t first_id = 0;
+        for (const BlockDag& block : blocks) {
+            littleEndian(first_id, 4);
+            first_id += static_cast<uint32_t>(block.dag.size());
+            if (buf_.size() >= kBufferSize) drain();
+        }
+        littleEndian(first_id, 4);
+        first_id = 0;
+        for (uint32_t b = 0; b < blocks.size(); ++b) {
+            const BlockView* view = views.empty() ? nullptr : &views[b];
+            if (!view || view->shown) {
+                forEachEdge(blocks[b].dag, view, first_id, [&](uint32_t from, uint32_t to) {
+                    littleEndian(from, 4);
+                    littleEndian(to, 4);
+                    if (buf_.size() >= kBufferSize) drain();
+                });
             }
+            first_id += static_cast<uint32_t>(blocks[b].dag.size());
+        }
+    }
+};
+
+// --- Function to build the block DAGs ---
+std::vector<BlockDag> buildBlockDags(const TacProgram& program, const std::set<std::string>& initial_variables, ThreadPool& pool) {
+    std::vector<uint32_t> variables;
+    for (const std::string& var : initial_variables) {
+        auto it = program.symbols.index.find(var);
+        if (it != program.symbols.index.end()) variables.push_back(it->second);
+    }
+    std::sort(variables.begin(), variables.end());
+
+    // Pure functions (see tac_callgraph.h): no I/O, no global reads or writes, no unknown or recursive calls
+    CallGraph graph = buildCallGraph(program);
+    std::vector<FunctionSummary> summaries = summarizeFunctions(program, graph, pool);
+    std::vector<uint32_t> pure;
+    for (uint32_t f = 0; f < graph.size(); ++f) {
+        if (!program.functions[f].isTopLevel() && summaries[f].pure()) pure.push_back(program.functions[f].name);
+    }
+    std::sort(pure.begin(), pure.end());
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<BlockDag> blocks;
+    for (uint32_t f = 0; f < program.functions.size(); ++f) {
+        const std::vector<BasicBlock> ranges = partitionBlocks(program.functions[f].code);
+        for (uint32_t b = 0; b < ranges.size(); ++b) {
+            if (ranges[b].begin == ranges[b].end) continue;
+            blocks.emplace_back();
+            blocks.back().function = f;
+            blocks.back().block = b;
+            blocks.back().range = ranges[b];
         }
-         if (node->right && node->right->node_id >= 0) {
-             auto edge = std::make_pair(node->right->node_id, node->node_id);
-             if (defined_edges.find(edge) == defined_edges.end()) {
-                dot_output.push_back("  N" + std::to_string(node->right->node_id) + " -> N" + std::to_string(node->node_id) + ";");
-                 defined_edges.insert(edge);
-             }
-         }
     }
+    pool.parallelFor(blocks.size(), [&](size_t b) {
+        buildBlockDag(program, program.functions[blocks[b].function], variables, pure, blocks[b]);
+    });
 
-    dot_output.push_back("}"); // End DOT graph definition
+    size_t nodes = 0, reused = 0, shared_calls = 0;
+    CanonicalStats canonical;
+    for (const BlockDag& block : blocks) {
+        nodes += block.dag.size();
+        shared_calls += block.shared_calls;
+        reused += block.dag.reused;
+        canonical.add(block.canonical);
+        for (const std::string& warning : block.warnings) std::cerr << warning << std::endl;
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "DAG: Built " << blocks.size() << " block DAG(s) for " << program.functions.size() << " function(s) on " << pool.size()
+              << " thread(s): " << nodes << " node(s), " << reused << " operation(s) reused, " << ms << " ms" << std::endl;
+    std::cout << "DAG: Canonicalized " << canonical.folded << " constant fold(s), " << canonical.simplified << " identity simplification(s), "
+              << canonical.reordered << " operand reorder(s), " << canonical.shifts << " power-of-two shift(s)" << std::endl;
+    std::cout << "DAG: " << pure.size() << " pure function(s); " << shared_calls << " pure call(s) shared" << std::endl;
+    return blocks;
 }
 
 // --- Main Function ---
 int main(int argc, char* argv[]) {
-     if (argc != 3) { std::cerr << "Usage: dag_builder <3ac_input_file> <vars_input_file>\n"; return 1; }
-    std::string tac_input_file = argv[1];
-    std::string dag_vars_file = argv[2];
-    std::string dag_output_file = "dag.dot"; // Output DOT format
+    std::string tac_input_file, dag_vars_file;
+    std::string regenerated_file = "dag_3ac.txt"; // Optimized 3AC rebuilt from the DAGs
+    unsigned jobs = 0; // 0 = one per hardware thread
+    std::string dag_output_file; // Default: dag.dot, dag.ndjson or dag.bin
+    GraphFormat graph_format = GraphFormat::Dot;
+    ViewOptions view_options;
+    LatencyModel model;
+    bool list_schedule = true; // --schedule su: plain Sethi-Ullman order
+    bool usage = false;
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        if (arg == "--jobs" && a + 1 < argc) usage |= !parseCount(argv[++a], jobs);
+        else if (arg == "--3ac" && a + 1 < argc) regenerated_file = argv[++a];
+        else if (arg == "--graph" && a + 1 < argc) dag_output_file = argv[++a];
+        else if (arg == "--graph-format" && a + 1 < argc) {
+            std::string format = argv[++a];
+            if (format == "dot") graph_format = GraphFormat::Dot;
+            else if (format == "ndjson") graph_format = GraphFormat::Json;
+            else if (format == "bin") graph_format = GraphFormat::Binary;
+            else usage = true;
+        }
+        else if (arg == "--function" && a + 1 < argc) view_options.functions.push_back(argv[++a]);
+        else if (arg == "--block" && a + 1 < argc) usage |= !parseCount(argv[++a], view_options.blocks.emplace_back());
+        else if (arg == "--root" && a + 1 < argc) usage |= !parseCount(argv[++a], view_options.root);
+        else if (arg == "--max-nodes" && a + 1 < argc) usage |= !parseCount(argv[++a], view_options.max_nodes);
+        else if (arg == "--collapse") view_options.collapse = true;
+        else if (arg == "--latency" && a + 1 < argc) usage |= !model.parse(argv[++a]);
+        else if (arg == "--schedule" && a + 1 < argc) {
+            std::string mode = argv[++a];
+            usage |= mode != "list" && mode != "su";
+            list_schedule = mode == "list";
+        }
+        else if (tac_input_file.empty()) tac_input_file = arg;
+        else if (dag_vars_file.empty()) dag_vars_file = arg;
+        else usage = true;
+    }
+    if (usage || dag_vars_file.empty()) {
+        std::cerr << "Usage: dag_builder <3ac_input_file (text or binary)> <vars_input_file> [--jobs N] [--3ac FILE] [--schedule list|su]\n"
+                     "                   [--latency add=1,mul=3,div=20,load=4,call=25,issue=2] [--graph FILE]\n"
+                     "                   [--graph-format dot|ndjson|bin] [--function NAME]... [--block K]... [--root ID]\n"
+                     "                   [--max-nodes N] [--collapse]\n";
+        return 1;
+    }
+    if (dag_output_file.empty()) {
+        dag_output_file = graph_format == GraphFormat::Dot ? "dag.dot" : graph_format == GraphFormat::Json ? "dag.ndjson" : "dag.bin";
+    }
 
     std::set<std::string> initial_vars = readVariableNames(dag_vars_file);
-    std::vector<std::string> three_addr_code = read3AC(tac_input_file);
-    if (three_addr_code.empty() && !std::ifstream(tac_input_file)) { std::cerr << "DAG Error: 3AC input file not found or empty.\n"; return 1; }
-    else if (three_addr_code.empty()) { std::cout << "DAG Warning: 3AC input file is empty.\n"; }
+    TacProgram program;
+    if (isTacBinaryFile(tac_input_file)) { // Written by intermediate_gen --binary: mapped, no text parsing
+        auto load_start = std::chrono::steady_clock::now();
+        std::string error;
+        if (!readTacBinary(tac_input_file, program, error)) { std::cerr << "DAG Error: " << error << std::endl; return 1; }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - load_start).count();
+        std::cout << "DAG: Loaded binary 3AC (version " << kTacBinaryVersion << ") from " << tac_input_file << ": "
+                  << countInstructions(program) << " instruction(s), " << ms << " ms" << std::endl;
+    } else {
+        std::vector<std::string> three_addr_code = read3AC(tac_input_file);
+        program = parseTacText(three_addr_code);
+        if (three_addr_code.empty() && !std::ifstream(tac_input_file)) { std::cerr << "DAG Error: 3AC input file not found or empty.\n"; return 1; }
+        else if (three_addr_code.empty()) { std::cout << "DAG Warning: 3AC input file is empty.\n"; }
+    }
 
     std::cout << "DAG: Building DAG from 3AC and variables..." << std::endl;
-    std::vector<std::string> dot_representation;
-    buildAndGenerateDot(three_addr_code, initial_vars, dot_representation);
+    ThreadPool pool(jobs);
+    std::vector<BlockDag> blocks = buildBlockDags(program, initial_vars, pool);
 
-    std::ofstream outfile(dag_output_file);
+    ScheduleStats schedule;
+    TacProgram regenerated = regenerateProgram(program, blocks, model, list_schedule, pool, schedule);
+    std::ofstream tac_outfile(regenerated_file);
+    if (!tac_outfile) { std::cerr << "Error: Cannot open 3AC output file: " << regenerated_file << std::endl; return 1; }
+    tac_outfile << "# Three-Address Code (regenerated from the block DAGs)\n";
+    writeTacText(regenerated, tac_outfile);
+    std::cout << "DAG: Regenerated 3AC written to " << regenerated_file << ": " << countInstructions(program) << " -> "
+              << countInstructions(regenerated) << " instruction(s), " << countTemps(program) << " -> " << countTemps(regenerated)
+              << " temp(s)" << std::endl;
+    std::cout << "DAG: Scheduled (" << (list_schedule ? "list" : "Sethi-Ullman") << "): estimated " << schedule.cycles_before << " -> "
+              << schedule.cycles_after << " cycle(s) at issue width " << model.issue << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    std::ofstream outfile(dag_output_file, std::ios::binary);
     if (!outfile) { std::cerr << "Error: Cannot open DAG output file: " << dag_output_file << std::endl; return 1; }
-    if (dot_representation.size() <= 2) { // Only contains boilerplate
-        outfile << "digraph G {}\n"; // Empty graph if no nodes/edges generated
-        std::cout << "DAG Warning: Generated empty DAG (likely due to empty/unprocessed 3AC)." << std::endl;
-    }
-    else {
-        for (const auto& line : dot_representation) outfile << line << std::endl;
-        std::cout << "DAG: DOT generation complete. Written to " << dag_output_file << std::endl;
+    GraphWriter writer(graph_format, outfile);
+    writer.write(program, blocks, buildViews(program, blocks, view_options));
+    if (!outfile) { std::cerr << "Error: Failed writing DAG output file: " << dag_output_file << std::endl; return 1; }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (!writer.nodes && !writer.summaries) {
+        if (view_options.scoped()) std::cout << "DAG Warning: No nodes in the selected view (check --function/--block/--root)." << std::endl;
+        else std::cout << "DAG Warning: Generated empty DAG (likely due to empty/unprocessed 3AC)." << std::endl;
     }
-    outfile.close();
+    std::cout << "DAG: Graph written to " << dag_output_file << ": " << writer.nodes << " node(s), "
+              << (writer.summaries ? std::to_string(writer.summaries) + " summary node(s), " : std::string()) << writer.edges << " edge(s), "
+              << writer.bytes << " byte(s), " << ms << " ms" << std::endl;
 
     return 0;
 }
\ No newline at end of file
@@ -13,9 +13,13 @@ SYNTAX_EXE_BASE = "syntax_analyzer"
 AST_OUTPUT_FILENAME = "ast_output.txt" # AST output (standard)
 ICG_EXE_BASE = "intermediate_gen"
 PIPELINE_TAC_OUTPUT_FILENAME = "3ac_output.txt" # ICG writes here
+PIPELINE_TAC_BINARY_FILENAME = "3ac_output.tacb" # ICG writes the same 3AC here in binary; the DAG builder maps it instead of parsing text
 PIPELINE_DAG_VARS_FILENAME = "dag_vars.txt"   # ICG writes here
 DAG_EXE_BASE = "dag_builder"
 PIPELINE_DAG_OUTPUT_FILENAME = "dag.dot"      # DAG builder writes here
+PIPELINE_DAG_VIEW_FILENAME = "dag_view.dot"   # DAG builder writes the scoped view here (DAG tab)
+PIPELINE_DAG_VIEW_TAC_FILENAME = "dag_view_3ac.txt" # Scratch 3AC the view run regenerates, so dag_3ac.txt is left alone
+DAG_VIEW_MAX_NODES = 2000                     # Default node cap for the scoped view, so Graphviz and the tab stay fast
 
 # --- Filenames containing the CORRECT/MANUAL output to DISPLAY ---
 DISPLAY_TAC_OUTPUT_FILENAME = "3ac_output1.txt"
@@ -101,6 +105,15 @@ class FullCompilerSimApp(tk.Tk):
         ttk.Label(self.tac_frame, text="Three-Address Code (Corrected - from file):", font=self.heading_font).pack(anchor='w', pady=(0, 5)) # Updated label
         self.tac_text = scrolledtext.ScrolledText(self.tac_frame, height=10, wrap=tk.WORD, font=self.code_font, state=tk.DISABLED, relief=tk.SOLID, borderwidth=1); self.tac_text.pack(fill=tk.BOTH, expand=True)
         ttk.Label(self.dag_frame, text="DAG (Corrected .dot - from file):", font=self.heading_font).pack(anchor='w', pady=(0, 5)) # Updated label
+        dag_view_bar = ttk.Frame(self.dag_frame); dag_view_bar.pack(fill=tk.X, pady=(0, 5))
+        ttk.Label(dag_view_bar, text="Function:", font=self.label_font).pack(side=tk.LEFT)
+        self.dag_function_entry = ttk.Entry(dag_view_bar, width=24, font=self.code_font); self.dag_function_entry.pack(side=tk.LEFT, padx=(5, 10))
+        ttk.Label(dag_view_bar, text="Max nodes:", font=self.label_font).pack(side=tk.LEFT)
+        self.dag_max_nodes = tk.StringVar(value=str(DAG_VIEW_MAX_NODES))
+        ttk.Spinbox(dag_view_bar, from_=10, to=1000000, increment=100, width=8, textvariable=self.dag_max_nodes).pack(side=tk.LEFT, padx=(5, 10))
+        self.dag_collapse = tk.BooleanVar(value=True); ttk.Checkbutton(dag_view_bar, text="Collapse repeats", variable=self.dag_collapse).pack(side=tk.LEFT, padx=(0, 10))
+        self.dag_view_button = ttk.Button(dag_view_bar, text="Show Function DAG", command=self.show_dag_view_threaded); self.dag_view_button.pack(side=tk.LEFT)
+        if self.error_msg_startup: self.dag_view_button.config(state=tk.DISABLED)
         self.dag_text = scrolledtext.ScrolledText(self.dag_frame, height=10, wrap=tk.NONE, font=self.code_font, state=tk.DISABLED, relief=tk.SOLID, borderwidth=1); self.dag_text.pack(fill=tk.BOTH, expand=True)
         ttk.Label(self.bottom_frame, text="Compiler Messages/Errors:", font=self.label_font).pack(anchor='w')
         self.error_text = scrolledtext.ScrolledText(self.bottom_frame, height=6, wrap=tk.WORD, font=self.code_font, state=tk.DISABLED, relief=tk.SOLID, borderwidth=1); self.error_text.pack(fill=tk.X, expand=True)
@@ -146,6 +159,7 @@ class FullCompilerSimApp(tk.Tk):
         self.abs_lexer_out = os.path.join(self.script_dir, LEXER_OUTPUT_FILENAME)
         self.abs_ast_out = os.path.join(self.script_dir, AST_OUTPUT_FILENAME)
         self.abs_pipeline_tac_out = os.path.join(self.script_dir, PIPELINE_TAC_OUTPUT_FILENAME) # 3ac_output.txt
+        self.abs_pipeline_tac_bin = os.path.join(self.script_dir, PIPELINE_TAC_BINARY_FILENAME) # 3ac_output.tacb
         self.abs_pipeline_dag_vars = os.path.join(self.script_dir, PIPELINE_DAG_VARS_FILENAME) # dag_vars.txt
         self.abs_pipeline_dag_out = os.path.join(self.script_dir, PIPELINE_DAG_OUTPUT_FILENAME) # dag.dot
 
@@ -167,7 +181,7 @@ class FullCompilerSimApp(tk.Tk):
 
         # --- Cleanup PIPELINE Output Files ---
         # Only clean the files the C++ pipeline ACTUALLY writes to
-        files_to_clean = [self.abs_lexer_out, self.abs_ast_out, self.abs_pipeline_tac_out, self.abs_pipeline_dag_vars, self.abs_pipeline_dag_out]
+        files_to_clean = [self.abs_lexer_out, self.abs_ast_out, self.abs_pipeline_tac_out, self.abs_pipeline_tac_bin, self.abs_pipeline_dag_vars, self.abs_pipeline_dag_out]
         for f_path in files_to_clean:
             try:
                 if os.path.exists(f_path): os.remove(f_path)
@@ -197,9 +211,9 @@ class FullCompilerSimApp(tk.Tk):
             { "name": "Lexer", "cmd": [self.lexer_path, cpp_filepath], "in_files": [], "out_files": [self.abs_lexer_out], "result_key": "lexer" },
             { "name": "Syntax Analyzer", "cmd": [self.syntax_path, self.abs_lexer_out], "in_files": [self.abs_lexer_out], "out_files": [self.abs_ast_out], "result_key": "ast" },
             { # ICG writes to PIPELINE files
-              "name": "Intermediate Code Gen", "cmd": [self.icg_path, self.abs_lexer_out], "in_files": [self.abs_lexer_out], "out_files": [self.abs_pipeline_tac_out, self.abs_pipeline_dag_vars], "result_key": "tac_pipeline" },
+              "name": "Intermediate Code Gen", "cmd": [self.icg_path, self.abs_lexer_out, "--binary", self.abs_pipeline_tac_bin], "in_files": [self.abs_lexer_out], "out_files": [self.abs_pipeline_tac_out, self.abs_pipeline_tac_bin, self.abs_pipeline_dag_vars], "result_key": "tac_pipeline" },
             { # DAG builder reads PIPELINE files, writes PIPELINE file
-              "name": "DAG Builder", "cmd": [self.dag_path, self.abs_pipeline_tac_out, self.abs_pipeline_dag_vars], "in_files": [self.abs_pipeline_tac_out, self.abs_pipeline_dag_vars], "out_files": [self.abs_pipeline_dag_out], "result_key": "dag_pipeline" }
+              "name": "DAG Builder", "cmd": [self.dag_path, self.abs_pipeline_tac_bin, self.abs_pipeline_dag_vars], "in_files": [self.abs_pipeline_tac_bin, self.abs_pipeline_dag_vars], "out_files": [self.abs_pipeline_dag_out], "result_key": "dag_pipeline" }
         ]
 
         # --- Run the Pipeline ---
@@ -281,6 +295,7 @@ class FullCompilerSimApp(tk.Tk):
         self.append_error_text(f"- {LEXER_OUTPUT_FILENAME}")
         self.append_error_text(f"- {AST_OUTPUT_FILENAME}")
         self.append_error_text(f"- {PIPELINE_TAC_OUTPUT_FILENAME}") # The standard 3AC file
+        self.append_error_text(f"- {PIPELINE_TAC_BINARY_FILENAME}") # The same 3AC in binary, read by the DAG builder
         self.append_error_text(f"- {PIPELINE_DAG_VARS_FILENAME}")  # The standard Vars file
         self.append_error_text(f"- {PIPELINE_DAG_OUTPUT_FILENAME}") # The standard DAG file
         self.append_error_text(f"Displaying content from:")
@@ -320,6 +335,41 @@ class FullCompilerSimApp(tk.Tk):
         else: self.dag_text.insert('1.0', "(No DAG .dot content found in display file)")
         self.dag_text.config(state=tk.DISABLED)
 
+    # --- Scoped DAG view (DAG tab) ---
+    def show_dag_view_threaded(self):
+        """Reruns the DAG builder on the last pipeline's 3AC, scoped to one function and capped, and shows that DOT."""
+        tac_file = os.path.join(self.script_dir, PIPELINE_TAC_BINARY_FILENAME); vars_file = os.path.join(self.script_dir, PIPELINE_DAG_VARS_FILENAME)
+        if not os.path.exists(tac_file) or not os.path.exists(vars_file): messagebox.showinfo("DAG View", f"Run an analysis first: the view is built from {PIPELINE_TAC_BINARY_FILENAME}."); return
+        try: max_nodes = int(self.dag_max_nodes.get())
+        except ValueError: max_nodes = 0
+        if max_nodes <= 0: messagebox.showwarning("DAG View", "Max nodes must be a positive whole number."); return
+        view_file = os.path.join(self.script_dir, PIPELINE_DAG_VIEW_FILENAME)
+        scratch_tac = os.path.join(self.script_dir, PIPELINE_DAG_VIEW_TAC_FILENAME)
+        cmd = [self.dag_path, tac_file, vars_file, "--graph", view_file, "--3ac", scratch_tac, "--max-nodes", str(max_nodes)]
+        function_name = self.dag_function_entry.get().strip() # Empty: the whole program, still capped
+        if function_name: cmd += ["--function", function_name]
+        if self.dag_collapse.get(): cmd.append("--collapse")
+        self.dag_view_button.config(state=tk.DISABLED); self.update_status(f"Building DAG view for {function_name or 'the whole program'}...")
+        threading.Thread(target=self.run_dag_view, args=(cmd, view_file), daemon=True).start()
+
+    def run_dag_view(self, cmd, view_file):
+        content, messages = None, []
+        try:
+            if os.path.exists(view_file): os.remove(view_file)
+            proc = subprocess.run(cmd, capture_output=True, text=True, check=False, encoding='utf-8', errors='ignore', cwd=self.script_dir)
+            messages = [line for line in (proc.stdout + proc.stderr).splitlines() if "Graph written" in line or "Warning" in line or "Error" in line]
+            if proc.returncode != 0: messages.append(f"Error: DAG Builder failed (Exit Code: {proc.returncode})")
+            elif os.path.exists(view_file):
+                with open(view_file, 'r', encoding='utf-8') as f: content = f.read()
+        except Exception as e: messages.append(f"Python error while building the DAG view: {e}")
+        self.after(0, self.update_gui_after_dag_view, content, messages)
+
+    def update_gui_after_dag_view(self, content, messages):
+        self.dag_view_button.config(state=tk.NORMAL)
+        for msg in messages: self.append_error_text(msg)
+        if content is not None: self.display_dag_results(content); self.update_status(f"DAG view written to {PIPELINE_DAG_VIEW_FILENAME}")
+        else: self.update_status("DAG view failed (see messages).")
+
 
 # --- Main Execution --- (No changes needed here) ---
 if __name__ == "__main__":
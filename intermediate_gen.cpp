@@ -7,6 +7,17 @@
 #include <set>
 #include <algorithm>
 #include <stdexcept>
+#include <chrono>
+#include <memory>
+#include "tac_ir.h"
+#include "tac_binary.h"
+#include "tac_cfg.h"
+#include "tac_dataflow.h"
+#include "tac_passes.h"
+#include "tac_regalloc.h"
+#include "tac_callgraph.h"
+#include "tac_interproc.h"
+#include "thread_pool.h"
 
 // --- Token Struct (same) ---
 struct Token {
@@ -50,11 +61,53 @@ std::vector<Token> parseLexerOutputFileWithLines(const std::string& filename) {
     return tokens;
 }
 
-// --- 3AC Generator State (same) ---
-int temp_count = 0;
-int label_count = 0;
-std::string newTemp() { return "t" + std::to_string(temp_count++); }
-std::string newLabel() { return "L" + std::to_string(label_count++); }
+// --- Per-Unit Lowering Context ---
+// All generation state lives here (no globals), so independent units can be lowered concurrently.
+// Temporaries, labels, symbols and constants are numbered locally; mergeLoweredUnit renumbers them.
+struct LoweringContext {
+    const std::vector<Token>& tokens;
+    TacProgram program;
+    std::set<std::string> variables;
+    std::set<std::string> char_variables; // 3AC names of the variables declared char: cout prints them as characters
+    uint32_t temp_count = 0;
+    uint32_t label_count = 0;
+    bool inside_function = false;
+    const std::set<std::string>* global_names = nullptr; // File-scope variables of the whole program (set for function units)
+    std::vector<std::map<std::string, std::string>> scopes; // Open scopes of the function being lowered: source name -> 3AC name
+    std::map<std::string, uint32_t> shadow_count;          // Fresh names handed out so far, per source name
+    std::vector<std::pair<Operand, Operand>> loop_labels; // (break, continue) targets of the enclosing loops and switches (None: no target)
+
+    explicit LoweringContext(const std::vector<Token>& t) : tokens(t) {}
+
+    Operand newTemp() { return Operand::temp(temp_count++); }
+    Operand newLabel() { return Operand::label(label_count++); }
+
+    // The 3AC name a source identifier refers to: its innermost visible declaration, else the identifier itself
+    const std::string& resolve(const std::string& name) const {
+        for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+            auto it = scope->find(name);
+            if (it != scope->end()) return it->second;
+        }
+        return name;
+    }
+    // Declares a variable in the innermost scope. A local that hides a visible declaration (an enclosing block's
+    // or a global) gets a 3AC name of its own, x.1, x.2, ..., which no source identifier can spell.
+    std::string declare(const std::string& name) {
+        if (scopes.empty()) return name; // File scope
+        bool hides = global_names && global_names->count(name);
+        for (const auto& scope : scopes) hides = hides || scope.count(name);
+        std::string local = hides ? name + "." + std::to_string(++shadow_count[name]) : name;
+        scopes.back()[name] = local;
+        return local;
+    }
+
+    // The function being lowered (or a top-level segment outside functions)
+    TacFunction& current() {
+        if (!inside_function && (program.functions.empty() || !program.functions.back().isTopLevel())) program.functions.emplace_back();
+        return program.functions.back();
+    }
+    void emit(const TacInstr& instr) { current().code.push_back(instr); }
+};
 
 // --- Helper to find end of a simple statement (ends with ;) or block ({}) ---
 size_t findEndOfStatementOrBlock(const std::vector<Token>& tokens, size_t start_index) {
@@ -84,43 +137,517 @@ size_t findEndOfStatementOrBlock(const std::vector<Token>& tokens, size_t start_
  }
 
 
+// --- Expression Trees ---
+// Expressions are parsed by precedence climbing into a flat node pool, then lowered to 3AC.
+struct ExprNode {
+    enum class Kind { Leaf, Unary, Binary, Logical, Assign, Call, IncDec, Ternary };
+    Kind kind = Kind::Leaf;
+    std::string text;            // Operator lexeme ("+", "&&", "+=", "++"), leaf lexeme or callee name
+    bool is_identifier = false;  // Leaf: identifier (true) or literal (false)
+    bool is_prefix = false;      // IncDec: ++x (true) or x++ (false)
+    int lhs = -1, rhs = -1, cond = -1;
+    std::vector<int> args;       // Call arguments
+};
+
+// Binary operator precedence (C rules); 0 means "not a binary operator"
+int binaryPrecedence(const std::string& op) {
+    if (op == "||") return 1;
+    if (op == "&&") return 2;
+    if (op == "|") return 3;
+    if (op == "^") return 4;
+    if (op == "&") return 5;
+    if (op == "==" || op == "!=") return 6;
+    if (op == "<" || op == "<=" || op == ">" || op == ">=") return 7;
+    if (op == "<<" || op == ">>") return 8;
+    if (op == "+" || op == "-") return 9;
+    if (op == "*" || op == "/" || op == "%") return 10;
+    return 0;
+}
+
+bool isAssignmentOperator(const std::string& op) {
+    return op == "=" || op == "+=" || op == "-=" || op == "*=" || op == "/=" || op == "%=" ||
+           op == "<<=" || op == ">>=" || op == "&=" || op == "|=" || op == "^=";
+}
+
+bool isTypeKeyword(const std::string& lex) {
+    static const std::set<std::string> type_keywords = { "int", "float", "double", "char", "long", "short", "unsigned", "signed",
+                                                         "const", "static", "auto", "void", "volatile", "register", "extern" };
+    return type_keywords.count(lex) > 0;
+}
+
+// True if the type words in [from, to) name a plain signed integer type (the only values the optimizer folds)
+bool isSignedIntegerType(const std::vector<Token>& tokens, size_t from, size_t to) {
+    static const std::set<std::string> integer_words = { "int", "long", "short", "signed", "const", "static", "register", "extern" };
+    if (from >= to) return false;
+    for (size_t k = from; k < to; ++k) if (!integer_words.count(tokens[k].lexeme)) return false;
+    return true;
+}
+
+// True for char, signed char and unsigned char, with the same storage words
+bool isCharType(const std::vector<Token>& tokens, size_t from, size_t to) {
+    static const std::set<std::string> char_words = { "char", "signed", "unsigned", "const", "static", "register", "extern" };
+    bool has_char = false;
+    for (size_t k = from; k < to; ++k) {
+        if (!char_words.count(tokens[k].lexeme)) return false;
+        has_char = has_char || tokens[k].lexeme == "char";
+    }
+    return has_char;
+}
+
+// --- Expression Parser ---
+// Parses tokens in [pos, end). Any construct it does not understand sets ok = false.
+struct ExprParser {
+    const std::vector<Token>& tokens;
+    size_t pos;
+    size_t end;
+    std::vector<ExprNode> nodes;
+    bool ok = true;
+
+    ExprParser(const std::vector<Token>& t, size_t start, size_t stop) : tokens(t), pos(start), end(stop) {}
+
+    bool atEnd() const { return pos >= end; }
+    const std::string& peek(size_t ahead = 0) const { static const std::string none; return (pos + ahead < end) ? tokens[pos + ahead].lexeme : none; }
+    int add(ExprNode node) { nodes.push_back(std::move(node)); return static_cast<int>(nodes.size()) - 1; }
+    int fail() { ok = false; return -1; }
+
+    int parseAssignment() {
+        int lhs = parseTernary();
+        if (!ok) return -1;
+        if (!atEnd() && tokens[pos].type_str == "OPERATOR" && isAssignmentOperator(peek())) {
+            if (nodes[lhs].kind != ExprNode::Kind::Leaf || !nodes[lhs].is_identifier) return fail(); // Only plain variables are assignable
+            ExprNode node; node.kind = ExprNode::Kind::Assign; node.text = peek(); pos++;
+            node.lhs = lhs;
+            node.rhs = parseAssignment();
+            return ok ? add(node) : -1;
+        }
+        return lhs;
+    }
+
+    int parseTernary() {
+        int cond = parseBinary(1);
+        if (!ok || peek() != "?") return cond;
+        pos++;
+        ExprNode node; node.kind = ExprNode::Kind::Ternary; node.cond = cond;
+        node.lhs = parseAssignment();
+        if (!ok || peek() != ":") return fail();
+        pos++;
+        node.rhs = parseTernary();
+        return ok ? add(node) : -1;
+    }
+
+    int parseBinary(int min_prec) {
+        int left = parseUnary();
+        while (ok && !atEnd() && tokens[pos].type_str == "OPERATOR") {
+            const std::string op = peek();
+            int prec = binaryPrecedence(op);
+            if (prec == 0 || prec < min_prec) break;
+            pos++;
+            int right = parseBinary(prec + 1);
+            if (!ok) return -1;
+            ExprNode node; node.kind = (op == "&&" || op == "||") ? ExprNode::Kind::Logical : ExprNode::Kind::Binary;
+            node.text = op; node.lhs = left; node.rhs = right;
+            left = add(node);
+        }
+        return ok ? left : -1;
+    }
+
+    int parseUnary() {
+        if (atEnd()) return fail();
+        const std::string op = peek();
+        if (tokens[pos].type_str == "OPERATOR" && (op == "-" || op == "+" || op == "!" || op == "~")) {
+            pos++;
+            ExprNode node; node.kind = ExprNode::Kind::Unary; node.text = op; node.lhs = parseUnary();
+            return ok ? add(node) : -1;
+        }
+        if (op == "++" || op == "--") {
+            pos++;
+            ExprNode node; node.kind = ExprNode::Kind::IncDec; node.text = op; node.is_prefix = true; node.lhs = parseUnary();
+            if (!ok || nodes[node.lhs].kind != ExprNode::Kind::Leaf || !nodes[node.lhs].is_identifier) return fail();
+            return add(node);
+        }
+        // C-style cast "( type ) expr" - types are not tracked, so the cast is dropped
+        if (op == "(" && pos + 2 < end && isTypeKeyword(tokens[pos + 1].lexeme)) {
+            size_t close = pos + 1;
+            while (close < end && isTypeKeyword(tokens[close].lexeme)) close++;
+            if (close < end && tokens[close].lexeme == ")") { pos = close + 1; return parseUnary(); }
+        }
+        return parsePostfix();
+    }
+
+    int parsePostfix() {
+        int primary = parsePrimary();
+        if (!ok) return -1;
+        if (peek() == "(" && nodes[primary].is_identifier) {
+            pos++;
+            ExprNode call; call.kind = ExprNode::Kind::Call; call.text = nodes[primary].text;
+            if (peek() != ")") {
+                while (true) {
+                    call.args.push_back(parseAssignment());
+                    if (!ok) return -1;
+                    if (peek() == ",") { pos++; continue; }
+                    break;
+                }
+            }
+            if (peek() != ")") return fail();
+            pos++;
+            primary = add(call);
+        }
+        while (ok && (peek() == "++" || peek() == "--")) {
+            if (nodes[primary].kind != ExprNode::Kind::Leaf || !nodes[primary].is_identifier) return fail();
+            ExprNode node; node.kind = ExprNode::Kind::IncDec; node.text = peek(); node.lhs = primary; pos++;
+            primary = add(node);
+        }
+        return primary;
+    }
+
+    int parsePrimary() {
+        if (atEnd()) return fail();
+        const Token& tok = tokens[pos];
+        if (tok.lexeme == "(") {
+            pos++;
+            int inner = parseAssignment();
+            if (!ok || peek() != ")") return fail();
+            pos++;
+            return inner;
+        }
+        ExprNode leaf;
+        if (tok.type_str == "IDENTIFIER") { leaf.text = tok.lexeme; leaf.is_identifier = true; }
+        else if (tok.type_str.find("LITERAL") != std::string::npos) { leaf.text = tok.lexeme; }
+        else if (tok.lexeme == "true" || tok.lexeme == "false") { leaf.text = (tok.lexeme == "true") ? "1" : "0"; }
+        else return fail();
+        pos++;
+        return add(leaf);
+    }
+};
+
+// --- Expression Lowering ---
+// lower() evaluates a node into an operand. When 'target' is given the value is computed straight
+// into it (so "c = a * b" needs no temporary); when 'want_value' is false only side effects are kept.
+struct ExprLowerer {
+    const ExprParser& expr;
+    LoweringContext& ctx;
+
+    const ExprNode& node(int n) const { return expr.nodes[n]; }
+
+    Operand variable(const std::string& name) {
+        const std::string& local = ctx.resolve(name);
+        ctx.variables.insert(local);
+        return ctx.program.symbol(local);
+    }
+
+    // No side effects and cannot trap, so evaluating it when C++ would skip it (the right side of && / ||)
+    // changes nothing. Division and modulo trap on a zero divisor: "x != 0 && y / x > 1" must stay lazy.
+    bool isPure(int n) const {
+        const ExprNode& e = node(n);
+        switch (e.kind) {
+            case ExprNode::Kind::Leaf: return true;
+            case ExprNode::Kind::Assign: case ExprNode::Kind::Call: case ExprNode::Kind::IncDec: return false;
+            case ExprNode::Kind::Unary: return isPure(e.lhs);
+            case ExprNode::Kind::Ternary: return isPure(e.cond) && isPure(e.lhs) && isPure(e.rhs);
+            case ExprNode::Kind::Binary:
+                if (e.text == "/" || e.text == "%") return false;
+                return isPure(e.lhs) && isPure(e.rhs);
+            default: return isPure(e.lhs) && isPure(e.rhs);
+        }
+    }
+
+    Operand into(Operand value, Operand target) {
+        if (target.isNone() || value == target) return value;
+        ctx.emit(TacInstr(TacOp::Copy, target, value));
+        return target;
+    }
+
+    Operand lower(int n, Operand target = Operand(), bool want_value = true) {
+        const ExprNode& e = node(n);
+        switch (e.kind) {
+            case ExprNode::Kind::Leaf: {
+                Operand value = e.is_identifier ? variable(e.text) : ctx.program.constant(e.text);
+                return want_value ? into(value, target) : Operand();
+            }
+            case ExprNode::Kind::Unary: {
+                if (!want_value) { lower(e.lhs, Operand(), false); return Operand(); }
+                if (e.text == "+") return lower(e.lhs, target);
+                const ExprNode& child = node(e.lhs);
+                if (e.text == "-" && child.kind == ExprNode::Kind::Leaf && !child.is_identifier && child.text[0] != '-') {
+                    return into(ctx.program.constant("-" + child.text), target); // Negative literal
+                }
+                Operand value = lower(e.lhs);
+                Operand dest = target.isNone() ? ctx.newTemp() : target;
+                ctx.emit(TacInstr(unaryOpFromLexeme(e.text), dest, value));
+                return dest;
+            }
+            case ExprNode::Kind::Binary: {
+                if (!want_value) { lower(e.lhs, Operand(), false); lower(e.rhs, Operand(), false); return Operand(); }
+                Operand a = lower(e.lhs);
+                Operand b = lower(e.rhs);
+                Operand dest = target.isNone() ? ctx.newTemp() : target;
+                ctx.emit(TacInstr(binaryOpFromLexeme(e.text), dest, a, b));
+                return dest;
+            }
+            case ExprNode::Kind::Logical: {
+                bool is_and = (e.text == "&&");
+                if (!want_value) { // Only the short-circuited side effects matter
+                    Operand skip = ctx.newLabel();
+                    if (is_and) branchFalse(e.lhs, skip); else branchTrue(e.lhs, skip);
+                    lower(e.rhs, Operand(), false);
+                    ctx.emit(TacInstr(TacOp::Label, Operand(), skip));
+                    return Operand();
+                }
+                if (isPure(e.rhs)) { // No observable difference: keep it a single instruction the DAG can share
+                    Operand a = lower(e.lhs);
+                    Operand b = lower(e.rhs);
+                    Operand dest = target.isNone() ? ctx.newTemp() : target;
+                    ctx.emit(TacInstr(is_and ? TacOp::LogAnd : TacOp::LogOr, dest, a, b));
+                    return dest;
+                }
+                Operand dest = target.isNone() ? ctx.newTemp() : target;
+                Operand label_short = ctx.newLabel();
+                Operand label_end = ctx.newLabel();
+                if (is_and) branchFalse(n, label_short); else branchTrue(n, label_short);
+                ctx.emit(TacInstr(TacOp::Copy, dest, ctx.program.constant(is_and ? "1" : "0")));
+                ctx.emit(TacInstr(TacOp::Goto, Operand(), label_end));
+                ctx.emit(TacInstr(TacOp::Label, Operand(), label_short));
+                ctx.emit(TacInstr(TacOp::Copy, dest, ctx.program.constant(is_and ? "0" : "1")));
+                ctx.emit(TacInstr(TacOp::Label, Operand(), label_end));
+                return dest;
+            }
+            case ExprNode::Kind::Assign: {
+                Operand var = variable(node(e.lhs).text);
+                if (e.text == "=") {
+                    lower(e.rhs, var);
+                } else { // Compound assignment: x op= e  ->  x = x op e
+                    Operand value = lower(e.rhs);
+                    ctx.emit(TacInstr(binaryOpFromLexeme(e.text.substr(0, e.text.size() - 1)), var, var, value));
+                }
+                return want_value ? into(var, target) : Operand();
+            }
+            case ExprNode::Kind::IncDec: {
+                Operand var = variable(node(e.lhs).text);
+                TacOp op = (e.text == "++") ? TacOp::Add : TacOp::Sub;
+                Operand result;
+                if (want_value && !e.is_prefix) { // Postfix value is the old one
+                    result = target.isNone() ? ctx.newTemp() : target;
+                    ctx.emit(TacInstr(TacOp::Copy, result, var));
+                }
+                ctx.emit(TacInstr(op, var, var, ctx.program.constant("1")));
+                if (want_value && e.is_prefix) result = into(var, target);
+                return result;
+            }
+            case ExprNode::Kind::Call: {
+                std::vector<Operand> values; // Evaluate every argument before the first param so nested calls don't interleave
+                values.reserve(e.args.size());
+                for (int arg : e.args) values.push_back(lower(arg));
+                for (Operand value : values) ctx.emit(TacInstr(TacOp::Param, Operand(), value));
+                Operand dest = want_value ? (target.isNone() ? ctx.newTemp() : target) : Operand();
+                ctx.emit(TacInstr(TacOp::Call, dest, variable(e.text), ctx.program.constant(std::to_string(e.args.size()))));
+                return dest;
+            }
+            case ExprNode::Kind::Ternary: {
+                Operand dest = want_value ? (target.isNone() ? ctx.newTemp() : target) : Operand();
+                Operand label_else = ctx.newLabel();
+                Operand label_end = ctx.newLabel();
+                branchFalse(e.cond, label_else);
+                lower(e.lhs, dest, want_value);
+                ctx.emit(TacInstr(TacOp::Goto, Operand(), label_end));
+                ctx.emit(TacInstr(TacOp::Label, Operand(), label_else));
+                lower(e.rhs, dest, want_value);
+                ctx.emit(TacInstr(TacOp::Label, Operand(), label_end));
+                return dest;
+            }
+        }
+        return Operand();
+    }
+
+    // Jumping code: branch to 'label' when the condition is false / true, short-circuiting && and ||
+    void branchFalse(int n, Operand label) {
+        const ExprNode& e = node(n);
+        if (e.kind == ExprNode::Kind::Logical && e.text == "&&") { branchFalse(e.lhs, label); branchFalse(e.rhs, label); return; }
+        if (e.kind == ExprNode::Kind::Logical && e.text == "||") {
+            Operand label_true = ctx.newLabel();
+            branchTrue(e.lhs, label_true);
+            branchFalse(e.rhs, label);
+            ctx.emit(TacInstr(TacOp::Label, Operand(), label_true));
+            return;
+        }
+        if (e.kind == ExprNode::Kind::Unary && e.text == "!") { branchTrue(e.lhs, label); return; }
+        ctx.emit(TacInstr(TacOp::IfFalse, Operand(), lower(n), label));
+    }
+
+    void branchTrue(int n, Operand label) {
+        const ExprNode& e = node(n);
+        if (e.kind == ExprNode::Kind::Logical && e.text == "||") { branchTrue(e.lhs, label); branchTrue(e.rhs, label); return; }
+        if (e.kind == ExprNode::Kind::Logical && e.text == "&&") {
+            Operand label_false = ctx.newLabel();
+            branchFalse(e.lhs, label_false);
+            branchTrue(e.rhs, label);
+            ctx.emit(TacInstr(TacOp::Label, Operand(), label_false));
+            return;
+        }
+        if (e.kind == ExprNode::Kind::Unary && e.text == "!") { branchFalse(e.lhs, label); return; }
+        ctx.emit(TacInstr(TacOp::IfTrue, Operand(), lower(n), label));
+    }
+};
+
+// Index of the ')' matching the '(' at open_idx (tokens.size() if unbalanced)
+size_t findMatchingParen(const std::vector<Token>& tokens, size_t open_idx) {
+    int depth = 0;
+    for (size_t k = open_idx; k < tokens.size(); ++k) {
+        if (tokens[k].lexeme == "(") depth++;
+        else if (tokens[k].lexeme == ")" && --depth == 0) return k;
+    }
+    return tokens.size();
+}
+
+// Recognises a function signature "type name ( params ) [qualifiers]" at i.
+// Returns the index just past it (the body's '{' or a prototype's ';'), or tokens.size() if i does not start one
+size_t functionSignatureEnd(const std::vector<Token>& tokens, size_t i) {
+    if (i + 3 >= tokens.size() || (tokens[i].type_str != "KEYWORD" && tokens[i].type_str != "IDENTIFIER") ||
+        tokens[i + 1].type_str != "IDENTIFIER" || tokens[i + 2].lexeme != "(") return tokens.size();
+    size_t params_end_idx = findMatchingParen(tokens, i + 2);
+    if (params_end_idx >= tokens.size()) return tokens.size();
+    size_t end = params_end_idx + 1;
+    while (end < tokens.size() && tokens[end].type_str == "KEYWORD") end++; // e.g. "const"
+    return end;
+}
+
+// Parses and lowers the full expression in [start, end); false if it is not a supported expression
+bool lowerExpressionRange(LoweringContext& ctx, size_t start, size_t end, bool want_value, Operand* value_out = nullptr) {
+    ExprParser parser(ctx.tokens, start, end);
+    int root = parser.parseAssignment();
+    if (!parser.ok || !parser.atEnd()) return false;
+    ExprLowerer lowerer{parser, ctx};
+    Operand value = lowerer.lower(root, Operand(), want_value);
+    if (value_out) *value_out = value;
+    return true;
+}
+
+
+// --- Switch Dispatch ---
+// The case values are split into clusters: runs dense enough for a jump table (at least kMinTableCases cases
+// filling at least 40% of their range) and single values. Dynamic programming over the sorted values picks
+// the split with the fewest clusters. The clusters are then searched as a balanced binary tree of "<"
+// compares, finishing with a linear test once at most kLinearClusters remain.
+struct SwitchCase {
+    int32_t value;
+    Operand label;
+};
+
+struct SwitchLowering {
+    static constexpr size_t kMinTableCases = 4;
+    static constexpr int64_t kMaxTableRange = 1 << 16;
+    static constexpr size_t kLinearClusters = 3;
+
+    struct Cluster { size_t first, last; bool table; }; // cases[first..last]
+    LoweringContext& ctx;
+    Operand value;
+    const std::vector<SwitchCase>& cases;   // Sorted by value, no duplicates
+    Operand fallback;                       // default, or the end of the switch
+    size_t tables = 0, compares = 0;
+
+    Operand number(int64_t v) { return ctx.program.constant(std::to_string(v)); }
+
+    static bool denseEnough(const std::vector<SwitchCase>& cases, size_t first, size_t last) {
+        const int64_t range = static_cast<int64_t>(cases[last].value) - cases[first].value + 1;
+        const int64_t count = static_cast<int64_t>(last - first + 1);
+        return count >= static_cast<int64_t>(kMinTableCases) && range <= kMaxTableRange && 10 * count >= 4 * range;
+    }
+
+    std::vector<Cluster> clusters() const {
+        const size_t n = cases.size();
+        std::vector<size_t> best(n + 1, 0), next(n, 0); // best[i]: fewest clusters covering cases[i..n)
+        for (size_t i = n; i-- > 0;) {
+            best[i] = best[i + 1] + 1;
+            next[i] = i;
+            for (size_t j = i + kMinTableCases - 1; j < n; ++j) {
+                if (static_cast<int64_t>(cases[j].value) - cases[i].value >= kMaxTableRange) break;
+                if (best[j + 1] + 1 < best[i] && denseEnough(cases, i, j)) { best[i] = best[j + 1] + 1; next[i] = j; }
+            }
+        }
+        std::vector<Cluster> out;
+        for (size_t i = 0; i < n; i = next[i] + 1) out.push_back({i, next[i], next[i] > i});
+        return out;
+    }
+
+    // Tests one cluster; falls through when the value is not in it
+    void emitCluster(const Cluster& c, Operand miss) {
+        if (!c.table) {
+            Operand t = ctx.newTemp();
+            ctx.emit(TacInstr(TacOp::Eq, t, value, number(cases[c.first].value)));
+            ctx.emit(TacInstr(TacOp::IfTrue, Operand(), t, cases[c.first].label));
+            compares++;
+            return;
+        }
+        const int32_t low = cases[c.first].value;
+        Operand index = value;
+        if (low != 0) { index = ctx.newTemp(); ctx.emit(TacInstr(TacOp::Sub, index, value, number(low))); }
+        JumpTable table;
+        table.targets.assign(static_cast<size_t>(static_cast<int64_t>(cases[c.last].value) - low + 1), fallback);
+        for (size_t k = c.first; k <= c.last; ++k) table.targets[static_cast<size_t>(static_cast<int64_t>(cases[k].value) - low)] = cases[k].label;
+        table.fallback = miss;
+        uint32_t id = ctx.current().addJumpTable(std::move(table));
+        ctx.emit(TacInstr(TacOp::JumpTable, Operand(), index, Operand::immediate(id)));
+        tables++;
+    }
+
+    void emitTree(const std::vector<Cluster>& cl, size_t first, size_t last) { // cl[first..last)
+        if (last - first <= kLinearClusters) {
+            for (size_t c = first; c < last; ++c) {
+                if (!cl[c].table) { emitCluster(cl[c], fallback); continue; }
+                Operand miss = c + 1 < last ? ctx.newLabel() : fallback;
+                emitCluster(cl[c], miss);
+                if (miss != fallback) ctx.emit(TacInstr(TacOp::Label, Operand(), miss));
+            }
+            if (last == first || !cl[last - 1].table) ctx.emit(TacInstr(TacOp::Goto, Operand(), fallback));
+            return;
+        }
+        const size_t mid = first + (last - first) / 2;
+        Operand right = ctx.newLabel(), t = ctx.newTemp();
+        ctx.emit(TacInstr(TacOp::Lt, t, value, number(cases[cl[mid].first].value)));
+        ctx.emit(TacInstr(TacOp::IfFalse, Operand(), t, right));
+        compares++;
+        emitTree(cl, first, mid);
+        ctx.emit(TacInstr(TacOp::Label, Operand(), right));
+        emitTree(cl, mid, last);
+    }
+
+    void emit() {
+        std::vector<Cluster> cl = clusters();
+        emitTree(cl, 0, cl.size());
+    }
+};
+
 // --- Forward Declaration ---
 
-size_t generate3ACRecursive(const std::vector<Token>& tokens, size_t i, std::vector<std::string>& three_addr_code, std::set<std::string>& variables); // <-- No bool here
+size_t generate3ACRecursive(LoweringContext& ctx, size_t i);
 
 
 // --- Process a sequence of tokens ---
 // Returns the index *after* the last processed token in the sequence
-// --- Process a sequence of tokens ---
-// (Function signature might still have bool, that's ok for now if unused)
-size_t processTokenSequence(const std::vector<Token>& tokens, size_t start_idx, size_t end_idx, std::vector<std::string>& three_addr_code, std::set<std::string>& variables, bool inside_if_else = false) {
+size_t processTokenSequence(LoweringContext& ctx, size_t start_idx, size_t end_idx) {
     size_t current_idx = start_idx;
-    while (current_idx <= end_idx && current_idx < tokens.size()) {
-        // Call generate3ACRecursive WITHOUT the boolean argument
-        current_idx = generate3ACRecursive(tokens, current_idx, three_addr_code, variables);
+    while (current_idx <= end_idx && current_idx < ctx.tokens.size()) {
+        current_idx = generate3ACRecursive(ctx, current_idx);
     }
     return current_idx;
 }
 
-// --- Main 3AC Generator Function (V9) ---
+// --- Main 3AC Generator Function (V10 - General Statement Lowering) ---
+// Lowers exactly one statement (or skips one unhandled token) starting at i.
 // Returns the index of the *next* token to process after handling the current construct
-size_t generate3ACRecursive(const std::vector<Token>& tokens, size_t i, std::vector<std::string>& three_addr_code, std::set<std::string>& variables) {
+size_t generate3ACRecursive(LoweringContext& ctx, size_t i) {
+    const std::vector<Token>& tokens = ctx.tokens;
     if (i >= tokens.size()) return tokens.size();
 
     const Token& token = tokens[i];
     auto is_safe = [&](size_t offset) { return (i + offset) < tokens.size(); };
-    // std::cerr << "generate3ACRecursive processing index " << i << " ('" << token.lexeme << "')" << std::endl; // Debug
 
     // --- START: Explicit Preamble Skipping ---
-    // Skip common directives/keywords FIRST before checking for functions etc.
     // using namespace std ;
     if (token.lexeme == "using" && is_safe(3) && tokens[i+1].lexeme == "namespace" && tokens[i+2].lexeme == "std" && tokens[i+3].lexeme == ";") {
-         // std::cerr << "  Skipping: using namespace std;" << std::endl; // Debug
         return i + 4;
     }
     // Skip preprocessor lines
      else if (token.type_str == "PREPROCESSOR") {
-         // std::cerr << "  Skipping: Preprocessor " << token.lexeme << std::endl; // Debug
          size_t pp_end = i + 1;
          int start_tok_num = token.line_num; // Assuming line_num is token number/index
          // This heuristic might be flawed if line_num isn't reliable
@@ -133,154 +660,482 @@ size_t generate3ACRecursive(const std::vector<Token>& tokens, size_t i, std::vec
          }
          return pp_end + (pp_end < tokens.size() && tokens[pp_end].lexeme == ";" ? 1 : 0); // Skip past EOL or ;
      }
-     // Skip standalone braces, commas, semicolons if they somehow appear at top level
-     else if (token.lexeme == "{" || token.lexeme == "}" || token.lexeme == "," || token.lexeme == ";") {
-         // std::cerr << "  Skipping: punctuation " << token.lexeme << std::endl; // Debug
+     // Skip stray closing braces, commas, semicolons
+     else if (token.lexeme == "}" || token.lexeme == "," || token.lexeme == ";") {
         return i + 1;
      }
     // --- END: Explicit Preamble Skipping ---
 
+    // --- Block ---
+    if (token.lexeme == "{") {
+        size_t block_end = findEndOfStatementOrBlock(tokens, i);
+        if (ctx.inside_function) ctx.scopes.emplace_back();
+        if (block_end > i + 1) processTokenSequence(ctx, i + 1, block_end - 1);
+        if (ctx.inside_function) ctx.scopes.pop_back();
+        return block_end + 1;
+    }
 
-    // --- Function Definition --- Check AFTER skipping preamble
-    if (is_safe(3) && (token.type_str == "KEYWORD" || token.type_str == "IDENTIFIER") && tokens[i + 1].type_str == "IDENTIFIER" && tokens[i + 2].lexeme == "(") {
-        // ... (Function Definition logic - SAME AS V8) ...
-        // std::cerr << "  Matched: Function Definition" << std::endl; // Debug
+    // --- Function Definition --- Only at top level; prototypes (ending in ';') are skipped
+    size_t body_start_idx = ctx.inside_function ? tokens.size() : functionSignatureEnd(tokens, i);
+    if (body_start_idx < tokens.size()) {
+        if (tokens[body_start_idx].lexeme == ";") return body_start_idx + 1; // Prototype
+        if (tokens[body_start_idx].lexeme != "{") return i + 1; // Malformed
         std::string func_name = tokens[i + 1].lexeme;
-        variables.insert(func_name);
-        three_addr_code.push_back("");
-        three_addr_code.push_back("func begin " + func_name);
-        size_t body_start_idx = i + 2; // Start search for '{' from '('
-        int paren_level = 0;
-        size_t params_end_idx = body_start_idx;
-        while(params_end_idx < tokens.size()) {
-             if(tokens[params_end_idx].lexeme == "(") paren_level++;
-             else if(tokens[params_end_idx].lexeme == ")") paren_level--;
-             if(paren_level == 1 && tokens[params_end_idx].type_str == "IDENTIFIER" && tokens[params_end_idx-1].lexeme != "(" && tokens[params_end_idx-1].lexeme != ",") {
-                 variables.insert(tokens[params_end_idx].lexeme);
-             }
-             if (paren_level == 0 && tokens[params_end_idx].lexeme == ")") break;
-              if (paren_level < 0) break;
-             params_end_idx++;
+        size_t params_end_idx = findMatchingParen(tokens, i + 2);
+
+        ctx.variables.insert(func_name);
+        ctx.program.functions.emplace_back();
+        TacFunction& function = ctx.program.functions.back();
+        function.name = ctx.program.symbols.intern(func_name);
+        ctx.scopes.emplace_back(); // Parameters and the outermost block of the body share one scope
+        // Parameters: the identifier that ends each "type name" group
+        for (size_t k = i + 3; k < params_end_idx; ++k) {
+            if (tokens[k].type_str == "IDENTIFIER" && (tokens[k + 1].lexeme == "," || k + 1 == params_end_idx) && tokens[k - 1].lexeme != "(" && tokens[k - 1].lexeme != ",") {
+                const std::string param = ctx.declare(tokens[k].lexeme);
+                ctx.variables.insert(param);
+                function.params.push_back(ctx.program.symbols.intern(param));
+                size_t type_start = k;
+                while (type_start > i + 3 && tokens[type_start - 1].lexeme != ",") type_start--;
+                if (!isSignedIntegerType(tokens, type_start, k)) ctx.program.opaque.push_back(function.params.back());
+                if (isCharType(tokens, type_start, k)) ctx.char_variables.insert(param);
+            }
+        }
+        ctx.inside_function = true;
+        size_t body_end_idx = findEndOfStatementOrBlock(tokens, body_start_idx);
+        if (body_end_idx > body_start_idx + 1) {
+            processTokenSequence(ctx, body_start_idx + 1, body_end_idx - 1);
         }
-        body_start_idx = params_end_idx + 1;
-        while (body_start_idx < tokens.size() && tokens[body_start_idx].lexeme != "{") body_start_idx++;
+        ctx.inside_function = false;
+        ctx.scopes.pop_back();
+        return body_end_idx + 1;
+    }
 
-        if (is_safe(body_start_idx - i) && tokens[body_start_idx].lexeme == "{") {
-            size_t body_end_idx = findEndOfStatementOrBlock(tokens, body_start_idx);
-            if (body_end_idx > body_start_idx) {
-                 processTokenSequence(tokens, body_start_idx + 1, body_end_idx - 1, three_addr_code, variables);
+    // --- If Statement --- if ( cond ) stmt [ else stmt ]
+    if (token.lexeme == "if" && is_safe(1) && tokens[i+1].lexeme == "(") {
+        size_t cond_end_idx = findMatchingParen(tokens, i + 1);
+        if (cond_end_idx >= tokens.size()) return i + 1;
+        ExprParser parser(tokens, i + 2, cond_end_idx);
+        int cond = parser.parseAssignment();
+        if (!parser.ok || !parser.atEnd()) return findEndOfStatementOrBlock(tokens, cond_end_idx + 1) + 1; // Unsupported condition: skip the whole statement
+        ExprLowerer lowerer{parser, ctx};
+        Operand label_else = ctx.newLabel();
+        Operand label_endif = ctx.newLabel();
+        lowerer.branchFalse(cond, label_else);
+        size_t next_idx = generate3ACRecursive(ctx, cond_end_idx + 1); // then-branch
+        ctx.emit(TacInstr(TacOp::Goto, Operand(), label_endif));
+        ctx.emit(TacInstr(TacOp::Label, Operand(), label_else));
+        if (next_idx < tokens.size() && tokens[next_idx].lexeme == "else") {
+            next_idx = generate3ACRecursive(ctx, next_idx + 1); // else-branch (possibly another if)
+        }
+        ctx.emit(TacInstr(TacOp::Label, Operand(), label_endif));
+        return next_idx;
+    }
+
+    // --- Loops --- while ( cond ) stmt | for ( [init] ; [cond] ; [step] ) stmt | do stmt while ( cond ) ;
+    // Rotated: a guard test, the body, then the test again jumping back to the top of the body. Each loop is a
+    // natural loop whose header is entered only by falling through from the guard, so code placed just before
+    // the header runs once, and only when the loop does. "continue" goes to the step/test, "break" past it.
+    if ((token.lexeme == "while" || token.lexeme == "for") && is_safe(1) && tokens[i+1].lexeme == "(") {
+        size_t head_end = findMatchingParen(tokens, i + 1);
+        if (head_end >= tokens.size()) return i + 1;
+        size_t cond_start = i + 2, cond_end = head_end, step_start = head_end, step_end = head_end;
+        if (token.lexeme == "for") { // Split at the two top-level ';'
+            size_t semis[2] = {head_end, head_end};
+            int found = 0, depth = 0;
+            for (size_t k = i + 2; k < head_end && found < 2; ++k) {
+                const std::string& lex = tokens[k].lexeme;
+                if (lex == "(") depth++;
+                else if (lex == ")") depth--;
+                else if (lex == ";" && depth == 0) semis[found++] = k;
+            }
+            if (found < 2) return findEndOfStatementOrBlock(tokens, head_end + 1) + 1;
+            cond_start = semis[0] + 1; cond_end = semis[1];
+            step_start = semis[1] + 1;
+        }
+        ExprParser parser(tokens, cond_start, cond_end);
+        int cond = cond_start < cond_end ? parser.parseAssignment() : -1;
+        ExprParser step_parser(tokens, step_start, step_end);
+        if (step_start < step_end) step_parser.parseAssignment();
+        if ((cond >= 0 && (!parser.ok || !parser.atEnd())) || (step_start < step_end && (!step_parser.ok || !step_parser.atEnd()))) {
+            return findEndOfStatementOrBlock(tokens, head_end + 1) + 1; // Unsupported header: skip the whole loop
+        }
+        const bool for_scope = token.lexeme == "for" && ctx.inside_function; // A declaration in the init lives until the loop ends
+        if (for_scope) ctx.scopes.emplace_back();
+        if (token.lexeme == "for" && cond_start > i + 3) generate3ACRecursive(ctx, i + 2); // init: declaration or expression, up to the first ';'
+        ExprLowerer lowerer{parser, ctx};
+        Operand label_top = ctx.newLabel();
+        Operand label_continue = ctx.newLabel();
+        Operand label_end = ctx.newLabel();
+        if (cond >= 0) lowerer.branchFalse(cond, label_end);
+        ctx.emit(TacInstr(TacOp::Label, Operand(), label_top));
+        ctx.loop_labels.emplace_back(label_end, label_continue);
+        size_t next_idx = generate3ACRecursive(ctx, head_end + 1); // body
+        ctx.loop_labels.pop_back();
+        ctx.emit(TacInstr(TacOp::Label, Operand(), label_continue));
+        if (step_start < step_end) lowerExpressionRange(ctx, step_start, step_end, false);
+        if (cond >= 0) lowerer.branchTrue(cond, label_top);
+        else ctx.emit(TacInstr(TacOp::Goto, Operand(), label_top));
+        ctx.emit(TacInstr(TacOp::Label, Operand(), label_end));
+        if (for_scope) ctx.scopes.pop_back();
+        return next_idx;
+    }
+    if (token.lexeme == "do") {
+        Operand label_top = ctx.newLabel();
+        Operand label_continue = ctx.newLabel();
+        Operand label_end = ctx.newLabel();
+        ctx.emit(TacInstr(TacOp::Label, Operand(), label_top));
+        ctx.loop_labels.emplace_back(label_end, label_continue);
+        size_t next_idx = generate3ACRecursive(ctx, i + 1); // body
+        ctx.loop_labels.pop_back();
+        ctx.emit(TacInstr(TacOp::Label, Operand(), label_continue));
+        if (next_idx + 1 < tokens.size() && tokens[next_idx].lexeme == "while" && tokens[next_idx + 1].lexeme == "(") {
+            size_t cond_end = findMatchingParen(tokens, next_idx + 1);
+            ExprParser parser(tokens, next_idx + 2, cond_end);
+            int cond = parser.parseAssignment();
+            if (cond_end < tokens.size() && parser.ok && parser.atEnd()) {
+                ExprLowerer lowerer{parser, ctx};
+                lowerer.branchTrue(cond, label_top);
             }
-            three_addr_code.push_back("func end " + func_name);
-            return body_end_idx + 1;
-        } else { return i + 1; } // Malformed
-    }
-
-    // --- If Statement --- Pattern: if ( ID OP LIT/ID ) ...
-    else if (token.lexeme == "if" && is_safe(5) && tokens[i+1].lexeme == "(" && tokens[i+2].type_str == "IDENTIFIER" && tokens[i+3].type_str == "OPERATOR" && (tokens[i+4].type_str.find("LITERAL") != std::string::npos || tokens[i+4].type_str == "IDENTIFIER") && tokens[i+5].lexeme == ")")
-    {
-        // ... (If Statement logic - SAME AS V8) ...
-         // std::cerr << "  Matched: If Statement" << std::endl; // Debug
-        std::string op1 = tokens[i+2].lexeme; variables.insert(op1);
-        std::string op = tokens[i+3].lexeme;
-        std::string op2 = tokens[i+4].lexeme;
-        if (tokens[i+4].type_str == "IDENTIFIER") variables.insert(op2);
-        std::string cond_temp = newTemp();
-        three_addr_code.push_back(cond_temp + " = " + op1 + " " + op + " " + op2);
-        std::string label_else = newLabel();
-        std::string label_endif = newLabel();
-        three_addr_code.push_back("ifFalse " + cond_temp + " goto " + label_else);
-        size_t then_start_idx = i + 6;
-        size_t then_end_idx = findEndOfStatementOrBlock(tokens, then_start_idx);
-        size_t next_idx_after_then = processTokenSequence(tokens, then_start_idx, then_end_idx, three_addr_code, variables);
-        three_addr_code.push_back("goto " + label_endif);
-        three_addr_code.push_back(label_else + ":");
-        size_t else_start_idx = next_idx_after_then;
-        size_t else_end_idx = findEndOfStatementOrBlock(tokens, else_start_idx);
-         size_t next_idx_after_else = processTokenSequence(tokens, else_start_idx, else_end_idx, three_addr_code, variables);
-        three_addr_code.push_back(label_endif + ":");
-        return next_idx_after_else;
+            next_idx = cond_end + 1;
+            if (next_idx < tokens.size() && tokens[next_idx].lexeme == ";") next_idx++;
+        }
+        ctx.emit(TacInstr(TacOp::Label, Operand(), label_end));
+        return next_idx;
+    }
+    if ((token.lexeme == "break" || token.lexeme == "continue") && is_safe(1) && tokens[i+1].lexeme == ";") {
+        Operand target;
+        if (!ctx.loop_labels.empty()) target = token.lexeme == "break" ? ctx.loop_labels.back().first : ctx.loop_labels.back().second;
+        if (!target.isNone()) ctx.emit(TacInstr(TacOp::Goto, Operand(), target));
+        return i + 2;
+    }
+
+    // --- Switch --- switch ( expr ) { case C : ... default : ... }
+    // The case labels at the top level of the body (not those of nested switches) must be integer or character
+    // literals; anything else skips the statement. The dispatch (see SwitchLowering) comes first, then the body
+    // in source order with each case as a label, so control falls through from one case into the next.
+    if (token.lexeme == "switch" && is_safe(1) && tokens[i+1].lexeme == "(") {
+        size_t head_end = findMatchingParen(tokens, i + 1);
+        if (head_end + 1 >= tokens.size() || tokens[head_end + 1].lexeme != "{") return findEndOfStatementOrBlock(tokens, i) + 1;
+        size_t body_end = findEndOfStatementOrBlock(tokens, head_end + 1);
+        std::map<size_t, Operand> label_at; // Token index of each top-level case/default -> its label
+        std::vector<SwitchCase> cases;
+        Operand label_default;
+        bool supported = true;
+        int depth = 0;
+        for (size_t k = head_end + 2; k < body_end && supported; ++k) {
+            const std::string& lex = tokens[k].lexeme;
+            if (lex == "{") depth++;
+            else if (lex == "}") depth--;
+            if (depth != 0) continue;
+            if (lex == "default" && k + 1 < body_end && tokens[k + 1].lexeme == ":") {
+                label_default = label_at[k] = ctx.newLabel();
+            } else if (lex == "case") {
+                size_t v = k + 1;
+                bool negative = v < body_end && tokens[v].lexeme == "-";
+                if (negative) v++;
+                int32_t value = 0;
+                if (v + 1 >= body_end || tokens[v + 1].lexeme != ":" || !integerLiteral(tokens[v].lexeme, value) ||
+                    (negative && value == INT32_MIN)) { supported = false; break; }
+                cases.push_back({negative ? -value : value, label_at[k] = ctx.newLabel()});
+            }
+        }
+        std::sort(cases.begin(), cases.end(), [](const SwitchCase& a, const SwitchCase& b) { return a.value < b.value; });
+        for (size_t k = 1; k < cases.size(); ++k) if (cases[k].value == cases[k - 1].value) supported = false;
+        ExprParser parser(tokens, i + 2, head_end);
+        int scrutinee = parser.parseAssignment();
+        if (!supported || !parser.ok || !parser.atEnd()) return body_end + 1; // Unsupported: skip the whole statement
+
+        ExprLowerer lowerer{parser, ctx};
+        Operand value = lowerer.lower(scrutinee, Operand(), true);
+        Operand label_end = ctx.newLabel();
+        SwitchLowering dispatch{ctx, value, cases, label_default.isNone() ? label_end : label_default};
+        dispatch.emit();
+        ctx.loop_labels.emplace_back(label_end, ctx.loop_labels.empty() ? Operand() : ctx.loop_labels.back().second);
+        if (ctx.inside_function) ctx.scopes.emplace_back();
+        for (size_t k = head_end + 2; k < body_end;) {
+            auto it = label_at.find(k);
+            if (it == label_at.end()) { k = generate3ACRecursive(ctx, k); continue; }
+            ctx.emit(TacInstr(TacOp::Label, Operand(), it->second));
+            while (tokens[k].lexeme != ":") k++;
+            k++;
+            label_at.erase(it);
+        }
+        if (ctx.inside_function) ctx.scopes.pop_back();
+        ctx.loop_labels.pop_back();
+        for (const auto& missed : label_at) ctx.emit(TacInstr(TacOp::Label, Operand(), missed.second)); // Case labels a statement swallowed
+        ctx.emit(TacInstr(TacOp::Label, Operand(), label_end));
+        return body_end + 1;
     }
 
     // --- Return Statement ---
-    else if (token.lexeme == "return") {
-        // ... (Return Statement logic - SAME AS V8) ...
-        // std::cerr << "  Matched: Return Statement" << std::endl; // Debug
+    if (token.lexeme == "return") {
         size_t expr_start_idx = i + 1;
-        size_t expr_end_idx = findEndOfStatementOrBlock(tokens, expr_start_idx); // Find ';'
-        if (is_safe(expr_start_idx - i + 8) && tokens[expr_start_idx].type_str == "IDENTIFIER" && tokens[expr_start_idx + 1].lexeme == "*" && tokens[expr_start_idx + 2].type_str == "IDENTIFIER" && tokens[expr_start_idx + 3].lexeme == "(" && tokens[expr_start_idx + 4].type_str == "IDENTIFIER" && tokens[expr_start_idx + 5].lexeme == "-" && tokens[expr_start_idx + 6].type_str.find("LITERAL") != std::string::npos && tokens[expr_start_idx + 7].lexeme == ")" && expr_end_idx >= expr_start_idx + 8 && tokens[expr_end_idx].lexeme == ";") {
-             std::string ret_op1 = tokens[expr_start_idx].lexeme; variables.insert(ret_op1); std::string ret_op = tokens[expr_start_idx + 1].lexeme; std::string ret_func = tokens[expr_start_idx + 2].lexeme; variables.insert(ret_func); std::string p_op1 = tokens[expr_start_idx + 4].lexeme; variables.insert(p_op1); std::string p_op = tokens[expr_start_idx + 5].lexeme; std::string p_op2_lit = tokens[expr_start_idx + 6].lexeme;
-             std::string param_temp = newTemp(); three_addr_code.push_back(param_temp + " = " + p_op1 + " " + p_op + " " + p_op2_lit);
-             three_addr_code.push_back("param " + param_temp);
-             std::string call_res = newTemp(); three_addr_code.push_back(call_res + " = call " + ret_func + ", 1");
-             std::string final_res = newTemp(); three_addr_code.push_back(final_res + " = " + ret_op1 + " " + ret_op + " " + call_res);
-             three_addr_code.push_back("return " + final_res);
-             return expr_end_idx + 1;
-         } else if (expr_start_idx <= expr_end_idx && (expr_start_idx == expr_end_idx) && (tokens[expr_start_idx].type_str == "IDENTIFIER" || tokens[expr_start_idx].type_str.find("LITERAL") != std::string::npos)) {
-            std::string ret_val = tokens[expr_start_idx].lexeme; three_addr_code.push_back("return " + ret_val); if (tokens[expr_start_idx].type_str == "IDENTIFIER") variables.insert(ret_val);
-             return expr_end_idx + 1;
-        } else if (expr_start_idx > expr_end_idx) {
-            three_addr_code.push_back("return"); return expr_end_idx + 1;
-        } else {
-            std::string expr_placeholder = ""; for(size_t k=expr_start_idx; k<=expr_end_idx; ++k) { if(k < tokens.size()) expr_placeholder += tokens[k].lexeme + " "; } if (!expr_placeholder.empty()) expr_placeholder.pop_back();
-             three_addr_code.push_back("return (" + expr_placeholder + ")"); for(size_t k = expr_start_idx; k <= expr_end_idx; ++k) { if(k < tokens.size() && tokens[k].type_str == "IDENTIFIER") variables.insert(tokens[k].lexeme); }
-              return expr_end_idx + 1;
-        }
-    }
-
-    // --- Assignment --- Pattern: [TYPE] ID = ...
-    else if ( (tokens[i].type_str=="KEYWORD" && is_safe(2) && tokens[i+1].type_str == "IDENTIFIER" && tokens[i+2].lexeme == "=" ) /* int c = ... */ ||
-              (tokens[i].type_str=="IDENTIFIER" && is_safe(1) && tokens[i+1].lexeme == "=") /* c = ... */ )
-    {
-        // ... (Assignment logic - SAME AS V8) ...
-        size_t eq_idx = (tokens[i].type_str=="KEYWORD") ? i+2 : i+1; size_t lhs_idx = (tokens[i].type_str=="KEYWORD") ? i+1 : i;
-        std::string lhs = tokens[lhs_idx].lexeme; variables.insert(lhs);
-        size_t rhs_start = eq_idx + 1;
-        if (is_safe(rhs_start - i + 8) && tokens[rhs_start].type_str == "IDENTIFIER" && tokens[rhs_start + 1].lexeme == "(" && tokens[rhs_start + 2].type_str == "IDENTIFIER" && tokens[rhs_start + 3].lexeme == ")" && tokens[rhs_start + 4].lexeme == "*" && tokens[rhs_start + 5].type_str == "IDENTIFIER" && tokens[rhs_start + 6].lexeme == "(" && tokens[rhs_start + 7].type_str == "IDENTIFIER" && tokens[rhs_start + 8].lexeme == ")") {
-             size_t pattern_end_idx = rhs_start + 8; if (is_safe(pattern_end_idx -i) && tokens[pattern_end_idx].lexeme == ";") {
-                  std::string func1 = tokens[rhs_start].lexeme; variables.insert(func1); std::string arg1 = tokens[rhs_start + 2].lexeme; variables.insert(arg1); std::string op = tokens[rhs_start + 4].lexeme; std::string func2 = tokens[rhs_start + 5].lexeme; variables.insert(func2); std::string arg2 = tokens[rhs_start + 7].lexeme; variables.insert(arg2);
-                  std::string temp1 = newTemp(); three_addr_code.push_back("param " + arg1); three_addr_code.push_back(temp1 + " = call " + func1 + ", 1");
-                  std::string temp2 = newTemp(); three_addr_code.push_back("param " + arg2); three_addr_code.push_back(temp2 + " = call " + func2 + ", 1");
-                  std::string temp3 = newTemp(); three_addr_code.push_back(temp3 + " = " + temp1 + " " + op + " " + temp2); three_addr_code.push_back(lhs + " = " + temp3);
-                  return pattern_end_idx + 1;
-             }
-         } else if (is_safe(rhs_start -i + 1) && (tokens[rhs_start].type_str == "IDENTIFIER" || tokens[rhs_start].type_str.find("LITERAL") != std::string::npos) && tokens[rhs_start + 1].lexeme == ";") {
-              std::string rhs = tokens[rhs_start].lexeme; if (tokens[rhs_start].type_str == "IDENTIFIER") variables.insert(rhs); three_addr_code.push_back(lhs + " = " + rhs); return rhs_start + 2;
-         } else { size_t assign_end = findEndOfStatementOrBlock(tokens, i); return assign_end + 1; } // Skip unhandled assignment
+        size_t expr_end_idx = findEndOfStatementOrBlock(tokens, expr_start_idx); // Index of ';'
+        if (expr_end_idx >= tokens.size() || tokens[expr_end_idx].lexeme != ";") return expr_end_idx + 1;
+        if (expr_start_idx == expr_end_idx) {
+            ctx.emit(TacInstr(TacOp::Return));
+            return expr_end_idx + 1;
+        }
+        Operand value;
+        if (lowerExpressionRange(ctx, expr_start_idx, expr_end_idx, true, &value)) {
+            ctx.emit(TacInstr(TacOp::Return, Operand(), value));
+        } else { // Unsupported expression: keep it as an opaque placeholder
+            std::string expr_placeholder = "";
+            for (size_t k = expr_start_idx; k < expr_end_idx; ++k) {
+                expr_placeholder += tokens[k].lexeme + " ";
+                if (tokens[k].type_str == "IDENTIFIER") ctx.variables.insert(tokens[k].lexeme);
+            }
+            if (!expr_placeholder.empty()) expr_placeholder.pop_back();
+            ctx.emit(TacInstr(TacOp::Comment, Operand(), ctx.program.constant("return (" + expr_placeholder + ")")));
+        }
+        return expr_end_idx + 1;
     }
 
-    // --- I/O Statements ---
-    else if (token.lexeme == "cin" && is_safe(4) && tokens[i+1].lexeme == ">>" && tokens[i+2].type_str == "IDENTIFIER" && tokens[i+3].lexeme == ">>" && tokens[i+4].type_str == "IDENTIFIER") {
-        // ... (Cin logic - SAME AS V8) ...
-        size_t stmt_end = findEndOfStatementOrBlock(tokens, i); if(stmt_end < tokens.size() && tokens[stmt_end].lexeme == ";"){ std::string var1 = tokens[i+2].lexeme; variables.insert(var1); std::string var2 = tokens[i+4].lexeme; variables.insert(var2); three_addr_code.push_back("read " + var1); three_addr_code.push_back("read " + var2); return stmt_end + 1; }
-    }
-    else if (token.lexeme == "cout" && is_safe(3) && tokens[i+1].lexeme == "<<" && tokens[i+2].type_str == "IDENTIFIER") {
-         // ... (Cout logic - SAME AS V8) ...
-         size_t stmt_end = findEndOfStatementOrBlock(tokens, i); if(stmt_end < tokens.size() && tokens[stmt_end].lexeme == ";"){ std::string var1 = tokens[i+2].lexeme; variables.insert(var1); three_addr_code.push_back("write " + var1); return stmt_end + 1; }
+    // --- I/O Statements --- cin >> a >> b ... ; cout << e1 << e2 ... ;
+    if ((token.lexeme == "cin" || token.lexeme == "cout") && is_safe(1) && (tokens[i+1].lexeme == ">>" || tokens[i+1].lexeme == "<<")) {
+        size_t stmt_end = findEndOfStatementOrBlock(tokens, i);
+        if (stmt_end >= tokens.size() || tokens[stmt_end].lexeme != ";") return stmt_end + 1;
+        const std::string chain_op = tokens[i+1].lexeme;
+        size_t item_start = i + 2;
+        while (item_start < stmt_end) {
+            // Each item runs up to the next top-level '<<' / '>>'
+            size_t item_end = item_start;
+            int depth = 0;
+            while (item_end < stmt_end) {
+                const std::string& lex = tokens[item_end].lexeme;
+                if (lex == "(") depth++;
+                else if (lex == ")") depth--;
+                else if (depth == 0 && lex == chain_op) break;
+                item_end++;
+            }
+            if (chain_op == ">>") {
+                if (item_end == item_start + 1 && tokens[item_start].type_str == "IDENTIFIER") {
+                    const std::string& local = ctx.resolve(tokens[item_start].lexeme);
+                    ctx.emit(TacInstr(TacOp::Read, Operand(), ctx.program.symbol(local)));
+                    ctx.variables.insert(local);
+                }
+            } else if (item_end == item_start + 1 && tokens[item_start].lexeme == "endl") {
+                ctx.emit(TacInstr(TacOp::Write, Operand(), ctx.program.constant("\"\\n\"")));
+            } else {
+                Operand value;
+                if (lowerExpressionRange(ctx, item_start, item_end, true, &value)) {
+                    const bool char_value = item_end == item_start + 1 && ctx.char_variables.count(ctx.resolve(tokens[item_start].lexeme));
+                    ctx.emit(TacInstr(TacOp::Write, Operand(), value, char_value ? kWriteChar : Operand()));
+                }
+            }
+            item_start = item_end + 1;
+        }
+        return stmt_end + 1;
     }
 
-    // --- Variable Declaration (just skip and track names) ---
-    else if ( (token.type_str == "KEYWORD" && (token.lexeme == "int" || token.lexeme == "float" /* etc */) ) ) {
-        // ... (Declaration logic - SAME AS V8) ...
-        bool assignment_found = false; size_t check_idx = i + 1;
-        while(check_idx < tokens.size() && tokens[check_idx].lexeme != ";") { if(tokens[check_idx].lexeme == "=") { assignment_found = true; break; } check_idx++; }
-        if (!assignment_found) {
-             size_t decl_end = i + 1; while (decl_end < tokens.size() && tokens[decl_end].lexeme != ";") { if (tokens[decl_end].type_str == "IDENTIFIER" && decl_end > 0 && tokens[decl_end-1].lexeme != "(") { variables.insert(tokens[decl_end].lexeme); } decl_end++; } return decl_end + 1;
-        } // else: let assignment rule handle it if possible by falling through
+    // --- Variable Declaration --- [qualifiers] type name [= expr] {, name [= expr]} ;
+    bool keyword_type = token.type_str == "KEYWORD" && isTypeKeyword(token.lexeme);
+    bool named_type = token.type_str == "IDENTIFIER" && is_safe(2) && tokens[i+1].type_str == "IDENTIFIER" &&
+                      (tokens[i+2].lexeme == "=" || tokens[i+2].lexeme == ";" || tokens[i+2].lexeme == "," || tokens[i+2].lexeme == "[");
+    if (keyword_type || named_type) {
+        size_t stmt_end = findEndOfStatementOrBlock(tokens, i);
+        size_t k = i;
+        while (k < stmt_end && tokens[k].type_str != "IDENTIFIER") k++; // Skip keyword type words
+        if (named_type) k = i + 1;
+        bool integer_type = keyword_type && isSignedIntegerType(tokens, i, k);
+        bool char_type = keyword_type && isCharType(tokens, i, k);
+        while (k < stmt_end) {
+            if (tokens[k].type_str != "IDENTIFIER") { k++; continue; }
+            const std::string name = ctx.declare(tokens[k].lexeme);
+            ctx.variables.insert(name);
+            if (char_type && tokens[k - 1].lexeme != "*" && (k + 1 == tokens.size() || tokens[k + 1].lexeme != "[")) ctx.char_variables.insert(name);
+            if (!ctx.inside_function) ctx.program.globals.push_back(ctx.program.symbols.intern(name));
+            if (!integer_type) ctx.program.opaque.push_back(ctx.program.symbols.intern(name));
+            // Declarator ends at the next top-level ','
+            size_t decl_end = k + 1;
+            int depth = 0;
+            while (decl_end < stmt_end) {
+                const std::string& lex = tokens[decl_end].lexeme;
+                if (lex == "(" || lex == "[") depth++;
+                else if (lex == ")" || lex == "]") depth--;
+                else if (depth == 0 && lex == ",") break;
+                decl_end++;
+            }
+            if (k + 1 < decl_end && tokens[k + 1].lexeme == "=") {
+                ExprParser parser(tokens, k + 2, decl_end);
+                int init = parser.parseAssignment();
+                if (parser.ok && parser.atEnd()) {
+                    ExprLowerer lowerer{parser, ctx};
+                    lowerer.lower(init, ctx.program.symbol(name));
+                }
+            }
+            else if (!ctx.inside_function && k + 1 == decl_end) { // Statics start out zero; say so, so readers of the 3AC see the global
+                ctx.emit(TacInstr(TacOp::Copy, ctx.program.symbol(name), ctx.program.constant("0")));
+            }
+            k = decl_end + 1;
+        }
+        return stmt_end + 1;
     }
 
+    // --- Expression Statement --- assignments, compound assignments, ++/--, calls
+    if (token.type_str == "IDENTIFIER" || token.lexeme == "++" || token.lexeme == "--" || token.lexeme == "(") {
+        size_t stmt_end = findEndOfStatementOrBlock(tokens, i);
+        if (stmt_end < tokens.size() && tokens[stmt_end].lexeme == ";" &&
+            lowerExpressionRange(ctx, i, stmt_end, false)) {
+            return stmt_end + 1;
+        }
+    }
 
     // --- Fallback: Unhandled token ---
-    // std::cerr << "ICG Debug: Default skip for unhandled token [" << i << "]: '" << token.lexeme << "' (" << token.type_str << ")" << std::endl; // Debug
     if (token.type_str == "IDENTIFIER") { // Track potentially used identifiers
-        variables.insert(token.lexeme);
+        ctx.variables.insert(token.lexeme);
     }
     return i + 1; // CRITICAL: Ensure we always advance index if no pattern matches
 
-} // --- End of generate3ACRecursive function (V9) ---
-// --- Main Function (V5 - Use Top-Level Loop - No changes needed here) ---
+} // --- End of generate3ACRecursive function (V10) ---
+// --- Lowering Units ---
+// The token stream is cut at top-level function definitions: each definition is one unit, and the
+// top-level tokens between definitions form another. Units share no generation state.
+struct LoweringUnit {
+    size_t start = 0;
+    size_t end = 0; // One past the last token
+    bool function = false;
+};
+
+std::vector<LoweringUnit> splitIntoUnits(const std::vector<Token>& tokens) {
+    std::vector<LoweringUnit> units;
+    size_t gap_start = 0;
+    size_t i = 0;
+    while (i < tokens.size()) {
+        size_t body_start_idx = functionSignatureEnd(tokens, i);
+        if (body_start_idx < tokens.size() && tokens[body_start_idx].lexeme == "{") {
+            if (gap_start < i) units.push_back({gap_start, i});
+            size_t unit_end = findEndOfStatementOrBlock(tokens, body_start_idx) + 1;
+            units.push_back({i, unit_end, true});
+            i = gap_start = unit_end;
+        } else if (tokens[i].lexeme == "{") { // struct/namespace bodies stay inside the surrounding gap
+            i = findEndOfStatementOrBlock(tokens, i) + 1;
+        } else {
+            i++;
+        }
+    }
+    if (gap_start < tokens.size()) units.push_back({gap_start, tokens.size()});
+    return units;
+}
+
+// Lowers one unit with the top-level statement loop
+void lowerUnit(LoweringContext& ctx, const LoweringUnit& unit) {
+    const std::vector<Token>& tokens = ctx.tokens;
+    size_t current_token_index = unit.start;
+    bool made_progress_once = false; // size_t has no "-1": the first iteration must not be treated as stalled
+    size_t last_processed_index = 0;
+
+    while (current_token_index < unit.end) {
+        current_token_index = generate3ACRecursive(ctx, current_token_index);
+
+        if (made_progress_once && current_token_index <= last_processed_index && current_token_index < tokens.size() && tokens[current_token_index].type_str != "END_OF_FILE" ) {
+             std::cerr << "ICG Warning: No progress made at token index " << current_token_index << " ('" << tokens[current_token_index].lexeme << "'). Stopping." << std::endl;
+              ctx.inside_function = false;
+              ctx.emit(TacInstr(TacOp::Comment, Operand(), ctx.program.constant("# WARNING: Generation stopped due to lack of progress.")));
+             break;
+        }
+        last_processed_index = current_token_index;
+        made_progress_once = true;
+
+        if (current_token_index < tokens.size() && tokens[current_token_index].type_str == "END_OF_FILE") break;
+    }
+}
+
+// Deterministic merge: appends a lowered unit to the program, shifting its temporaries and labels past
+// everything merged so far and re-interning its names. Merging units in source order reproduces the
+// numbering of a serial run exactly.
+void mergeLoweredUnit(TacProgram& program, const LoweringContext& ctx) {
+    std::vector<uint32_t> symbol_map(ctx.program.symbols.size());
+    for (uint32_t k = 0; k < symbol_map.size(); ++k) symbol_map[k] = program.symbols.intern(ctx.program.symbols[k]);
+    std::vector<uint32_t> constant_map(ctx.program.constants.size());
+    for (uint32_t k = 0; k < constant_map.size(); ++k) constant_map[k] = program.constants.intern(ctx.program.constants[k]);
+
+    const uint32_t temp_base = program.temp_count;
+    const uint32_t label_base = program.label_count;
+    auto remap = [&](Operand o) -> Operand {
+        switch (o.kind()) {
+            case OperandKind::Temp: return Operand::temp(o.id() + temp_base);
+            case OperandKind::Label: return Operand::label(o.id() + label_base);
+            case OperandKind::Symbol: return Operand::symbol(symbol_map[o.id()]);
+            case OperandKind::Const: return Operand::constant(constant_map[o.id()]);
+            default: return o;
+        }
+    };
+
+    for (const TacFunction& local : ctx.program.functions) {
+        program.functions.emplace_back();
+        TacFunction& function = program.functions.back();
+        function.name = local.isTopLevel() ? TacFunction::kNoName : symbol_map[local.name];
+        for (uint32_t param : local.params) function.params.push_back(symbol_map[param]);
+        function.code.reserve(local.code.size());
+        for (const TacInstr& in : local.code) function.code.emplace_back(in.op, remap(in.result), remap(in.arg1), remap(in.arg2));
+        for (const JumpTable& table : local.jump_tables) {
+            function.jump_tables.push_back(table);
+            for (Operand& target : function.jump_tables.back().targets) target = remap(target);
+            function.jump_tables.back().fallback = remap(function.jump_tables.back().fallback);
+        }
+    }
+    for (uint32_t global : ctx.program.globals) program.addGlobal(symbol_map[global]);
+    for (uint32_t sym : ctx.program.opaque) program.addOpaque(symbol_map[sym]);
+    program.temp_count += ctx.temp_count;
+    program.label_count += ctx.label_count;
+}
+
+// --- Main Function (V6 - Parallel Per-Unit Lowering) ---
 int main(int argc, char* argv[]) {
-    if (argc != 2) { std::cerr << "Usage: intermediate_gen <lexer_output_filename>\n"; return 1; }
-    std::string lexer_output_file = argv[1];
+    unsigned jobs = 0; // 0 = one per hardware thread
+    bool dump_cfg = false;
+    bool dump_dataflow = false;
+    bool dump_ssa = false;
+    bool dump_regalloc = false;
+    bool allocate = true;
+    RegAllocOptions regalloc;
+    InterprocOptions interproc;
+    bool optimize = true;
+    std::vector<std::string> disabled_passes;
+    std::string lexer_output_file;
+    std::string binary_output_file; // --binary: also write the 3AC in the binary format dag_builder can map
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        if (arg == "--dump-cfg") dump_cfg = true;
+        else if (arg == "--dump-dataflow") dump_dataflow = true;
+        else if (arg == "--dump-ssa") dump_ssa = true;
+        else if (arg == "--dump-regalloc") dump_regalloc = true;
+        else if (arg == "--regalloc" && a + 1 < argc) {
+            std::string method = argv[++a];
+            if (method == "linear") regalloc.method = RegAllocMethod::LinearScan;
+            else if (method == "coloring") regalloc.method = RegAllocMethod::GraphColoring;
+            else if (method == "none") allocate = false;
+            else { std::cerr << "ICG: Unknown allocator '" << method << "'\n"; lexer_output_file.clear(); break; }
+        }
+        else if (arg == "--regs" && a + 1 < argc) { if (!parseCount(argv[++a], regalloc.registers)) { lexer_output_file.clear(); break; } }
+        else if (arg == "--no-opt") optimize = false;
+        else if (arg == "--binary" && a + 1 < argc) binary_output_file = argv[++a];
+        else if (arg == "--no-regalloc") allocate = false;
+        else if (arg == "--no-tre") interproc.tail_recursion = false;
+        else if (arg == "--no-inline") interproc.inlining = false;
+        else if (arg == "--inline-budget" && a + 1 < argc) { if (!parseCount(argv[++a], interproc.inline_budget)) { lexer_output_file.clear(); break; } }
+        else if (arg.rfind("--no-", 0) == 0) disabled_passes.push_back(arg.substr(5));
+        else if (arg == "--jobs" && a + 1 < argc) { if (!parseCount(argv[++a], jobs)) { lexer_output_file.clear(); break; } }
+        else if (arg.rfind("--jobs=", 0) == 0) { if (!parseCount(arg.substr(7), jobs)) { lexer_output_file.clear(); break; } }
+        else if (lexer_output_file.empty()) lexer_output_file = arg;
+        else { lexer_output_file.clear(); break; }
+    }
+    PeepholeCounters peephole_counters;
+    PassManager passes = defaultPassPipeline(&peephole_counters);
+    if (!optimize) passes.setAllEnabled(false);
+    for (const std::string& name : disabled_passes) {
+        if (!passes.setEnabled(name, false)) { std::cerr << "ICG: Unknown pass '" << name << "'\n"; lexer_output_file.clear(); }
+    }
+    if (regalloc.registers == 0) { std::cerr << "ICG: --regs needs at least one register\n"; lexer_output_file.clear(); }
+    if (lexer_output_file.empty()) {
+        std::cerr << "Usage: intermediate_gen <lexer_output_filename> [--jobs N] [--dump-cfg] [--dump-dataflow] [--dump-ssa] [--dump-regalloc]"
+                     " [--regalloc linear|coloring|none] [--no-regalloc] [--regs N] [--no-opt]"
+                     " [--no-tre] [--no-inline] [--inline-budget N] [--binary FILE]";
+        for (const TacPass& pass : passes.passes()) std::cerr << " [--no-" << pass.name << "]";
+        std::cerr << "\n";
+        return 1;
+    }
     std::string tac_output_file = "3ac_output.txt";
     std::string dag_input_vars_file = "dag_vars.txt";
 
@@ -290,33 +1145,203 @@ int main(int argc, char* argv[]) {
     else if (tokens.empty()) { std::cout << "ICG: Token file parsed, but no valid tokens found...\n"; }
 
     std::cout << "ICG: Generating 3AC..." << std::endl;
-    std::vector<std::string> three_addr_code;
+    auto lowering_start = std::chrono::steady_clock::now();
+    std::vector<LoweringUnit> units = splitIntoUnits(tokens);
+    std::vector<std::unique_ptr<LoweringContext>> contexts(units.size());
+    ThreadPool pool(jobs);
+    // File-scope units go first: a function unit needs every global's name to tell which of its locals hide one
+    std::set<std::string> global_names;
+    for (bool functions : {false, true}) {
+        pool.parallelFor(units.size(), [&](size_t u) {
+            if (units[u].function != functions) return;
+            contexts[u] = std::make_unique<LoweringContext>(tokens);
+            contexts[u]->global_names = &global_names;
+            lowerUnit(*contexts[u], units[u]);
+        });
+        for (size_t u = 0; u < units.size() && !functions; ++u) {
+            if (units[u].function) continue;
+            for (uint32_t g : contexts[u]->program.globals) global_names.insert(contexts[u]->program.symbols[g]);
+        }
+    }
+
+    TacProgram program;
     std::set<std::string> variable_names;
-    temp_count = 0; label_count = 0;
+    for (const auto& ctx : contexts) {
+        mergeLoweredUnit(program, *ctx);
+        variable_names.insert(ctx->variables.begin(), ctx->variables.end());
+    }
+    double lowering_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - lowering_start).count();
+    std::cout << "ICG: Lowered " << units.size() << " unit(s) on " << pool.size() << " thread(s) in " << lowering_ms << " ms" << std::endl;
 
-    size_t current_token_index = 0;
-    size_t last_processed_index = -1; // Use -1 to ensure first iteration works
+    // --- Interprocedural transforms (the passes below clean up the copies they leave) ---
+    if (optimize && (interproc.tail_recursion || interproc.inlining)) {
+        auto interproc_start = std::chrono::steady_clock::now();
+        std::vector<InterprocFunctionStats> changes = runInterprocedural(program, interproc);
+        double interproc_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - interproc_start).count();
+        size_t before = 0, after = 0, tail_calls = 0, accumulators = 0, inlined = 0, changed = 0;
+        for (const InterprocFunctionStats& s : changes) {
+            before += s.instrs_before; after += s.instrs_after;
+            tail_calls += s.tail_calls; inlined += s.inlined;
+            accumulators += s.accumulator != TacOp::Nop ? 1 : 0;
+            changed += s.changed() ? 1 : 0;
+        }
+        std::cout << "ICG: Interprocedural: " << tail_calls << " tail call(s) turned into loops (" << accumulators << " function(s) with an accumulator), "
+                  << inlined << " call site(s) inlined, " << before << " -> " << after << " instructions, " << interproc_ms << " ms" << std::endl;
+        const size_t kMaxListed = 20;
+        size_t listed = 0;
+        for (size_t f = 0; f < changes.size(); ++f) {
+            const InterprocFunctionStats& s = changes[f];
+            if (!s.changed() || listed++ >= kMaxListed) continue;
+            std::cout << "ICG:   " << program.functionName(program.functions[f]) << ": " << s.instrs_before << " -> " << s.instrs_after
+                      << " instructions, " << s.calls_before << " -> " << s.calls_after << " call(s)";
+            if (s.tail_calls) std::cout << ", " << s.tail_calls << " tail call(s) -> loop" << (s.accumulator != TacOp::Nop ? std::string(" with ") + tacOpSymbol(s.accumulator) + " accumulator" : "");
+            if (s.inlined) std::cout << ", " << s.inlined << " call site(s) inlined";
+            std::cout << std::endl;
+        }
+        if (changed > kMaxListed) std::cout << "ICG:   ... and " << changed - kMaxListed << " more function(s)" << std::endl;
+    }
 
-    while (current_token_index < tokens.size()) {
-        current_token_index = generate3ACRecursive(tokens, current_token_index, three_addr_code, variable_names);
+    // --- Call graph: functions whose calls have no effect besides their result (dead-code elimination drops unused ones) ---
+    if (optimize) {
+        auto callgraph_start = std::chrono::steady_clock::now();
+        CallGraph graph = buildCallGraph(program);
+        std::vector<FunctionSummary> summaries = summarizeFunctions(program, graph, pool);
+        std::set<uint32_t> with_effects; // A name counts only if every definition of it is free of effects
+        size_t pure = 0;
+        for (size_t f = 0; f < program.functions.size(); ++f) {
+            const TacFunction& function = program.functions[f];
+            if (function.isTopLevel()) continue;
+            if (!summaries[f].sideEffectFree()) with_effects.insert(function.name);
+            else program.side_effect_free.push_back(function.name);
+            pure += summaries[f].pure() ? 1 : 0;
+        }
+        std::sort(program.side_effect_free.begin(), program.side_effect_free.end());
+        program.side_effect_free.erase(std::unique(program.side_effect_free.begin(), program.side_effect_free.end()), program.side_effect_free.end());
+        program.side_effect_free.erase(std::remove_if(program.side_effect_free.begin(), program.side_effect_free.end(),
+                                                      [&](uint32_t name) { return with_effects.count(name) != 0; }),
+                                       program.side_effect_free.end());
+        double callgraph_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - callgraph_start).count();
+        std::cout << "ICG: Call graph: " << graph.size() << " function(s), " << graph.edges << " call edge(s), " << graph.sccs.size()
+                  << " component(s) (" << graph.recursiveCount() << " recursive) on " << graph.levels.size() << " level(s); "
+                  << program.side_effect_free.size() << " side-effect-free function(s) (" << pure << " pure), " << callgraph_ms << " ms" << std::endl;
+    }
 
-        if (current_token_index <= last_processed_index && current_token_index < tokens.size() && tokens[current_token_index].type_str != "END_OF_FILE" ) {
-             std::cerr << "ICG Warning: No progress made at token index " << current_token_index << " ('" << tokens[current_token_index].lexeme << "'). Stopping." << std::endl;
-              three_addr_code.push_back("# WARNING: Generation stopped due to lack of progress.");
-             break;
+    // --- Optimization passes ---
+    for (const PassReport& report : passes.run(program, pool)) {
+        long delta = static_cast<long>(report.instrs_after) - static_cast<long>(report.instrs_before);
+        std::cout << "ICG: Pass " << report.name << ": " << report.instrs_before << " -> " << report.instrs_after << " instructions ("
+                  << (delta > 0 ? "+" : "") << delta << "), " << report.functions_changed << " function(s) changed, " << report.ms << " ms" << std::endl;
+    }
+    std::string fired;
+    for (size_t r = 0; r < kPeepholeRuleCount; ++r) {
+        if (uint64_t n = peephole_counters.fired[r]) fired += (fired.empty() ? "" : ", ") + std::string(kPeepholeRules[r].name) + " " + std::to_string(n);
+    }
+    if (!fired.empty()) std::cout << "ICG: Peephole rules fired: " << fired << std::endl;
+
+    // --- Temporary reuse: every function's temporaries are mapped onto the same few virtual registers ---
+    if (allocate) {
+        auto regalloc_start = std::chrono::steady_clock::now();
+        std::vector<RegAllocResult> allocations(program.functions.size());
+        pool.parallelFor(program.functions.size(), [&](size_t f) { allocations[f] = allocateRegisters(program.functions[f], regalloc); });
+        size_t temps_before = 0, spilled = 0, spilling_functions = 0, copies_removed = 0;
+        uint32_t pressure = 0;
+        std::string regalloc_text;
+        program.temp_count = 0;
+        for (size_t f = 0; f < allocations.size(); ++f) {
+            const RegAllocResult& result = allocations[f];
+            temps_before += result.intervals.size();
+            spilled += result.spilled;
+            spilling_functions += result.spilled ? 1 : 0;
+            copies_removed += result.copies_removed;
+            pressure = std::max(pressure, result.max_pressure);
+            program.temp_count = std::max(program.temp_count, result.tempCount(regalloc));
+            if (dump_regalloc) appendRegAllocText(program, program.functions[f], result, regalloc, regalloc_text);
         }
-        last_processed_index = current_token_index;
+        double regalloc_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - regalloc_start).count();
+        std::cout << "ICG: Register allocation (" << regAllocMethodName(regalloc.method) << ", " << regalloc.registers << " registers): "
+                  << temps_before << " temps -> " << program.temp_count << " names, peak pressure " << pressure << ", " << spilled
+                  << " spilled in " << spilling_functions << " function(s), " << copies_removed << " copies removed, " << regalloc_ms << " ms" << std::endl;
+        if (dump_regalloc) {
+            std::ofstream regalloc_outfile("regalloc_output.txt");
+            if (!regalloc_outfile) std::cerr << "Error: Cannot open register allocation output file...\n";
+            else { regalloc_outfile << regalloc_text; std::cout << "ICG: Register allocation dump written to regalloc_output.txt" << std::endl; }
+        }
+    }
 
-        if (current_token_index < tokens.size() && tokens[current_token_index].type_str == "END_OF_FILE") break;
+    // --- Control-flow graphs of the optimized code (always built; the dumps below use them) ---
+    auto cfg_start = std::chrono::steady_clock::now();
+    std::vector<ControlFlowGraph> cfgs(program.functions.size());
+    pool.parallelFor(program.functions.size(), [&](size_t f) { cfgs[f] = buildCFG(program.functions[f]); });
+    size_t block_total = 0, edge_total = 0;
+    for (const ControlFlowGraph& cfg : cfgs) { block_total += cfg.size(); edge_total += cfg.edgeCount(); }
+    double cfg_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cfg_start).count();
+    std::cout << "ICG: Built CFGs for " << program.functions.size() << " function(s): " << block_total << " blocks, "
+              << edge_total << " edges in " << cfg_ms << " ms" << std::endl;
+    if (dump_cfg) {
+        std::string cfg_text;
+        for (size_t f = 0; f < program.functions.size(); ++f) appendCFGText(program, program.functions[f], cfgs[f], cfg_text);
+        std::ofstream cfg_outfile("cfg_output.txt");
+        if (!cfg_outfile) std::cerr << "Error: Cannot open CFG output file...\n";
+        else { cfg_outfile << cfg_text; std::cout << "ICG: CFG dump written to cfg_output.txt" << std::endl; }
+    }
+
+    // --- Dataflow analyses (on request; each function is solved independently) ---
+    if (dump_dataflow) {
+        auto dataflow_start = std::chrono::steady_clock::now();
+        std::vector<std::string> dataflow_texts(program.functions.size());
+        std::vector<double> solve_ms(program.functions.size(), 0.0);
+        std::vector<size_t> visits(program.functions.size(), 0);
+        pool.parallelFor(program.functions.size(), [&](size_t f) {
+            const TacFunction& function = program.functions[f];
+            auto solve_start = std::chrono::steady_clock::now();
+            LivenessInfo live = computeLiveness(program, function, cfgs[f]);
+            ReachingDefsInfo reach = computeReachingDefinitions(program, function, cfgs[f]);
+            AvailableExprsInfo avail = computeAvailableExpressions(program, function, cfgs[f]);
+            solve_ms[f] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - solve_start).count();
+            visits[f] = live.result.block_visits + reach.result.block_visits + avail.result.block_visits;
+            appendDataflowText(program, function, cfgs[f], live, reach, avail, dataflow_texts[f]);
+        });
+        size_t visit_total = 0;
+        double solve_total = 0;
+        for (size_t f = 0; f < visits.size(); ++f) { visit_total += visits[f]; solve_total += solve_ms[f]; }
+        std::ofstream dataflow_outfile("dataflow_output.txt");
+        if (!dataflow_outfile) std::cerr << "Error: Cannot open dataflow output file...\n";
+        else for (const std::string& text : dataflow_texts) dataflow_outfile << text;
+        double dataflow_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - dataflow_start).count();
+        std::cout << "ICG: Solved liveness, reaching definitions and available expressions (" << visit_total
+                  << " block visits) in " << solve_total << " ms of analysis time, " << dataflow_ms << " ms including the dump" << std::endl;
+        if (dataflow_outfile) std::cout << "ICG: Dataflow dump written to dataflow_output.txt" << std::endl;
+    }
+
+    // --- SSA form of the optimized code (on request; built on copies, the emitted 3AC is unchanged) ---
+    if (dump_ssa) {
+        std::vector<std::string> ssa_texts(program.functions.size());
+        pool.parallelFor(program.functions.size(), [&](size_t f) {
+            TacFunction function = program.functions[f];
+            SsaForm ssa = constructSSA(program, function);
+            appendSsaText(program, function, ssa, ssa_texts[f]);
+        });
+        std::ofstream ssa_outfile("ssa_output.txt");
+        if (!ssa_outfile) std::cerr << "Error: Cannot open SSA output file...\n";
+        else {
+            for (const std::string& text : ssa_texts) ssa_outfile << text;
+            std::cout << "ICG: SSA dump written to ssa_output.txt" << std::endl;
+        }
     }
 
 
     std::ofstream tac_outfile(tac_output_file);
     if (!tac_outfile) { std::cerr << "Error: Cannot open 3AC output file...\n"; return 1; }
     tac_outfile << "# Three-Address Code (Simulated - V6)" << std::endl; // Update version marker
-    if (three_addr_code.empty()) tac_outfile << "# (No 3AC generated)\n";
-    else for (const auto& line : three_addr_code) tac_outfile << line << std::endl;
+    if (program.functions.empty()) tac_outfile << "# (No 3AC generated)\n";
+    else writeTacText(program, tac_outfile);
     tac_outfile.close();
+    if (!binary_output_file.empty()) {
+        std::ofstream binary_outfile(binary_output_file, std::ios::binary);
+        if (binary_outfile) writeTacBinary(program, binary_outfile);
+        if (!binary_outfile) { std::cerr << "Error: Cannot write binary 3AC file: " << binary_output_file << std::endl; return 1; }
+        std::cout << "ICG: Binary 3AC written to " << binary_output_file << std::endl;
+    }
 
     std::ofstream dagvars_outfile(dag_input_vars_file);
      if (!dagvars_outfile) { std::cerr << "Error: Cannot open DAG variables file...\n"; }
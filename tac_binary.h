@@ -0,0 +1,301 @@
+// File: tac_binary.h - Versioned binary 3AC file (the intermediate_gen -> dag_builder handoff): writer and memory-mapped reader
+#ifndef TAC_BINARY_H
+#define TAC_BINARY_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "tac_ir.h"
+
+#if defined(_WIN32)
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// --- Layout ---
+// Everything is little-endian. The header is followed by a directory of sections, each 8-byte aligned:
+//   0   char[8]  magic "TAC3BIN\n"
+//   8   u32      version (kTacBinaryVersion)
+//   12  u32      section count
+//   16  u32      temp count, u32 label count (labels are numbered: Ln is Operand::label(n), no table needed)
+//   24  u64      file size
+//   32  {u64 offset, u64 bytes} per section, in TacSection order
+// Instructions are packed 16-byte records: u8 opcode, 3 bytes zero, then result, arg1, arg2 as raw Operand
+// bits. String tables are u32 offsets (count + 1 of them) into a byte blob. Globals, opaque symbols and
+// side-effect-free functions, which the text format cannot carry, are sorted u32 symbol ids.
+// A reader accepts files with more sections than it knows (later versions may append), never fewer.
+constexpr char kTacBinaryMagic[8] = {'T', 'A', 'C', '3', 'B', 'I', 'N', '\n'};
+constexpr uint32_t kTacBinaryVersion = 1;
+
+enum TacSection : uint32_t {
+    kSectionFunctions,      // Per function: u32 name, params (offset, count), code (offset, count), jump tables (offset, count)
+    kSectionParams,         // u32 symbol ids
+    kSectionCode,           // 16-byte instruction records
+    kSectionJumpTables,     // Per table: u32 targets offset, u32 targets count, u32 fallback label bits
+    kSectionJumpTargets,    // u32 label bits
+    kSectionSymbolOffsets,
+    kSectionSymbolBytes,
+    kSectionConstantOffsets,
+    kSectionConstantBytes,
+    kSectionGlobals,
+    kSectionOpaque,
+    kSectionSideEffectFree,
+    kSectionCount
+};
+
+namespace tac_binary_detail {
+constexpr size_t kHeaderBytes = 32;
+constexpr size_t kFunctionRecord = 7 * 4;
+constexpr size_t kInstrRecord = 16;
+constexpr size_t kJumpTableRecord = 3 * 4;
+
+inline void put32(std::string& out, uint32_t v) { for (int k = 0; k < 4; ++k) out += static_cast<char>((v >> (8 * k)) & 0xFF); }
+inline void put64(std::string& out, uint64_t v) { for (int k = 0; k < 8; ++k) out += static_cast<char>((v >> (8 * k)) & 0xFF); }
+inline uint32_t get32(const unsigned char* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24); }
+inline uint64_t get64(const unsigned char* p) { return get32(p) | (static_cast<uint64_t>(get32(p + 4)) << 32); }
+inline void align8(std::string& out) { while (out.size() % 8) out += '\0'; }
+
+inline void putStrings(std::string& offsets, std::string& bytes, const StringTable& table) {
+    uint32_t at = 0;
+    put32(offsets, 0);
+    for (const std::string& s : table.names) { bytes += s; at += static_cast<uint32_t>(s.size()); put32(offsets, at); }
+}
+} // namespace tac_binary_detail
+
+// --- Writer ---
+inline void writeTacBinary(const TacProgram& prog, std::ostream& os) {
+    using namespace tac_binary_detail;
+    std::vector<std::string> sections(kSectionCount);
+    uint32_t params = 0, code = 0, tables = 0, targets = 0;
+    for (const TacFunction& f : prog.functions) {
+        std::string& rec = sections[kSectionFunctions];
+        put32(rec, f.name);
+        put32(rec, params); put32(rec, static_cast<uint32_t>(f.params.size()));
+        put32(rec, code); put32(rec, static_cast<uint32_t>(f.code.size()));
+        put32(rec, tables); put32(rec, static_cast<uint32_t>(f.jump_tables.size()));
+        for (uint32_t p : f.params) put32(sections[kSectionParams], p);
+        for (const TacInstr& in : f.code) {
+            std::string& out = sections[kSectionCode];
+            out += static_cast<char>(in.op); out.append(3, '\0');
+            put32(out, in.result.bits); put32(out, in.arg1.bits); put32(out, in.arg2.bits);
+        }
+        for (const JumpTable& table : f.jump_tables) {
+            put32(sections[kSectionJumpTables], targets);
+            put32(sections[kSectionJumpTables], static_cast<uint32_t>(table.targets.size()));
+            put32(sections[kSectionJumpTables], table.fallback.bits);
+            for (Operand t : table.targets) put32(sections[kSectionJumpTargets], t.bits);
+            targets += static_cast<uint32_t>(table.targets.size());
+        }
+        params += static_cast<uint32_t>(f.params.size());
+        code += static_cast<uint32_t>(f.code.size());
+        tables += static_cast<uint32_t>(f.jump_tables.size());
+    }
+    putStrings(sections[kSectionSymbolOffsets], sections[kSectionSymbolBytes], prog.symbols);
+    putStrings(sections[kSectionConstantOffsets], sections[kSectionConstantBytes], prog.constants);
+    for (uint32_t s : prog.globals) put32(sections[kSectionGlobals], s);
+    for (uint32_t s : prog.opaque) put32(sections[kSectionOpaque], s);
+    for (uint32_t s : prog.side_effect_free) put32(sections[kSectionSideEffectFree], s);
+
+    std::string header(kTacBinaryMagic, sizeof kTacBinaryMagic);
+    put32(header, kTacBinaryVersion);
+    put32(header, kSectionCount);
+    put32(header, prog.temp_count);
+    put32(header, prog.label_count);
+    uint64_t at = kHeaderBytes + 16 * kSectionCount;
+    std::string directory;
+    for (std::string& s : sections) {
+        put64(directory, at); put64(directory, s.size());
+        align8(s);
+        at += s.size();
+    }
+    put64(header, at);
+    os.write(header.data(), static_cast<std::streamsize>(header.size()));
+    os.write(directory.data(), static_cast<std::streamsize>(directory.size()));
+    for (const std::string& s : sections) os.write(s.data(), static_cast<std::streamsize>(s.size()));
+}
+
+// --- Reader ---
+// The whole file mapped read-only (read into memory where mmap is not available)
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+#if defined(_WIN32)
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return;
+        copy_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        data_ = reinterpret_cast<const unsigned char*>(copy_.data());
+        size_ = copy_.size();
+        ok_ = true;
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (::fstat(fd, &st) == 0) {
+            size_ = static_cast<size_t>(st.st_size);
+            if (size_ == 0) ok_ = true;
+            else {
+                void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) { data_ = static_cast<const unsigned char*>(p); ok_ = true; }
+            }
+        }
+        ::close(fd);
+#endif
+    }
+    ~MappedFile() {
+#if !defined(_WIN32)
+        if (data_) ::munmap(const_cast<unsigned char*>(data_), size_);
+#endif
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool ok() const { return ok_; }
+    const unsigned char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const unsigned char* data_ = nullptr;
+    size_t size_ = 0;
+    bool ok_ = false;
+#if defined(_WIN32)
+    std::string copy_;
+#endif
+};
+
+inline bool isTacBinaryFile(const std::string& path) {
+    char magic[sizeof kTacBinaryMagic] = {};
+    std::ifstream in(path, std::ios::binary);
+    return in.read(magic, sizeof magic) && std::memcmp(magic, kTacBinaryMagic, sizeof magic) == 0;
+}
+
+// Decodes a binary 3AC file into prog. Every offset, count and operand is checked against the file, so a
+// truncated or corrupt file fails with a message instead of producing a broken program.
+inline bool readTacBinary(const std::string& path, TacProgram& prog, std::string& error) {
+    using namespace tac_binary_detail;
+    MappedFile file(path);
+    if (!file.ok()) { error = "cannot open " + path; return false; }
+    const unsigned char* base = file.data();
+    if (file.size() < kHeaderBytes || std::memcmp(base, kTacBinaryMagic, sizeof kTacBinaryMagic) != 0) { error = path + " is not a binary 3AC file"; return false; }
+    const uint32_t version = get32(base + 8), section_count = get32(base + 12);
+    if (version != kTacBinaryVersion) { error = path + ": unsupported binary 3AC version " + std::to_string(version); return false; }
+    if (section_count < kSectionCount || file.size() < kHeaderBytes + 16ull * section_count || get64(base + 24) != file.size()) {
+        error = path + ": truncated or corrupt binary 3AC header"; return false;
+    }
+    const unsigned char* section[kSectionCount];
+    uint64_t bytes[kSectionCount];
+    for (uint32_t s = 0; s < kSectionCount; ++s) {
+        const uint64_t offset = get64(base + kHeaderBytes + 16 * s);
+        bytes[s] = get64(base + kHeaderBytes + 16 * s + 8);
+        if (offset > file.size() || bytes[s] > file.size() - offset) { error = path + ": section " + std::to_string(s) + " out of bounds"; return false; }
+        section[s] = base + offset;
+    }
+    auto count = [&](TacSection s, size_t record) { return bytes[s] % record == 0 ? bytes[s] / record : SIZE_MAX; };
+    auto u32s = [&](TacSection s, std::vector<uint32_t>& out) {
+        const size_t n = count(s, 4);
+        if (n == SIZE_MAX) return false;
+        out.resize(n);
+        for (size_t k = 0; k < n; ++k) out[k] = get32(section[s] + 4 * k);
+        return true;
+    };
+    auto strings = [&](TacSection offsets, TacSection blob, StringTable& table) {
+        const size_t n = count(offsets, 4);
+        if (n == SIZE_MAX || n == 0) return false;
+        table.names.clear(); table.index.clear();
+        table.names.reserve(n - 1);
+        for (size_t k = 0; k + 1 < n; ++k) {
+            const uint32_t from = get32(section[offsets] + 4 * k), to = get32(section[offsets] + 4 * k + 4);
+            if (from > to || to > bytes[blob]) return false;
+            table.names.emplace_back(reinterpret_cast<const char*>(section[blob]) + from, to - from);
+            table.index.emplace(table.names.back(), static_cast<uint32_t>(k));
+        }
+        return true;
+    };
+
+    prog = TacProgram();
+    prog.temp_count = get32(base + 16);
+    prog.label_count = get32(base + 20);
+    if (!strings(kSectionSymbolOffsets, kSectionSymbolBytes, prog.symbols) || !strings(kSectionConstantOffsets, kSectionConstantBytes, prog.constants) ||
+        !u32s(kSectionGlobals, prog.globals) || !u32s(kSectionOpaque, prog.opaque) || !u32s(kSectionSideEffectFree, prog.side_effect_free)) {
+        error = path + ": corrupt string or symbol tables"; return false;
+    }
+    const uint32_t symbols = static_cast<uint32_t>(prog.symbols.size()), constants = static_cast<uint32_t>(prog.constants.size());
+    auto validOperand = [&](Operand o) { // Temp and label counts grow to cover every id, as in parseTacText
+        switch (o.kind()) {
+            case OperandKind::None: return o.bits == 0;
+            case OperandKind::Temp: prog.temp_count = std::max(prog.temp_count, o.id() + 1); return true;
+            case OperandKind::Symbol: return o.id() < symbols;
+            case OperandKind::Const: return o.id() < constants;
+            case OperandKind::Label: prog.label_count = std::max(prog.label_count, o.id() + 1); return true;
+            case OperandKind::Imm: return true;
+            default: return false; // Locals never leave a pass
+        }
+    };
+    for (const std::vector<uint32_t>* ids : {&prog.globals, &prog.opaque, &prog.side_effect_free}) {
+        for (uint32_t id : *ids) if (id >= symbols) { error = path + ": symbol id out of range"; return false; }
+    }
+
+    const size_t functions = count(kSectionFunctions, kFunctionRecord), instrs = count(kSectionCode, kInstrRecord);
+    const size_t tables = count(kSectionJumpTables, kJumpTableRecord), params = count(kSectionParams, 4), targets = count(kSectionJumpTargets, 4);
+    if (functions == SIZE_MAX || instrs == SIZE_MAX || tables == SIZE_MAX || params == SIZE_MAX || targets == SIZE_MAX) {
+        error = path + ": corrupt section sizes"; return false;
+    }
+    prog.functions.resize(functions);
+    for (size_t f = 0; f < functions; ++f) {
+        const unsigned char* rec = section[kSectionFunctions] + kFunctionRecord * f;
+        TacFunction& fn = prog.functions[f];
+        const uint32_t name = get32(rec), param_at = get32(rec + 4), param_n = get32(rec + 8), code_at = get32(rec + 12), code_n = get32(rec + 16);
+        const uint32_t table_at = get32(rec + 20), table_n = get32(rec + 24);
+        if ((name != TacFunction::kNoName && name >= symbols) || param_at > params || param_n > params - param_at || code_at > instrs ||
+            code_n > instrs - code_at || table_at > tables || table_n > tables - table_at) {
+            error = path + ": corrupt function table"; return false;
+        }
+        fn.name = name;
+        fn.params.resize(param_n);
+        for (uint32_t k = 0; k < param_n; ++k) {
+            fn.params[k] = get32(section[kSectionParams] + 4 * (param_at + k));
+            if (fn.params[k] >= symbols) { error = path + ": corrupt parameter list"; return false; }
+        }
+        fn.code.resize(code_n);
+        for (uint32_t k = 0; k < code_n; ++k) {
+            const unsigned char* r = section[kSectionCode] + kInstrRecord * (code_at + k);
+            TacInstr& in = fn.code[k];
+            if (r[0] > static_cast<uint8_t>(TacOp::Comment)) { error = path + ": unknown opcode"; return false; }
+            in.op = static_cast<TacOp>(r[0]);
+            in.result.bits = get32(r + 4); in.arg1.bits = get32(r + 8); in.arg2.bits = get32(r + 12);
+            if (!validOperand(in.result) || !validOperand(in.arg1) || !validOperand(in.arg2)) { error = path + ": operand out of range"; return false; }
+            if (in.op == TacOp::JumpTable && (!in.arg2.isImm() || in.arg2.immValue() < 0 || static_cast<uint32_t>(in.arg2.immValue()) >= table_n)) {
+                error = path + ": jump table index out of range"; return false;
+            }
+            // Slots the passes read without looking at the kind: call target and argument count, branch targets
+            const bool kinds_ok = in.op == TacOp::Call ? in.arg1.isSymbol() && (in.arg2.isConst() || in.arg2.isImm())
+                                : in.op == TacOp::Goto ? in.arg1.isLabel()
+                                : in.op == TacOp::IfFalse || in.op == TacOp::IfTrue ? in.arg2.isLabel()
+                                : true;
+            if (!kinds_ok) { error = path + ": wrong operand kind for " + instrToString(prog, in); return false; }
+        }
+        fn.jump_tables.resize(table_n);
+        for (uint32_t k = 0; k < table_n; ++k) {
+            const unsigned char* r = section[kSectionJumpTables] + kJumpTableRecord * (table_at + k);
+            const uint32_t at = get32(r), n = get32(r + 4);
+            JumpTable& table = fn.jump_tables[k];
+            table.fallback.bits = get32(r + 8);
+            if (at > targets || n > targets - at || !table.fallback.isLabel() || !validOperand(table.fallback)) { error = path + ": corrupt jump table"; return false; }
+            table.targets.resize(n);
+            for (uint32_t t = 0; t < n; ++t) {
+                table.targets[t].bits = get32(section[kSectionJumpTargets] + 4 * (at + t));
+                if (!table.targets[t].isLabel() || !validOperand(table.targets[t])) { error = path + ": corrupt jump table"; return false; }
+            }
+        }
+    }
+    return true;
+}
+
+#endif // TAC_BINARY_H
@@ -0,0 +1,205 @@
+// File: tac_callgraph.h - Call graph over the program's functions, its strongly connected components in bottom-up order, and per-function effect summaries
+#ifndef TAC_CALLGRAPH_H
+#define TAC_CALLGRAPH_H
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "tac_ir.h"
+#include "thread_pool.h"
+
+// --- Call Sites ---
+// Shared by the interprocedural transforms and by dead-code elimination, which drops whole call sites
+inline bool callArgumentCount(const TacProgram& prog, const TacInstr& call, int32_t& n) {
+    if (call.arg2.isImm()) { n = call.arg2.immValue(); return true; }
+    return call.arg2.isConst() && integerLiteral(prog.constants[call.arg2.id()], n) && n >= 0;
+}
+
+// The params feeding code[call], in order. Walks back within the block, skipping params that belong to calls
+// made in between (f(a, g(b)) pushes a, then b for g). Fails if they are not all in the call's block.
+inline bool findCallParams(const TacProgram& prog, const std::vector<TacInstr>& code, size_t call, uint32_t n, std::vector<size_t>& params) {
+    params.clear();
+    uint32_t owed = 0;
+    for (size_t k = call; params.size() < n && k-- > 0;) {
+        const TacInstr& in = code[k];
+        if (in.op == TacOp::Label || in.op == TacOp::Goto || in.op == TacOp::Return || in.op == TacOp::IfFalse || in.op == TacOp::IfTrue ||
+            in.op == TacOp::JumpTable) return false;
+        if (in.op == TacOp::Call) { int32_t m; if (!callArgumentCount(prog, in, m)) return false; owed += static_cast<uint32_t>(m); }
+        else if (in.op == TacOp::Param) { if (owed) owed--; else params.push_back(k); }
+    }
+    if (params.size() < n) return false;
+    std::reverse(params.begin(), params.end());
+    return true;
+}
+
+// --- Call Graph ---
+// One node per entry of program.functions (top-level segments included: they call, but are never called).
+// Components come out of Tarjan's algorithm callees first, so walking `sccs` in order is a bottom-up walk.
+// Levels group components for parallel work: a component's level is one more than the highest level among
+// the components it calls, so components on the same level never call each other.
+struct CallGraph {
+    std::vector<std::vector<uint32_t>> callees;     // Distinct functions of the program each function calls (sorted)
+    std::vector<std::vector<uint32_t>> callers;
+    std::vector<uint8_t> calls_unknown;             // Calls some function the program does not define
+    std::vector<std::vector<uint32_t>> sccs;        // Bottom-up: every component after the components it calls
+    std::vector<uint32_t> scc_of;                   // Function -> index into sccs
+    std::vector<uint32_t> scc_level;
+    std::vector<std::vector<uint32_t>> levels;      // Component indices per level, lowest first
+    std::unordered_map<uint32_t, uint32_t> by_name; // Function symbol -> function index (first definition)
+    size_t edges = 0;
+
+    size_t size() const { return callees.size(); }
+    // Part of a cycle: a component with several functions, or a function calling itself
+    bool recursive(uint32_t scc) const {
+        const std::vector<uint32_t>& members = sccs[scc];
+        return members.size() > 1 || std::binary_search(callees[members[0]].begin(), callees[members[0]].end(), members[0]);
+    }
+    size_t recursiveCount() const {
+        size_t n = 0;
+        for (uint32_t s = 0; s < sccs.size(); ++s) n += recursive(s) ? 1 : 0;
+        return n;
+    }
+    // Function index of a call's target, or UINT32_MAX when the program does not define it
+    uint32_t target(const TacInstr& call) const {
+        auto it = by_name.find(call.arg1.id());
+        return call.arg1.isSymbol() && it != by_name.end() ? it->second : UINT32_MAX;
+    }
+};
+
+inline CallGraph buildCallGraph(const TacProgram& prog) {
+    CallGraph g;
+    const uint32_t n = static_cast<uint32_t>(prog.functions.size());
+    for (uint32_t f = 0; f < n; ++f) {
+        if (!prog.functions[f].isTopLevel()) g.by_name.emplace(prog.functions[f].name, f);
+    }
+    g.callees.resize(n);
+    g.callers.resize(n);
+    g.calls_unknown.assign(n, 0);
+    for (uint32_t f = 0; f < n; ++f) {
+        std::vector<uint32_t>& out = g.callees[f];
+        for (const TacInstr& in : prog.functions[f].code) {
+            if (in.op != TacOp::Call) continue;
+            uint32_t callee = g.target(in);
+            if (callee == UINT32_MAX) g.calls_unknown[f] = 1;
+            else out.push_back(callee);
+        }
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+        for (uint32_t callee : out) g.callers[callee].push_back(f);
+        g.edges += out.size();
+    }
+
+    // Tarjan's algorithm with an explicit stack, so call chains thousands of functions deep are fine
+    const uint32_t kUnvisited = UINT32_MAX;
+    std::vector<uint32_t> index(n, kUnvisited), low(n, 0), stack;
+    std::vector<uint8_t> on_stack(n, 0);
+    std::vector<std::pair<uint32_t, size_t>> frames; // (function, next callee to visit)
+    uint32_t counter = 0;
+    g.scc_of.assign(n, 0);
+    for (uint32_t root = 0; root < n; ++root) {
+        if (index[root] != kUnvisited) continue;
+        index[root] = low[root] = counter++;
+        stack.push_back(root); on_stack[root] = 1;
+        frames.emplace_back(root, 0);
+        while (!frames.empty()) {
+            const uint32_t v = frames.back().first;
+            if (frames.back().second < g.callees[v].size()) {
+                const uint32_t w = g.callees[v][frames.back().second++];
+                if (index[w] == kUnvisited) {
+                    index[w] = low[w] = counter++;
+                    stack.push_back(w); on_stack[w] = 1;
+                    frames.emplace_back(w, 0);
+                } else if (on_stack[w]) low[v] = std::min(low[v], index[w]);
+                continue;
+            }
+            frames.pop_back();
+            if (!frames.empty()) low[frames.back().first] = std::min(low[frames.back().first], low[v]);
+            if (low[v] != index[v]) continue;
+            const uint32_t s = static_cast<uint32_t>(g.sccs.size());
+            g.sccs.emplace_back();
+            uint32_t w;
+            do {
+                w = stack.back(); stack.pop_back(); on_stack[w] = 0;
+                g.scc_of[w] = s;
+                g.sccs.back().push_back(w);
+            } while (w != v);
+            std::sort(g.sccs.back().begin(), g.sccs.back().end());
+        }
+    }
+
+    g.scc_level.assign(g.sccs.size(), 0);
+    for (uint32_t s = 0; s < g.sccs.size(); ++s) {
+        for (uint32_t f : g.sccs[s]) {
+            for (uint32_t callee : g.callees[f]) {
+                if (g.scc_of[callee] != s) g.scc_level[s] = std::max(g.scc_level[s], g.scc_level[g.scc_of[callee]] + 1);
+            }
+        }
+        if (g.scc_level[s] >= g.levels.size()) g.levels.resize(g.scc_level[s] + 1);
+        g.levels[g.scc_level[s]].push_back(s);
+    }
+    return g;
+}
+
+// Runs fn(scc) for every component, callees before callers; components on one level run in parallel
+template <typename Fn>
+void forEachSccBottomUp(const CallGraph& g, ThreadPool& pool, Fn fn) {
+    for (const std::vector<uint32_t>& level : g.levels) pool.parallelFor(level.size(), [&](size_t k) { fn(level[k]); });
+}
+
+// --- Summaries ---
+// What a call to a function may do, counting everything it calls. Functions in one component share a summary.
+struct FunctionSummary {
+    static constexpr uint32_t kUnbounded = UINT32_MAX;
+    bool io = false;                // read or write
+    bool reads_globals = false;
+    bool writes_globals = false;
+    bool calls_unknown = false;     // Reaches a function the program does not define
+    bool recursive = false;         // Reaches a cycle of calls
+    uint32_t call_depth = 0;        // Longest chain of nested calls it makes (kUnbounded through recursion)
+
+    // A call whose result is unused can go. Recursion counts as an effect (it may not terminate); loops do
+    // not, since C++ lets a loop without side effects be assumed to terminate.
+    bool sideEffectFree() const { return !io && !writes_globals && !calls_unknown && !recursive; }
+    // Its result depends only on its arguments
+    bool pure() const { return sideEffectFree() && !reads_globals; }
+};
+
+// One summary per function. The facts of each function's own code are gathered in parallel, then folded
+// into callers one level of components at a time.
+inline std::vector<FunctionSummary> summarizeFunctions(const TacProgram& prog, const CallGraph& g, ThreadPool& pool) {
+    std::vector<FunctionSummary> local(g.size()), summary(g.size());
+    pool.parallelFor(g.size(), [&](size_t f) {
+        FunctionSummary& s = local[f];
+        for (const TacInstr& in : prog.functions[f].code) {
+            if (in.op == TacOp::Read || in.op == TacOp::Write) s.io = true;
+            if (prog.isGlobal(definedOperand(in))) s.writes_globals = true;
+            Operand uses[2];
+            for (int u = 0, m = usedOperands(in, uses); u < m; ++u) s.reads_globals |= prog.isGlobal(uses[u]);
+        }
+        s.calls_unknown = g.calls_unknown[f] != 0;
+        if (s.calls_unknown) s.call_depth = 1;
+    });
+    forEachSccBottomUp(g, pool, [&](uint32_t scc) {
+        FunctionSummary s;
+        s.recursive = g.recursive(scc);
+        for (uint32_t f : g.sccs[scc]) {
+            const FunctionSummary& own = local[f];
+            s.io |= own.io; s.reads_globals |= own.reads_globals; s.writes_globals |= own.writes_globals;
+            s.calls_unknown |= own.calls_unknown;
+            s.call_depth = std::max(s.call_depth, own.call_depth);
+            for (uint32_t callee : g.callees[f]) {
+                if (g.scc_of[callee] == scc) continue;
+                const FunctionSummary& c = summary[callee]; // Lower level: already final
+                s.io |= c.io; s.reads_globals |= c.reads_globals; s.writes_globals |= c.writes_globals;
+                s.calls_unknown |= c.calls_unknown; s.recursive |= c.recursive;
+                s.call_depth = std::max(s.call_depth, c.call_depth == FunctionSummary::kUnbounded ? c.call_depth : c.call_depth + 1);
+            }
+        }
+        if (s.recursive) s.call_depth = FunctionSummary::kUnbounded;
+        for (uint32_t f : g.sccs[scc]) summary[f] = s;
+    });
+    return summary;
+}
+
+#endif // TAC_CALLGRAPH_H
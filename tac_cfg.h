@@ -0,0 +1,296 @@
+// File: tac_cfg.h - Basic blocks, control-flow graph, reverse postorder and dominator tree over TacFunction code
+#ifndef TAC_CFG_H
+#define TAC_CFG_H
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "tac_ir.h"
+
+inline bool isBranch(TacOp op) { return op == TacOp::IfFalse || op == TacOp::IfTrue; }
+// Instructions after which control never falls through to the next one
+inline bool endsControlFlow(TacOp op) { return op == TacOp::Goto || op == TacOp::Return || op == TacOp::JumpTable; }
+
+// --- Basic Block ---
+// Instruction range [begin, end) in the owning function's code vector
+struct BasicBlock {
+    uint32_t begin = 0;
+    uint32_t end = 0;
+};
+
+// --- Control-Flow Graph ---
+// Edges live in compressed adjacency arrays: the successors of block b are
+// succs[succ_offsets[b] .. succ_offsets[b+1]) (likewise for predecessors).
+// Block 0 is the entry and never has predecessors (code that starts at a label gets an empty entry block).
+// Unreachable blocks are kept but get no RPO number or dominator.
+struct ControlFlowGraph {
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    std::vector<BasicBlock> blocks;
+    std::vector<uint32_t> succ_offsets, succs;
+    std::vector<uint32_t> pred_offsets, preds;
+    std::vector<uint32_t> rpo;          // Reachable blocks in reverse postorder (rpo[0] == entry)
+    std::vector<uint32_t> rpo_index;    // Block -> position in rpo, kNone if unreachable
+    std::vector<uint32_t> idom;         // Immediate dominator (entry -> itself, unreachable -> kNone)
+    std::vector<uint32_t> dom_offsets, dom_children; // Dominator tree, same compressed layout
+    std::vector<std::pair<uint32_t, uint32_t>> label_blocks; // (label operand bits, block), sorted by label
+
+    struct Range {
+        const uint32_t* first; const uint32_t* last;
+        const uint32_t* begin() const { return first; }
+        const uint32_t* end() const { return last; }
+        size_t size() const { return static_cast<size_t>(last - first); }
+        bool empty() const { return first == last; }
+    };
+    Range successors(uint32_t b) const { return { succs.data() + succ_offsets[b], succs.data() + succ_offsets[b + 1] }; }
+    Range predecessors(uint32_t b) const { return { preds.data() + pred_offsets[b], preds.data() + pred_offsets[b + 1] }; }
+    Range domChildren(uint32_t b) const { return { dom_children.data() + dom_offsets[b], dom_children.data() + dom_offsets[b + 1] }; }
+
+    uint32_t size() const { return static_cast<uint32_t>(blocks.size()); }
+    uint32_t edgeCount() const { return static_cast<uint32_t>(succs.size()); }
+    bool reachable(uint32_t b) const { return rpo_index[b] != kNone; }
+
+    // Block that starts with the given label, kNone if the label is not defined in this function
+    uint32_t blockOfLabel(Operand label) const {
+        auto it = std::lower_bound(label_blocks.begin(), label_blocks.end(), std::make_pair(label.bits, 0u));
+        return (it != label_blocks.end() && it->first == label.bits) ? it->second : kNone;
+    }
+
+    // True if a dominates b (walks b's idom chain; depth is small in structured code)
+    bool dominates(uint32_t a, uint32_t b) const {
+        if (!reachable(a) || !reachable(b)) return false;
+        while (rpo_index[b] > rpo_index[a]) b = idom[b];
+        return a == b;
+    }
+};
+
+namespace tac_cfg_detail {
+// Builds CSR arrays from an (unsorted) edge list keyed on edges[k].first
+inline void buildAdjacency(uint32_t node_count, const std::vector<std::pair<uint32_t, uint32_t>>& edges,
+                           std::vector<uint32_t>& offsets, std::vector<uint32_t>& targets) {
+    offsets.assign(node_count + 1, 0);
+    for (const auto& e : edges) offsets[e.first + 1]++;
+    for (uint32_t k = 0; k < node_count; ++k) offsets[k + 1] += offsets[k];
+    targets.resize(edges.size());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (const auto& e : edges) targets[fill[e.first]++] = e.second;
+}
+} // namespace tac_cfg_detail
+
+// --- CFG Construction ---
+// Leaders: the first instruction, every label, and every instruction after a branch/goto/return/jump table.
+// Code that starts at a label gets an empty entry block first; an empty function a single empty block.
+inline std::vector<BasicBlock> partitionBlocks(const std::vector<TacInstr>& code) {
+    std::vector<BasicBlock> blocks;
+    const uint32_t n = static_cast<uint32_t>(code.size());
+    if (n > 0 && code[0].op == TacOp::Label) blocks.push_back({0, 0});
+    for (uint32_t k = 0; k < n; ++k) {
+        bool leader = (k == 0) || code[k].op == TacOp::Label ||
+                      endsControlFlow(code[k - 1].op) || isBranch(code[k - 1].op);
+        if (leader) {
+            if (!blocks.empty()) blocks.back().end = k;
+            blocks.push_back({k, n});
+        }
+    }
+    if (blocks.empty()) blocks.push_back({0, 0});
+    return blocks;
+}
+
+// tables are the jump tables that JumpTable instructions in code index (the owning function's).
+inline ControlFlowGraph buildCFG(const std::vector<TacInstr>& code, const std::vector<JumpTable>& tables) {
+    using namespace tac_cfg_detail;
+    ControlFlowGraph cfg;
+    cfg.blocks = partitionBlocks(code);
+
+    // Every label leads its block
+    std::vector<std::pair<uint32_t, uint32_t>>& label_blocks = cfg.label_blocks;
+    for (uint32_t b = 0; b < cfg.size(); ++b) {
+        const BasicBlock& bb = cfg.blocks[b];
+        if (bb.begin < bb.end && code[bb.begin].op == TacOp::Label) label_blocks.emplace_back(code[bb.begin].arg1.bits, b);
+    }
+    std::sort(label_blocks.begin(), label_blocks.end());
+    auto blockOfLabel = [&](Operand label) { return cfg.blockOfLabel(label); };
+
+    // Edges (duplicates collapsed, e.g. a branch whose target is the fall-through block)
+    const uint32_t block_count = cfg.size();
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    edges.reserve(block_count * 2);
+    for (uint32_t b = 0; b < block_count; ++b) {
+        const BasicBlock& bb = cfg.blocks[b];
+        auto addEdge = [&](uint32_t to) {
+            if (to == ControlFlowGraph::kNone) return;
+            for (size_t e = edges.size(); e-- > 0 && edges[e].first == b;) if (edges[e].second == to) return;
+            edges.emplace_back(b, to);
+        };
+        if (bb.end == bb.begin) { if (b + 1 < block_count) addEdge(b + 1); continue; }
+        const TacInstr& last = code[bb.end - 1];
+        if (last.op == TacOp::Goto) addEdge(blockOfLabel(last.arg1));
+        else if (last.op == TacOp::Return) {}
+        else if (last.op == TacOp::JumpTable) {
+            const JumpTable& table = tables[static_cast<uint32_t>(last.arg2.immValue())];
+            for (Operand target : table.targets) addEdge(blockOfLabel(target));
+            addEdge(blockOfLabel(table.fallback));
+        }
+        else {
+            if (b + 1 < block_count) addEdge(b + 1);
+            if (isBranch(last.op)) addEdge(blockOfLabel(last.arg2));
+        }
+    }
+    buildAdjacency(block_count, edges, cfg.succ_offsets, cfg.succs);
+    for (auto& e : edges) std::swap(e.first, e.second);
+    buildAdjacency(block_count, edges, cfg.pred_offsets, cfg.preds);
+
+    // Reverse postorder (iterative DFS from the entry)
+    cfg.rpo_index.assign(block_count, ControlFlowGraph::kNone);
+    std::vector<uint8_t> visited(block_count, 0);
+    std::vector<std::pair<uint32_t, uint32_t>> stack; // (block, next successor slot)
+    std::vector<uint32_t> postorder;
+    postorder.reserve(block_count);
+    stack.emplace_back(0, cfg.succ_offsets[0]);
+    visited[0] = 1;
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        if (top.second < cfg.succ_offsets[top.first + 1]) {
+            uint32_t s = cfg.succs[top.second++];
+            if (!visited[s]) { visited[s] = 1; stack.emplace_back(s, cfg.succ_offsets[s]); }
+        } else {
+            postorder.push_back(top.first);
+            stack.pop_back();
+        }
+    }
+    cfg.rpo.assign(postorder.rbegin(), postorder.rend());
+    for (uint32_t k = 0; k < cfg.rpo.size(); ++k) cfg.rpo_index[cfg.rpo[k]] = k;
+
+    // Dominators: Cooper, Harvey & Kennedy, "A Simple, Fast Dominance Algorithm"
+    cfg.idom.assign(block_count, ControlFlowGraph::kNone);
+    cfg.idom[0] = 0;
+    auto intersect = [&](uint32_t a, uint32_t b) {
+        while (a != b) {
+            while (cfg.rpo_index[a] > cfg.rpo_index[b]) a = cfg.idom[a];
+            while (cfg.rpo_index[b] > cfg.rpo_index[a]) b = cfg.idom[b];
+        }
+        return a;
+    };
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (uint32_t k = 1; k < cfg.rpo.size(); ++k) {
+            uint32_t b = cfg.rpo[k];
+            uint32_t new_idom = ControlFlowGraph::kNone;
+            for (uint32_t p : cfg.predecessors(b)) {
+                if (cfg.idom[p] == ControlFlowGraph::kNone) continue; // Not processed yet / unreachable
+                new_idom = (new_idom == ControlFlowGraph::kNone) ? p : intersect(p, new_idom);
+            }
+            if (new_idom != cfg.idom[b]) { cfg.idom[b] = new_idom; changed = true; }
+        }
+    }
+
+    // Dominator tree children (in RPO order, so a pre-order walk visits blocks in RPO-compatible order)
+    std::vector<std::pair<uint32_t, uint32_t>> tree_edges;
+    tree_edges.reserve(cfg.rpo.size());
+    for (uint32_t k = 1; k < cfg.rpo.size(); ++k) tree_edges.emplace_back(cfg.idom[cfg.rpo[k]], cfg.rpo[k]);
+    buildAdjacency(block_count, tree_edges, cfg.dom_offsets, cfg.dom_children);
+    return cfg;
+}
+
+inline ControlFlowGraph buildCFG(const TacFunction& function) { return buildCFG(function.code, function.jump_tables); }
+
+// --- Dominance Frontiers ---
+// Cooper, Harvey & Kennedy: walk up from each predecessor of a join block until reaching its idom.
+// The frontier of block b is frontier[offsets[b] .. offsets[b+1]), same compressed layout as the CFG edges.
+inline void computeDominanceFrontiers(const ControlFlowGraph& cfg, std::vector<uint32_t>& offsets, std::vector<uint32_t>& frontier) {
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    std::vector<uint32_t> last_added(cfg.size(), ControlFlowGraph::kNone);
+    for (uint32_t b : cfg.rpo) {
+        if (cfg.predecessors(b).size() < 2) continue;
+        for (uint32_t p : cfg.predecessors(b)) {
+            if (!cfg.reachable(p)) continue;
+            for (uint32_t runner = p; runner != cfg.idom[b] && last_added[runner] != b; runner = cfg.idom[runner]) {
+                pairs.emplace_back(runner, b);
+                last_added[runner] = b;
+                if (runner == 0) break;
+            }
+        }
+    }
+    tac_cfg_detail::buildAdjacency(cfg.size(), pairs, offsets, frontier);
+}
+
+// --- Natural Loops ---
+// One loop per header: the union of the natural loops of all back edges t -> h (h dominates t), found by walking
+// predecessors back from each latch until the header. Loops come out sorted by header in reverse postorder,
+// so an enclosing loop precedes the loops nested in it.
+struct NaturalLoop {
+    uint32_t header = 0;
+    std::vector<uint32_t> blocks;      // Sorted, header included
+    std::vector<uint32_t> latches;     // Sources of the back edges
+    uint32_t parent = ControlFlowGraph::kNone; // Innermost enclosing loop (index into the same vector)
+    uint32_t depth = 1;
+
+    bool contains(uint32_t b) const { return std::binary_search(blocks.begin(), blocks.end(), b); }
+};
+
+inline std::vector<NaturalLoop> findNaturalLoops(const ControlFlowGraph& cfg) {
+    std::vector<NaturalLoop> loops;
+    std::vector<uint32_t> loop_of_header(cfg.size(), ControlFlowGraph::kNone);
+    for (uint32_t h : cfg.rpo) {
+        for (uint32_t t : cfg.predecessors(h)) {
+            if (!cfg.dominates(h, t)) continue;
+            if (loop_of_header[h] == ControlFlowGraph::kNone) {
+                loop_of_header[h] = static_cast<uint32_t>(loops.size());
+                loops.emplace_back();
+                loops.back().header = h;
+            }
+            loops[loop_of_header[h]].latches.push_back(t);
+        }
+    }
+    std::vector<uint32_t> mark(cfg.size(), ControlFlowGraph::kNone), stack;
+    for (uint32_t l = 0; l < loops.size(); ++l) {
+        NaturalLoop& loop = loops[l];
+        mark[loop.header] = l;
+        loop.blocks.push_back(loop.header);
+        for (uint32_t t : loop.latches) if (mark[t] != l) { mark[t] = l; loop.blocks.push_back(t); stack.push_back(t); }
+        while (!stack.empty()) {
+            uint32_t b = stack.back(); stack.pop_back();
+            for (uint32_t p : cfg.predecessors(b)) {
+                if (mark[p] != l && cfg.reachable(p)) { mark[p] = l; loop.blocks.push_back(p); stack.push_back(p); }
+            }
+        }
+        std::sort(loop.blocks.begin(), loop.blocks.end());
+    }
+    // Parent: every enclosing loop's header dominates this header, so the innermost one is the first loop met
+    // walking up the dominator tree whose body holds the header. Parents come first in the vector.
+    for (NaturalLoop& loop : loops) {
+        for (uint32_t a = loop.header; a != 0 && loop.parent == ControlFlowGraph::kNone;) {
+            a = cfg.idom[a];
+            const uint32_t o = loop_of_header[a];
+            if (o != ControlFlowGraph::kNone && loops[o].contains(loop.header)) { loop.parent = o; loop.depth = loops[o].depth + 1; }
+        }
+    }
+    return loops;
+}
+
+// --- Text dump (one line per block: range, successors, immediate dominator; then one line per loop) ---
+inline void appendCFGText(const TacProgram& prog, const TacFunction& function, const ControlFlowGraph& cfg, std::string& out) {
+    out += "func "; out += function.isTopLevel() ? std::string("<top-level>") : prog.symbols[function.name];
+    out += ": " + std::to_string(cfg.size()) + " blocks, " + std::to_string(cfg.edgeCount()) + " edges\n";
+    for (uint32_t b = 0; b < cfg.size(); ++b) {
+        out += "  B" + std::to_string(b) + " [" + std::to_string(cfg.blocks[b].begin) + "," + std::to_string(cfg.blocks[b].end) + ")";
+        out += " succ:";
+        for (uint32_t s : cfg.successors(b)) out += " B" + std::to_string(s);
+        out += "  idom: ";
+        if (!cfg.reachable(b)) out += "unreachable";
+        else if (b == 0) out += "-";
+        else out += "B" + std::to_string(cfg.idom[b]);
+        out += '\n';
+        for (uint32_t k = cfg.blocks[b].begin; k < cfg.blocks[b].end; ++k) { out += "    "; appendInstr(prog, function.code[k], out, &function.jump_tables); out += '\n'; }
+    }
+    for (const NaturalLoop& loop : findNaturalLoops(cfg)) {
+        out += "  loop B" + std::to_string(loop.header) + " depth " + std::to_string(loop.depth) + ":";
+        for (uint32_t b : loop.blocks) out += " B" + std::to_string(b);
+        out += "  latches:";
+        for (uint32_t t : loop.latches) out += " B" + std::to_string(t);
+        out += '\n';
+    }
+}
+
+#endif // TAC_CFG_H
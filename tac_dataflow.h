@@ -0,0 +1,428 @@
+// File: tac_dataflow.h - Bit-vector dataflow framework: worklist solver plus liveness, reaching definitions and available expressions
+#ifndef TAC_DATAFLOW_H
+#define TAC_DATAFLOW_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "tac_ir.h"
+#include "tac_cfg.h"
+
+// --- Dense Bit Vector ---
+// All set operations work a 64-bit word at a time; the loops are simple enough for the compiler to vectorise.
+class BitVector {
+public:
+    BitVector() = default;
+    explicit BitVector(uint32_t bits, bool value = false) { resize(bits, value); }
+
+    void resize(uint32_t bits, bool value = false) {
+        size_ = bits;
+        words_.assign((bits + 63) / 64, value ? ~uint64_t(0) : 0);
+        trimTail();
+    }
+    uint32_t size() const { return size_; }
+
+    bool test(uint32_t i) const { return (words_[i >> 6] >> (i & 63)) & 1; }
+    void set(uint32_t i) { words_[i >> 6] |= uint64_t(1) << (i & 63); }
+    void reset(uint32_t i) { words_[i >> 6] &= ~(uint64_t(1) << (i & 63)); }
+    void clearAll() { std::fill(words_.begin(), words_.end(), 0); }
+    void setAll() { std::fill(words_.begin(), words_.end(), ~uint64_t(0)); trimTail(); }
+
+    // this |= o; returns true if any bit changed
+    bool unionWith(const BitVector& o) {
+        uint64_t changed = 0;
+        uint64_t* __restrict w = words_.data();
+        const uint64_t* __restrict v = o.words_.data();
+        for (size_t k = 0, n = words_.size(); k < n; ++k) { uint64_t x = w[k] | v[k]; changed |= x ^ w[k]; w[k] = x; }
+        return changed != 0;
+    }
+    // this &= o; returns true if any bit changed
+    bool intersectWith(const BitVector& o) {
+        uint64_t changed = 0;
+        uint64_t* __restrict w = words_.data();
+        const uint64_t* __restrict v = o.words_.data();
+        for (size_t k = 0, n = words_.size(); k < n; ++k) { uint64_t x = w[k] & v[k]; changed |= x ^ w[k]; w[k] = x; }
+        return changed != 0;
+    }
+    // this &= ~o
+    void subtract(const BitVector& o) {
+        uint64_t* __restrict w = words_.data();
+        const uint64_t* __restrict v = o.words_.data();
+        for (size_t k = 0, n = words_.size(); k < n; ++k) w[k] &= ~v[k];
+    }
+    // this = gen | (in & ~kill), the standard transfer function; returns true if this changed
+    bool assignTransfer(const BitVector& gen, const BitVector& in, const BitVector& kill) {
+        uint64_t changed = 0;
+        uint64_t* __restrict w = words_.data();
+        const uint64_t* __restrict g = gen.words_.data();
+        const uint64_t* __restrict i = in.words_.data();
+        const uint64_t* __restrict k = kill.words_.data();
+        for (size_t x = 0, n = words_.size(); x < n; ++x) { uint64_t v = g[x] | (i[x] & ~k[x]); changed |= v ^ w[x]; w[x] = v; }
+        return changed != 0;
+    }
+
+    uint32_t count() const { uint32_t c = 0; for (uint64_t w : words_) c += static_cast<uint32_t>(__builtin_popcountll(w)); return c; }
+    bool any() const { for (uint64_t w : words_) if (w) return true; return false; }
+    bool operator==(const BitVector& o) const { return size_ == o.size_ && words_ == o.words_; }
+
+    // Index of the first set bit >= from, or size() if none
+    uint32_t findNext(uint32_t from) const {
+        if (from >= size_) return size_;
+        size_t k = from >> 6;
+        uint64_t w = words_[k] & (~uint64_t(0) << (from & 63));
+        while (true) {
+            if (w) return static_cast<uint32_t>((k << 6) + __builtin_ctzll(w));
+            if (++k >= words_.size()) return size_;
+            w = words_[k];
+        }
+    }
+    template <typename F> void forEach(F&& fn) const {
+        for (size_t k = 0; k < words_.size(); ++k)
+            for (uint64_t w = words_[k]; w; w &= w - 1) fn(static_cast<uint32_t>((k << 6) + __builtin_ctzll(w)));
+    }
+
+private:
+    void trimTail() { if (size_ & 63) words_.back() &= (uint64_t(1) << (size_ & 63)) - 1; }
+    std::vector<uint64_t> words_;
+    uint32_t size_ = 0;
+};
+
+// --- Generic Worklist Solver ---
+enum class FlowDirection { Forward, Backward };
+enum class MeetOp { Union, Intersection };
+
+struct DataflowProblem {
+    FlowDirection direction = FlowDirection::Forward;
+    MeetOp meet = MeetOp::Union;
+    uint32_t universe = 0;
+    std::vector<BitVector> gen, kill;   // Per block
+    BitVector boundary;                 // Flows into the entry (forward) or out of exit blocks (backward)
+};
+
+// in[b] holds the value at the top of block b and out[b] the value at the bottom, whatever the direction
+struct DataflowResult {
+    std::vector<BitVector> in, out;
+    uint32_t block_visits = 0;
+};
+
+// Iterates in reverse postorder (postorder for backward problems), revisiting only blocks whose inputs changed
+inline DataflowResult solveDataflow(const ControlFlowGraph& cfg, const DataflowProblem& problem) {
+    const bool forward = problem.direction == FlowDirection::Forward;
+    const bool is_union = problem.meet == MeetOp::Union;
+    const uint32_t block_count = cfg.size();
+    DataflowResult r;
+    r.in.assign(block_count, BitVector(problem.universe, !is_union));
+    r.out.assign(block_count, BitVector(problem.universe, !is_union));
+
+    // Visit order and the position of each block in it
+    const uint32_t order_len = static_cast<uint32_t>(cfg.rpo.size());
+    std::vector<uint32_t> order(cfg.rpo);
+    if (!forward) std::reverse(order.begin(), order.end());
+    std::vector<uint32_t> position(block_count, ControlFlowGraph::kNone);
+    for (uint32_t k = 0; k < order_len; ++k) position[order[k]] = k;
+
+    BitVector pending(order_len, true);
+    BitVector meet_value(problem.universe);
+    uint32_t cursor = 0;
+    while (true) {
+        uint32_t pos = pending.findNext(cursor);
+        if (pos >= order_len) { pos = pending.findNext(0); if (pos >= order_len) break; }
+        pending.reset(pos);
+        cursor = pos + 1;
+        const uint32_t b = order[pos];
+        r.block_visits++;
+
+        // Meet over the flow predecessors
+        auto flow_preds = forward ? cfg.predecessors(b) : cfg.successors(b);
+        bool is_boundary = forward ? (b == 0) : flow_preds.empty();
+        if (is_boundary) meet_value = problem.boundary;
+        else if (is_union) meet_value.clearAll();
+        else meet_value.setAll();
+        for (uint32_t p : flow_preds) {
+            if (!cfg.reachable(p)) continue;
+            const BitVector& v = forward ? r.out[p] : r.in[p];
+            if (is_union) meet_value.unionWith(v); else meet_value.intersectWith(v);
+        }
+
+        BitVector& meet_slot = forward ? r.in[b] : r.out[b];
+        BitVector& result_slot = forward ? r.out[b] : r.in[b];
+        meet_slot = meet_value;
+        if (result_slot.assignTransfer(problem.gen[b], meet_slot, problem.kill[b])) {
+            for (uint32_t s : (forward ? cfg.successors(b) : cfg.predecessors(b))) {
+                if (position[s] != ControlFlowGraph::kNone) pending.set(position[s]);
+            }
+        }
+    }
+    return r;
+}
+
+// --- Dense variable numbering ---
+// Temps and symbols that occur in one function, numbered 0..n-1 so they can index bit vectors.
+struct VariableIndex {
+    static constexpr uint32_t kNone = UINT32_MAX;
+    std::vector<Operand> vars;
+    std::unordered_map<uint32_t, uint32_t> index; // Operand bits -> dense id
+
+    uint32_t add(Operand o) {
+        auto it = index.find(o.bits);
+        if (it != index.end()) return it->second;
+        uint32_t id = static_cast<uint32_t>(vars.size());
+        vars.push_back(o);
+        index.emplace(o.bits, id);
+        return id;
+    }
+    uint32_t of(Operand o) const { auto it = index.find(o.bits); return it == index.end() ? kNone : it->second; }
+    uint32_t size() const { return static_cast<uint32_t>(vars.size()); }
+
+    static VariableIndex build(const TacFunction& function) {
+        VariableIndex vi;
+        for (uint32_t p : function.params) vi.add(Operand::symbol(p));
+        Operand uses[2];
+        for (const TacInstr& in : function.code) {
+            for (int u = 0, n = usedOperands(in, uses); u < n; ++u) vi.add(uses[u]);
+            Operand d = definedOperand(in);
+            if (isVariable(d)) vi.add(d);
+        }
+        return vi;
+    }
+};
+
+// Dense ids of the globals that occur in the function (calls may read or write them)
+inline std::vector<uint32_t> globalsIn(const TacProgram& prog, const VariableIndex& vars) {
+    std::vector<uint32_t> ids;
+    for (uint32_t v = 0; v < vars.size(); ++v) if (prog.isGlobal(vars.vars[v])) ids.push_back(v);
+    return ids;
+}
+
+// --- Liveness (backward, union) ---
+// Globals are live at every exit and at every call. Only "global names" (Briggs et al.) get a bit: variables
+// read in some block before being written there. Anything else, typically an expression temp, is dead at
+// every block boundary, which keeps the sets small for functions with tens of thousands of temps.
+struct LivenessInfo {
+    VariableIndex vars;      // Global names only
+    DataflowResult result;   // in = live-in, out = live-out, over vars
+};
+
+inline LivenessInfo computeLiveness(const TacProgram& prog, const TacFunction& function, const ControlFlowGraph& cfg) {
+    LivenessInfo info;
+    Operand uses[2];
+    {
+        VariableIndex all = VariableIndex::build(function);
+        std::vector<uint8_t> defined(all.size(), 0), global_name(all.size(), 0);
+        std::vector<uint32_t> touched;
+        for (uint32_t b = 0; b < cfg.size(); ++b) {
+            for (uint32_t k = cfg.blocks[b].begin; k < cfg.blocks[b].end; ++k) {
+                const TacInstr& in = function.code[k];
+                for (int u = 0, n = usedOperands(in, uses); u < n; ++u) {
+                    uint32_t v = all.of(uses[u]);
+                    if (!defined[v]) global_name[v] = 1;
+                }
+                Operand d = definedOperand(in);
+                if (isVariable(d)) { uint32_t v = all.of(d); if (!defined[v]) { defined[v] = 1; touched.push_back(v); } }
+            }
+            for (uint32_t v : touched) defined[v] = 0;
+            touched.clear();
+        }
+        for (uint32_t v = 0; v < all.size(); ++v) if (global_name[v] || prog.isGlobal(all.vars[v])) info.vars.add(all.vars[v]);
+    }
+    const uint32_t nv = info.vars.size();
+    std::vector<uint32_t> globals = globalsIn(prog, info.vars);
+    DataflowProblem p;
+    p.direction = FlowDirection::Backward;
+    p.meet = MeetOp::Union;
+    p.universe = nv;
+    p.gen.assign(cfg.size(), BitVector(nv));
+    p.kill.assign(cfg.size(), BitVector(nv));
+    p.boundary = BitVector(nv);
+    for (uint32_t g : globals) p.boundary.set(g);
+    for (uint32_t b = 0; b < cfg.size(); ++b) {
+        BitVector& use = p.gen[b];
+        BitVector& def = p.kill[b];
+        for (uint32_t k = cfg.blocks[b].begin; k < cfg.blocks[b].end; ++k) { // Forward scan: a use counts only if not yet defined here
+            const TacInstr& in = function.code[k];
+            for (int u = 0, n = usedOperands(in, uses); u < n; ++u) {
+                uint32_t v = info.vars.of(uses[u]);
+                if (v != VariableIndex::kNone && !def.test(v)) use.set(v);
+            }
+            if (in.op == TacOp::Call) for (uint32_t g : globals) if (!def.test(g)) use.set(g);
+            Operand d = definedOperand(in);
+            uint32_t v = isVariable(d) ? info.vars.of(d) : VariableIndex::kNone;
+            if (v != VariableIndex::kNone) def.set(v);
+        }
+    }
+    info.result = solveDataflow(cfg, p);
+    return info;
+}
+
+// --- Reaching Definitions (forward, union) ---
+// The universe is the set of definitions: one pseudo-definition per symbol at entry (kEntry), standing for
+// parameters, globals and locals read before any assignment, then the defining instructions in order.
+// A call is a may-definition of every global: it reaches like a definition but kills nothing.
+struct ReachingDefsInfo {
+    static constexpr uint32_t kEntry = UINT32_MAX;
+    std::vector<uint32_t> def_instr;   // Definition id -> instruction index (kEntry for entry pseudo-definitions)
+    std::vector<uint32_t> def_var;     // Definition id -> dense variable id
+    std::vector<uint8_t> def_may;      // Definition id -> 1 for call may-definitions
+    std::vector<uint32_t> instr_defs;  // Instruction k defines ids instr_defs[k] .. instr_defs[k+1]
+    std::vector<std::vector<uint32_t>> defs_of_var;
+    VariableIndex vars;
+    DataflowResult result;
+};
+
+inline ReachingDefsInfo computeReachingDefinitions(const TacProgram& prog, const TacFunction& function, const ControlFlowGraph& cfg) {
+    ReachingDefsInfo info;
+    info.vars = VariableIndex::build(function);
+    info.defs_of_var.resize(info.vars.size());
+    std::vector<uint32_t> globals = globalsIn(prog, info.vars);
+    auto addDef = [&](uint32_t instr, uint32_t v, bool may) {
+        info.defs_of_var[v].push_back(static_cast<uint32_t>(info.def_instr.size()));
+        info.def_instr.push_back(instr);
+        info.def_var.push_back(v);
+        info.def_may.push_back(may ? 1 : 0);
+    };
+    for (uint32_t v = 0; v < info.vars.size(); ++v) {
+        if (info.vars.vars[v].isSymbol()) addDef(ReachingDefsInfo::kEntry, v, false);
+    }
+    const uint32_t entry_defs = static_cast<uint32_t>(info.def_instr.size());
+    info.instr_defs.resize(function.code.size() + 1);
+    for (uint32_t k = 0; k < function.code.size(); ++k) {
+        info.instr_defs[k] = static_cast<uint32_t>(info.def_instr.size());
+        Operand d = definedOperand(function.code[k]);
+        if (isVariable(d)) addDef(k, info.vars.of(d), false);
+        if (function.code[k].op == TacOp::Call) for (uint32_t g : globals) if (info.vars.vars[g] != d) addDef(k, g, true);
+    }
+    info.instr_defs[function.code.size()] = static_cast<uint32_t>(info.def_instr.size());
+
+    const uint32_t nd = static_cast<uint32_t>(info.def_instr.size());
+    DataflowProblem p;
+    p.direction = FlowDirection::Forward;
+    p.meet = MeetOp::Union;
+    p.universe = nd;
+    p.gen.assign(cfg.size(), BitVector(nd));
+    p.kill.assign(cfg.size(), BitVector(nd));
+    p.boundary = BitVector(nd);
+    for (uint32_t id = 0; id < entry_defs; ++id) p.boundary.set(id);
+    for (uint32_t b = 0; b < cfg.size(); ++b) {
+        for (uint32_t id = info.instr_defs[cfg.blocks[b].begin]; id < info.instr_defs[cfg.blocks[b].end]; ++id) {
+            if (!info.def_may[id]) {
+                for (uint32_t other : info.defs_of_var[info.def_var[id]]) { p.kill[b].set(other); p.gen[b].reset(other); }
+            }
+            p.gen[b].set(id);
+        }
+    }
+    info.result = solveDataflow(cfg, p);
+    return info;
+}
+
+// --- Available Expressions (forward, intersection) ---
+// An expression is an (opcode, operand, operand) triple of a unary/binary instruction.
+struct ExprKey {
+    TacOp op; Operand a, b;
+    bool operator==(const ExprKey& o) const { return op == o.op && a == o.a && b == o.b; }
+};
+struct ExprKeyHash {
+    size_t operator()(const ExprKey& k) const {
+        uint64_t h = (uint64_t(k.a.bits) << 32 | k.b.bits) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(h ^ (h >> 29) ^ static_cast<uint8_t>(k.op));
+    }
+};
+
+struct AvailableExprsInfo {
+    std::vector<ExprKey> exprs;   // Expression id -> key
+    std::unordered_map<ExprKey, uint32_t, ExprKeyHash> index;
+    DataflowResult result;
+};
+
+inline AvailableExprsInfo computeAvailableExpressions(const TacProgram& prog, const TacFunction& function, const ControlFlowGraph& cfg) {
+    AvailableExprsInfo info;
+    // Number expressions and record which ones each variable appears in
+    std::unordered_map<uint32_t, std::vector<uint32_t>> exprs_using; // Operand bits -> expression ids
+    std::vector<uint32_t> expr_at_instr(function.code.size(), VariableIndex::kNone);
+    for (uint32_t k = 0; k < function.code.size(); ++k) {
+        const TacInstr& in = function.code[k];
+        if (!isBinaryOp(in.op) && !isUnaryOp(in.op)) continue;
+        ExprKey key{in.op, in.arg1, in.arg2};
+        auto it = info.index.find(key);
+        uint32_t id;
+        if (it == info.index.end()) {
+            id = static_cast<uint32_t>(info.exprs.size());
+            info.exprs.push_back(key);
+            info.index.emplace(key, id);
+            if (isVariable(key.a)) exprs_using[key.a.bits].push_back(id);
+            if (isVariable(key.b) && key.b != key.a) exprs_using[key.b.bits].push_back(id);
+        } else id = it->second;
+        expr_at_instr[k] = id;
+    }
+    std::vector<uint32_t> global_exprs;
+    for (const auto& entry : exprs_using) {
+        Operand o; o.bits = entry.first;
+        if (prog.isGlobal(o)) global_exprs.insert(global_exprs.end(), entry.second.begin(), entry.second.end());
+    }
+
+    const uint32_t ne = static_cast<uint32_t>(info.exprs.size());
+    DataflowProblem p;
+    p.direction = FlowDirection::Forward;
+    p.meet = MeetOp::Intersection;
+    p.universe = ne;
+    p.gen.assign(cfg.size(), BitVector(ne));
+    p.kill.assign(cfg.size(), BitVector(ne));
+    p.boundary = BitVector(ne);
+    for (uint32_t b = 0; b < cfg.size(); ++b) {
+        auto killExpr = [&](uint32_t e) { p.kill[b].set(e); p.gen[b].reset(e); };
+        for (uint32_t k = cfg.blocks[b].begin; k < cfg.blocks[b].end; ++k) {
+            const TacInstr& in = function.code[k];
+            if (expr_at_instr[k] != VariableIndex::kNone) p.gen[b].set(expr_at_instr[k]);
+            if (in.op == TacOp::Call) for (uint32_t e : global_exprs) killExpr(e);
+            Operand d = definedOperand(in);
+            if (isVariable(d)) {
+                auto it = exprs_using.find(d.bits);
+                if (it != exprs_using.end()) for (uint32_t e : it->second) killExpr(e);
+            }
+        }
+    }
+    info.result = solveDataflow(cfg, p);
+    return info;
+}
+
+// --- Text dump of the three analyses for one function ---
+inline void appendDataflowText(const TacProgram& prog, const TacFunction& function, const ControlFlowGraph& cfg,
+                               const LivenessInfo& live, const ReachingDefsInfo& reach, const AvailableExprsInfo& avail, std::string& out) {
+    auto varSet = [&](const BitVector& bits) {
+        std::string s = "{";
+        bits.forEach([&](uint32_t v) { if (s.size() > 1) s += ' '; appendOperand(prog, live.vars.vars[v], s); });
+        return s + "}";
+    };
+    auto defSet = [&](const BitVector& bits) {
+        std::string s = "{";
+        bits.forEach([&](uint32_t d) {
+            if (s.size() > 1) s += ' ';
+            if (reach.def_instr[d] == ReachingDefsInfo::kEntry) { s += "entry:"; appendOperand(prog, reach.vars.vars[reach.def_var[d]], s); }
+            else s += '#' + std::to_string(reach.def_instr[d]) + (reach.def_may[d] ? "?" : "");
+        });
+        return s + "}";
+    };
+    auto exprSet = [&](const BitVector& bits) {
+        std::string s = "{";
+        bits.forEach([&](uint32_t e) {
+            if (s.size() > 1) s += ", ";
+            const ExprKey& k = avail.exprs[e];
+            if (isUnaryOp(k.op)) { s += tacOpSymbol(k.op); appendOperand(prog, k.a, s); }
+            else { appendOperand(prog, k.a, s); s += ' '; s += tacOpSymbol(k.op); s += ' '; appendOperand(prog, k.b, s); }
+        });
+        return s + "}";
+    };
+    out += "func "; out += function.isTopLevel() ? std::string("<top-level>") : prog.symbols[function.name];
+    out += ": " + std::to_string(reach.vars.size()) + " vars (" + std::to_string(live.vars.size()) + " live across blocks), " + std::to_string(reach.def_instr.size()) + " defs, " + std::to_string(avail.exprs.size()) + " exprs\n";
+    for (uint32_t b = 0; b < cfg.size(); ++b) {
+        if (!cfg.reachable(b)) continue;
+        out += "  B" + std::to_string(b) + "\n";
+        out += "    live-in:  " + varSet(live.result.in[b]) + "\n";
+        out += "    live-out: " + varSet(live.result.out[b]) + "\n";
+        out += "    reach-in: " + defSet(reach.result.in[b]) + "\n";
+        out += "    avail-in: " + exprSet(avail.result.in[b]) + "\n";
+    }
+}
+
+#endif // TAC_DATAFLOW_H
@@ -0,0 +1,275 @@
+// File: tac_interproc.h - Interprocedural 3AC transforms: self tail calls into loops (with accumulator introduction) and inlining of small leaf functions
+#ifndef TAC_INTERPROC_H
+#define TAC_INTERPROC_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "tac_ir.h"
+#include "tac_callgraph.h"
+
+// Both transforms run over the whole program before the per-function passes, which then clean up the copies
+// they leave behind. They hand out program-wide temps and labels, so they run serially, bottom-up over the call
+// graph. Tail recursion goes first: a function whose only call was to itself becomes a leaf, and leaves are
+// what gets inlined.
+struct InterprocOptions {
+    bool tail_recursion = true;
+    bool inlining = true;
+    uint32_t inline_budget = 24;    // Largest callee inlined, in instructions
+    uint32_t growth_limit = 400;    // Most instructions inlining may add to one caller
+};
+
+// Before/after figures for one function
+struct InterprocFunctionStats {
+    size_t instrs_before = 0, instrs_after = 0;
+    uint32_t calls_before = 0, calls_after = 0;   // Call sites in the code
+    uint32_t tail_calls = 0;                      // Self tail calls turned into jumps
+    TacOp accumulator = TacOp::Nop;               // Add or Mul when the loop carries an accumulator
+    uint32_t inlined = 0;                         // Call sites replaced by the callee's body
+    bool changed() const { return tail_calls || inlined; }
+};
+
+namespace tac_interproc_detail {
+inline size_t instrCount(const TacFunction& f) {
+    return static_cast<size_t>(std::count_if(f.code.begin(), f.code.end(), [](const TacInstr& in) { return in.op != TacOp::Nop; }));
+}
+inline uint32_t callCount(const TacFunction& f) {
+    return static_cast<uint32_t>(std::count_if(f.code.begin(), f.code.end(), [](const TacInstr& in) { return in.op == TacOp::Call; }));
+}
+// Index of the next instruction after k that is not a Nop or Comment (code.size() if none)
+inline size_t nextReal(const std::vector<TacInstr>& code, size_t k) {
+    for (++k; k < code.size(); ++k) if (code[k].op != TacOp::Nop && code[k].op != TacOp::Comment) return k;
+    return code.size();
+}
+} // namespace tac_interproc_detail
+
+// --- Tail-recursion elimination ---
+// A self call whose result is returned as is ("t = call f; return t", or a void call followed by return)
+// becomes a jump back to the top after reassigning the parameters. With an accumulator, so does
+// "t = call f; u = x OP t; return u" for OP in {+, *}: the loop carries acc = acc OP x (starting at 0 or 1) and
+// every remaining return v becomes return acc OP v. Both operators are associative and commutative in 32-bit
+// wrap-around arithmetic, so the result is exact. x must not be a global, since the original reads it only
+// after the call returns. Argument values are copied at their param, so evaluation order is unchanged.
+inline bool eliminateTailRecursion(TacProgram& prog, TacFunction& function, InterprocFunctionStats& stats) {
+    using namespace tac_interproc_detail;
+    if (function.isTopLevel()) return false;
+    const std::vector<TacInstr>& code = function.code;
+    const size_t nparams = function.params.size();
+    struct Site { size_t call, last; std::vector<size_t> params; TacOp op; Operand x; };
+    std::vector<Site> sites;
+    auto local = [&](Operand o) { return o.isTemp() || (o.isSymbol() && !prog.isGlobal(o)); };
+    for (size_t k = 0; k < code.size(); ++k) {
+        const TacInstr& in = code[k];
+        int32_t n;
+        if (in.op != TacOp::Call || in.arg1 != Operand::symbol(function.name) || !callArgumentCount(prog, in, n) || static_cast<size_t>(n) != nparams) continue;
+        Site site{k, 0, {}, TacOp::Nop, Operand()};
+        if (!findCallParams(prog, code, k, static_cast<uint32_t>(n), site.params)) continue;
+        size_t j = nextReal(code, k);
+        if (in.result.isNone()) {
+            if (j < code.size() && !(code[j].op == TacOp::Return && code[j].arg1.isNone())) continue;
+            site.last = j < code.size() ? j : k;
+        } else if (!local(in.result) || j == code.size()) {
+            continue;
+        } else if (code[j].op == TacOp::Return && code[j].arg1 == in.result) {
+            site.last = j;
+        } else if ((code[j].op == TacOp::Add || code[j].op == TacOp::Mul) && (code[j].arg1 == in.result) != (code[j].arg2 == in.result)) {
+            const TacInstr& combine = code[j];
+            Operand x = combine.arg1 == in.result ? combine.arg2 : combine.arg1;
+            size_t r = nextReal(code, j);
+            if (prog.isGlobal(x) || !local(combine.result) || r == code.size() || code[r].op != TacOp::Return || code[r].arg1 != combine.result) continue;
+            site.op = combine.op;
+            site.x = x;
+            site.last = r;
+        } else {
+            continue;
+        }
+        sites.push_back(std::move(site));
+        k = sites.back().last;
+    }
+    // One accumulator per loop: keep the sites that agree with the first accumulating one
+    TacOp acc_op = TacOp::Nop;
+    for (const Site& s : sites) if (s.op != TacOp::Nop) { acc_op = s.op; break; }
+    if (acc_op != TacOp::Nop) {
+        bool void_return = false;
+        for (const TacInstr& in : code) if (in.op == TacOp::Return && in.arg1.isNone()) void_return = true;
+        sites.erase(std::remove_if(sites.begin(), sites.end(), [&](const Site& s) { return s.op != TacOp::Nop && (s.op != acc_op || void_return); }), sites.end());
+        if (void_return) acc_op = TacOp::Nop;
+        bool still_used = false;
+        for (const Site& s : sites) still_used |= s.op != TacOp::Nop;
+        if (!still_used) acc_op = TacOp::Nop;
+    }
+    if (sites.empty()) return false;
+
+    // Per instruction: which site's param it is (and which argument), or whose call it is
+    std::vector<int32_t> param_site(code.size(), -1), param_index(code.size(), -1), call_site(code.size(), -1);
+    for (size_t s = 0; s < sites.size(); ++s) {
+        call_site[sites[s].call] = static_cast<int32_t>(s);
+        for (size_t i = 0; i < sites[s].params.size(); ++i) { param_site[sites[s].params[i]] = static_cast<int32_t>(s); param_index[sites[s].params[i]] = static_cast<int32_t>(i); }
+    }
+    std::vector<std::vector<Operand>> arg_temps(sites.size());
+    for (auto& temps : arg_temps) for (size_t i = 0; i < nparams; ++i) temps.push_back(Operand::temp(prog.temp_count++));
+    const Operand acc = acc_op != TacOp::Nop ? Operand::temp(prog.temp_count++) : Operand();
+    const Operand top = Operand::label(prog.label_count++);
+
+    std::vector<TacInstr> out;
+    out.reserve(code.size() + 4 * sites.size() + 2);
+    if (acc_op != TacOp::Nop) out.emplace_back(TacOp::Copy, acc, Operand::immediate(acc_op == TacOp::Mul ? 1 : 0));
+    out.emplace_back(TacOp::Label, Operand(), top);
+    for (size_t k = 0; k < code.size(); ++k) {
+        const TacInstr& in = code[k];
+        if (param_site[k] >= 0) { out.emplace_back(TacOp::Copy, arg_temps[param_site[k]][param_index[k]], in.arg1); continue; }
+        if (call_site[k] >= 0) {
+            const Site& s = sites[call_site[k]];
+            if (s.op != TacOp::Nop) out.emplace_back(acc_op, acc, acc, s.x);
+            for (size_t i = 0; i < nparams; ++i) out.emplace_back(TacOp::Copy, Operand::symbol(function.params[i]), arg_temps[call_site[k]][i]);
+            out.emplace_back(TacOp::Goto, Operand(), top);
+            k = s.last;
+            continue;
+        }
+        if (acc_op != TacOp::Nop && in.op == TacOp::Return) {
+            Operand result = Operand::temp(prog.temp_count++);
+            out.emplace_back(acc_op, result, acc, in.arg1);
+            out.emplace_back(TacOp::Return, Operand(), result);
+            continue;
+        }
+        out.push_back(in);
+    }
+    function.code = std::move(out);
+    stats.tail_calls += static_cast<uint32_t>(sites.size());
+    stats.accumulator = acc_op;
+    return true;
+}
+
+// --- Inlining ---
+// A call to a small leaf function (no calls of its own, no non-int variables) is replaced by a renamed copy of
+// the callee's body: its variables become fresh temps, its labels fresh labels (its jump tables new tables over
+// them), each param a copy into the temp standing for that parameter, and each return a copy into the call's
+// result plus a jump past the body.
+// Callees are never changed by inlining (they contain no calls), so one round over the callers suffices.
+inline uint32_t inlineLeafCalls(TacProgram& prog, TacFunction& caller, const std::unordered_map<uint32_t, const TacFunction*>& leaves,
+                                const InterprocOptions& options) {
+    using namespace tac_interproc_detail;
+    const std::vector<TacInstr>& code = caller.code;
+    struct Site { size_t call; const TacFunction* callee; std::vector<size_t> params; };
+    std::vector<Site> sites;
+    size_t growth = 0;
+    for (size_t k = 0; k < code.size(); ++k) {
+        const TacInstr& in = code[k];
+        if (in.op != TacOp::Call) continue;
+        auto it = leaves.find(in.arg1.id());
+        int32_t n;
+        if (it == leaves.end() || it->second == &caller || !callArgumentCount(prog, in, n) || static_cast<size_t>(n) != it->second->params.size()) continue;
+        size_t size = instrCount(*it->second);
+        if (growth + size > options.growth_limit) continue;
+        Site site{k, it->second, {}};
+        if (!findCallParams(prog, code, k, static_cast<uint32_t>(n), site.params)) continue;
+        growth += size;
+        sites.push_back(std::move(site));
+    }
+    if (sites.empty()) return 0;
+
+    std::vector<int32_t> param_site(code.size(), -1), param_index(code.size(), -1), call_site(code.size(), -1);
+    for (size_t s = 0; s < sites.size(); ++s) {
+        call_site[sites[s].call] = static_cast<int32_t>(s);
+        for (size_t i = 0; i < sites[s].params.size(); ++i) { param_site[sites[s].params[i]] = static_cast<int32_t>(s); param_index[sites[s].params[i]] = static_cast<int32_t>(i); }
+    }
+    std::vector<std::vector<Operand>> arg_temps(sites.size());
+    for (size_t s = 0; s < sites.size(); ++s) for (size_t i = 0; i < sites[s].params.size(); ++i) arg_temps[s].push_back(Operand::temp(prog.temp_count++));
+
+    std::vector<TacInstr> out;
+    out.reserve(code.size() + growth + 2 * sites.size());
+    std::unordered_map<uint32_t, Operand> rename;  // Callee operand bits -> operand in this copy
+    for (size_t k = 0; k < code.size(); ++k) {
+        const TacInstr& in = code[k];
+        if (param_site[k] >= 0) { out.emplace_back(TacOp::Copy, arg_temps[param_site[k]][param_index[k]], in.arg1); continue; }
+        if (call_site[k] < 0) { out.push_back(in); continue; }
+        const TacFunction& callee = *sites[call_site[k]].callee;
+        rename.clear();
+        for (size_t i = 0; i < callee.params.size(); ++i) rename[Operand::symbol(callee.params[i]).bits] = arg_temps[call_site[k]][i];
+        auto value = [&](Operand o) {
+            if (!(o.isTemp() || o.isSymbol()) || prog.isGlobal(o)) return o;
+            auto it = rename.emplace(o.bits, Operand()).first;
+            if (it->second.isNone()) it->second = Operand::temp(prog.temp_count++);
+            return it->second;
+        };
+        auto label = [&](Operand o) {
+            auto it = rename.emplace(o.bits, Operand()).first;
+            if (it->second.isNone()) it->second = Operand::label(prog.label_count++);
+            return it->second;
+        };
+        const Operand done = Operand::label(prog.label_count++);
+        const size_t last = [&] { size_t j = callee.code.size(); while (j > 0 && (callee.code[j - 1].op == TacOp::Nop || callee.code[j - 1].op == TacOp::Comment)) --j; return j; }();
+        for (size_t j = 0; j < callee.code.size(); ++j) {
+            TacInstr c = callee.code[j];
+            switch (c.op) {
+                case TacOp::Nop: continue;
+                case TacOp::Comment: break;
+                case TacOp::Label: case TacOp::Goto: c.arg1 = label(c.arg1); break;
+                case TacOp::IfFalse: case TacOp::IfTrue: c.arg1 = value(c.arg1); c.arg2 = label(c.arg2); break;
+                case TacOp::JumpTable: { // The copy gets its own table over the copied labels
+                    JumpTable table = callee.jumpTable(c);
+                    for (Operand& target : table.targets) target = label(target);
+                    table.fallback = label(table.fallback);
+                    c.arg1 = value(c.arg1);
+                    c.arg2 = Operand::immediate(caller.addJumpTable(std::move(table)));
+                    break;
+                }
+                case TacOp::Return:
+                    if (!in.result.isNone() && !c.arg1.isNone()) out.emplace_back(TacOp::Copy, in.result, value(c.arg1));
+                    if (j + 1 != last) out.emplace_back(TacOp::Goto, Operand(), done);
+                    continue;
+                default:
+                    c.result = value(c.result);
+                    c.arg1 = value(c.arg1);
+                    c.arg2 = value(c.arg2);
+                    break;
+            }
+            out.push_back(c);
+        }
+        out.emplace_back(TacOp::Label, Operand(), done);
+    }
+    caller.code = std::move(out);
+    return static_cast<uint32_t>(sites.size());
+}
+
+// --- Driver ---
+// Returns one entry per program function (top-level segments included, always unchanged)
+inline std::vector<InterprocFunctionStats> runInterprocedural(TacProgram& prog, const InterprocOptions& options) {
+    using namespace tac_interproc_detail;
+    std::vector<InterprocFunctionStats> stats(prog.functions.size());
+    for (size_t f = 0; f < prog.functions.size(); ++f) {
+        stats[f].instrs_before = instrCount(prog.functions[f]);
+        stats[f].calls_before = callCount(prog.functions[f]);
+    }
+    // Callees before callers: by the time a function is visited, the leaves it calls are final, and once its
+    // own calls are gone (turned into loops or inlined) it can be inlined into its callers in turn
+    std::unordered_map<uint32_t, const TacFunction*> leaves;
+    auto inlinable = [&](const TacFunction& f) {
+        if (f.isTopLevel() || callCount(f) || instrCount(f) > options.inline_budget) return false;
+        bool plain = true;
+        for (uint32_t p : f.params) plain &= !prog.isOpaque(Operand::symbol(p));
+        for (const TacInstr& in : f.code) {
+            for (Operand o : {in.result, in.arg1, in.arg2}) plain &= !prog.isOpaque(o);
+        }
+        return plain;
+    };
+    const CallGraph graph = buildCallGraph(prog);
+    for (const std::vector<uint32_t>& scc : graph.sccs) {
+        for (uint32_t f : scc) {
+            if (options.tail_recursion) eliminateTailRecursion(prog, prog.functions[f], stats[f]);
+            if (options.inlining) stats[f].inlined += inlineLeafCalls(prog, prog.functions[f], leaves, options);
+        }
+        for (uint32_t f : scc) {
+            if (options.inlining && inlinable(prog.functions[f])) leaves.emplace(prog.functions[f].name, &prog.functions[f]);
+        }
+    }
+    for (size_t f = 0; f < prog.functions.size(); ++f) {
+        stats[f].instrs_after = instrCount(prog.functions[f]);
+        stats[f].calls_after = callCount(prog.functions[f]);
+    }
+    return stats;
+}
+
+#endif // TAC_INTERPROC_H
@@ -0,0 +1,468 @@
+// File: tac_ir.h - Structured three-address code (quadruple IR) shared by intermediate_gen and dag_builder
+#ifndef TAC_IR_H
+#define TAC_IR_H
+
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+#include <unordered_map>
+#include <ostream>
+#include <cctype>
+#include <algorithm>
+
+// --- Opcodes ---
+// Every 3AC line maps onto one opcode; "func begin/end" is implied by TacFunction.
+enum class TacOp : uint8_t {
+    Nop,
+    Copy,                                   // r = a
+    Add, Sub, Mul, Div, Mod,                // r = a OP b
+    Lt, Le, Gt, Ge, Eq, Ne,
+    LogAnd, LogOr, BitAnd, BitOr, BitXor, Shl, Shr,
+    Neg, Not, BitNot,                       // r = OP a
+    Param,                                  // param a
+    Call,                                   // [r =] call f, n   (arg1 = function symbol, arg2 = constant n)
+    Return,                                 // return [a]
+    IfFalse,                                // ifFalse a goto L
+    IfTrue,                                 // if a goto L
+    Goto,                                   // goto L
+    JumpTable,                              // jumptable a goto L0, L1, ... else Ld  (arg2 = immediate index into the function's jump_tables)
+    Label,                                  // L:
+    Read,                                   // read a
+    Write,                                  // write a   (writechar a when arg2 is set: the value is a char, printed as one)
+    Comment                                 // verbatim text line (arg1 = constant holding the text)
+};
+
+inline bool isBinaryOp(TacOp op) { return op >= TacOp::Add && op <= TacOp::Shr; }
+inline bool isUnaryOp(TacOp op) { return op >= TacOp::Neg && op <= TacOp::BitNot; }
+
+// Source-level spelling of an arithmetic/logical opcode ("" for everything else)
+inline const char* tacOpSymbol(TacOp op) {
+    switch (op) {
+        case TacOp::Add: return "+";   case TacOp::Sub: return "-";   case TacOp::Mul: return "*";
+        case TacOp::Div: return "/";   case TacOp::Mod: return "%";
+        case TacOp::Lt: return "<";    case TacOp::Le: return "<=";   case TacOp::Gt: return ">";
+        case TacOp::Ge: return ">=";   case TacOp::Eq: return "==";   case TacOp::Ne: return "!=";
+        case TacOp::LogAnd: return "&&"; case TacOp::LogOr: return "||";
+        case TacOp::BitAnd: return "&"; case TacOp::BitOr: return "|"; case TacOp::BitXor: return "^";
+        case TacOp::Shl: return "<<";  case TacOp::Shr: return ">>";
+        case TacOp::Neg: return "-";   case TacOp::Not: return "!";   case TacOp::BitNot: return "~";
+        default: return "";
+    }
+}
+
+// Binary opcode for an operator lexeme, or Nop if it is not one
+inline TacOp binaryOpFromLexeme(const std::string& lex) {
+    for (uint8_t o = static_cast<uint8_t>(TacOp::Add); o <= static_cast<uint8_t>(TacOp::Shr); ++o) {
+        if (lex == tacOpSymbol(static_cast<TacOp>(o))) return static_cast<TacOp>(o);
+    }
+    return TacOp::Nop;
+}
+
+inline TacOp unaryOpFromLexeme(const std::string& lex) {
+    if (lex == "-") return TacOp::Neg;
+    if (lex == "!") return TacOp::Not;
+    if (lex == "~") return TacOp::BitNot;
+    return TacOp::Nop;
+}
+
+// --- Operands ---
+// Packed into 32 bits: 3-bit kind tag + 29-bit ID (temp number, label number or string table index).
+// Imm holds a small signed integer directly, so passes can make constants without touching the string table.
+// Local is a function-private value made by a pass (SSA names, fresh temporaries); the pass manager renumbers
+// locals into ordinary temps once the pass is done, so they never reach the text output.
+enum class OperandKind : uint8_t { None, Temp, Symbol, Const, Label, Imm, Local };
+
+struct Operand {
+    uint32_t bits = 0;
+
+    static constexpr uint32_t kIdMask = (1u << 29) - 1;
+    static Operand make(OperandKind k, uint32_t id) { Operand o; o.bits = (static_cast<uint32_t>(k) << 29) | (id & kIdMask); return o; }
+    static Operand temp(uint32_t id) { return make(OperandKind::Temp, id); }
+    static Operand symbol(uint32_t id) { return make(OperandKind::Symbol, id); }
+    static Operand constant(uint32_t id) { return make(OperandKind::Const, id); }
+    static Operand label(uint32_t id) { return make(OperandKind::Label, id); }
+    static constexpr int64_t kImmMin = -(int64_t(1) << 28), kImmMax = (int64_t(1) << 28) - 1;
+    static bool fitsImmediate(int64_t v) { return v >= kImmMin && v <= kImmMax; }
+    static Operand immediate(int64_t v) { return make(OperandKind::Imm, static_cast<uint32_t>(v)); }
+    static Operand local(uint32_t id) { return make(OperandKind::Local, id); }
+
+    OperandKind kind() const { return static_cast<OperandKind>(bits >> 29); }
+    uint32_t id() const { return bits & kIdMask; }
+    bool isNone() const { return bits == 0; }
+    bool isTemp() const { return kind() == OperandKind::Temp; }
+    bool isSymbol() const { return kind() == OperandKind::Symbol; }
+    bool isConst() const { return kind() == OperandKind::Const; }
+    bool isLabel() const { return kind() == OperandKind::Label; }
+    bool isImm() const { return kind() == OperandKind::Imm; }
+    bool isLocal() const { return kind() == OperandKind::Local; }
+    int32_t immValue() const { return static_cast<int32_t>(bits << 3) >> 3; } // Sign-extend the 29-bit payload
+    bool operator==(const Operand& o) const { return bits == o.bits; }
+    bool operator!=(const Operand& o) const { return bits != o.bits; }
+};
+
+// --- Instruction (quadruple) ---
+struct TacInstr {
+    TacOp op = TacOp::Nop;
+    Operand result, arg1, arg2;
+
+    TacInstr() = default;
+    TacInstr(TacOp o, Operand r = Operand(), Operand a = Operand(), Operand b = Operand()) : op(o), result(r), arg1(a), arg2(b) {}
+};
+static_assert(sizeof(TacInstr) == 16, "TacInstr should stay a compact 16-byte record");
+
+// arg2 of a Write whose value is a char: the back ends print the character, not its code
+const Operand kWriteChar = Operand::immediate(1);
+inline bool isCharWrite(const TacInstr& in) { return in.op == TacOp::Write && !in.arg2.isNone(); }
+
+// --- Uses and definitions ---
+// Only temps, symbols and pass-local values are variables; call targets, labels and comment text are not.
+inline bool isVariable(Operand o) { return o.isTemp() || o.isSymbol() || o.isLocal(); }
+
+// The variable an instruction writes (None if it writes nothing)
+inline Operand definedOperand(const TacInstr& in) {
+    if (in.op == TacOp::Read) return in.arg1;
+    if (in.op == TacOp::Copy || in.op == TacOp::Call || isBinaryOp(in.op) || isUnaryOp(in.op)) return in.result;
+    return Operand();
+}
+
+// True if the instruction reads operand slot 0 (arg1) / slot 1 (arg2) as a value
+inline bool readsArg(const TacInstr& in, int slot) {
+    if (slot == 1) return isBinaryOp(in.op);
+    switch (in.op) {
+        case TacOp::Copy: case TacOp::Param: case TacOp::Return: case TacOp::Write:
+        case TacOp::IfFalse: case TacOp::IfTrue: case TacOp::JumpTable: return true;
+        default: return isBinaryOp(in.op) || isUnaryOp(in.op);
+    }
+}
+inline Operand& argSlot(TacInstr& in, int slot) { return slot == 0 ? in.arg1 : in.arg2; }
+
+// The variables an instruction reads; returns how many were stored in uses[0..1]
+inline int usedOperands(const TacInstr& in, Operand uses[2]) {
+    int n = 0;
+    switch (in.op) {
+        case TacOp::Copy: case TacOp::Param: case TacOp::Return: case TacOp::Write:
+        case TacOp::IfFalse: case TacOp::IfTrue: case TacOp::JumpTable:
+        case TacOp::Neg: case TacOp::Not: case TacOp::BitNot:
+            if (isVariable(in.arg1)) uses[n++] = in.arg1;
+            break;
+        default:
+            if (isBinaryOp(in.op)) {
+                if (isVariable(in.arg1)) uses[n++] = in.arg1;
+                if (isVariable(in.arg2)) uses[n++] = in.arg2;
+            }
+            break;
+    }
+    return n;
+}
+
+// --- Interned names (symbols, literals) ---
+struct StringTable {
+    std::vector<std::string> names;
+    std::unordered_map<std::string, uint32_t> index;
+
+    uint32_t intern(const std::string& s) {
+        auto it = index.find(s);
+        if (it != index.end()) return it->second;
+        uint32_t id = static_cast<uint32_t>(names.size());
+        names.push_back(s);
+        index.emplace(s, id);
+        return id;
+    }
+    const std::string& operator[](uint32_t id) const { return names[id]; }
+    size_t size() const { return names.size(); }
+};
+
+// --- Jump tables ---
+// Targets of one JumpTable instruction: an index i in [0, targets.size()) jumps to targets[i], anything else
+// (negative included) to fallback. Kept beside the code because a quadruple has no room for a label list.
+struct JumpTable {
+    std::vector<Operand> targets;
+    Operand fallback;
+
+    Operand target(int64_t index) const { return index >= 0 && index < static_cast<int64_t>(targets.size()) ? targets[static_cast<size_t>(index)] : fallback; }
+};
+
+// --- Function: instructions stored contiguously ---
+// A function with no name (kNoName) is a top-level segment, printed without func begin/end.
+struct TacFunction {
+    static constexpr uint32_t kNoName = UINT32_MAX;
+    uint32_t name = kNoName;
+    std::vector<uint32_t> params;   // Parameter symbols, in declaration order
+    std::vector<TacInstr> code;
+    std::vector<JumpTable> jump_tables; // Indexed by JumpTable instructions (arg2)
+
+    bool isTopLevel() const { return name == kNoName; }
+    const JumpTable& jumpTable(const TacInstr& in) const { return jump_tables[static_cast<uint32_t>(in.arg2.immValue())]; }
+    uint32_t addJumpTable(JumpTable table) { jump_tables.push_back(std::move(table)); return static_cast<uint32_t>(jump_tables.size() - 1); }
+};
+
+struct TacProgram {
+    StringTable symbols;
+    StringTable constants;
+    std::vector<TacFunction> functions;
+    uint32_t temp_count = 0;
+    uint32_t label_count = 0;
+    std::vector<uint32_t> globals;  // Symbols declared at file scope (sorted)
+    std::vector<uint32_t> opaque;   // Symbols declared somewhere with a type other than signed int/long/short (sorted); never folded
+    std::vector<uint32_t> side_effect_free; // Functions whose calls may go when the result is unused (sorted; see tac_callgraph.h)
+
+    void addGlobal(uint32_t sym) {
+        auto it = std::lower_bound(globals.begin(), globals.end(), sym);
+        if (it == globals.end() || *it != sym) globals.insert(it, sym);
+    }
+    bool isGlobal(Operand o) const { return o.isSymbol() && std::binary_search(globals.begin(), globals.end(), o.id()); }
+    void addOpaque(uint32_t sym) {
+        auto it = std::lower_bound(opaque.begin(), opaque.end(), sym);
+        if (it == opaque.end() || *it != sym) opaque.insert(it, sym);
+    }
+    bool isOpaque(Operand o) const { return o.isSymbol() && std::binary_search(opaque.begin(), opaque.end(), o.id()); }
+    bool isSideEffectFreeCall(const TacInstr& in) const {
+        return in.op == TacOp::Call && in.arg1.isSymbol() && std::binary_search(side_effect_free.begin(), side_effect_free.end(), in.arg1.id());
+    }
+    Operand symbol(const std::string& name) { return Operand::symbol(symbols.intern(name)); }
+    Operand constant(const std::string& text) { return Operand::constant(constants.intern(text)); }
+    const std::string& functionName(const TacFunction& f) const { static const std::string none; return f.isTopLevel() ? none : symbols[f.name]; }
+};
+
+// --- Literals ---
+// Constant text as C++ spells it, shared by the back ends that need the value rather than the spelling
+inline int decodeEscape(const std::string& s, size_t& i) { // s[i] follows a backslash; advances past the escape
+    switch (s[i++]) {
+        case 'n': return '\n'; case 't': return '\t'; case 'r': return '\r'; case '0': return '\0';
+        case 'a': return '\a'; case 'b': return '\b'; case 'f': return '\f'; case 'v': return '\v';
+        default: return static_cast<unsigned char>(s[i - 1]); // \\ \' \" \?
+    }
+}
+
+// Integer literals as C++ spells them (decimal, hex, octal, u/l suffixes) and single-character literals
+inline bool integerLiteral(const std::string& text, int32_t& value) {
+    if (text.size() >= 3 && text.front() == '\'' && text.back() == '\'') {
+        size_t i = 1;
+        int c = text[i] == '\\' ? (++i, decodeEscape(text, i)) : static_cast<unsigned char>(text[i++]);
+        if (i != text.size() - 1) return false;
+        value = static_cast<int32_t>(static_cast<signed char>(c));
+        return true;
+    }
+    if (text.empty() || !(std::isdigit(static_cast<unsigned char>(text[0])) || (text[0] == '-' && text.size() > 1))) return false;
+    char* end = nullptr;
+    errno = 0;
+    long long v = std::strtoll(text.c_str(), &end, 0);
+    while (*end == 'u' || *end == 'U' || *end == 'l' || *end == 'L') ++end;
+    if (*end != '\0' || errno == ERANGE) return false;
+    value = static_cast<int32_t>(static_cast<uint32_t>(v)); // Wraps like the conversion in the source program
+    return true;
+}
+
+inline std::string decodeStringLiteral(const std::string& literal) {
+    std::string out;
+    for (size_t i = 1; i + 1 < literal.size();) {
+        if (literal[i] == '\\' && i + 2 < literal.size()) { ++i; out += static_cast<char>(decodeEscape(literal, i)); }
+        else out += literal[i++];
+    }
+    return out;
+}
+
+// Decimal count given on a command line (--jobs 4); false for anything else, overflow included, so the
+// tools print their usage instead of throwing
+template <typename T>
+inline bool parseCount(const std::string& text, T& value) {
+    const char* end = text.data() + text.size();
+    const auto parsed = std::from_chars(text.data(), end, value);
+    return !text.empty() && parsed.ec == std::errc() && parsed.ptr == end;
+}
+
+// --- Printer ---
+inline void appendOperand(const TacProgram& prog, Operand o, std::string& out) {
+    switch (o.kind()) {
+        case OperandKind::Temp: out += 't'; out += std::to_string(o.id()); break;
+        case OperandKind::Label: out += 'L'; out += std::to_string(o.id()); break;
+        case OperandKind::Symbol: out += prog.symbols[o.id()]; break;
+        case OperandKind::Const: out += prog.constants[o.id()]; break;
+        case OperandKind::Imm: out += std::to_string(o.immValue()); break;
+        case OperandKind::Local: out += '%'; out += std::to_string(o.id()); break;
+        case OperandKind::None: break;
+    }
+}
+
+inline std::string operandName(const TacProgram& prog, Operand o) { std::string s; appendOperand(prog, o, s); return s; }
+
+// Appends the text form of one instruction (no newline), matching the historical 3ac_output.txt layout.
+// A jump table's labels live in its function; without the tables only its number is shown.
+inline void appendInstr(const TacProgram& prog, const TacInstr& in, std::string& out, const std::vector<JumpTable>* tables = nullptr) {
+    switch (in.op) {
+        case TacOp::Nop: break;
+        case TacOp::Copy:
+            appendOperand(prog, in.result, out); out += " = "; appendOperand(prog, in.arg1, out); break;
+        case TacOp::Neg: case TacOp::Not: case TacOp::BitNot:
+            appendOperand(prog, in.result, out); out += " = "; out += tacOpSymbol(in.op);
+            if (in.op == TacOp::Neg) { // "-5" would read back as a literal: negating one is written "- 5"
+                const size_t at = out.size();
+                appendOperand(prog, in.arg1, out);
+                if (at < out.size() && std::isdigit(static_cast<unsigned char>(out[at]))) out.insert(at, 1, ' ');
+            }
+            else appendOperand(prog, in.arg1, out);
+            break;
+        case TacOp::Param: out += "param "; appendOperand(prog, in.arg1, out); break;
+        case TacOp::Call:
+            if (!in.result.isNone()) { appendOperand(prog, in.result, out); out += " = "; }
+            out += "call "; appendOperand(prog, in.arg1, out); out += ", "; appendOperand(prog, in.arg2, out); break;
+        case TacOp::Return:
+            out += "return"; if (!in.arg1.isNone()) { out += ' '; appendOperand(prog, in.arg1, out); } break;
+        case TacOp::IfFalse:
+            out += "ifFalse "; appendOperand(prog, in.arg1, out); out += " goto "; appendOperand(prog, in.arg2, out); break;
+        case TacOp::IfTrue:
+            out += "if "; appendOperand(prog, in.arg1, out); out += " goto "; appendOperand(prog, in.arg2, out); break;
+        case TacOp::Goto: out += "goto "; appendOperand(prog, in.arg1, out); break;
+        case TacOp::JumpTable: {
+            out += "jumptable "; appendOperand(prog, in.arg1, out); out += " goto ";
+            const uint32_t id = static_cast<uint32_t>(in.arg2.immValue());
+            if (!tables || id >= tables->size()) { out += "table " + std::to_string(id); break; }
+            const JumpTable& table = (*tables)[id];
+            for (size_t k = 0; k < table.targets.size(); ++k) { if (k) out += ", "; appendOperand(prog, table.targets[k], out); }
+            out += " else "; appendOperand(prog, table.fallback, out); break;
+        }
+        case TacOp::Label: appendOperand(prog, in.arg1, out); out += ':'; break;
+        case TacOp::Read: out += "read "; appendOperand(prog, in.arg1, out); break;
+        case TacOp::Write: out += isCharWrite(in) ? "writechar " : "write "; appendOperand(prog, in.arg1, out); break;
+        case TacOp::Comment: appendOperand(prog, in.arg1, out); break;
+        default: // binary
+            appendOperand(prog, in.result, out); out += " = "; appendOperand(prog, in.arg1, out);
+            out += ' '; out += tacOpSymbol(in.op); out += ' '; appendOperand(prog, in.arg2, out); break;
+    }
+}
+
+inline std::string instrToString(const TacProgram& prog, const TacInstr& in, const std::vector<JumpTable>* tables = nullptr) {
+    std::string s; appendInstr(prog, in, s, tables); return s;
+}
+
+// Writes every function/segment in order, one instruction per line; "func begin" lists the parameters
+inline void writeTacText(const TacProgram& prog, std::ostream& os) {
+    std::string buf;
+    for (const TacFunction& f : prog.functions) {
+        if (!f.isTopLevel()) {
+            buf += "\nfunc begin "; buf += prog.symbols[f.name];
+            for (uint32_t p : f.params) { buf += ' '; buf += prog.symbols[p]; }
+            buf += '\n';
+        }
+        for (const TacInstr& in : f.code) { appendInstr(prog, in, buf, &f.jump_tables); buf += '\n'; }
+        if (!f.isTopLevel()) { buf += "func end "; buf += prog.symbols[f.name]; buf += '\n'; }
+    }
+    os << buf;
+}
+
+// --- Text parser (for consumers reading 3ac_output.txt) ---
+// Lines are parsed once into TacInstr; anything unrecognised is kept as a Comment.
+namespace tac_text_detail {
+inline void splitWords(const std::string& line, std::vector<std::string>& words) {
+    words.clear();
+    size_t i = 0, n = line.size();
+    while (i < n) {
+        while (i < n && std::isspace(static_cast<unsigned char>(line[i]))) i++;
+        size_t start = i;
+        if (i + 1 < n && (line[i] == '-' || line[i] == '!' || line[i] == '~') && (line[i + 1] == '"' || line[i + 1] == '\'')) i++; // Unary op on a literal
+        if (i < n && (line[i] == '"' || line[i] == '\'')) { // Quoted literal: keep embedded spaces
+            char quote = line[i++];
+            while (i < n && line[i] != quote) i += (line[i] == '\\') ? 2 : 1;
+            if (i < n) i++;
+            if (i > n) i = n;
+        }
+        while (i < n && !std::isspace(static_cast<unsigned char>(line[i]))) i++;
+        if (i > start) words.emplace_back(line, start, i - start);
+    }
+}
+inline bool isNumbered(const std::string& w, char prefix) {
+    if (w.size() < 2 || w[0] != prefix) return false;
+    for (size_t k = 1; k < w.size(); ++k) if (!std::isdigit(static_cast<unsigned char>(w[k]))) return false;
+    return true;
+}
+// The number after the prefix; false when it does not fit an operand id (29 bits), which would alias another one
+inline bool numberOf(const std::string& w, uint32_t& id) {
+    const auto parsed = std::from_chars(w.data() + 1, w.data() + w.size(), id);
+    return parsed.ec == std::errc() && id <= Operand::kIdMask;
+}
+} // namespace tac_text_detail
+
+// None for a temp or label number too large for an operand id
+inline Operand parseValueOperand(TacProgram& prog, const std::string& w) {
+    using namespace tac_text_detail;
+    uint32_t id;
+    if (isNumbered(w, 't')) { if (!numberOf(w, id)) return Operand(); if (id >= prog.temp_count) prog.temp_count = id + 1; return Operand::temp(id); }
+    unsigned char c0 = static_cast<unsigned char>(w[0]);
+    if (std::isdigit(c0) || c0 == '"' || c0 == '\'' || c0 == '.' || (c0 == '-' && w.size() > 1)) return prog.constant(w);
+    return prog.symbol(w);
+}
+
+inline Operand parseLabelOperand(TacProgram& prog, const std::string& w) {
+    using namespace tac_text_detail;
+    uint32_t id;
+    if (isNumbered(w, 'L')) { if (!numberOf(w, id)) return Operand(); if (id >= prog.label_count) prog.label_count = id + 1; return Operand::label(id); }
+    return prog.symbol(w);
+}
+
+// Parses trimmed, non-comment 3AC lines (as returned by read3AC) into a program
+inline TacProgram parseTacText(const std::vector<std::string>& lines) {
+    using namespace tac_text_detail;
+    TacProgram prog;
+    bool in_function = false;
+    std::vector<std::string> w;
+    auto segment = [&]() -> TacFunction& {
+        if (!in_function && (prog.functions.empty() || !prog.functions.back().isTopLevel())) prog.functions.emplace_back();
+        return prog.functions.back();
+    };
+    bool out_of_range = false; // A t/L number too large for an operand id: the line is kept as text
+    auto val = [&](const std::string& s) { Operand o = parseValueOperand(prog, s); out_of_range |= o.isNone(); return o; };
+    auto lab = [&](const std::string& s) { Operand o = parseLabelOperand(prog, s); out_of_range |= o.isNone(); return o; };
+    for (const std::string& line : lines) {
+        splitWords(line, w);
+        if (w.empty()) continue;
+        if (w[0] == "func" && w.size() >= 3 && w[1] == "begin") { // func begin name [params...]
+            prog.functions.emplace_back(); prog.functions.back().name = prog.symbols.intern(w[2]); in_function = true;
+            for (size_t k = 3; k < w.size(); ++k) prog.functions.back().params.push_back(prog.symbols.intern(w[k]));
+            continue;
+        }
+        if (w[0] == "func" && w.size() == 3 && w[1] == "end") { in_function = false; continue; }
+
+        TacInstr in;
+        size_t n = w.size();
+        out_of_range = false;
+        if (n == 1 && w[0].size() > 1 && w[0].back() == ':') { in = TacInstr(TacOp::Label, Operand(), lab(w[0].substr(0, w[0].size() - 1))); }
+        else if (w[0] == "ifFalse" && n == 4 && w[2] == "goto") { in = TacInstr(TacOp::IfFalse, Operand(), val(w[1]), lab(w[3])); }
+        else if (w[0] == "if" && n == 4 && w[2] == "goto") { in = TacInstr(TacOp::IfTrue, Operand(), val(w[1]), lab(w[3])); }
+        else if (w[0] == "goto" && n == 2) { in = TacInstr(TacOp::Goto, Operand(), lab(w[1])); }
+        else if (w[0] == "jumptable" && n >= 6 && w[2] == "goto" && w[n - 2] == "else") { // jumptable a goto L0, L1, ... else Ld
+            JumpTable table;
+            for (size_t k = 3; k < n - 2; ++k) table.targets.push_back(lab(w[k].back() == ',' ? w[k].substr(0, w[k].size() - 1) : w[k]));
+            table.fallback = lab(w[n - 1]);
+            in = TacInstr(TacOp::JumpTable, Operand(), val(w[1]), Operand::immediate(segment().addJumpTable(std::move(table))));
+        }
+        else if (w[0] == "param" && n == 2) { in = TacInstr(TacOp::Param, Operand(), val(w[1])); }
+        else if (w[0] == "read" && n == 2) { in = TacInstr(TacOp::Read, Operand(), val(w[1])); }
+        else if (w[0] == "write" && n == 2) { in = TacInstr(TacOp::Write, Operand(), val(w[1])); }
+        else if (w[0] == "writechar" && n == 2) { in = TacInstr(TacOp::Write, Operand(), val(w[1]), kWriteChar); }
+        else if (w[0] == "return" && n <= 2) { in = TacInstr(TacOp::Return, Operand(), n == 2 ? val(w[1]) : Operand()); }
+        else if (w[0] == "call" && n == 3 && w[1].back() == ',') { in = TacInstr(TacOp::Call, Operand(), prog.symbol(w[1].substr(0, w[1].size() - 1)), val(w[2])); }
+        else if (n >= 3 && w[1] == "=") {
+            Operand r = val(w[0]);
+            if (n == 5 && w[2] == "call" && w[3].back() == ',') { in = TacInstr(TacOp::Call, r, prog.symbol(w[3].substr(0, w[3].size() - 1)), val(w[4])); }
+            else if (n == 5 && binaryOpFromLexeme(w[3]) != TacOp::Nop) { in = TacInstr(binaryOpFromLexeme(w[3]), r, val(w[2]), val(w[4])); }
+            else if (n == 3 && w[2].size() > 1 && unaryOpFromLexeme(w[2].substr(0, 1)) != TacOp::Nop &&
+                     (w[2][0] != '-' || !std::isdigit(static_cast<unsigned char>(w[2][1])))) { // "-5" is a literal, "~5" and "!5" are not
+                in = TacInstr(unaryOpFromLexeme(w[2].substr(0, 1)), r, val(w[2].substr(1)));
+            }
+            else if (n == 4 && w[2] == "-") { in = TacInstr(TacOp::Neg, r, val(w[3])); } // Negated literal
+            else if (n == 3) { in = TacInstr(TacOp::Copy, r, val(w[2])); }
+            else { in = TacInstr(TacOp::Comment, Operand(), prog.constant(line)); }
+        }
+        else { in = TacInstr(TacOp::Comment, Operand(), prog.constant(line)); }
+        if (out_of_range) in = TacInstr(TacOp::Comment, Operand(), prog.constant(line));
+        if (!in_function && definedOperand(in).isSymbol()) prog.addGlobal(definedOperand(in).id()); // File-scope initialiser
+        segment().code.push_back(in);
+    }
+    return prog;
+}
+
+#endif // TAC_IR_H
@@ -0,0 +1,110 @@
+// File: tac_ir_check.cpp - Self-check of the 3AC text format: every opcode with every operand kind it can take
+// is printed with appendInstr and read back with parseTacText, and must come back as the same instruction.
+// Usage: tac_ir_check   (exit status 1 and one line per mismatch when the round trip breaks)
+#include <iostream>
+#include <string>
+#include <vector>
+#include "tac_ir.h"
+
+namespace {
+
+// Operands print the same after the trip (an Imm comes back as the Const spelling it, which is equivalent)
+bool sameOperand(const TacProgram& a, Operand x, const TacProgram& b, Operand y) {
+    if (x.isNone() || y.isNone()) return x.isNone() && y.isNone();
+    return operandName(a, x) == operandName(b, y) && (x.isLabel() == y.isLabel()) && (x.isTemp() == y.isTemp()) &&
+           (x.isSymbol() == y.isSymbol());
+}
+
+bool sameInstr(const TacProgram& a, const TacFunction& fa, const TacInstr& x, const TacProgram& b, const TacFunction& fb, const TacInstr& y) {
+    if (x.op != y.op) return false;
+    if (x.op == TacOp::JumpTable) {
+        const JumpTable& ta = fa.jumpTable(x);
+        const JumpTable& tb = fb.jumpTable(y);
+        if (ta.targets.size() != tb.targets.size() || !sameOperand(a, ta.fallback, b, tb.fallback)) return false;
+        for (size_t k = 0; k < ta.targets.size(); ++k) if (!sameOperand(a, ta.targets[k], b, tb.targets[k])) return false;
+        return sameOperand(a, x.arg1, b, y.arg1);
+    }
+    return sameOperand(a, x.result, b, y.result) && sameOperand(a, x.arg1, b, y.arg1) && sameOperand(a, x.arg2, b, y.arg2);
+}
+
+} // namespace
+
+int main() {
+    TacProgram prog;
+    TacFunction f;
+    f.name = prog.symbols.intern("f");
+    // Every operand kind a value slot can hold, literals in each spelling the lexer produces
+    const std::vector<Operand> values = {
+        Operand::temp(3), prog.symbol("x"), prog.constant("0"), prog.constant("5"), prog.constant("-5"), prog.constant("0x1F"),
+        prog.constant("'a'"), prog.constant("'\\n'"), prog.constant("\"hi there\""), prog.constant("2.5"), prog.constant(".5"),
+        Operand::immediate(7), Operand::immediate(0), Operand::immediate(-7)};
+    const std::vector<Operand> results = {Operand::temp(1), prog.symbol("y")};
+    const Operand label = Operand::label(4);
+    prog.label_count = 8;
+
+    std::vector<TacInstr> cases;
+    for (int o = 0; o <= static_cast<int>(TacOp::Comment); ++o) {
+        const TacOp op = static_cast<TacOp>(o);
+        switch (op) {
+            case TacOp::Nop: break; // Prints as a blank line, which the reader skips
+            case TacOp::Copy: case TacOp::Neg: case TacOp::Not: case TacOp::BitNot:
+                for (Operand r : results) for (Operand a : values) cases.emplace_back(op, r, a);
+                break;
+            case TacOp::Param: case TacOp::Write: case TacOp::Return:
+                for (Operand a : values) cases.emplace_back(op, Operand(), a);
+                if (op == TacOp::Return) cases.emplace_back(op);
+                if (op == TacOp::Write) for (Operand a : values) cases.emplace_back(op, Operand(), a, kWriteChar);
+                break;
+            case TacOp::Read:
+                for (Operand r : results) cases.emplace_back(op, Operand(), r);
+                break;
+            case TacOp::Call:
+                for (Operand argc : {prog.constant("2"), Operand::immediate(0)}) {
+                    cases.emplace_back(op, Operand(), prog.symbol("g"), argc);
+                    for (Operand r : results) cases.emplace_back(op, r, prog.symbol("g"), argc);
+                }
+                break;
+            case TacOp::IfFalse: case TacOp::IfTrue:
+                for (Operand a : values) cases.emplace_back(op, Operand(), a, label);
+                break;
+            case TacOp::Goto: case TacOp::Label: cases.emplace_back(op, Operand(), label); break;
+            case TacOp::JumpTable: {
+                JumpTable table;
+                table.targets = {Operand::label(1), Operand::label(2), Operand::label(1)};
+                table.fallback = Operand::label(3);
+                const Operand index = Operand::immediate(f.addJumpTable(table));
+                for (Operand a : values) cases.emplace_back(op, Operand(), a, index);
+                break;
+            }
+            case TacOp::Comment: cases.emplace_back(op, Operand(), prog.constant("# note")); break;
+            default: // Binary operators
+                for (Operand r : results) for (Operand a : values) for (Operand b : values) cases.emplace_back(op, r, a, b);
+                break;
+        }
+    }
+
+    size_t failures = 0;
+    std::string text;
+    for (const TacInstr& in : cases) {
+        text.clear();
+        appendInstr(prog, in, text, &f.jump_tables);
+        TacProgram back = parseTacText({"func begin f", text, "func end f"});
+        const TacFunction* g = back.functions.empty() ? nullptr : &back.functions[0];
+        if (!g || g->code.size() != 1 || !sameInstr(prog, f, in, back, *g, g->code[0])) {
+            std::string again;
+            if (g && g->code.size() == 1) appendInstr(back, g->code[0], again, &g->jump_tables);
+            std::cout << "IR: mismatch: '" << text << "' read back as '" << again << "' (opcode " << static_cast<int>(in.op) << " -> "
+                      << (g && g->code.size() == 1 ? static_cast<int>(g->code[0].op) : -1) << ")" << std::endl;
+            failures++;
+        }
+    }
+    // Temp and label numbers past the 29-bit operand id must stay text, not wrap onto another operand
+    for (const char* line : {"t536870912 = 1", "x = t99999999999999999999 + 1", "goto L536870912", "ifFalse x goto L4294967296"}) {
+        TacProgram back = parseTacText({"func begin f", line, "func end f"});
+        if (back.functions.size() == 1 && back.functions[0].code.size() == 1 && back.functions[0].code[0].op == TacOp::Comment) continue;
+        std::cout << "IR: mismatch: out-of-range '" << line << "' was not kept as text" << std::endl;
+        failures++;
+    }
+    std::cout << "IR: text round trip: " << cases.size() << " instruction(s) checked, " << failures << " mismatch(es)" << std::endl;
+    return failures ? 1 : 0;
+}
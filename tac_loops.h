@@ -0,0 +1,281 @@
+// File: tac_loops.h - Loop passes over natural loops: loop-invariant code motion and strength reduction of induction variables
+#ifndef TAC_LOOPS_H
+#define TAC_LOOPS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "tac_ir.h"
+#include "tac_cfg.h"
+#include "tac_dataflow.h"
+
+// Both are plain passes (no SSA). They work on the loops the generator lowers in rotated form, where the header
+// label follows the loop guard, so the code placed in front of the header runs once per entry into the loop.
+// New variables and labels are Locals, renumbered into program temps and labels by the pass manager.
+
+namespace tac_loops_detail {
+constexpr uint32_t kNone = ControlFlowGraph::kNone;
+constexpr uint32_t kMaxHoistRounds = 8; // Each round moves code out of one more level of nesting
+
+// Integer value of an immediate or an integer constant (decimal, hex, octal or character literal)
+inline bool constantInt(const TacProgram& prog, Operand o, int32_t& value) {
+    if (o.isImm()) { value = o.immValue(); return true; }
+    return o.isConst() && integerLiteral(prog.constants[o.id()], value);
+}
+
+// A loop can take code in front of its header if the header starts with a label and is not entered by falling
+// through from a block of the loop itself (then the code would run on every iteration). Jump tables are not
+// redirected, so neither is a header that one of them targets.
+inline bool hasPreheaderSlot(const TacFunction& function, const ControlFlowGraph& cfg, const NaturalLoop& loop) {
+    const std::vector<TacInstr>& code = function.code;
+    const BasicBlock& header = cfg.blocks[loop.header];
+    if (header.begin == header.end || code[header.begin].op != TacOp::Label || loop.header == 0) return false;
+    for (const JumpTable& table : function.jump_tables) {
+        if (table.fallback == code[header.begin].arg1) return false;
+        for (Operand target : table.targets) if (target == code[header.begin].arg1) return false;
+    }
+    const uint32_t prev = loop.header - 1;
+    if (!loop.contains(prev)) return true;
+    const BasicBlock& bb = cfg.blocks[prev];
+    return bb.begin != bb.end && endsControlFlow(code[bb.end - 1].op);
+}
+
+// Instruction placed before code[at]; several at the same position come out in (order, insertion) order
+struct Insertion {
+    uint32_t at;
+    uint8_t order;
+    TacInstr instr;
+};
+enum InsertionOrder : uint8_t { kAfterPrevious = 0, kPreheaderLabel = 1, kPreheaderCode = 2 };
+
+// Queues code for the preheader of a loop. Jumps to the header from outside the loop are redirected to a new
+// label in front of the code; jumps from inside (the back edges) still go straight to the header.
+inline void addPreheaderCode(std::vector<TacInstr>& code, const ControlFlowGraph& cfg, const NaturalLoop& loop,
+                             const std::vector<TacInstr>& instrs, uint32_t& next_label, std::vector<Insertion>& edits) {
+    const uint32_t at = cfg.blocks[loop.header].begin;
+    const Operand header_label = code[at].arg1;
+    Operand pre;
+    for (uint32_t b = 0; b < cfg.size(); ++b) {
+        const BasicBlock& bb = cfg.blocks[b];
+        if (bb.begin == bb.end || loop.contains(b)) continue;
+        TacInstr& last = code[bb.end - 1];
+        Operand& target = last.op == TacOp::Goto ? last.arg1 : last.arg2;
+        if ((last.op != TacOp::Goto && !isBranch(last.op)) || target.bits != header_label.bits) continue;
+        if (pre.isNone()) pre = Operand::local(next_label++);
+        target = pre;
+    }
+    if (!pre.isNone()) edits.push_back({at, kPreheaderLabel, TacInstr(TacOp::Label, Operand(), pre)});
+    for (const TacInstr& in : instrs) edits.push_back({at, kPreheaderCode, in});
+}
+
+// Applies the queued insertions and drops Nops
+inline void applyInsertions(std::vector<TacInstr>& code, std::vector<Insertion>& edits) {
+    std::stable_sort(edits.begin(), edits.end(), [](const Insertion& a, const Insertion& b) {
+        return a.at != b.at ? a.at < b.at : a.order < b.order;
+    });
+    std::vector<TacInstr> out;
+    out.reserve(code.size() + edits.size());
+    size_t e = 0;
+    for (uint32_t k = 0; k <= code.size(); ++k) {
+        for (; e < edits.size() && edits[e].at == k; ++e) out.push_back(edits[e].instr);
+        if (k < code.size() && code[k].op != TacOp::Nop) out.push_back(code[k]);
+    }
+    code.swap(out);
+}
+
+// Definitions inside one loop, indexed by VariableIndex id (reset between loops through touched)
+struct LoopDefs {
+    std::vector<uint32_t> count, at, touched;
+    bool has_call = false;
+
+    explicit LoopDefs(uint32_t vars) : count(vars, 0), at(vars, kNone) {}
+    void collect(const std::vector<TacInstr>& code, const ControlFlowGraph& cfg, const NaturalLoop& loop, const VariableIndex& vars) {
+        for (uint32_t v : touched) { count[v] = 0; at[v] = kNone; }
+        touched.clear();
+        has_call = false;
+        for (uint32_t b : loop.blocks) {
+            for (uint32_t k = cfg.blocks[b].begin; k < cfg.blocks[b].end; ++k) {
+                if (code[k].op == TacOp::Call) has_call = true;
+                Operand d = definedOperand(code[k]);
+                if (!isVariable(d)) continue;
+                uint32_t v = vars.of(d);
+                if (count[v]++ == 0) touched.push_back(v);
+                at[v] = k;
+            }
+        }
+    }
+};
+
+// Innermost loop containing each block (nested loops follow their parents in findNaturalLoops order)
+inline std::vector<uint32_t> innermostLoops(const ControlFlowGraph& cfg, const std::vector<NaturalLoop>& loops) {
+    std::vector<uint32_t> loop_of(cfg.size(), kNone);
+    for (uint32_t l = 0; l < loops.size(); ++l) for (uint32_t b : loops[l].blocks) loop_of[b] = l;
+    return loop_of;
+}
+} // namespace tac_loops_detail
+
+// --- Loop-Invariant Code Motion ---
+// Moves r = a OP b out of its innermost loop when every operand is a constant, a variable the loop never writes
+// (a global only if the loop also makes no calls) or the result of an instruction already moved out, and when
+// moving is invisible: r has no other definition in the loop, is not live into the header, and wherever it is
+// live out of the loop the instruction dominates the exit. Division only by a constant other than 0 and -1, so
+// nothing that could trap runs on a path that did not run it before. Repeats outward, one nesting level a round.
+inline bool hoistLoopInvariants(const TacProgram& prog, TacFunction& function) {
+    using namespace tac_loops_detail;
+    std::vector<TacInstr>& code = function.code;
+    uint32_t next_label = 0;
+    bool changed = false;
+    for (uint32_t round = 0; round < kMaxHoistRounds; ++round) {
+        ControlFlowGraph cfg = buildCFG(function);
+        std::vector<NaturalLoop> loops = findNaturalLoops(cfg);
+        if (loops.empty()) break;
+        LivenessInfo live = computeLiveness(prog, function, cfg);
+        VariableIndex vars = VariableIndex::build(function);
+        std::vector<uint32_t> loop_of = innermostLoops(cfg, loops);
+        std::vector<uint8_t> hoisted(code.size(), 0);
+        std::vector<Insertion> edits;
+        LoopDefs defs(vars.size());
+
+        for (uint32_t l = 0; l < loops.size(); ++l) {
+            const NaturalLoop& loop = loops[l];
+            if (!hasPreheaderSlot(function, cfg, loop)) continue;
+            defs.collect(code, cfg, loop, vars);
+            auto invariant = [&](Operand o) {
+                if (!isVariable(o)) return true;
+                uint32_t v = vars.of(o);
+                if (defs.count[v] == 0) return !(defs.has_call && prog.isGlobal(o));
+                return defs.count[v] == 1 && hoisted[defs.at[v]];
+            };
+            auto liveAt = [&](uint32_t lv, uint32_t b) { return lv != VariableIndex::kNone && live.result.in[b].test(lv); };
+            std::vector<TacInstr> moved;
+            std::vector<uint32_t> moved_at;
+            for (uint32_t b : loop.blocks) {
+                if (loop_of[b] != l) continue;
+                for (uint32_t k = cfg.blocks[b].begin; k < cfg.blocks[b].end; ++k) {
+                    const TacInstr& in = code[k];
+                    if (in.op != TacOp::Copy && !isBinaryOp(in.op) && !isUnaryOp(in.op)) continue;
+                    if (!isVariable(in.result) || prog.isGlobal(in.result) || defs.count[vars.of(in.result)] != 1) continue;
+                    int32_t divisor = 0;
+                    if ((in.op == TacOp::Div || in.op == TacOp::Mod) &&
+                        (!constantInt(prog, in.arg2, divisor) || divisor == 0 || divisor == -1)) continue;
+                    if (!invariant(in.arg1) || (isBinaryOp(in.op) && !invariant(in.arg2))) continue;
+                    const uint32_t lv = live.vars.of(in.result);
+                    if (liveAt(lv, loop.header)) continue;
+                    bool visible = false;
+                    for (uint32_t x : loop.blocks) {
+                        for (uint32_t s : cfg.successors(x)) {
+                            if (!loop.contains(s) && liveAt(lv, s) && !cfg.dominates(b, x)) visible = true;
+                        }
+                    }
+                    if (visible) continue;
+                    hoisted[k] = 1;
+                    moved.push_back(in);
+                    moved_at.push_back(k);
+                }
+            }
+            if (moved.empty()) continue;
+            for (uint32_t k : moved_at) code[k] = TacInstr();
+            addPreheaderCode(code, cfg, loop, moved, next_label, edits);
+        }
+        if (edits.empty()) break;
+        applyInsertions(code, edits);
+        changed = true;
+    }
+    return changed;
+}
+
+// --- Strength Reduction of Induction Variables ---
+// A basic induction variable i is written exactly once in the loop, by i = i + c, i = c + i or i = i - c.
+// For t = i * m or t = m * i (m a constant or a local the loop never writes) and t = i << k (k a constant), a
+// new variable s = i * m is set up in the preheader and stepped by m * c right after every update of i, so the
+// multiplication becomes t = s. All arithmetic is 32-bit two's complement, so the identity survives overflow.
+inline bool reduceInductionStrength(const TacProgram& prog, TacFunction& function) {
+    using namespace tac_loops_detail;
+    std::vector<TacInstr>& code = function.code;
+    ControlFlowGraph cfg = buildCFG(function);
+    std::vector<NaturalLoop> loops = findNaturalLoops(cfg);
+    if (loops.empty()) return false;
+    VariableIndex vars = VariableIndex::build(function);
+    LoopDefs defs(vars.size());
+    std::vector<uint8_t> done(code.size(), 0);
+    std::vector<Insertion> edits;
+    uint32_t next_label = 0, next_local = 0;
+
+    // Innermost loops first, so a multiplication is reduced in the loop whose counter it follows most closely
+    std::vector<uint32_t> order(loops.size());
+    for (uint32_t l = 0; l < loops.size(); ++l) order[l] = l;
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return loops[a].depth > loops[b].depth; });
+
+    struct Reduced { Operand iv, factor, value; TacOp op; };
+    for (uint32_t l : order) {
+        const NaturalLoop& loop = loops[l];
+        if (!hasPreheaderSlot(function, cfg, loop)) continue;
+        defs.collect(code, cfg, loop, vars);
+        // The update instruction of i if i is a basic induction variable of this loop, else kNone
+        auto updateOf = [&](Operand i) -> uint32_t {
+            if (!isVariable(i) || prog.isGlobal(i) || prog.isOpaque(i)) return kNone;
+            uint32_t v = vars.of(i);
+            if (defs.count[v] != 1) return kNone;
+            const TacInstr& up = code[defs.at[v]];
+            int32_t c = 0;
+            if (up.op == TacOp::Add && up.arg1.bits == i.bits && constantInt(prog, up.arg2, c)) return defs.at[v];
+            if (up.op == TacOp::Add && up.arg2.bits == i.bits && constantInt(prog, up.arg1, c)) return defs.at[v];
+            if (up.op == TacOp::Sub && up.arg1.bits == i.bits && constantInt(prog, up.arg2, c)) return defs.at[v];
+            return kNone;
+        };
+        auto invariantFactor = [&](Operand m) {
+            int32_t value = 0;
+            if (!isVariable(m)) return constantInt(prog, m, value);
+            return !prog.isGlobal(m) && !prog.isOpaque(m) && defs.count[vars.of(m)] == 0;
+        };
+        std::vector<Reduced> reduced;
+        for (uint32_t b : loop.blocks) {
+            for (uint32_t k = cfg.blocks[b].begin; k < cfg.blocks[b].end; ++k) {
+                TacInstr& in = code[k];
+                if (done[k] || !isVariable(in.result) || prog.isOpaque(in.result)) continue;
+                Operand iv, factor;
+                int32_t shift = 0;
+                if (in.op == TacOp::Mul) {
+                    if (updateOf(in.arg1) != kNone && invariantFactor(in.arg2)) { iv = in.arg1; factor = in.arg2; }
+                    else if (updateOf(in.arg2) != kNone && invariantFactor(in.arg1)) { iv = in.arg2; factor = in.arg1; }
+                } else if (in.op == TacOp::Shl && updateOf(in.arg1) != kNone && constantInt(prog, in.arg2, shift) && shift >= 0 && shift < 32) {
+                    iv = in.arg1; factor = in.arg2;
+                }
+                if (iv.isNone()) continue;
+                auto same = std::find_if(reduced.begin(), reduced.end(), [&](const Reduced& r) {
+                    return r.iv.bits == iv.bits && r.factor.bits == factor.bits && r.op == in.op;
+                });
+                if (same == reduced.end()) { reduced.push_back({iv, factor, Operand::local(next_local++), in.op}); same = reduced.end() - 1; }
+                in = TacInstr(TacOp::Copy, in.result, same->value);
+                done[k] = 1;
+            }
+        }
+        if (reduced.empty()) continue;
+
+        std::vector<TacInstr> setup;
+        for (const Reduced& r : reduced) {
+            const uint32_t at = updateOf(r.iv);
+            const TacInstr& up = code[at];
+            const Operand c = up.arg1.bits == r.iv.bits ? up.arg2 : up.arg1;
+            setup.push_back(TacInstr(r.op, r.value, r.iv, r.factor));
+            // Step m * c (c << k): an immediate when both are known and it fits, else computed once in the preheader
+            Operand step;
+            int32_t cv = 0, mv = 0;
+            if (constantInt(prog, c, cv) && constantInt(prog, r.factor, mv)) {
+                uint32_t product = r.op == TacOp::Shl ? static_cast<uint32_t>(cv) << mv : static_cast<uint32_t>(cv) * static_cast<uint32_t>(mv);
+                if (Operand::fitsImmediate(static_cast<int32_t>(product))) step = Operand::immediate(static_cast<int32_t>(product));
+            }
+            if (step.isNone()) {
+                step = Operand::local(next_local++);
+                setup.push_back(r.op == TacOp::Shl ? TacInstr(TacOp::Shl, step, c, r.factor) : TacInstr(TacOp::Mul, step, r.factor, c));
+            }
+            edits.push_back({at + 1, kAfterPrevious, TacInstr(up.op, r.value, r.value, step)});
+        }
+        addPreheaderCode(code, cfg, loop, setup, next_label, edits);
+    }
+    if (edits.empty()) return false;
+    applyInsertions(code, edits);
+    return true;
+}
+
+#endif // TAC_LOOPS_H
@@ -0,0 +1,547 @@
+// File: tac_passes.h - Pass manager and scalar optimizations over 3AC in SSA form: sparse conditional constant propagation, copy propagation, dead-code elimination
+#ifndef TAC_PASSES_H
+#define TAC_PASSES_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "tac_ir.h"
+#include "tac_callgraph.h"
+#include "tac_cfg.h"
+#include "tac_dataflow.h"
+#include "tac_ssa.h"
+#include "tac_loops.h"
+#include "tac_peephole.h"
+#include "thread_pool.h"
+
+// Passes rewrite a function in place. Deleted instructions are overwritten with Nop (so CFG block ranges and
+// SSA definition sites stay valid while passes run) and squeezed out by compactCode afterwards.
+inline size_t compactCode(TacFunction& function) {
+    auto keep_end = std::remove_if(function.code.begin(), function.code.end(), [](const TacInstr& in) { return in.op == TacOp::Nop; });
+    size_t removed = static_cast<size_t>(function.code.end() - keep_end);
+    function.code.erase(keep_end, function.code.end());
+    return removed;
+}
+
+// --- Integer constants ---
+// Literals and immediates that denote a 32-bit signed int. Octal/hex/suffixed/character literals are left alone.
+inline bool integerValue(const TacProgram& prog, Operand o, int64_t& value) {
+    if (o.isImm()) { value = o.immValue(); return true; }
+    if (!o.isConst()) return false;
+    const std::string& text = prog.constants[o.id()];
+    size_t k = (text.size() > 1 && text[0] == '-') ? 1 : 0;
+    if (k >= text.size() || text.size() - k > 10 || (text[k] == '0' && text.size() - k > 1)) return false;
+    int64_t v = 0;
+    for (; k < text.size(); ++k) {
+        if (!std::isdigit(static_cast<unsigned char>(text[k]))) return false;
+        v = v * 10 + (text[k] - '0');
+    }
+    value = text[0] == '-' ? -v : v;
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+// Evaluates op on int operands. Fails (returns false) wherever C++ int arithmetic would overflow or be undefined.
+inline bool foldInteger(TacOp op, int64_t a, int64_t b, int64_t& r) {
+    switch (op) {
+        case TacOp::Add: r = a + b; break;
+        case TacOp::Sub: r = a - b; break;
+        case TacOp::Mul: r = a * b; break;
+        case TacOp::Div: if (b == 0) return false; r = a / b; break;
+        case TacOp::Mod: if (b == 0) return false; r = a % b; break;
+        case TacOp::Lt: r = a < b; break;
+        case TacOp::Le: r = a <= b; break;
+        case TacOp::Gt: r = a > b; break;
+        case TacOp::Ge: r = a >= b; break;
+        case TacOp::Eq: r = a == b; break;
+        case TacOp::Ne: r = a != b; break;
+        case TacOp::LogAnd: r = (a != 0) && (b != 0); break;
+        case TacOp::LogOr: r = (a != 0) || (b != 0); break;
+        case TacOp::BitAnd: r = a & b; break;
+        case TacOp::BitOr: r = a | b; break;
+        case TacOp::BitXor: r = a ^ b; break;
+        case TacOp::Shl: if (a < 0 || b < 0 || b >= 32) return false; r = a << b; break;
+        case TacOp::Shr: if (b < 0 || b >= 32) return false; r = a >> b; break;
+        case TacOp::Neg: r = -a; break;
+        case TacOp::Not: r = !a; break;
+        case TacOp::BitNot: r = ~a; break;
+        default: return false;
+    }
+    return r >= INT32_MIN && r <= INT32_MAX;
+}
+
+// Last non-Nop instruction of a block, or kNone
+inline uint32_t blockTerminator(const std::vector<TacInstr>& code, const BasicBlock& bb) {
+    for (uint32_t k = bb.end; k-- > bb.begin;) if (code[k].op != TacOp::Nop) return k;
+    return ControlFlowGraph::kNone;
+}
+
+// --- Sparse Conditional Constant Propagation ---
+// Wegman & Zadeck's SCCP on SSA form: a definition is re-evaluated only when a value it reads changes (def-use
+// chains), and blocks and phi arguments only count once the CFG edge feeding them is known to execute.
+// Entry values (parameters, globals, uninitialised locals, statements the lowering skipped) and opaque
+// variables are unknown (Bottom) rather than undefined (Top).
+struct LatticeValue {
+    enum Kind : uint8_t { Top, Const, Bottom };
+    Kind kind = Top;
+    int64_t value = 0;
+
+    static LatticeValue bottom() { LatticeValue v; v.kind = Bottom; return v; }
+    static LatticeValue constant(int64_t c) { LatticeValue v; v.kind = Const; v.value = c; return v; }
+    // Lowers this towards o; returns true if it changed
+    bool meet(const LatticeValue& o) {
+        if (kind == Bottom || o.kind == Top) return false;
+        if (kind == Top) { *this = o; return true; }
+        if (o.kind == Const && o.value == value) return false;
+        kind = Bottom;
+        return true;
+    }
+};
+
+inline bool propagateConstants(const TacProgram& prog, TacFunction& function, SsaForm& ssa) {
+    std::vector<TacInstr>& code = function.code;
+    const ControlFlowGraph& cfg = ssa.cfg;
+    std::vector<LatticeValue> value(ssa.valueCount());
+    for (uint32_t v = 0; v < ssa.valueCount(); ++v) {
+        if (ssa.value_def[v] == SsaForm::kEntryDef || prog.isOpaque(ssa.originalOf(v))) value[v] = LatticeValue::bottom();
+    }
+    std::vector<uint32_t> block_of(code.size());
+    for (uint32_t b = 0; b < cfg.size(); ++b) for (uint32_t k = cfg.blocks[b].begin; k < cfg.blocks[b].end; ++k) block_of[k] = b;
+    std::vector<uint8_t> block_done(cfg.size(), 0), edge_done(cfg.preds.size(), 0); // Edges indexed like cfg.preds
+    std::vector<std::pair<uint32_t, uint32_t>> edge_work;
+    std::vector<uint32_t> site_work; // Instruction index or phi | kPhiTag
+
+    auto operandValue = [&](Operand o) {
+        int64_t c;
+        if (o.isLocal()) return value[o.id()];
+        return integerValue(prog, o, c) ? LatticeValue::constant(c) : LatticeValue::bottom();
+    };
+    auto lower = [&](Operand result, const LatticeValue& v) {
+        if (!result.isLocal() || !value[result.id()].meet(v)) return;
+        for (uint32_t site : ssa.usesOf(result.id())) site_work.push_back(site);
+    };
+    auto markEdge = [&](uint32_t from, uint32_t to) {
+        if (to == ControlFlowGraph::kNone) return;
+        auto preds = cfg.predecessors(to);
+        uint32_t slot = cfg.pred_offsets[to] + static_cast<uint32_t>(std::find(preds.begin(), preds.end(), from) - preds.begin());
+        if (!edge_done[slot]) { edge_done[slot] = 1; edge_work.emplace_back(from, to); }
+    };
+    auto visitPhi = [&](uint32_t p) {
+        const PhiNode& phi = ssa.phis[p];
+        if (phi.dead) return;
+        LatticeValue r;
+        for (uint32_t a = 0, n = ssa.phiArgCount(p); a < n; ++a) {
+            Operand arg = ssa.phiArgs(p)[a];
+            if (edge_done[cfg.pred_offsets[phi.block] + a] && !arg.isNone()) r.meet(operandValue(arg));
+        }
+        lower(phi.result, r);
+    };
+    auto visitInstr = [&](uint32_t k) {
+        const TacInstr& in = code[k];
+        const uint32_t b = block_of[k];
+        if (isBranch(in.op)) {
+            LatticeValue cond = operandValue(in.arg1);
+            uint32_t taken = cfg.blockOfLabel(in.arg2), fall = b + 1 < cfg.size() ? b + 1 : ControlFlowGraph::kNone;
+            if (cond.kind == LatticeValue::Bottom) { markEdge(b, taken); markEdge(b, fall); }
+            else if (cond.kind == LatticeValue::Const) markEdge(b, ((cond.value != 0) == (in.op == TacOp::IfTrue)) ? taken : fall);
+            return;
+        }
+        if (in.op == TacOp::JumpTable) {
+            LatticeValue index = operandValue(in.arg1);
+            const JumpTable& table = function.jumpTable(in);
+            if (index.kind == LatticeValue::Const) markEdge(b, cfg.blockOfLabel(table.target(index.value)));
+            else if (index.kind == LatticeValue::Bottom) {
+                for (Operand target : table.targets) markEdge(b, cfg.blockOfLabel(target));
+                markEdge(b, cfg.blockOfLabel(table.fallback));
+            }
+            return;
+        }
+        Operand d = definedOperand(in);
+        if (!d.isLocal()) return;
+        LatticeValue result = LatticeValue::bottom();
+        if (in.op == TacOp::Copy) result = operandValue(in.arg1);
+        else if (isUnaryOp(in.op) || isBinaryOp(in.op)) {
+            LatticeValue a = operandValue(in.arg1), c = isBinaryOp(in.op) ? operandValue(in.arg2) : LatticeValue::constant(0);
+            int64_t r;
+            if (a.kind == LatticeValue::Bottom || c.kind == LatticeValue::Bottom) result = LatticeValue::bottom();
+            else if (a.kind == LatticeValue::Top || c.kind == LatticeValue::Top) result = LatticeValue();
+            else result = foldInteger(in.op, a.value, c.value, r) ? LatticeValue::constant(r) : LatticeValue::bottom();
+        }
+        lower(d, result);
+    };
+    auto enterBlock = [&](uint32_t b) {
+        block_done[b] = 1;
+        for (uint32_t p = ssa.phi_offsets[b]; p < ssa.phi_offsets[b + 1]; ++p) visitPhi(p);
+        for (uint32_t k = cfg.blocks[b].begin; k < cfg.blocks[b].end; ++k) visitInstr(k);
+        uint32_t last = blockTerminator(code, cfg.blocks[b]);
+        TacOp op = last == ControlFlowGraph::kNone ? TacOp::Nop : code[last].op;
+        if (op == TacOp::Goto) markEdge(b, cfg.blockOfLabel(code[last].arg1));
+        else if (!endsControlFlow(op) && !isBranch(op) && b + 1 < cfg.size()) markEdge(b, b + 1);
+    };
+
+    enterBlock(0);
+    while (!edge_work.empty() || !site_work.empty()) {
+        if (!edge_work.empty()) {
+            uint32_t to = edge_work.back().second;
+            edge_work.pop_back();
+            if (!block_done[to]) enterBlock(to);
+            else for (uint32_t p = ssa.phi_offsets[to]; p < ssa.phi_offsets[to + 1]; ++p) visitPhi(p);
+        } else {
+            uint32_t site = site_work.back();
+            site_work.pop_back();
+            if (site & SsaForm::kPhiTag) { if (block_done[ssa.phis[site & ~SsaForm::kPhiTag].block]) visitPhi(site & ~SsaForm::kPhiTag); }
+            else if (block_done[block_of[site]]) visitInstr(site);
+        }
+    }
+
+    // Rewrite: drop never-executed code, fold constant branches, delete constant definitions (every use becomes an immediate)
+    bool changed = false;
+    auto asImmediate = [&](Operand o, Operand& imm) {
+        if (!o.isLocal() || value[o.id()].kind != LatticeValue::Const || !Operand::fitsImmediate(value[o.id()].value)) return false;
+        imm = Operand::immediate(value[o.id()].value);
+        return true;
+    };
+    for (uint32_t b = 0; b < cfg.size(); ++b) {
+        for (uint32_t p = ssa.phi_offsets[b]; p < ssa.phi_offsets[b + 1]; ++p) {
+            PhiNode& phi = ssa.phis[p];
+            Operand imm;
+            if (phi.dead) continue;
+            if (!block_done[b] || asImmediate(phi.result, imm)) { phi.dead = true; changed = true; continue; }
+            for (uint32_t a = 0, n = ssa.phiArgCount(p); a < n; ++a) {
+                Operand& arg = ssa.phiArgs(p)[a];
+                if (!edge_done[cfg.pred_offsets[b] + a]) { if (!arg.isNone()) { arg = Operand(); changed = true; } }
+                else if (asImmediate(arg, imm)) { arg = imm; changed = true; }
+            }
+        }
+        for (uint32_t k = cfg.blocks[b].begin; k < cfg.blocks[b].end; ++k) {
+            TacInstr& in = code[k];
+            Operand imm;
+            if (in.op == TacOp::Nop) continue;
+            if (!block_done[b]) { in = TacInstr(); changed = true; continue; }
+            LatticeValue cond = isBranch(in.op) ? operandValue(in.arg1) : LatticeValue();
+            if (cond.kind == LatticeValue::Const) { // Only the taken edge was marked executable
+                if ((cond.value != 0) == (in.op == TacOp::IfTrue)) in = TacInstr(TacOp::Goto, Operand(), in.arg2);
+                else in = TacInstr();
+                changed = true;
+                continue;
+            }
+            LatticeValue index = in.op == TacOp::JumpTable ? operandValue(in.arg1) : LatticeValue();
+            if (index.kind == LatticeValue::Const) {
+                in = TacInstr(TacOp::Goto, Operand(), function.jumpTable(in).target(index.value));
+                changed = true;
+                continue;
+            }
+            if ((in.op == TacOp::Copy || isUnaryOp(in.op) || isBinaryOp(in.op)) && asImmediate(in.result, imm)) { in = TacInstr(); changed = true; continue; }
+            for (int s = 0; s < 2; ++s) {
+                if (readsArg(in, s) && asImmediate(argSlot(in, s), imm)) { argSlot(in, s) = imm; changed = true; }
+            }
+        }
+    }
+    if (changed) ssa.buildUses(function);
+    return changed;
+}
+
+// --- Copy Propagation ---
+// On SSA a copy "x = y" simply makes x another name for y: every read of x becomes a read of y and the copy
+// goes. Phis whose arguments are all the same value (ignoring themselves) go the same way. Before that,
+// "t = <expr>; x = t" with t read nowhere else computes straight into x, which keeps user variable names.
+// Copies from globals stay, since a call may change the global before the copy's readers run.
+inline bool propagateCopies(const TacProgram& prog, TacFunction& function, SsaForm& ssa) {
+    std::vector<TacInstr>& code = function.code;
+    bool changed = false;
+    for (size_t k = 0; k + 1 < code.size(); ++k) {
+        TacInstr& in = code[k];
+        TacInstr& next = code[k + 1];
+        if (!in.result.isLocal() || next.op != TacOp::Copy || next.arg1 != in.result || !isVariable(next.result)) continue;
+        if (ssa.usesOf(in.result.id()).size() != 1 || !ssa.originalOf(in.result.id()).isTemp()) continue;
+        if (next.result.isLocal()) ssa.value_def[next.result.id()] = static_cast<uint32_t>(k);
+        in.result = next.result;
+        next = TacInstr();
+        changed = true;
+    }
+
+    std::vector<Operand> replacement(ssa.valueCount());
+    auto resolve = [&](Operand o) {
+        while (o.isLocal() && !replacement[o.id()].isNone()) o = replacement[o.id()];
+        return o;
+    };
+    for (TacInstr& in : code) {
+        int64_t c;
+        if (in.op != TacOp::Copy || !in.result.isLocal() || !(in.arg1.isLocal() || integerValue(prog, in.arg1, c))) continue;
+        replacement[in.result.id()] = in.arg1;
+        in = TacInstr();
+        changed = true;
+    }
+    for (bool again = true; again;) {
+        again = false;
+        for (uint32_t p = 0; p < ssa.phis.size(); ++p) {
+            PhiNode& phi = ssa.phis[p];
+            if (phi.dead) continue;
+            Operand same;
+            bool trivial = true;
+            for (uint32_t a = 0, n = ssa.phiArgCount(p); a < n && trivial; ++a) {
+                Operand arg = resolve(ssa.phiArgs(p)[a]);
+                if (arg.isNone() || arg == phi.result) continue;
+                if (same.isNone()) same = arg;
+                else if (arg != same) trivial = false;
+            }
+            if (!trivial || same.isNone()) continue;
+            replacement[phi.result.id()] = same;
+            phi.dead = true;
+            again = changed = true;
+        }
+    }
+    if (!changed) return false;
+    for (TacInstr& in : code) for (int s = 0; s < 2; ++s) if (readsArg(in, s)) argSlot(in, s) = resolve(argSlot(in, s));
+    for (uint32_t p = 0; p < ssa.phis.size(); ++p) {
+        if (ssa.phis[p].dead) continue;
+        for (uint32_t a = 0, n = ssa.phiArgCount(p); a < n; ++a) ssa.phiArgs(p)[a] = resolve(ssa.phiArgs(p)[a]);
+    }
+    ssa.buildUses(function);
+    return true;
+}
+
+// --- Dead-Code Elimination ---
+// Mark and sweep over SSA def-use chains: instructions with side effects (calls, I/O, control flow, stores to
+// globals) are live, and so is every definition a live instruction or phi reads. Everything else goes in one
+// pass; a call whose result is never read keeps running but drops the result. Unreachable blocks go too.
+// A call to a side-effect-free function (program.side_effect_free) is live only through its result; when it
+// goes, so do its params.
+inline bool eliminateDeadCode(const TacProgram& program, TacFunction& function, SsaForm& ssa) {
+    std::vector<TacInstr>& code = function.code;
+    const ControlFlowGraph& cfg = ssa.cfg;
+    std::vector<uint8_t> live_instr(code.size(), 0), live_phi(ssa.phis.size(), 0), value_read(ssa.valueCount(), 0);
+    std::vector<uint32_t> work;
+    std::unordered_map<uint32_t, std::vector<size_t>> call_params; // Droppable call -> its params
+    std::vector<uint8_t> owned_param(code.size(), 0);
+    auto readValue = [&](Operand o) { if (o.isLocal() && !value_read[o.id()]) { value_read[o.id()] = 1; work.push_back(o.id()); } };
+    auto markInstr = [&](uint32_t k) {
+        if (live_instr[k]) return;
+        live_instr[k] = 1;
+        for (int s = 0; s < 2; ++s) if (readsArg(code[k], s)) readValue(argSlot(code[k], s));
+        auto it = call_params.find(k);
+        if (it == call_params.end()) return;
+        for (size_t p : it->second) {
+            live_instr[p] = 1;
+            readValue(code[p].arg1);
+        }
+    };
+    std::vector<size_t> params;
+    for (uint32_t k = 0; k < code.size(); ++k) {
+        int32_t n;
+        if (!program.isSideEffectFreeCall(code[k]) || !(code[k].result.isNone() || code[k].result.isLocal()) ||
+            !callArgumentCount(program, code[k], n) || !findCallParams(program, code, k, static_cast<uint32_t>(n), params)) continue;
+        for (size_t p : params) owned_param[p] = 1;
+        call_params.emplace(k, params);
+    }
+    for (uint32_t b = 0; b < cfg.size(); ++b) {
+        if (!cfg.reachable(b)) continue;
+        for (uint32_t k = cfg.blocks[b].begin; k < cfg.blocks[b].end; ++k) {
+            const TacInstr& in = code[k];
+            bool pure = in.op == TacOp::Nop || ((in.op == TacOp::Copy || isUnaryOp(in.op) || isBinaryOp(in.op)) && in.result.isLocal()) ||
+                        owned_param[k] || call_params.count(k);
+            if (!pure) markInstr(k);
+        }
+    }
+    while (!work.empty()) {
+        uint32_t v = work.back(); work.pop_back();
+        uint32_t def = ssa.value_def[v];
+        if (def == SsaForm::kEntryDef) continue;
+        if (def & SsaForm::kPhiTag) {
+            uint32_t p = def & ~SsaForm::kPhiTag;
+            if (live_phi[p]) continue;
+            live_phi[p] = 1;
+            for (uint32_t a = 0, n = ssa.phiArgCount(p); a < n; ++a) readValue(ssa.phiArgs(p)[a]);
+        } else markInstr(def);
+    }
+
+    bool changed = false;
+    for (uint32_t b = 0; b < cfg.size(); ++b) {
+        for (uint32_t k = cfg.blocks[b].begin; k < cfg.blocks[b].end; ++k) {
+            TacInstr& in = code[k];
+            if (in.op == TacOp::Nop) continue;
+            if (!live_instr[k]) { in = TacInstr(); changed = true; }
+            else if (in.op == TacOp::Call && in.result.isLocal() && !value_read[in.result.id()]) { in.result = Operand(); changed = true; }
+        }
+    }
+    for (uint32_t p = 0; p < ssa.phis.size(); ++p) {
+        if (!ssa.phis[p].dead && !live_phi[p]) { ssa.phis[p].dead = true; changed = true; }
+    }
+    if (changed) ssa.buildUses(function);
+    return changed;
+}
+
+// Gives every Local operand left by a pass a fresh program-wide temp, in order of first appearance. Locals in
+// label positions (a pass that adds blocks) get fresh program labels from a separate numbering.
+inline void materializeLocals(TacProgram& program, TacFunction& function) {
+    std::vector<uint32_t> temp_of, label_of;
+    auto materialize = [&](Operand& o, bool is_label) {
+        if (!o.isLocal()) return;
+        std::vector<uint32_t>& map = is_label ? label_of : temp_of;
+        uint32_t& counter = is_label ? program.label_count : program.temp_count;
+        if (o.id() >= map.size()) map.resize(o.id() + 1, UINT32_MAX);
+        if (map[o.id()] == UINT32_MAX) map[o.id()] = counter++;
+        o = is_label ? Operand::label(map[o.id()]) : Operand::temp(map[o.id()]);
+    };
+    for (TacInstr& in : function.code) {
+        const bool label1 = in.op == TacOp::Label || in.op == TacOp::Goto;
+        materialize(in.result, false);
+        materialize(in.arg1, label1);
+        materialize(in.arg2, isBranch(in.op));
+    }
+}
+
+// --- Pass Manager ---
+// Runs the enabled passes in order over every function, functions in parallel. Consecutive SSA passes share
+// one SSA construction and destruction per function, which are reported as stages of their own. Passes only
+// read the shared program tables, so functions never contend; any Locals they leave are renumbered into
+// program temps serially afterwards. Times are summed over functions (CPU time when several threads run).
+// A cleanup pass (at most one) runs before the first stage and after every stage; it gets a single report,
+// whose instruction counts say what the program would have had without it.
+using TacPassFn = bool (*)(const TacProgram&, TacFunction&);
+using SsaPassFn = bool (*)(const TacProgram&, TacFunction&, SsaForm&);
+using CleanupFn = std::function<bool(const TacProgram&, TacFunction&)>;
+
+struct TacPass {
+    std::string name;
+    TacPassFn run = nullptr;
+    SsaPassFn ssa_run = nullptr;
+    CleanupFn cleanup;
+    bool enabled = true;
+};
+
+struct PassReport {
+    std::string name;
+    double ms = 0;
+    size_t instrs_before = 0, instrs_after = 0;
+    size_t functions_changed = 0;
+};
+
+class PassManager {
+public:
+    void add(const std::string& name, TacPassFn run) { passes_.push_back({name, run, nullptr, nullptr, true}); }
+    void add(const std::string& name, SsaPassFn run) { passes_.push_back({name, nullptr, run, nullptr, true}); }
+    void setCleanup(const std::string& name, CleanupFn run) {
+        passes_.erase(std::remove_if(passes_.begin(), passes_.end(), [](const TacPass& p) { return p.cleanup != nullptr; }), passes_.end());
+        passes_.push_back({name, nullptr, nullptr, std::move(run), true});
+    }
+    // Returns false if there is no pass with that name
+    bool setEnabled(const std::string& name, bool enabled) {
+        for (TacPass& pass : passes_) if (pass.name == name) { pass.enabled = enabled; return true; }
+        return false;
+    }
+    void setAllEnabled(bool enabled) { for (TacPass& pass : passes_) pass.enabled = enabled; }
+    const std::vector<TacPass>& passes() const { return passes_; }
+
+    std::vector<PassReport> run(TacProgram& program, ThreadPool& pool) const {
+        std::vector<PassReport> reports;
+        const size_t nf = program.functions.size();
+        auto liveCount = [](const TacFunction& f) {
+            return static_cast<size_t>(std::count_if(f.code.begin(), f.code.end(), [](const TacInstr& in) { return in.op != TacOp::Nop; }));
+        };
+        size_t total = 0;
+        for (const TacFunction& f : program.functions) total += f.code.size();
+        const TacPass* cleanup = nullptr;
+        for (const TacPass& pass : passes_) if (pass.cleanup && pass.enabled) cleanup = &pass;
+        PassReport cleanup_report;
+        size_t cleaned = 0;
+        auto runCleanup = [&] {
+            std::vector<double> ms(nf, 0.0);
+            std::vector<size_t> removed(nf, 0);
+            std::vector<uint8_t> changed(nf, 0);
+            pool.parallelFor(nf, [&](size_t f) {
+                TacFunction& function = program.functions[f];
+                const size_t before = liveCount(function);
+                auto start = std::chrono::steady_clock::now();
+                changed[f] = cleanup->cleanup(program, function) ? 1 : 0;
+                compactCode(function);
+                ms[f] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                removed[f] = before - liveCount(function);
+            });
+            for (size_t f = 0; f < nf; ++f) {
+                cleanup_report.ms += ms[f];
+                cleanup_report.functions_changed += changed[f];
+                cleaned += removed[f];
+                total -= removed[f];
+            }
+        };
+        if (cleanup) runCleanup();
+        for (size_t i = 0; i < passes_.size();) {
+            // Next stage: one plain pass, or a run of SSA passes (disabled ones skipped) wrapped in construct/destruct
+            std::vector<const TacPass*> stage;
+            if (!passes_[i].enabled || passes_[i].cleanup) { ++i; continue; }
+            if (passes_[i].run) stage.push_back(&passes_[i++]);
+            else {
+                for (; i < passes_.size() && passes_[i].ssa_run; ++i) if (passes_[i].enabled) stage.push_back(&passes_[i]);
+            }
+            const bool ssa = stage[0]->ssa_run != nullptr;
+            const size_t steps = stage.size() + (ssa ? 2 : 0);
+            std::vector<double> ms(nf * steps, 0.0);
+            std::vector<size_t> count(nf * steps, 0);
+            std::vector<uint8_t> changed(nf * steps, 0);
+            pool.parallelFor(nf, [&](size_t f) {
+                TacFunction& function = program.functions[f];
+                size_t step = 0;
+                auto timed = [&](auto&& body) {
+                    auto start = std::chrono::steady_clock::now();
+                    changed[f * steps + step] = body() ? 1 : 0;
+                    ms[f * steps + step] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                    count[f * steps + step] = liveCount(function);
+                    step++;
+                };
+                if (!ssa) { timed([&] { return stage[0]->run(program, function); }); compactCode(function); return; }
+                SsaForm form;
+                timed([&] { form = constructSSA(program, function); return true; });
+                for (const TacPass* pass : stage) timed([&] { return pass->ssa_run(program, function, form); });
+                timed([&] { destructSSA(program, function, form); return true; });
+            });
+            for (size_t step = 0; step < steps; ++step) {
+                PassReport report;
+                if (ssa && step == 0) report.name = "ssa-construct";
+                else if (ssa && step == steps - 1) report.name = "ssa-destruct";
+                else report.name = stage[ssa ? step - 1 : step]->name;
+                report.instrs_before = total;
+                for (size_t f = 0; f < nf; ++f) {
+                    report.ms += ms[f * steps + step];
+                    report.instrs_after += count[f * steps + step];
+                    report.functions_changed += changed[f * steps + step];
+                }
+                total = report.instrs_after;
+                reports.push_back(report);
+            }
+            for (TacFunction& function : program.functions) materializeLocals(program, function);
+            if (cleanup) runCleanup();
+        }
+        if (cleanup) {
+            cleanup_report.name = cleanup->name;
+            cleanup_report.instrs_after = total;
+            cleanup_report.instrs_before = total + cleaned;
+            reports.push_back(cleanup_report);
+        }
+        return reports;
+    }
+
+private:
+    std::vector<TacPass> passes_;
+};
+
+// The standard pipeline: the loop passes on plain code, then the rest all on one SSA form: constants first (it
+// deletes dead branches and exposes copies), then copies, then cleanup of what the others left behind. The
+// peephole rules tidy the code after lowering and after each of those stages.
+inline PassManager defaultPassPipeline(PeepholeCounters* peephole_counters = nullptr) {
+    PassManager pm;
+    pm.add("licm", TacPassFn(hoistLoopInvariants));
+    pm.add("strength", TacPassFn(reduceInductionStrength));
+    pm.add("sccp", SsaPassFn(propagateConstants));
+    pm.add("copyprop", SsaPassFn(propagateCopies));
+    pm.add("dce", SsaPassFn(eliminateDeadCode));
+    pm.setCleanup("peephole", [peephole_counters](const TacProgram& prog, TacFunction& function) {
+        return runPeephole(prog, function, peephole_counters);
+    });
+    return pm;
+}
+
+#endif // TAC_PASSES_H
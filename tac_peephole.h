@@ -0,0 +1,283 @@
+// File: tac_peephole.h - Window-based peephole cleanup of 3AC driven by a table of local rewrite rules
+#ifndef TAC_PEEPHOLE_H
+#define TAC_PEEPHOLE_H
+
+#include <atomic>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "tac_ir.h"
+#include "tac_cfg.h"
+
+// The function is rebuilt in one linear pass: each instruction is appended to the output, then the rules are
+// tried against the newest instructions (the window) until none fires. A rule that rewrites the tail exposes
+// the instruction before it, so chains collapse in the same pass. Jump threading and the label and temp use
+// counts are function-wide facts gathered once per round; rounds repeat until nothing fires (at most
+// kPeepholeMaxRounds). Linear in the size of the code, so the pass manager runs it after every stage.
+constexpr int kPeepholeMaxRounds = 4;
+constexpr size_t kPeepholeWindow = 4;
+
+namespace tac_peephole_detail {
+// What a window slot must hold for a rule to be tried
+enum class Shape : uint8_t {
+    Jump,       // goto, if, ifFalse
+    Branch,     // if, ifFalse
+    EndsFlow,   // goto, return, jumptable
+    Code,       // anything but a label or comment
+    Label,
+    Copy,
+    Binary,
+    Value,      // Computes into its result: copy, unary, binary, call with a result
+};
+
+inline bool fits(Shape shape, const TacInstr& in) {
+    switch (shape) {
+        case Shape::Jump: return in.op == TacOp::Goto || isBranch(in.op);
+        case Shape::Branch: return isBranch(in.op);
+        case Shape::EndsFlow: return endsControlFlow(in.op);
+        case Shape::Code: return in.op != TacOp::Label && in.op != TacOp::Comment;
+        case Shape::Label: return in.op == TacOp::Label;
+        case Shape::Copy: return in.op == TacOp::Copy;
+        case Shape::Binary: return isBinaryOp(in.op);
+        case Shape::Value: return in.op == TacOp::Copy || isUnaryOp(in.op) || isBinaryOp(in.op) || (in.op == TacOp::Call && !in.result.isNone());
+    }
+    return false;
+}
+
+inline Operand jumpTarget(const TacInstr& in) { return in.op == TacOp::Goto ? in.arg1 : in.arg2; }
+
+inline bool constantInt(const TacProgram& prog, Operand o, int32_t& value) {
+    if (o.isImm()) { value = o.immValue(); return true; }
+    return o.isConst() && integerLiteral(prog.constants[o.id()], value);
+}
+} // namespace tac_peephole_detail
+
+// The output built so far plus the function-wide facts the rules consult. at(0) is the newest instruction.
+class PeepholeWindow {
+public:
+    PeepholeWindow(const TacProgram& prog, TacFunction& function) : prog_(prog), function_(function) {}
+
+    const TacProgram& program() const { return prog_; }
+    size_t size() const { return out_.size(); }
+    TacInstr& at(size_t back) { return out_[out_.size() - 1 - back]; }
+
+    // Label uses by jumps and jump tables, temp reads, and where each label's code immediately jumps
+    void begin(const std::vector<TacInstr>& code) {
+        refs_.clear(); temp_reads_.clear(); forward_.clear();
+        out_.clear();
+        out_.reserve(code.size());
+        for (size_t k = 0; k < code.size(); ++k) {
+            const TacInstr& in = code[k];
+            forEachLabel(in, [&](Operand label) { refs_[label.bits]++; });
+            Operand uses[2];
+            for (int u = 0, n = usedOperands(in, uses); u < n; ++u) if (uses[u].isTemp()) temp_reads_[uses[u].bits]++;
+            if (in.op != TacOp::Label) continue;
+            size_t j = k + 1;
+            while (j < code.size() && (code[j].op == TacOp::Label || code[j].op == TacOp::Nop || code[j].op == TacOp::Comment)) j++;
+            if (j < code.size() && code[j].op == TacOp::Goto) forward_[in.arg1.bits] = code[j].arg1;
+        }
+        // A jump threaded later in the round may land on any chain end, so those labels must stay
+        for (const auto& hop : forward_) refs_[hop.second.bits]++;
+        // A temp computed from an opaque value is opaque too (t0 = x + 1 with x a double); grow to a fixed point
+        opaque_temps_.clear();
+        for (bool grew = !prog_.opaque.empty(); grew;) {
+            grew = false;
+            for (const TacInstr& in : code) {
+                const Operand def = definedOperand(in);
+                if (!def.isTemp() || opaque_temps_.count(def.bits)) continue;
+                Operand uses[2];
+                bool from_opaque = prog_.isOpaque(in.arg1) || prog_.isOpaque(in.arg2);
+                for (int u = 0, n = usedOperands(in, uses); u < n; ++u) from_opaque = from_opaque || opaque_temps_.count(uses[u].bits);
+                if (from_opaque) { opaque_temps_.insert(def.bits); grew = true; }
+            }
+        }
+    }
+    void push(const TacInstr& in) { out_.push_back(in); }
+    std::vector<TacInstr> finish() { return std::move(out_); }
+
+    uint32_t labelRefs(Operand label) const { auto it = refs_.find(label.bits); return it == refs_.end() ? 0 : it->second; }
+    uint32_t tempReads(Operand temp) const { auto it = temp_reads_.find(temp.bits); return it == temp_reads_.end() ? 0 : it->second; }
+    // Holds a non-int value: an opaque symbol or a temp computed from one
+    bool opaque(Operand o) const { return prog_.isOpaque(o) || (o.isTemp() && opaque_temps_.count(o.bits)); }
+
+    // Where a jump to label ends up after following "L: goto M" chains (label itself if it leads nowhere else)
+    Operand finalTarget(Operand label) const {
+        Operand target = label;
+        for (size_t hops = 0; hops <= forward_.size(); ++hops) {
+            auto it = forward_.find(target.bits);
+            if (it == forward_.end() || it->second == target) return target;
+            target = it->second;
+        }
+        return label; // A cycle of gotos: leave the jump alone
+    }
+
+    void erase(size_t back) {
+        forEachLabel(at(back), [&](Operand label) { refs_[label.bits]--; });
+        out_.erase(out_.end() - 1 - static_cast<std::ptrdiff_t>(back));
+    }
+    void retarget(Operand& slot, Operand label) { refs_[slot.bits]--; refs_[label.bits]++; slot = label; }
+    JumpTable& table(const TacInstr& in) { return function_.jump_tables[static_cast<uint32_t>(in.arg2.immValue())]; }
+
+private:
+    template <typename Fn>
+    void forEachLabel(const TacInstr& in, Fn fn) {
+        if (in.op == TacOp::Goto || isBranch(in.op)) fn(tac_peephole_detail::jumpTarget(in));
+        if (in.op != TacOp::JumpTable) return;
+        const JumpTable& t = table(in);
+        for (Operand target : t.targets) fn(target);
+        fn(t.fallback);
+    }
+
+    const TacProgram& prog_;
+    TacFunction& function_;
+    std::vector<TacInstr> out_;
+    std::unordered_map<uint32_t, uint32_t> refs_, temp_reads_;
+    std::unordered_set<uint32_t> opaque_temps_;
+    std::unordered_map<uint32_t, Operand> forward_;
+};
+
+// --- Rules ---
+// A rule is tried when the newest instructions fit its pattern (oldest first); apply returns whether it
+// rewrote anything. Rules may also look further back, up to kPeepholeWindow instructions.
+struct PeepholeRule {
+    const char* name;
+    uint8_t length;
+    tac_peephole_detail::Shape pattern[2];
+    bool (*apply)(PeepholeWindow& w);
+};
+
+inline const PeepholeRule kPeepholeRules[] = {
+    // Code after goto/return/jumptable and before the next label never runs
+    {"dead-code", 2, {tac_peephole_detail::Shape::EndsFlow, tac_peephole_detail::Shape::Code},
+     [](PeepholeWindow& w) { w.erase(0); return true; }},
+    // "goto L" / "if t goto L" right before L: (possibly among other labels)
+    {"jump-next", 1, {tac_peephole_detail::Shape::Label},
+     [](PeepholeWindow& w) {
+         size_t k = 0;
+         while (k + 1 < w.size() && k < kPeepholeWindow && w.at(k).op == TacOp::Label) k++;
+         if (k >= w.size() || !tac_peephole_detail::fits(tac_peephole_detail::Shape::Jump, w.at(k))) return false;
+         for (size_t l = 0; l < k; ++l) {
+             if (w.at(l).arg1 == tac_peephole_detail::jumpTarget(w.at(k))) { w.erase(k); return true; }
+         }
+         return false;
+     }},
+    // "ifFalse t goto L; goto M; L:" -> "if t goto M; L:" (and the other way round)
+    {"branch-invert", 2, {tac_peephole_detail::Shape::Jump, tac_peephole_detail::Shape::Label},
+     [](PeepholeWindow& w) {
+         if (w.size() < 3 || w.at(1).op != TacOp::Goto || !isBranch(w.at(2).op) || w.at(2).arg2 != w.at(0).arg1) return false;
+         TacInstr& branch = w.at(2);
+         branch.op = branch.op == TacOp::IfTrue ? TacOp::IfFalse : TacOp::IfTrue;
+         w.retarget(branch.arg2, w.at(1).arg1);
+         w.erase(1);
+         return true;
+     }},
+    // Labels nothing jumps to
+    {"unused-label", 1, {tac_peephole_detail::Shape::Label},
+     [](PeepholeWindow& w) { if (w.labelRefs(w.at(0).arg1)) return false; w.erase(0); return true; }},
+    // A branch on a constant either always jumps or never does
+    {"const-branch", 1, {tac_peephole_detail::Shape::Branch},
+     [](PeepholeWindow& w) {
+         int32_t value;
+         TacInstr& in = w.at(0);
+         if (!tac_peephole_detail::constantInt(w.program(), in.arg1, value)) return false;
+         if ((in.op == TacOp::IfTrue) != (value != 0)) { w.erase(0); return true; }
+         in = TacInstr(TacOp::Goto, Operand(), in.arg2);
+         return true;
+     }},
+    // A jump to "L: goto M" goes straight to M
+    {"jump-thread", 1, {tac_peephole_detail::Shape::Jump},
+     [](PeepholeWindow& w) {
+         TacInstr& in = w.at(0);
+         Operand& slot = in.op == TacOp::Goto ? in.arg1 : in.arg2;
+         Operand target = w.finalTarget(slot);
+         if (target == slot) return false;
+         w.retarget(slot, target);
+         return true;
+     }},
+    {"table-thread", 1, {tac_peephole_detail::Shape::EndsFlow},
+     [](PeepholeWindow& w) {
+         if (w.at(0).op != TacOp::JumpTable) return false;
+         JumpTable& table = w.table(w.at(0));
+         bool changed = false;
+         for (Operand* slot = table.targets.data(), *end = slot + table.targets.size() + 1; slot != end; ++slot) {
+             Operand& target = slot == end - 1 ? table.fallback : *slot;
+             Operand final_target = w.finalTarget(target);
+             if (final_target != target) { w.retarget(target, final_target); changed = true; }
+         }
+         return changed;
+     }},
+    // x = a + 0, a - 0, a * 1, a / 1, a << 0, a >> 0, a | 0, a ^ 0 (either side where commutative) -> x = a;
+    // x = a * 0, a & 0 -> x = 0
+    {"identity", 1, {tac_peephole_detail::Shape::Binary},
+     [](PeepholeWindow& w) {
+         TacInstr& in = w.at(0);
+         const TacProgram& prog = w.program();
+         if (w.opaque(in.result) || w.opaque(in.arg1) || w.opaque(in.arg2)) return false; // -0.0 + 0, NaN * 0
+         int32_t a = 0, b = 0;
+         const bool ca = tac_peephole_detail::constantInt(prog, in.arg1, a);
+         const bool cb = tac_peephole_detail::constantInt(prog, in.arg2, b);
+         const bool commutative = in.op == TacOp::Add || in.op == TacOp::Mul || in.op == TacOp::BitOr ||
+                                  in.op == TacOp::BitXor || in.op == TacOp::BitAnd;
+         auto neutral = [&](int32_t v) {
+             switch (in.op) {
+                 case TacOp::Add: case TacOp::Sub: case TacOp::Shl: case TacOp::Shr: case TacOp::BitOr: case TacOp::BitXor: return v == 0;
+                 case TacOp::Mul: case TacOp::Div: return v == 1;
+                 default: return false;
+             }
+         };
+         auto absorbing = [&](int32_t v) { return (in.op == TacOp::Mul || in.op == TacOp::BitAnd) && v == 0; };
+         if (cb && neutral(b)) in = TacInstr(TacOp::Copy, in.result, in.arg1);
+         else if (ca && commutative && neutral(a)) in = TacInstr(TacOp::Copy, in.result, in.arg2);
+         else if (cb && absorbing(b)) in = TacInstr(TacOp::Copy, in.result, in.arg2);
+         else if (ca && absorbing(a)) in = TacInstr(TacOp::Copy, in.result, in.arg1);
+         else return false;
+         return true;
+     }},
+    {"self-copy", 1, {tac_peephole_detail::Shape::Copy},
+     [](PeepholeWindow& w) { if (w.at(0).result != w.at(0).arg1) return false; w.erase(0); return true; }},
+    // "t = <expr>; x = t" with t read nowhere else -> "x = <expr>"
+    {"temp-copy", 2, {tac_peephole_detail::Shape::Value, tac_peephole_detail::Shape::Copy},
+     [](PeepholeWindow& w) {
+         Operand t = w.at(0).arg1;
+         if (!t.isTemp() || w.at(1).result != t || w.at(0).result == t || w.tempReads(t) != 1 || w.program().isOpaque(w.at(0).result)) return false;
+         w.at(1).result = w.at(0).result;
+         w.erase(0);
+         return true;
+     }},
+};
+constexpr size_t kPeepholeRuleCount = sizeof(kPeepholeRules) / sizeof(kPeepholeRules[0]);
+
+// How often each rule fired, summed over every function and every run (functions run in parallel)
+struct PeepholeCounters {
+    std::atomic<uint64_t> fired[kPeepholeRuleCount] = {};
+};
+
+inline bool runPeephole(const TacProgram& prog, TacFunction& function, PeepholeCounters* counters = nullptr) {
+    using namespace tac_peephole_detail;
+    uint64_t fired[kPeepholeRuleCount] = {};
+    PeepholeWindow w(prog, function);
+    bool changed = false;
+    for (int round = 0; round < kPeepholeMaxRounds; ++round) {
+        bool any = false;
+        w.begin(function.code);
+        for (const TacInstr& next : function.code) {
+            if (next.op == TacOp::Nop) continue;
+            w.push(next);
+            for (size_t r = 0; r < kPeepholeRuleCount && w.size();) {
+                const PeepholeRule& rule = kPeepholeRules[r];
+                bool fit = w.size() >= rule.length;
+                for (size_t s = 0; fit && s < rule.length; ++s) fit = fits(rule.pattern[s], w.at(rule.length - 1 - s));
+                if (fit && rule.apply(w)) { fired[r]++; any = true; r = 0; }
+                else ++r;
+            }
+        }
+        function.code = w.finish();
+        changed |= any;
+        if (!any) break;
+    }
+    if (counters) for (size_t r = 0; r < kPeepholeRuleCount; ++r) if (fired[r]) counters->fired[r] += fired[r];
+    return changed;
+}
+
+#endif // TAC_PEEPHOLE_H
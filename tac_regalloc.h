@@ -0,0 +1,329 @@
+// File: tac_regalloc.h - Temporary reuse: live intervals, linear-scan and graph-coloring allocation onto virtual registers
+#ifndef TAC_REGALLOC_H
+#define TAC_REGALLOC_H
+
+#include <algorithm>
+#include <cstdint>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "tac_ir.h"
+#include "tac_cfg.h"
+
+// Only temporaries are allocated; named variables keep their names. After allocation register r is written as
+// temp r and spill slot s as temp (registers + s), so every function numbers its temporaries from t0 again and
+// the 3AC stays in the usual text format. Spilled temporaries share slots whenever their intervals are disjoint.
+enum class RegAllocMethod : uint8_t { LinearScan, GraphColoring };
+
+inline const char* regAllocMethodName(RegAllocMethod m) { return m == RegAllocMethod::LinearScan ? "linear-scan" : "graph-coloring"; }
+
+struct RegAllocOptions {
+    RegAllocMethod method = RegAllocMethod::LinearScan;
+    uint32_t registers = 16;
+};
+
+// Positions: instruction k reads its operands at 2k and writes its result at 2k+1
+struct LiveInterval {
+    Operand temp;            // The temporary before allocation
+    uint32_t start = 0, end = 0;
+    uint32_t uses = 0;       // Reads plus writes, the spill cost
+    uint32_t assigned = 0;   // Register, or kSpilled | slot
+};
+
+struct RegAllocResult {
+    static constexpr uint32_t kSpilled = 1u << 31;
+    std::vector<LiveInterval> intervals; // Sorted by start
+    uint32_t registers_used = 0;
+    uint32_t spill_slots = 0;
+    uint32_t max_pressure = 0;           // Most temporaries live at one point
+    size_t spilled = 0;
+    size_t copies_removed = 0;           // Copies whose source and destination ended up in the same register
+
+    uint32_t tempCount(const RegAllocOptions& options) const { return spill_slots ? options.registers + spill_slots : registers_used; }
+};
+
+namespace tac_regalloc_detail {
+// Dense ids for the temporaries of one function plus the blocks each is live out of. Temporaries rarely outlive
+// their block (short-circuit results and values coming out of SSA destruction do); those are found by walking
+// predecessors from every upward-exposed use until a block that defines them.
+struct TempLiveness {
+    std::unordered_map<uint32_t, uint32_t> index; // Temp operand bits -> dense id
+    std::vector<Operand> temps;
+    std::vector<uint32_t> out_offsets, live_out;  // Live-out temps of block b: live_out[out_offsets[b] .. out_offsets[b+1])
+    std::vector<uint32_t> in_offsets, live_in;
+
+    uint32_t of(Operand o) const { return index.find(o.bits)->second; }
+};
+
+inline TempLiveness computeTempLiveness(const TacFunction& function, const ControlFlowGraph& cfg) {
+    constexpr uint32_t kNone = ControlFlowGraph::kNone;
+    TempLiveness tl;
+    const std::vector<TacInstr>& code = function.code;
+    std::vector<std::pair<uint32_t, uint32_t>> exposed, defs; // (temp, block)
+    std::vector<uint32_t> defined_in;
+    auto idOf = [&](Operand o) {
+        auto it = tl.index.emplace(o.bits, static_cast<uint32_t>(tl.temps.size()));
+        if (it.second) { tl.temps.push_back(o); defined_in.push_back(kNone); }
+        return it.first->second;
+    };
+    Operand used[2];
+    for (uint32_t b = 0; b < cfg.size(); ++b) {
+        for (uint32_t k = cfg.blocks[b].begin; k < cfg.blocks[b].end; ++k) {
+            for (int u = 0, c = usedOperands(code[k], used); u < c; ++u) {
+                if (!used[u].isTemp()) continue;
+                uint32_t t = idOf(used[u]);
+                if (defined_in[t] != b) exposed.emplace_back(t, b);
+            }
+            Operand d = definedOperand(code[k]);
+            if (d.isTemp()) { uint32_t t = idOf(d); defined_in[t] = b; defs.emplace_back(t, b); }
+        }
+    }
+    const uint32_t nt = static_cast<uint32_t>(tl.temps.size());
+    std::vector<uint32_t> exposed_offsets, exposed_blocks, def_offsets, def_blocks;
+    tac_cfg_detail::buildAdjacency(nt, exposed, exposed_offsets, exposed_blocks);
+    tac_cfg_detail::buildAdjacency(nt, defs, def_offsets, def_blocks);
+    std::vector<uint32_t> def_mark(cfg.size(), kNone), in_mark(cfg.size(), kNone), out_mark(cfg.size(), kNone), work;
+    std::vector<std::pair<uint32_t, uint32_t>> out_pairs, in_pairs; // (block, temp)
+    for (uint32_t t = 0; t < nt; ++t) {
+        for (uint32_t e = def_offsets[t]; e < def_offsets[t + 1]; ++e) def_mark[def_blocks[e]] = t;
+        for (uint32_t e = exposed_offsets[t]; e < exposed_offsets[t + 1]; ++e) {
+            uint32_t b = exposed_blocks[e];
+            if (in_mark[b] != t) { in_mark[b] = t; in_pairs.emplace_back(b, t); work.push_back(b); }
+        }
+        while (!work.empty()) {
+            uint32_t b = work.back(); work.pop_back();
+            for (uint32_t p : cfg.predecessors(b)) {
+                if (out_mark[p] == t) continue;
+                out_mark[p] = t;
+                out_pairs.emplace_back(p, t);
+                if (def_mark[p] != t && in_mark[p] != t) { in_mark[p] = t; in_pairs.emplace_back(p, t); work.push_back(p); }
+            }
+        }
+    }
+    tac_cfg_detail::buildAdjacency(cfg.size(), out_pairs, tl.out_offsets, tl.live_out);
+    tac_cfg_detail::buildAdjacency(cfg.size(), in_pairs, tl.in_offsets, tl.live_in);
+    return tl;
+}
+
+// Hands out the lowest free number to each interval in start order; used for spill slots (no limit)
+inline uint32_t assignSlots(std::vector<LiveInterval*>& intervals) {
+    std::sort(intervals.begin(), intervals.end(), [](const LiveInterval* a, const LiveInterval* b) { return a->start < b->start; });
+    std::priority_queue<std::pair<uint32_t, uint32_t>, std::vector<std::pair<uint32_t, uint32_t>>, std::greater<>> active; // (end, slot)
+    std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<>> free_slots;
+    uint32_t slots = 0;
+    for (LiveInterval* iv : intervals) {
+        while (!active.empty() && active.top().first < iv->start) { free_slots.push(active.top().second); active.pop(); }
+        uint32_t slot;
+        if (free_slots.empty()) slot = slots++;
+        else { slot = free_slots.top(); free_slots.pop(); }
+        iv->assigned = RegAllocResult::kSpilled | slot;
+        active.emplace(iv->end, slot);
+    }
+    return slots;
+}
+} // namespace tac_regalloc_detail
+
+// --- Live Intervals ---
+// One interval per temporary: from its first read or write to its last, widened to the start of every block
+// it is live into and the end of every block it is live out of. Intervals have no holes, so they are
+// conservative but never wrong, and they are all linear scan needs.
+inline std::vector<LiveInterval> computeLiveIntervals(const TacFunction& function, const ControlFlowGraph& cfg,
+                                                      const tac_regalloc_detail::TempLiveness& tl) {
+    std::vector<LiveInterval> intervals(tl.temps.size());
+    for (uint32_t t = 0; t < tl.temps.size(); ++t) { intervals[t].temp = tl.temps[t]; intervals[t].start = UINT32_MAX; }
+    auto cover = [&](uint32_t t, uint32_t pos) {
+        intervals[t].start = std::min(intervals[t].start, pos);
+        intervals[t].end = std::max(intervals[t].end, pos);
+    };
+    Operand used[2];
+    for (uint32_t b = 0; b < cfg.size(); ++b) {
+        const BasicBlock& bb = cfg.blocks[b];
+        for (uint32_t k = bb.begin; k < bb.end; ++k) {
+            for (int u = 0, c = usedOperands(function.code[k], used); u < c; ++u) {
+                if (used[u].isTemp()) { cover(tl.of(used[u]), 2 * k); intervals[tl.of(used[u])].uses++; }
+            }
+            Operand d = definedOperand(function.code[k]);
+            if (d.isTemp()) { cover(tl.of(d), 2 * k + 1); intervals[tl.of(d)].uses++; }
+        }
+        if (bb.begin == bb.end) continue;
+        for (uint32_t e = tl.in_offsets[b]; e < tl.in_offsets[b + 1]; ++e) cover(tl.live_in[e], 2 * bb.begin);
+        for (uint32_t e = tl.out_offsets[b]; e < tl.out_offsets[b + 1]; ++e) cover(tl.live_out[e], 2 * bb.end - 1);
+    }
+    return intervals;
+}
+
+// --- Linear Scan ---
+// Poletto & Sarkar: intervals in order of start, expiring those that ended; when every register is busy the
+// interval ending furthest away (the new one or an active one) is spilled.
+inline void linearScan(std::vector<LiveInterval>& intervals, uint32_t registers, RegAllocResult& result) {
+    std::vector<uint32_t> order(intervals.size());
+    for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return intervals[a].start < intervals[b].start; });
+    std::vector<uint32_t> active; // Sorted by end
+    std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<>> live_ends; // Every interval, spilled or not
+    std::vector<uint32_t> free_regs;
+    for (uint32_t r = registers; r-- > 0;) free_regs.push_back(r); // Lowest register on top
+    for (uint32_t i : order) {
+        LiveInterval& iv = intervals[i];
+        size_t expired = 0;
+        while (expired < active.size() && intervals[active[expired]].end < iv.start) free_regs.push_back(intervals[active[expired++]].assigned);
+        active.erase(active.begin(), active.begin() + static_cast<long>(expired));
+        std::sort(free_regs.begin(), free_regs.end(), std::greater<uint32_t>());
+        while (!live_ends.empty() && live_ends.top() < iv.start) live_ends.pop();
+        live_ends.push(iv.end);
+        result.max_pressure = std::max(result.max_pressure, static_cast<uint32_t>(live_ends.size()));
+        uint32_t chosen = i;
+        if (free_regs.empty()) {
+            uint32_t last = active.back();
+            if (intervals[last].end > iv.end) { // Steal the register of the interval that lives longest
+                iv.assigned = intervals[last].assigned;
+                active.pop_back();
+                chosen = last;
+                active.insert(std::upper_bound(active.begin(), active.end(), i, [&](uint32_t a, uint32_t b) { return intervals[a].end < intervals[b].end; }), i);
+            }
+            intervals[chosen].assigned = RegAllocResult::kSpilled;
+            continue;
+        }
+        iv.assigned = free_regs.back();
+        free_regs.pop_back();
+        result.registers_used = std::max(result.registers_used, iv.assigned + 1);
+        active.insert(std::upper_bound(active.begin(), active.end(), i, [&](uint32_t a, uint32_t b) { return intervals[a].end < intervals[b].end; }), i);
+    }
+}
+
+// --- Graph Coloring ---
+// Chaitin-Briggs without rewriting: interference comes from a backward scan of every block (a copy's destination
+// does not interfere with its source, so the two may share a register and the copy disappears). Nodes with
+// fewer neighbours than registers are simplified first; when none is left the cheapest node (uses per
+// neighbour) is pushed optimistically, and only nodes that find no free color on the way back are spilled.
+inline void graphColoring(const TacFunction& function, const ControlFlowGraph& cfg, const tac_regalloc_detail::TempLiveness& tl,
+                          std::vector<LiveInterval>& intervals, uint32_t registers, RegAllocResult& result) {
+    const uint32_t nt = static_cast<uint32_t>(intervals.size());
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    std::vector<uint8_t> live(nt, 0);
+    std::vector<uint32_t> live_list; // Superset of the live temps; compacted lazily
+    Operand used[2];
+    for (uint32_t b = 0; b < cfg.size(); ++b) {
+        for (uint32_t e = tl.out_offsets[b]; e < tl.out_offsets[b + 1]; ++e) { live[tl.live_out[e]] = 1; live_list.push_back(tl.live_out[e]); }
+        for (uint32_t k = cfg.blocks[b].end; k-- > cfg.blocks[b].begin;) {
+            const TacInstr& in = function.code[k];
+            Operand d = definedOperand(in);
+            if (d.isTemp()) {
+                uint32_t t = tl.of(d);
+                uint32_t source = in.op == TacOp::Copy && in.arg1.isTemp() ? tl.of(in.arg1) : UINT32_MAX;
+                size_t keep = 0, count = 0;
+                for (uint32_t l : live_list) {
+                    if (!live[l]) continue;
+                    live_list[keep++] = l;
+                    count++;
+                    if (l != t && l != source) { edges.emplace_back(t, l); edges.emplace_back(l, t); }
+                }
+                live_list.resize(keep);
+                result.max_pressure = std::max(result.max_pressure, static_cast<uint32_t>(count + (live[t] ? 0 : 1)));
+                live[t] = 0;
+            }
+            for (int u = 0, c = usedOperands(in, used); u < c; ++u) {
+                if (!used[u].isTemp() || live[tl.of(used[u])]) continue;
+                live[tl.of(used[u])] = 1;
+                live_list.push_back(tl.of(used[u]));
+            }
+        }
+        for (uint32_t l : live_list) live[l] = 0;
+        live_list.clear();
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    std::vector<uint32_t> adj_offsets, adj;
+    tac_cfg_detail::buildAdjacency(nt, edges, adj_offsets, adj);
+
+    // Simplify
+    std::vector<uint32_t> degree(nt), stack;
+    std::vector<uint8_t> removed(nt, 0);
+    std::vector<uint32_t> low;
+    using Candidate = std::pair<double, uint32_t>; // (spill cost, temp)
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<>> spill_candidates;
+    for (uint32_t t = 0; t < nt; ++t) {
+        degree[t] = adj_offsets[t + 1] - adj_offsets[t];
+        if (degree[t] < registers) low.push_back(t);
+        else spill_candidates.emplace(static_cast<double>(intervals[t].uses) / degree[t], t);
+    }
+    while (stack.size() < nt) {
+        uint32_t t;
+        if (!low.empty()) { t = low.back(); low.pop_back(); }
+        else { t = spill_candidates.top().second; spill_candidates.pop(); }
+        if (removed[t]) continue;
+        removed[t] = 1;
+        stack.push_back(t);
+        for (uint32_t e = adj_offsets[t]; e < adj_offsets[t + 1]; ++e) {
+            uint32_t n = adj[e];
+            if (!removed[n] && degree[n]-- == registers) low.push_back(n);
+        }
+    }
+
+    // Select
+    std::vector<uint8_t> colored(nt, 0), taken(registers, 0);
+    while (!stack.empty()) {
+        uint32_t t = stack.back(); stack.pop_back();
+        for (uint32_t e = adj_offsets[t]; e < adj_offsets[t + 1]; ++e) if (colored[adj[e]]) taken[intervals[adj[e]].assigned] = 1;
+        uint32_t color = 0;
+        while (color < registers && taken[color]) color++;
+        for (uint32_t e = adj_offsets[t]; e < adj_offsets[t + 1]; ++e) if (colored[adj[e]]) taken[intervals[adj[e]].assigned] = 0;
+        if (color == registers) { intervals[t].assigned = RegAllocResult::kSpilled; continue; }
+        intervals[t].assigned = color;
+        colored[t] = 1;
+        result.registers_used = std::max(result.registers_used, color + 1);
+    }
+}
+
+// --- Allocation ---
+// Allocates one function in place and returns what was decided (for the report)
+inline RegAllocResult allocateRegisters(TacFunction& function, const RegAllocOptions& options) {
+    using namespace tac_regalloc_detail;
+    RegAllocResult result;
+    ControlFlowGraph cfg = buildCFG(function);
+    TempLiveness tl = computeTempLiveness(function, cfg);
+    result.intervals = computeLiveIntervals(function, cfg, tl);
+    if (options.method == RegAllocMethod::LinearScan) linearScan(result.intervals, options.registers, result);
+    else graphColoring(function, cfg, tl, result.intervals, options.registers, result);
+
+    std::vector<LiveInterval*> spilled;
+    for (LiveInterval& iv : result.intervals) if (iv.assigned & RegAllocResult::kSpilled) spilled.push_back(&iv);
+    result.spilled = spilled.size();
+    result.spill_slots = assignSlots(spilled);
+
+    auto rename = [&](Operand& o) {
+        if (!o.isTemp()) return;
+        uint32_t a = result.intervals[tl.of(o)].assigned;
+        o = Operand::temp(a & RegAllocResult::kSpilled ? options.registers + (a & ~RegAllocResult::kSpilled) : a);
+    };
+    std::vector<TacInstr>& code = function.code;
+    size_t kept = 0;
+    for (TacInstr& in : code) {
+        rename(in.result); rename(in.arg1); rename(in.arg2);
+        if (in.op == TacOp::Copy && in.result == in.arg1) { result.copies_removed++; continue; }
+        code[kept++] = in;
+    }
+    code.resize(kept);
+    std::sort(result.intervals.begin(), result.intervals.end(), [](const LiveInterval& a, const LiveInterval& b) { return a.start < b.start; });
+    return result;
+}
+
+// --- Text dump (one line per temporary: interval, uses, decision) ---
+inline void appendRegAllocText(const TacProgram& prog, const TacFunction& function, const RegAllocResult& result,
+                               const RegAllocOptions& options, std::string& out) {
+    out += "func "; out += function.isTopLevel() ? std::string("<top-level>") : prog.symbols[function.name];
+    out += ": " + std::to_string(result.intervals.size()) + " temps, pressure " + std::to_string(result.max_pressure);
+    out += ", " + std::to_string(result.registers_used) + " register(s), " + std::to_string(result.spilled) + " spilled into ";
+    out += std::to_string(result.spill_slots) + " slot(s)\n";
+    for (const LiveInterval& iv : result.intervals) {
+        out += "  "; appendOperand(prog, iv.temp, out);
+        out += " [" + std::to_string(iv.start) + "," + std::to_string(iv.end) + "] uses " + std::to_string(iv.uses) + " -> ";
+        if (iv.assigned & RegAllocResult::kSpilled) {
+            uint32_t slot = iv.assigned & ~RegAllocResult::kSpilled;
+            out += "spill slot " + std::to_string(slot) + " (t" + std::to_string(options.registers + slot) + ")\n";
+        } else out += "r" + std::to_string(iv.assigned) + " (t" + std::to_string(iv.assigned) + ")\n";
+    }
+}
+
+#endif // TAC_REGALLOC_H
@@ -0,0 +1,492 @@
+// File: tac_ssa.h - SSA form over TacFunction: pruned phi placement and renaming, sparse def-use chains, destruction with coalescing
+#ifndef TAC_SSA_H
+#define TAC_SSA_H
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+#include "tac_ir.h"
+#include "tac_cfg.h"
+#include "tac_dataflow.h"
+
+// --- SSA Form ---
+// Renamed variables become Local operands, one id per SSA value; globals stay as plain symbols because calls
+// may change them. Every renamed variable also has an entry value (its id equals the variable's dense id)
+// standing for whatever the variable holds on function entry. Phis live in a side table grouped by block,
+// with one argument per CFG predecessor (None once an edge is known never to execute).
+struct PhiNode {
+    uint32_t block = 0;
+    uint32_t var = 0;        // Dense id of the original variable
+    Operand result;
+    uint32_t first_arg = 0;  // Index into SsaForm::phi_args
+    bool dead = false;
+};
+
+struct SsaForm {
+    static constexpr uint32_t kEntryDef = UINT32_MAX;
+    static constexpr uint32_t kPhiTag = 1u << 31;   // Definition/use site tag: phi index | kPhiTag
+
+    ControlFlowGraph cfg;
+    VariableIndex vars;                  // Original variables (dense ids)
+    std::vector<uint8_t> renamed;        // Per variable: 1 if it was put into SSA form
+    std::vector<PhiNode> phis;           // Grouped by block
+    std::vector<uint32_t> phi_offsets;   // Phis of block b: phis[phi_offsets[b] .. phi_offsets[b+1])
+    std::vector<Operand> phi_args;
+    std::vector<uint32_t> value_var;     // SSA value -> original variable
+    std::vector<uint32_t> value_def;     // SSA value -> defining instruction, phi | kPhiTag, or kEntryDef
+    std::vector<uint32_t> use_offsets, uses; // Def-use chains (see buildUses)
+
+    uint32_t valueCount() const { return static_cast<uint32_t>(value_var.size()); }
+    uint32_t newValue(uint32_t var, uint32_t def) {
+        value_var.push_back(var);
+        value_def.push_back(def);
+        return valueCount() - 1;
+    }
+    Operand* phiArgs(uint32_t phi) { return phi_args.data() + phis[phi].first_arg; }
+    const Operand* phiArgs(uint32_t phi) const { return phi_args.data() + phis[phi].first_arg; }
+    uint32_t phiArgCount(uint32_t phi) const { return static_cast<uint32_t>(cfg.predecessors(phis[phi].block).size()); }
+    Operand originalOf(uint32_t value) const { return vars.vars[value_var[value]]; }
+
+    // Sparse def-use chains: the sites that read value v are uses[use_offsets[v] .. use_offsets[v+1]),
+    // each an instruction index or phi | kPhiTag. Rebuild after a pass rewrites operands.
+    void buildUses(const TacFunction& function) {
+        const uint32_t nv = valueCount();
+        std::vector<std::pair<uint32_t, uint32_t>> pairs; // (value, site)
+        for (uint32_t k = 0; k < function.code.size(); ++k) {
+            const TacInstr& in = function.code[k];
+            if (in.arg1.isLocal()) pairs.emplace_back(in.arg1.id(), k);
+            if (in.arg2.isLocal() && in.arg2 != in.arg1) pairs.emplace_back(in.arg2.id(), k);
+        }
+        for (uint32_t p = 0; p < phis.size(); ++p) {
+            if (phis[p].dead) continue;
+            for (uint32_t a = 0, n = phiArgCount(p); a < n; ++a)
+                if (phiArgs(p)[a].isLocal()) pairs.emplace_back(phiArgs(p)[a].id(), p | kPhiTag);
+        }
+        tac_cfg_detail::buildAdjacency(nv, pairs, use_offsets, uses);
+    }
+    ControlFlowGraph::Range usesOf(uint32_t value) const { return { uses.data() + use_offsets[value], uses.data() + use_offsets[value + 1] }; }
+};
+
+// --- Construction ---
+// Cytron et al. with pruning: a phi for v is placed on the iterated dominance frontier of v's definitions only
+// where v is live on entry, and only "global names" (variables live across some block boundary) need phis at all.
+// Renaming walks the dominator tree with one stack of current values per variable.
+inline SsaForm constructSSA(const TacProgram& prog, TacFunction& function) {
+    SsaForm ssa;
+    std::vector<TacInstr>& code = function.code;
+    ssa.cfg = buildCFG(function);
+    const ControlFlowGraph& cfg = ssa.cfg;
+    ssa.vars = VariableIndex::build(function);
+    const uint32_t nv = ssa.vars.size();
+    ssa.renamed.assign(nv, 0);
+    for (uint32_t v = 0; v < nv; ++v) ssa.renamed[v] = !prog.isGlobal(ssa.vars.vars[v]);
+    for (uint32_t v = 0; v < nv; ++v) ssa.newValue(v, SsaForm::kEntryDef);
+
+    // Phi placement
+    LivenessInfo live = computeLiveness(prog, function, cfg);
+    std::vector<uint32_t> df_offsets, df;
+    computeDominanceFrontiers(cfg, df_offsets, df);
+    std::vector<std::vector<uint32_t>> def_blocks(live.vars.size());
+    for (uint32_t b = 0; b < cfg.size(); ++b) {
+        if (!cfg.reachable(b)) continue;
+        for (uint32_t k = cfg.blocks[b].begin; k < cfg.blocks[b].end; ++k) {
+            Operand d = definedOperand(code[k]);
+            uint32_t lv = isVariable(d) ? live.vars.of(d) : VariableIndex::kNone;
+            if (lv != VariableIndex::kNone && (def_blocks[lv].empty() || def_blocks[lv].back() != b)) def_blocks[lv].push_back(b);
+        }
+    }
+    std::vector<std::pair<uint32_t, uint32_t>> placed; // (block, variable)
+    std::vector<uint32_t> has_phi(cfg.size(), VariableIndex::kNone), queued(cfg.size(), VariableIndex::kNone);
+    std::vector<uint32_t> work;
+    for (uint32_t lv = 0; lv < live.vars.size(); ++lv) {
+        uint32_t v = ssa.vars.of(live.vars.vars[lv]);
+        if (!ssa.renamed[v] || def_blocks[lv].empty()) continue;
+        work = def_blocks[lv];
+        for (uint32_t b : work) queued[b] = lv;
+        while (!work.empty()) {
+            uint32_t b = work.back(); work.pop_back();
+            for (uint32_t e = df_offsets[b]; e < df_offsets[b + 1]; ++e) {
+                uint32_t f = df[e];
+                if (has_phi[f] == lv || !live.result.in[f].test(lv)) continue;
+                has_phi[f] = lv;
+                placed.emplace_back(f, v);
+                if (queued[f] != lv) { queued[f] = lv; work.push_back(f); }
+            }
+        }
+    }
+    std::sort(placed.begin(), placed.end());
+    ssa.phi_offsets.assign(cfg.size() + 1, 0);
+    for (const auto& bv : placed) {
+        PhiNode phi;
+        phi.block = bv.first;
+        phi.var = bv.second;
+        phi.first_arg = static_cast<uint32_t>(ssa.phi_args.size());
+        ssa.phi_args.resize(ssa.phi_args.size() + cfg.predecessors(bv.first).size());
+        ssa.phis.push_back(phi);
+        ssa.phi_offsets[bv.first + 1]++;
+    }
+    for (uint32_t b = 0; b < cfg.size(); ++b) ssa.phi_offsets[b + 1] += ssa.phi_offsets[b];
+
+    // Renaming (iterative pre/post-order walk of the dominator tree)
+    std::vector<uint32_t> current(nv);
+    std::iota(current.begin(), current.end(), 0u);
+    std::vector<std::pair<uint32_t, uint32_t>> undo; // (variable, previous value)
+    std::vector<std::pair<uint32_t, uint32_t>> stack{{0u, 0u}}; // (block, undo mark | 1<<31 once entered)
+    auto define = [&](uint32_t v, uint32_t def) {
+        uint32_t value = ssa.newValue(v, def);
+        undo.emplace_back(v, current[v]);
+        current[v] = value;
+        return Operand::local(value);
+    };
+    while (!stack.empty()) {
+        uint32_t b = stack.back().first;
+        if (stack.back().second & SsaForm::kPhiTag) { // Leaving b: restore the values live before it
+            uint32_t mark = stack.back().second & ~SsaForm::kPhiTag;
+            while (undo.size() > mark) { current[undo.back().first] = undo.back().second; undo.pop_back(); }
+            stack.pop_back();
+            continue;
+        }
+        stack.back().second = static_cast<uint32_t>(undo.size()) | SsaForm::kPhiTag;
+        for (uint32_t p = ssa.phi_offsets[b]; p < ssa.phi_offsets[b + 1]; ++p) ssa.phis[p].result = define(ssa.phis[p].var, p | SsaForm::kPhiTag);
+        for (uint32_t k = cfg.blocks[b].begin; k < cfg.blocks[b].end; ++k) {
+            TacInstr& in = code[k];
+            for (int s = 0; s < 2; ++s) {
+                Operand& o = argSlot(in, s);
+                if (!readsArg(in, s) || !isVariable(o)) continue;
+                uint32_t v = ssa.vars.of(o);
+                if (ssa.renamed[v]) o = Operand::local(current[v]);
+            }
+            Operand d = definedOperand(in);
+            if (!isVariable(d)) continue;
+            uint32_t v = ssa.vars.of(d);
+            if (!ssa.renamed[v]) continue;
+            Operand value = define(v, k);
+            if (in.op == TacOp::Read) in.arg1 = value; else in.result = value;
+        }
+        for (uint32_t s : cfg.successors(b)) {
+            auto preds = cfg.predecessors(s);
+            uint32_t slot = static_cast<uint32_t>(std::find(preds.begin(), preds.end(), b) - preds.begin());
+            for (uint32_t p = ssa.phi_offsets[s]; p < ssa.phi_offsets[s + 1]; ++p) ssa.phiArgs(p)[slot] = Operand::local(current[ssa.phis[p].var]);
+        }
+        for (uint32_t c : cfg.domChildren(b)) stack.emplace_back(c, 0u);
+    }
+    ssa.buildUses(function);
+    return ssa;
+}
+
+// --- Destruction ---
+// 1. Sreedhar's method I: each phi x = phi(a1..an) gets a fresh web value w; "w = ai" joins a parallel copy
+//    at the end of predecessor i (before its branch) and "x = w" a parallel copy at the top of the block.
+//    Copies into fresh names never clobber anything, so the phi-free code is correct before any coalescing.
+// 2. Interference is collected only between values that might share a name (same original variable, or tied
+//    by a copy); a copy's destination does not interfere with its source (Chaitin).
+// 3. Coalescing merges phi webs, then copies, then versions of one variable, whenever the classes do not
+//    interfere. Each class is named after an original variable when that name is free, otherwise a fresh Local.
+// 4. Parallel copies are sequentialised, breaking cycles with one extra Local.
+namespace tac_ssa_detail {
+struct CopyGroup { uint32_t begin, end; }; // Range of copies in the converted code
+
+// Emits the parallel copy dests[k] = srcs[k] (k = 0..n-1) as sequential copies. cycle_temp makes a fresh Local.
+template <typename F>
+inline void sequentialiseCopies(std::vector<std::pair<Operand, Operand>> copies, std::vector<TacInstr>& out, F&& cycle_temp) {
+    copies.erase(std::remove_if(copies.begin(), copies.end(), [](const std::pair<Operand, Operand>& c) { return c.first == c.second; }), copies.end());
+    while (!copies.empty()) {
+        bool progressed = false;
+        for (size_t k = 0; k < copies.size(); ++k) {
+            Operand dest = copies[k].first;
+            bool dest_is_read = false;
+            for (size_t j = 0; j < copies.size(); ++j) if (j != k && copies[j].second == dest) { dest_is_read = true; break; }
+            if (dest_is_read) continue;
+            out.emplace_back(TacOp::Copy, dest, copies[k].second);
+            copies.erase(copies.begin() + static_cast<long>(k));
+            progressed = true;
+            break;
+        }
+        if (progressed) continue;
+        // Every destination is still read by another copy: a cycle. Save one destination and redirect its readers.
+        Operand saved = copies[0].first, temp = cycle_temp();
+        out.emplace_back(TacOp::Copy, temp, saved);
+        for (auto& c : copies) if (c.second == saved) c.second = temp;
+    }
+}
+// Liveness of Local values by path exploration: from every upward-exposed use walk predecessors backwards
+// until a block that defines the value. Interference only matters inside an affinity group (group[v] is the
+// group of value v), so a live-out value is recorded only in blocks where its group has a definition; the
+// walk costs the size of the live ranges and the result stays small even when hundreds of values are live
+// across every block. Live-out Locals of block b are live_out[out_offsets[b] .. out_offsets[b+1]);
+// live_in0 lists the Locals live on entry.
+inline void localLiveness(const std::vector<TacInstr>& code, const ControlFlowGraph& cfg, const std::vector<uint32_t>& group,
+                          std::vector<uint32_t>& out_offsets, std::vector<uint32_t>& live_out, std::vector<uint32_t>& live_in0) {
+    constexpr uint32_t kNone = ControlFlowGraph::kNone;
+    const uint32_t nvalues = static_cast<uint32_t>(group.size());
+    std::vector<std::pair<uint32_t, uint32_t>> exposed, defs, group_def_blocks; // (value, block), (group, block)
+    std::vector<uint32_t> defined_in(nvalues, kNone);
+    Operand used[2];
+    for (uint32_t b = 0; b < cfg.size(); ++b) {
+        if (!cfg.reachable(b)) continue;
+        for (uint32_t k = cfg.blocks[b].begin; k < cfg.blocks[b].end; ++k) {
+            for (int u = 0, c = usedOperands(code[k], used); u < c; ++u)
+                if (used[u].isLocal() && defined_in[used[u].id()] != b) exposed.emplace_back(used[u].id(), b);
+            Operand d = definedOperand(code[k]);
+            if (d.isLocal()) { defined_in[d.id()] = b; defs.emplace_back(d.id(), b); group_def_blocks.emplace_back(group[d.id()], b); }
+        }
+    }
+    std::vector<std::pair<uint32_t, uint32_t>> by_group(nvalues); // (group, value)
+    for (uint32_t v = 0; v < nvalues; ++v) by_group[v] = {group[v], v};
+    std::vector<uint32_t> exposed_offsets, exposed_blocks, def_offsets, def_blocks, gdef_offsets, gdef_blocks, member_offsets, members;
+    tac_cfg_detail::buildAdjacency(nvalues, exposed, exposed_offsets, exposed_blocks);
+    tac_cfg_detail::buildAdjacency(nvalues, defs, def_offsets, def_blocks);
+    tac_cfg_detail::buildAdjacency(nvalues, group_def_blocks, gdef_offsets, gdef_blocks);
+    tac_cfg_detail::buildAdjacency(nvalues, by_group, member_offsets, members);
+    std::vector<uint32_t> group_defs(cfg.size(), kNone), value_defs(cfg.size(), kNone), in_mark(cfg.size(), kNone), out_mark(cfg.size(), kNone), work;
+    std::vector<std::pair<uint32_t, uint32_t>> out_pairs; // (block, value)
+    for (uint32_t g = 0; g < nvalues; ++g) {
+        for (uint32_t e = gdef_offsets[g]; e < gdef_offsets[g + 1]; ++e) group_defs[gdef_blocks[e]] = g;
+        for (uint32_t m = member_offsets[g]; m < member_offsets[g + 1]; ++m) {
+            const uint32_t v = members[m];
+            for (uint32_t e = def_offsets[v]; e < def_offsets[v + 1]; ++e) value_defs[def_blocks[e]] = v;
+            for (uint32_t e = exposed_offsets[v]; e < exposed_offsets[v + 1]; ++e) {
+                if (in_mark[exposed_blocks[e]] != v) { in_mark[exposed_blocks[e]] = v; work.push_back(exposed_blocks[e]); }
+            }
+            while (!work.empty()) {
+                uint32_t b = work.back(); work.pop_back();
+                if (b == 0) live_in0.push_back(v);
+                for (uint32_t p : cfg.predecessors(b)) {
+                    if (!cfg.reachable(p) || out_mark[p] == v) continue;
+                    out_mark[p] = v;
+                    if (group_defs[p] == g) out_pairs.emplace_back(p, v);
+                    if (value_defs[p] != v && in_mark[p] != v) { in_mark[p] = v; work.push_back(p); }
+                }
+            }
+        }
+    }
+    tac_cfg_detail::buildAdjacency(cfg.size(), out_pairs, out_offsets, live_out);
+}
+} // namespace tac_ssa_detail
+
+inline void destructSSA(const TacProgram&, TacFunction& function, SsaForm& ssa) {
+    using namespace tac_ssa_detail;
+    const ControlFlowGraph& cfg = ssa.cfg;
+    const std::vector<TacInstr>& code = function.code;
+
+    // 1. Phi-free code with copy groups
+    std::vector<std::vector<std::pair<Operand, Operand>>> top_copies(cfg.size()), end_copies(cfg.size());
+    for (uint32_t p = 0; p < ssa.phis.size(); ++p) {
+        const PhiNode& phi = ssa.phis[p];
+        if (phi.dead || !cfg.reachable(phi.block)) continue;
+        Operand web = Operand::local(ssa.newValue(phi.var, p | SsaForm::kPhiTag));
+        top_copies[phi.block].emplace_back(phi.result, web);
+        auto preds = cfg.predecessors(phi.block);
+        for (uint32_t a = 0; a < preds.size(); ++a) {
+            Operand arg = ssa.phiArgs(p)[a];
+            if (!arg.isNone() && cfg.reachable(preds.begin()[a])) end_copies[preds.begin()[a]].emplace_back(web, arg);
+        }
+    }
+    std::vector<TacInstr> out;
+    out.reserve(code.size() + ssa.phis.size() * 3);
+    std::vector<CopyGroup> groups;
+    auto emitGroup = [&](const std::vector<std::pair<Operand, Operand>>& copies) {
+        if (copies.empty()) return;
+        uint32_t begin = static_cast<uint32_t>(out.size());
+        for (const auto& c : copies) out.emplace_back(TacOp::Copy, c.first, c.second);
+        groups.push_back({begin, static_cast<uint32_t>(out.size())});
+    };
+    for (uint32_t b = 0; b < cfg.size(); ++b) {
+        uint32_t k = cfg.blocks[b].begin, end = cfg.blocks[b].end;
+        if (!cfg.reachable(b)) { // Never runs; keep it only as far as labels and text go
+            for (; k < end; ++k) if (code[k].op == TacOp::Label || code[k].op == TacOp::Comment) out.push_back(code[k]);
+            continue;
+        }
+        while (k < end && code[k].op == TacOp::Label) out.push_back(code[k++]);
+        emitGroup(top_copies[b]);
+        uint32_t body_end = end;
+        while (body_end > k && code[body_end - 1].op == TacOp::Nop) body_end--;
+        bool has_terminator = body_end > k && (isBranch(code[body_end - 1].op) || endsControlFlow(code[body_end - 1].op));
+        for (uint32_t j = k; j < body_end - (has_terminator ? 1 : 0); ++j) if (code[j].op != TacOp::Nop) out.push_back(code[j]);
+        emitGroup(end_copies[b]);
+        if (has_terminator) out.push_back(code[body_end - 1]);
+    }
+
+    // 2. Interference between values that might be coalesced
+    const uint32_t nvalues = ssa.valueCount();
+    std::vector<uint32_t> affinity(nvalues); // Union-find over candidate pairs
+    std::iota(affinity.begin(), affinity.end(), 0u);
+    auto findRoot = [](std::vector<uint32_t>& uf, uint32_t x) { while (uf[x] != x) { uf[x] = uf[uf[x]]; x = uf[x]; } return x; };
+    std::vector<uint32_t> first_of_var(ssa.vars.size(), VariableIndex::kNone);
+    for (uint32_t v = 0; v < nvalues; ++v) {
+        uint32_t var = ssa.value_var[v];
+        if (first_of_var[var] == VariableIndex::kNone) first_of_var[var] = v;
+        else affinity[findRoot(affinity, v)] = findRoot(affinity, first_of_var[var]);
+    }
+    std::vector<std::pair<uint32_t, uint32_t>> copy_pairs; // (dest, src) Local copies, in the order they get coalesced
+    for (const CopyGroup& g : groups)
+        for (uint32_t k = g.begin; k < g.end; ++k) if (out[k].arg1.isLocal()) copy_pairs.emplace_back(out[k].result.id(), out[k].arg1.id());
+    for (const TacInstr& in : out)
+        if (in.op == TacOp::Copy && in.result.isLocal() && in.arg1.isLocal()) copy_pairs.emplace_back(in.result.id(), in.arg1.id());
+    for (const auto& c : copy_pairs) affinity[findRoot(affinity, c.first)] = findRoot(affinity, c.second);
+    for (uint32_t v = 0; v < nvalues; ++v) affinity[v] = findRoot(affinity, v);
+
+    std::vector<std::vector<uint32_t>> interferes(nvalues);
+    std::vector<uint8_t> entry_live(ssa.vars.size(), 0); // Entry values the function actually reads
+    {
+        ControlFlowGraph ccfg = buildCFG(out, function.jump_tables);
+        std::vector<uint32_t> out_offsets, live_out, live_in0;
+        localLiveness(out, ccfg, affinity, out_offsets, live_out, live_in0);
+        // Live Locals, bucketed by affinity group so a definition only meets its own group
+        std::vector<uint8_t> is_live(nvalues, 0);
+        std::vector<uint32_t> touched;
+        std::vector<std::vector<uint32_t>> live_in_group(nvalues);
+        std::vector<uint32_t> slot_in_group(nvalues, 0);
+        auto setLive = [&](uint32_t v) {
+            if (is_live[v]) return;
+            is_live[v] = 1;
+            touched.push_back(v);
+            auto& bucket = live_in_group[affinity[v]];
+            slot_in_group[v] = static_cast<uint32_t>(bucket.size());
+            bucket.push_back(v);
+        };
+        auto setDead = [&](uint32_t v) {
+            if (!is_live[v]) return;
+            is_live[v] = 0;
+            auto& bucket = live_in_group[affinity[v]];
+            uint32_t last = bucket.back();
+            bucket[slot_in_group[v]] = last;
+            slot_in_group[last] = slot_in_group[v];
+            bucket.pop_back();
+        };
+        auto defineAt = [&](uint32_t d, Operand copy_src) {
+            for (uint32_t l : live_in_group[affinity[d]]) {
+                if (l == d || (copy_src.isLocal() && copy_src.id() == l)) continue;
+                interferes[d].push_back(l);
+                interferes[l].push_back(d);
+            }
+        };
+        std::vector<uint32_t> group_at(out.size(), UINT32_MAX);
+        for (uint32_t g = 0; g < groups.size(); ++g) for (uint32_t k = groups[g].begin; k < groups[g].end; ++k) group_at[k] = g;
+        Operand used[2];
+        for (uint32_t b = 0; b < ccfg.size(); ++b) {
+            if (!ccfg.reachable(b)) continue;
+            for (uint32_t e = out_offsets[b]; e < out_offsets[b + 1]; ++e) setLive(live_out[e]);
+            for (uint32_t k = ccfg.blocks[b].end; k-- > ccfg.blocks[b].begin;) {
+                const TacInstr& in = out[k];
+                if (group_at[k] != UINT32_MAX) { // A parallel copy: all destinations are written at once, then all sources read
+                    const CopyGroup& g = groups[group_at[k]];
+                    for (uint32_t j = g.begin; j < g.end; ++j) defineAt(out[j].result.id(), out[j].arg1);
+                    for (uint32_t j = g.begin; j < g.end; ++j) setDead(out[j].result.id());
+                    for (uint32_t j = g.begin; j < g.end; ++j) if (out[j].arg1.isLocal()) setLive(out[j].arg1.id());
+                    k = g.begin;
+                    continue;
+                }
+                Operand d = definedOperand(in);
+                if (d.isLocal()) { defineAt(d.id(), in.op == TacOp::Copy ? in.arg1 : Operand()); setDead(d.id()); }
+                for (int u = 0, c = usedOperands(in, used); u < c; ++u) if (used[u].isLocal()) setLive(used[u].id());
+            }
+            for (uint32_t v : touched) setDead(v);
+            touched.clear();
+        }
+        // Entry values are all defined together at the top of the function (block 0 never has predecessors)
+        for (uint32_t v : live_in0) { setLive(v); if (v < ssa.vars.size()) entry_live[v] = 1; }
+        for (uint32_t v = 0; v < ssa.vars.size(); ++v) if (ssa.renamed[v]) defineAt(v, Operand());
+    }
+
+    // 3. Coalescing
+    std::vector<uint32_t> cls(nvalues);
+    std::iota(cls.begin(), cls.end(), 0u);
+    std::vector<std::vector<uint32_t>> members(nvalues);
+    for (uint32_t v = 0; v < nvalues; ++v) members[v].push_back(v);
+    auto tryMerge = [&](uint32_t a, uint32_t b) {
+        a = findRoot(cls, a); b = findRoot(cls, b);
+        if (a == b) return;
+        if (members[a].size() < members[b].size()) std::swap(a, b);
+        for (uint32_t m : members[b])
+            for (uint32_t n : interferes[m]) if (findRoot(cls, n) == a) return;
+        cls[b] = a;
+        members[a].insert(members[a].end(), members[b].begin(), members[b].end());
+        members[b].clear();
+        members[b].shrink_to_fit();
+    };
+    for (const auto& c : copy_pairs) tryMerge(c.first, c.second);
+    for (uint32_t v = 0; v < nvalues; ++v) tryMerge(v, first_of_var[ssa.value_var[v]]);
+
+    // Names: classes holding a live entry value keep that variable; then symbols before temps claim free names;
+    // the rest get fresh Locals
+    std::vector<Operand> name(nvalues);
+    std::vector<uint8_t> name_taken(ssa.vars.size(), 0);
+    uint32_t next_local = nvalues;
+    std::vector<uint32_t> roots;
+    for (uint32_t v = 0; v < nvalues; ++v) if (findRoot(cls, v) == v) roots.push_back(v);
+    auto classVar = [&](uint32_t root, bool want_symbol) {
+        for (uint32_t m : members[root]) {
+            uint32_t var = ssa.value_var[m];
+            if (!name_taken[var] && ssa.vars.vars[var].isSymbol() == want_symbol) return var;
+        }
+        return VariableIndex::kNone;
+    };
+    for (uint32_t v = 0; v < ssa.vars.size(); ++v) {
+        uint32_t root = findRoot(cls, v);
+        if (!entry_live[v]) continue;
+        name[root] = ssa.vars.vars[v];
+        name_taken[v] = 1;
+    }
+    for (int pass = 0; pass < 2; ++pass) {
+        for (uint32_t root : roots) {
+            if (!name[root].isNone()) continue;
+            uint32_t var = classVar(root, pass == 0);
+            if (var == VariableIndex::kNone) continue;
+            name[root] = ssa.vars.vars[var];
+            name_taken[var] = 1;
+        }
+    }
+    for (uint32_t root : roots) if (name[root].isNone()) name[root] = Operand::local(next_local++);
+    auto rename = [&](Operand o) { return o.isLocal() && o.id() < nvalues ? name[findRoot(cls, o.id())] : o; };
+
+    // 4. Final code: rename, sequentialise copy groups, drop self-copies
+    std::vector<TacInstr> final_code;
+    final_code.reserve(out.size());
+    size_t next_group = 0;
+    for (uint32_t k = 0; k < out.size(); ++k) {
+        if (next_group < groups.size() && groups[next_group].begin == k) {
+            std::vector<std::pair<Operand, Operand>> copies;
+            for (uint32_t j = groups[next_group].begin; j < groups[next_group].end; ++j) copies.emplace_back(rename(out[j].result), rename(out[j].arg1));
+            sequentialiseCopies(copies, final_code, [&] { return Operand::local(next_local++); });
+            k = groups[next_group++].end - 1;
+            continue;
+        }
+        TacInstr in = out[k];
+        in.result = rename(in.result);
+        in.arg1 = rename(in.arg1);
+        in.arg2 = rename(in.arg2);
+        if (in.op == TacOp::Copy && in.result == in.arg1) continue;
+        final_code.push_back(in);
+    }
+    function.code.swap(final_code);
+}
+
+// --- Text dump (per block: phis, then the renamed code; %N is SSA value N) ---
+inline void appendSsaText(const TacProgram& prog, const TacFunction& function, const SsaForm& ssa, std::string& out) {
+    size_t live_phis = static_cast<size_t>(std::count_if(ssa.phis.begin(), ssa.phis.end(), [](const PhiNode& phi) { return !phi.dead; }));
+    out += "func "; out += function.isTopLevel() ? std::string("<top-level>") : prog.symbols[function.name];
+    out += ": " + std::to_string(ssa.valueCount()) + " values (" + std::to_string(ssa.vars.size()) + " entry), ";
+    out += std::to_string(live_phis) + " phis\n";
+    for (uint32_t b = 0; b < ssa.cfg.size(); ++b) {
+        out += "  B" + std::to_string(b) + (ssa.cfg.reachable(b) ? "\n" : " (unreachable)\n");
+        for (uint32_t p = ssa.phi_offsets[b]; p < ssa.phi_offsets[b + 1]; ++p) {
+            if (ssa.phis[p].dead) continue;
+            auto preds = ssa.cfg.predecessors(b);
+            out += "    "; appendOperand(prog, ssa.phis[p].result, out); out += " = phi(";
+            for (uint32_t a = 0; a < preds.size(); ++a) {
+                if (a) out += ", ";
+                if (ssa.phiArgs(p)[a].isNone()) out += '-'; else appendOperand(prog, ssa.phiArgs(p)[a], out);
+                out += " B" + std::to_string(preds.begin()[a]);
+            }
+            out += ")  ; "; appendOperand(prog, ssa.vars.vars[ssa.phis[p].var], out); out += '\n';
+        }
+        for (uint32_t k = ssa.cfg.blocks[b].begin; k < ssa.cfg.blocks[b].end; ++k) {
+            if (function.code[k].op == TacOp::Nop) continue;
+            out += "    "; appendInstr(prog, function.code[k], out, &function.jump_tables); out += '\n';
+        }
+    }
+}
+
+#endif // TAC_SSA_H
@@ -0,0 +1,114 @@
+// File: tac_vm.cpp - Runs generated 3AC on a bytecode VM (for checking results and measuring passes)
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <iomanip>
+#include "tac_ir.h"
+#include "tac_vm.h"
+
+// --- Function to read 3AC instructions (same format as dag_builder) ---
+std::vector<std::string> read3AC(const std::string& filename) {
+    std::vector<std::string> code;
+    std::ifstream infile(filename);
+    std::string line;
+    const std::string whitespace = " \t\n\r\f\v";
+    while (std::getline(infile, line)) {
+        if (line.empty() || line[0] == '#') continue; // Skip comments/empty
+        size_t first = line.find_first_not_of(whitespace);
+        if (first == std::string::npos) continue;
+        size_t last = line.find_last_not_of(whitespace);
+        code.push_back(line.substr(first, last - first + 1));
+    }
+    return code;
+}
+
+// --- Main Function ---
+// Program output goes to stdout exactly as the compiled C++ program would print it; everything the VM reports
+// goes to stderr, so the two can be diffed directly.
+int main(int argc, char* argv[]) {
+    std::string tac_file, input_file;
+    int bench_runs = 0;
+    bool profile = false, stats_wanted = false;
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        if (arg == "--bench" && a + 1 < argc) {
+            if (!parseCount(argv[++a], bench_runs) || bench_runs < 0) { tac_file.clear(); break; }
+            bench_runs = std::max(1, bench_runs);
+        }
+        else if (arg == "--profile") profile = true;
+        else if (arg == "--stats") stats_wanted = true;
+        else if (arg == "--input" && a + 1 < argc) input_file = argv[++a];
+        else if (tac_file.empty()) tac_file = arg;
+        else { tac_file.clear(); break; }
+    }
+    if (tac_file.empty()) {
+        std::cerr << "Usage: tac_vm <3ac_file> [--input FILE] [--stats] [--profile] [--bench N]\n"
+                     "  Reads the program's input from stdin unless --input is given.\n";
+        return 1;
+    }
+
+    std::vector<std::string> lines = read3AC(tac_file);
+    if (lines.empty() && !std::ifstream(tac_file)) { std::cerr << "VM: Cannot open 3AC file " << tac_file << "\n"; return 1; }
+    TacProgram program = parseTacText(lines);
+    VmProgram vm;
+    std::string error;
+    auto compile_start = std::chrono::steady_clock::now();
+    if (!compileVmProgram(program, vm, error)) { std::cerr << "VM: " << error << "\n"; return 1; }
+    double compile_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - compile_start).count();
+    if (vm.skipped_lines) std::cerr << "VM: Warning: " << vm.skipped_lines << " line(s) of 3AC are not instructions and were skipped\n";
+
+    std::string input;
+    if (!input_file.empty()) {
+        std::ifstream in(input_file, std::ios::binary);
+        if (!in) { std::cerr << "VM: Cannot open input file " << input_file << "\n"; return 1; }
+        std::ostringstream ss; ss << in.rdbuf(); input = ss.str();
+    } else {
+        std::ostringstream ss; ss << std::cin.rdbuf(); input = ss.str();
+    }
+
+    // One run for the output (and the profile), then the timed benchmark runs on the same input
+    std::string output;
+    VmStats stats;
+    auto run_start = std::chrono::steady_clock::now();
+    VmResult result = runVm(vm, input, output, stats, profile);
+    double run_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - run_start).count();
+    std::cout << output << std::flush;
+    if (!result.error.empty()) std::cerr << "VM: Runtime error: " << result.error << "\n";
+
+    if (stats_wanted || bench_runs) {
+        std::cerr << "VM: Compiled " << program.functions.size() << " function(s) into " << vm.code.size() << " instructions in "
+                  << compile_ms << " ms\n";
+        std::cerr << "VM: Executed " << stats.instructions << " instructions, " << stats.calls << " call(s), max depth "
+                  << stats.max_depth << ", exit code " << result.exit_code << ", " << run_ms << " ms\n";
+    }
+    if (profile) {
+        std::cerr << "VM: Dynamic instruction mix:\n";
+        for (size_t op = 0; op < stats.op_counts.size(); ++op) {
+            if (!stats.op_counts[op]) continue;
+            std::ostringstream share;
+            share << std::fixed << std::setprecision(1) << 100.0 * stats.op_counts[op] / stats.instructions;
+            std::cerr << "  " << std::left << std::setw(9) << vmOpName(static_cast<VmOp>(op)) << std::right << std::setw(14) << stats.op_counts[op]
+                      << std::setw(7) << share.str() << "%\n";
+        }
+    }
+    if (bench_runs) {
+        double best_ms = 0, total_ms = 0;
+        uint64_t per_run = 0;
+        for (int r = 0; r < bench_runs; ++r) {
+            std::string sink;
+            VmStats run_stats;
+            auto start = std::chrono::steady_clock::now();
+            runVm(vm, input, sink, run_stats);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            best_ms = r == 0 ? ms : std::min(best_ms, ms);
+            total_ms += ms;
+            per_run = run_stats.instructions;
+        }
+        std::cerr << "VM: Benchmark: " << bench_runs << " run(s), " << per_run << " instructions per run, best " << best_ms << " ms, mean "
+                  << total_ms / bench_runs << " ms, " << (best_ms > 0 ? per_run / best_ms / 1000.0 : 0.0) << " M instructions/s\n";
+    }
+    return result.error.empty() ? result.exit_code : 1;
+}
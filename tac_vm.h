@@ -0,0 +1,436 @@
+// File: tac_vm.h - Compact bytecode for 3AC and a threaded-dispatch interpreter (call stack, read/write on buffers)
+#ifndef TAC_VM_H
+#define TAC_VM_H
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "tac_ir.h"
+
+// Computed goto where the compiler has it (GCC, Clang), a plain switch everywhere else
+#if defined(__GNUC__) || defined(__clang__)
+#define TAC_VM_THREADED 1
+#else
+#define TAC_VM_THREADED 0
+#endif
+
+// --- Bytecode ---
+// Fixed 16-byte instructions. A value operand is an encoded slot address, (index << 1) | frame_relative, so
+// one load serves globals and constants (absolute) as well as locals and temps (relative to the frame pointer)
+// without branching. Values are 32-bit ints with the wrap-around of the C++ programs being compiled.
+enum class VmOp : uint8_t {
+    Mov,
+    Add, Sub, Mul, Div, Mod, Lt, Le, Gt, Ge, Eq, Ne, LogAnd, LogOr, BitAnd, BitOr, BitXor, Shl, Shr, // Same order as TacOp
+    Neg, Not, BitNot,
+    Jmp, Jz, Jnz, JmpTable, Param, Call, Ret, RetVoid, Read, Write, WriteChar, WriteStr, Trap, Halt,
+    Count
+};
+
+inline const char* vmOpName(VmOp op) {
+    static const char* const names[] = {
+        "mov", "add", "sub", "mul", "div", "mod", "lt", "le", "gt", "ge", "eq", "ne", "land", "lor", "and", "or", "xor",
+        "shl", "shr", "neg", "not", "bitnot", "jmp", "jz", "jnz", "jmptable", "param", "call", "ret", "retvoid", "read", "write",
+        "writechar", "writestr", "trap", "halt"};
+    static_assert(sizeof(names) / sizeof(names[0]) == static_cast<size_t>(VmOp::Count), "one name per VmOp");
+    return names[static_cast<uint8_t>(op)];
+}
+
+struct VmInstr {
+    VmOp op = VmOp::Halt;
+    int32_t a = 0;  // Destination (kNoDest for a call whose result is dropped)
+    int32_t b = 0;  // First source; branch target, callee index, string index, or first jump-table slot
+    int32_t c = 0;  // Second source; argument count of a call, or jump-table size (the slot after the last is the default)
+    static constexpr int32_t kNoDest = -1;
+};
+static_assert(sizeof(VmInstr) == 16, "VmInstr should stay a compact 16-byte record");
+
+struct VmFunction {
+    std::string name;
+    uint32_t entry = 0;
+    uint32_t frame_size = 0;   // Parameters first, then the other locals and temps
+    uint32_t param_count = 0;
+};
+
+struct VmProgram {
+    std::vector<VmInstr> code;
+    std::vector<VmFunction> functions;  // functions[0] is the startup code: file-scope initialisers, then "call main"
+    std::vector<int32_t> statics;       // Globals and constants; copied to the bottom of memory on every run
+    std::vector<std::string> strings;   // Text for WriteStr and Trap
+    std::vector<uint32_t> jump_targets; // Target pcs of every JmpTable, each table followed by its default
+    size_t skipped_lines = 0;           // Comment lines the generator could not lower
+
+    // Index of the function containing pc (functions are laid out in order)
+    uint32_t functionAt(uint32_t pc) const {
+        auto it = std::upper_bound(functions.begin(), functions.end(), pc, [](uint32_t p, const VmFunction& f) { return p < f.entry; });
+        return static_cast<uint32_t>(it - functions.begin()) - 1;
+    }
+};
+
+// --- Compilation ---
+// One pass per function with label fix-ups afterwards. Calls to functions the program does not define become
+// Trap instructions, so a program only fails if such a call actually runs. Returns false with a message when
+// the 3AC uses something the VM cannot represent (a non-integer constant in arithmetic, no main).
+inline bool compileVmProgram(const TacProgram& prog, VmProgram& vm, std::string& error) {
+    vm = VmProgram();
+    std::unordered_map<uint32_t, uint32_t> function_of; // Symbol -> function index
+    vm.functions.push_back({"<startup>", 0, 0, 0});
+    for (const TacFunction& f : prog.functions) {
+        if (f.isTopLevel()) continue;
+        if (!function_of.emplace(f.name, static_cast<uint32_t>(vm.functions.size())).second) { error = "function '" + prog.symbols[f.name] + "' is defined twice"; return false; }
+        vm.functions.push_back({prog.symbols[f.name], 0, 0, static_cast<uint32_t>(f.params.size())});
+    }
+    auto main_it = prog.symbols.index.find("main");
+    if (main_it == prog.symbols.index.end() || !function_of.count(main_it->second)) { error = "the program has no function 'main'"; return false; }
+
+    // The 3AC has no declarations: a symbol is global everywhere once file-scope code assigns it. The ICG gives
+    // a local that hides a global a name of its own (g.1), so the name alone decides.
+    std::unordered_map<uint32_t, int32_t> global_slot;  // Symbol -> encoded absolute slot
+    std::unordered_map<int32_t, int32_t> constant_slot; // Value -> encoded absolute slot
+    for (uint32_t sym : prog.globals) { global_slot[sym] = static_cast<int32_t>(vm.statics.size()) << 1; vm.statics.push_back(0); }
+    auto constantSlot = [&](int32_t v) {
+        auto it = constant_slot.emplace(v, static_cast<int32_t>(vm.statics.size()) << 1);
+        if (it.second) vm.statics.push_back(v);
+        return it.first->second;
+    };
+
+    std::unordered_map<uint32_t, int32_t> frame;   // Operand bits -> encoded frame slot (for the function being compiled)
+    std::unordered_map<uint32_t, uint32_t> label_pc;
+    std::vector<std::pair<uint32_t, uint32_t>> fixups; // (pc, label operand bits)
+    std::vector<std::pair<uint32_t, uint32_t>> table_fixups; // (jump_targets slot, label operand bits)
+    std::string where;
+    auto value = [&](Operand o, int32_t& enc) {
+        if (o.isSymbol() && prog.isGlobal(o)) { enc = global_slot[o.id()]; return true; }
+        if (o.isSymbol() || o.isTemp()) {
+            auto it = frame.emplace(o.bits, (static_cast<int32_t>(frame.size()) << 1) | 1).first;
+            enc = it->second;
+            return true;
+        }
+        if (o.isImm()) { enc = constantSlot(o.immValue()); return true; }
+        int32_t v;
+        if (o.isConst() && integerLiteral(prog.constants[o.id()], v)) { enc = constantSlot(v); return true; }
+        error = "unsupported operand '" + operandName(prog, o) + "' in " + where;
+        return false;
+    };
+    auto emit = [&](VmOp op, int32_t a = 0, int32_t b = 0, int32_t c = 0) { vm.code.push_back({op, a, b, c}); };
+    auto jumpTo = [&](Operand label) { fixups.emplace_back(static_cast<uint32_t>(vm.code.size()), label.bits); };
+    auto stringIndex = [&](const std::string& s) { vm.strings.push_back(s); return static_cast<int32_t>(vm.strings.size() - 1); };
+
+    auto compileCode = [&](const TacFunction& f) {
+        for (const TacInstr& in : f.code) {
+            int32_t a = 0, b = 0, c = 0;
+            where = "'" + instrToString(prog, in, &f.jump_tables) + "'";
+            switch (in.op) {
+                case TacOp::Nop: break;
+                case TacOp::Comment: vm.skipped_lines++; break;
+                case TacOp::Label: label_pc[in.arg1.bits] = static_cast<uint32_t>(vm.code.size()); break;
+                case TacOp::Copy:
+                    if (!value(in.result, a) || !value(in.arg1, b)) return false;
+                    emit(VmOp::Mov, a, b); break;
+                case TacOp::Goto: jumpTo(in.arg1); emit(VmOp::Jmp); break;
+                case TacOp::IfFalse: case TacOp::IfTrue:
+                    if (!value(in.arg1, a)) return false;
+                    jumpTo(in.arg2); emit(in.op == TacOp::IfFalse ? VmOp::Jz : VmOp::Jnz, a); break;
+                case TacOp::JumpTable: {
+                    if (!value(in.arg1, a)) return false;
+                    const JumpTable& table = f.jumpTable(in);
+                    b = static_cast<int32_t>(vm.jump_targets.size());
+                    auto slot = [&](Operand target) {
+                        table_fixups.emplace_back(static_cast<uint32_t>(vm.jump_targets.size()), target.bits);
+                        vm.jump_targets.push_back(0);
+                    };
+                    for (Operand target : table.targets) slot(target);
+                    slot(table.fallback);
+                    emit(VmOp::JmpTable, a, b, static_cast<int32_t>(table.targets.size()));
+                    break;
+                }
+                case TacOp::Param: if (!value(in.arg1, b)) return false; emit(VmOp::Param, 0, b); break;
+                case TacOp::Call: {
+                    if (!in.result.isNone() && !value(in.result, a)) return false;
+                    if (in.result.isNone()) a = VmInstr::kNoDest;
+                    if (!in.arg2.isConst() || !integerLiteral(prog.constants[in.arg2.id()], c)) { error = "bad argument count in " + where; return false; }
+                    auto callee = function_of.find(in.arg1.id());
+                    if (callee == function_of.end()) emit(VmOp::Trap, 0, stringIndex("call to undefined function '" + prog.symbols[in.arg1.id()] + "'"));
+                    else emit(VmOp::Call, a, static_cast<int32_t>(callee->second), c);
+                    break;
+                }
+                case TacOp::Return:
+                    if (in.arg1.isNone()) { emit(VmOp::RetVoid); break; }
+                    if (!value(in.arg1, b)) return false;
+                    emit(VmOp::Ret, 0, b); break;
+                case TacOp::Read: if (!value(in.arg1, a)) return false; emit(VmOp::Read, a); break;
+                case TacOp::Write: {
+                    const std::string* text = in.arg1.isConst() ? &prog.constants[in.arg1.id()] : nullptr;
+                    if (text && !integerLiteral(*text, b)) { // Strings print decoded; other literals (3.5) print as written
+                        emit(VmOp::WriteStr, 0, stringIndex(text->front() == '"' ? decodeStringLiteral(*text) : *text));
+                        break;
+                    }
+                    const bool as_char = isCharWrite(in) || (text && text->front() == '\''); // 'x' and char variables print the character
+                    if (text && as_char) { emit(VmOp::WriteStr, 0, stringIndex(std::string(1, static_cast<char>(b)))); break; }
+                    if (!value(in.arg1, b)) return false;
+                    emit(as_char ? VmOp::WriteChar : VmOp::Write, 0, b); break;
+                }
+                default:
+                    if (!value(in.result, a) || !value(in.arg1, b) || (isBinaryOp(in.op) && !value(in.arg2, c))) return false;
+                    emit(isBinaryOp(in.op) ? static_cast<VmOp>(static_cast<uint8_t>(VmOp::Add) + (static_cast<uint8_t>(in.op) - static_cast<uint8_t>(TacOp::Add)))
+                                           : static_cast<VmOp>(static_cast<uint8_t>(VmOp::Neg) + (static_cast<uint8_t>(in.op) - static_cast<uint8_t>(TacOp::Neg))),
+                         a, b, c);
+                    break;
+            }
+        }
+        return true;
+    };
+    auto resolveLabels = [&](const std::string& name) {
+        for (const auto& fix : fixups) {
+            auto it = label_pc.find(fix.second);
+            if (it == label_pc.end()) { error = "jump to a missing label in " + name; return false; }
+            vm.code[fix.first].b = static_cast<int32_t>(it->second);
+        }
+        for (const auto& fix : table_fixups) {
+            auto it = label_pc.find(fix.second);
+            if (it == label_pc.end()) { error = "jump table with a missing label in " + name; return false; }
+            vm.jump_targets[fix.first] = it->second;
+        }
+        fixups.clear();
+        table_fixups.clear();
+        label_pc.clear();
+        return true;
+    };
+
+    // Startup: every file-scope segment in order, then main
+    for (const TacFunction& f : prog.functions) if (f.isTopLevel() && !compileCode(f)) return false;
+    emit(VmOp::Call, VmInstr::kNoDest, static_cast<int32_t>(function_of[main_it->second]), 0);
+    emit(VmOp::Halt);
+    if (!resolveLabels("file-scope code")) return false;
+    vm.functions[0].frame_size = static_cast<uint32_t>(frame.size());
+    for (const TacFunction& f : prog.functions) {
+        if (f.isTopLevel()) continue;
+        VmFunction& vf = vm.functions[function_of[f.name]];
+        frame.clear();
+        int32_t unused;
+        for (uint32_t p : f.params) value(Operand::symbol(p), unused);
+        vf.entry = static_cast<uint32_t>(vm.code.size());
+        if (!compileCode(f)) return false;
+        emit(VmOp::RetVoid); // Falling off the end returns
+        if (!resolveLabels(vf.name)) return false;
+        vf.frame_size = static_cast<uint32_t>(frame.size());
+    }
+    return true;
+}
+
+// --- Execution ---
+struct VmStats {
+    uint64_t instructions = 0;
+    uint64_t calls = 0;
+    uint32_t max_depth = 0;
+    std::vector<uint64_t> op_counts;   // Per VmOp; only filled when profiling
+};
+
+struct VmResult {
+    int32_t exit_code = 0;  // main's return value
+    std::string error;      // Runtime error, empty on success
+};
+
+namespace tac_vm_detail {
+// cin-like integer input: skips whitespace; the first failed read stores 0, later reads leave the target alone
+struct VmInput {
+    const std::string& text;
+    size_t pos = 0;
+    bool failed = false;
+
+    bool next(int32_t& out) {
+        if (failed) return false;
+        while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) pos++;
+        size_t start = pos;
+        if (pos < text.size() && (text[pos] == '-' || text[pos] == '+')) pos++;
+        size_t digits = pos;
+        long long v = 0;
+        while (pos < text.size() && std::isdigit(static_cast<unsigned char>(text[pos]))) v = std::min<long long>(v * 10 + (text[pos++] - '0'), 1LL << 40);
+        if (pos == digits) { pos = start; failed = true; out = 0; return false; }
+        if (text[start] == '-') v = -v;
+        if (v > INT32_MAX || v < INT32_MIN) { failed = true; out = v > 0 ? INT32_MAX : INT32_MIN; return false; }
+        out = static_cast<int32_t>(v);
+        return true;
+    }
+};
+
+inline void appendInt(std::string& out, int32_t v) {
+    char buf[12];
+    char* p = buf + sizeof(buf);
+    uint32_t u = v < 0 ? 0u - static_cast<uint32_t>(v) : static_cast<uint32_t>(v);
+    do { *--p = static_cast<char>('0' + u % 10); u /= 10; } while (u);
+    if (v < 0) *--p = '-';
+    out.append(p, buf + sizeof(buf));
+}
+
+template <bool kProfile>
+inline VmResult runVmImpl(const VmProgram& vm, const std::string& input, std::string& output, VmStats& stats, uint32_t stack_slots) {
+    struct Frame { uint32_t return_pc, fp; int32_t dest; };
+    VmResult result;
+    VmInput in{input};
+    const uint32_t limit = static_cast<uint32_t>(vm.statics.size()) + stack_slots;
+    std::unique_ptr<int32_t[]> memory(new int32_t[limit]); // Frames are cleared on entry, so the stack starts uninitialised
+    std::copy(vm.statics.begin(), vm.statics.end(), memory.get());
+    std::vector<int32_t> args(64); // Pending params; grows on demand
+    size_t arg_count = 0;
+    std::vector<Frame> frames;
+    if (kProfile) stats.op_counts.assign(static_cast<size_t>(VmOp::Count), 0);
+
+    int32_t* const mem = memory.get();
+    const VmInstr* const code = vm.code.data();
+    const uint32_t* const jump_targets = vm.jump_targets.data();
+    uint32_t fp = static_cast<uint32_t>(vm.statics.size());
+    uint32_t sp = fp + vm.functions[0].frame_size;
+    std::fill(mem + fp, mem + sp, 0);
+    const VmInstr* ip = code;
+    uint64_t executed = 0;
+
+#define VM_SLOT(e) mem[(static_cast<uint32_t>(e) >> 1) + (fp & (0u - (static_cast<uint32_t>(e) & 1u)))]
+#define VM_FAIL(message) do { result.error = message; goto done; } while (0)
+#define VM_COUNT() do { ++executed; if (kProfile) stats.op_counts[static_cast<uint8_t>(ip->op)]++; } while (0)
+#if TAC_VM_THREADED
+    static const void* const handlers[] = {
+        &&op_Mov, &&op_Add, &&op_Sub, &&op_Mul, &&op_Div, &&op_Mod, &&op_Lt, &&op_Le, &&op_Gt, &&op_Ge, &&op_Eq, &&op_Ne,
+        &&op_LogAnd, &&op_LogOr, &&op_BitAnd, &&op_BitOr, &&op_BitXor, &&op_Shl, &&op_Shr, &&op_Neg, &&op_Not, &&op_BitNot,
+        &&op_Jmp, &&op_Jz, &&op_Jnz, &&op_JmpTable, &&op_Param, &&op_Call, &&op_Ret, &&op_RetVoid, &&op_Read, &&op_Write,
+        &&op_WriteChar, &&op_WriteStr, &&op_Trap, &&op_Halt};
+    static_assert(sizeof(handlers) / sizeof(handlers[0]) == static_cast<size_t>(VmOp::Count), "one handler per VmOp");
+#define VM_DISPATCH() do { VM_COUNT(); goto *handlers[static_cast<uint8_t>(ip->op)]; } while (0)
+#define VM_OP(name) op_##name:
+#else
+#define VM_DISPATCH() goto dispatch
+#define VM_OP(name) case VmOp::name:
+#endif
+#define VM_NEXT() do { ++ip; VM_DISPATCH(); } while (0)
+#define VM_BINARY(name, expr) VM_OP(name) { int32_t x = VM_SLOT(ip->b), y = VM_SLOT(ip->c); (void)x; (void)y; VM_SLOT(ip->a) = (expr); VM_NEXT(); }
+#define VM_UNARY(name, expr) VM_OP(name) { int32_t x = VM_SLOT(ip->b); VM_SLOT(ip->a) = (expr); VM_NEXT(); }
+
+#if TAC_VM_THREADED
+    VM_DISPATCH();
+#else
+dispatch:
+    VM_COUNT();
+    switch (ip->op) {
+#endif
+    VM_OP(Mov) { VM_SLOT(ip->a) = VM_SLOT(ip->b); VM_NEXT(); }
+    VM_BINARY(Add, static_cast<int32_t>(static_cast<uint32_t>(x) + static_cast<uint32_t>(y)))
+    VM_BINARY(Sub, static_cast<int32_t>(static_cast<uint32_t>(x) - static_cast<uint32_t>(y)))
+    VM_BINARY(Mul, static_cast<int32_t>(static_cast<uint32_t>(x) * static_cast<uint32_t>(y)))
+    VM_OP(Div) {
+        int32_t x = VM_SLOT(ip->b), y = VM_SLOT(ip->c);
+        if (y == 0) VM_FAIL("division by zero");
+        if (x == INT32_MIN && y == -1) VM_FAIL("integer overflow in division");
+        VM_SLOT(ip->a) = x / y;
+        VM_NEXT();
+    }
+    VM_OP(Mod) {
+        int32_t x = VM_SLOT(ip->b), y = VM_SLOT(ip->c);
+        if (y == 0) VM_FAIL("division by zero");
+        VM_SLOT(ip->a) = y == -1 ? 0 : x % y;
+        VM_NEXT();
+    }
+    VM_BINARY(Lt, x < y)
+    VM_BINARY(Le, x <= y)
+    VM_BINARY(Gt, x > y)
+    VM_BINARY(Ge, x >= y)
+    VM_BINARY(Eq, x == y)
+    VM_BINARY(Ne, x != y)
+    VM_BINARY(LogAnd, (x != 0) & (y != 0))
+    VM_BINARY(LogOr, (x != 0) | (y != 0))
+    VM_BINARY(BitAnd, x & y)
+    VM_BINARY(BitOr, x | y)
+    VM_BINARY(BitXor, x ^ y)
+    VM_BINARY(Shl, static_cast<int32_t>(static_cast<uint32_t>(x) << (y & 31))) // Counts masked as x86 does
+    VM_BINARY(Shr, x >> (y & 31))
+    VM_UNARY(Neg, static_cast<int32_t>(0u - static_cast<uint32_t>(x)))
+    VM_UNARY(Not, x == 0)
+    VM_UNARY(BitNot, ~x)
+    VM_OP(Jmp) { ip = code + ip->b; VM_DISPATCH(); }
+    VM_OP(Jz) { ip = VM_SLOT(ip->a) == 0 ? code + ip->b : ip + 1; VM_DISPATCH(); }
+    VM_OP(Jnz) { ip = VM_SLOT(ip->a) != 0 ? code + ip->b : ip + 1; VM_DISPATCH(); }
+    VM_OP(JmpTable) { // One unsigned compare sends negative and too-large indexes alike to the default
+        uint32_t index = static_cast<uint32_t>(VM_SLOT(ip->a)), size = static_cast<uint32_t>(ip->c);
+        ip = code + jump_targets[static_cast<uint32_t>(ip->b) + (index < size ? index : size)];
+        VM_DISPATCH();
+    }
+    VM_OP(Param) {
+        if (arg_count == args.size()) args.resize(args.size() * 2);
+        args[arg_count++] = VM_SLOT(ip->b);
+        VM_NEXT();
+    }
+    VM_OP(Call) {
+        const VmFunction& callee = vm.functions[static_cast<uint32_t>(ip->b)];
+        uint32_t argc = static_cast<uint32_t>(ip->c);
+        if (argc > arg_count) VM_FAIL("call to '" + callee.name + "' with missing arguments");
+        if (sp + callee.frame_size > limit) VM_FAIL("stack overflow in '" + callee.name + "'");
+        frames.push_back({static_cast<uint32_t>(ip - code) + 1, fp, ip->a});
+        stats.max_depth = std::max(stats.max_depth, static_cast<uint32_t>(frames.size()));
+        stats.calls++;
+        std::fill(mem + sp, mem + sp + callee.frame_size, 0);
+        arg_count -= argc;
+        std::copy(args.data() + arg_count, args.data() + arg_count + std::min(argc, callee.param_count), mem + sp);
+        fp = sp;
+        sp += callee.frame_size;
+        ip = code + callee.entry;
+        VM_DISPATCH();
+    }
+    VM_OP(Ret) {
+        int32_t v = VM_SLOT(ip->b);
+        if (frames.size() <= 1) { result.exit_code = v; goto done; } // main returned
+        Frame f = frames.back();
+        frames.pop_back();
+        sp = fp;
+        fp = f.fp;
+        if (f.dest != VmInstr::kNoDest) VM_SLOT(f.dest) = v;
+        ip = code + f.return_pc;
+        VM_DISPATCH();
+    }
+    VM_OP(RetVoid) {
+        if (frames.size() <= 1) goto done;
+        Frame f = frames.back();
+        frames.pop_back();
+        sp = fp;
+        fp = f.fp;
+        if (f.dest != VmInstr::kNoDest) VM_SLOT(f.dest) = 0;
+        ip = code + f.return_pc;
+        VM_DISPATCH();
+    }
+    VM_OP(Read) { in.next(VM_SLOT(ip->a)); VM_NEXT(); }
+    VM_OP(Write) { appendInt(output, VM_SLOT(ip->b)); VM_NEXT(); }
+    VM_OP(WriteChar) { output += static_cast<char>(VM_SLOT(ip->b)); VM_NEXT(); }
+    VM_OP(WriteStr) { output += vm.strings[static_cast<uint32_t>(ip->b)]; VM_NEXT(); }
+    VM_OP(Trap) { VM_FAIL(vm.strings[static_cast<uint32_t>(ip->b)]); }
+    VM_OP(Halt) { goto done; }
+#if !TAC_VM_THREADED
+    case VmOp::Count: break;
+    }
+#endif
+
+done:
+    if (!result.error.empty()) result.error += " in '" + vm.functions[vm.functionAt(static_cast<uint32_t>(ip - code))].name + "'";
+    stats.instructions += executed;
+    return result;
+#undef VM_SLOT
+#undef VM_FAIL
+#undef VM_COUNT
+#undef VM_DISPATCH
+#undef VM_OP
+#undef VM_NEXT
+#undef VM_BINARY
+#undef VM_UNARY
+}
+} // namespace tac_vm_detail
+
+// Runs the program once. Input is consumed like cin >> int; output is appended to `output`.
+// stack_slots bounds the memory for frames (4 bytes each).
+inline VmResult runVm(const VmProgram& vm, const std::string& input, std::string& output, VmStats& stats,
+                      bool profile = false, uint32_t stack_slots = 1u << 22) {
+    return profile ? tac_vm_detail::runVmImpl<true>(vm, input, output, stats, stack_slots)
+                   : tac_vm_detail::runVmImpl<false>(vm, input, output, stats, stack_slots);
+}
+
+#endif // TAC_VM_H
@@ -0,0 +1,77 @@
+// File: tac_x86.cpp - Compiles generated 3AC to x86-64 assembly and optionally links it with the system compiler
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include "tac_ir.h"
+#include "tac_x86.h"
+
+// --- Function to read 3AC instructions (same format as dag_builder) ---
+std::vector<std::string> read3AC(const std::string& filename) {
+    std::vector<std::string> code;
+    std::ifstream infile(filename);
+    std::string line;
+    const std::string whitespace = " \t\n\r\f\v";
+    while (std::getline(infile, line)) {
+        if (line.empty() || line[0] == '#') continue; // Skip comments/empty
+        size_t first = line.find_first_not_of(whitespace);
+        if (first == std::string::npos) continue;
+        size_t last = line.find_last_not_of(whitespace);
+        code.push_back(line.substr(first, last - first + 1));
+    }
+    return code;
+}
+
+// Single-quoted for /bin/sh
+std::string shellQuote(const std::string& s) {
+    std::string q = "'";
+    for (char c : s) { if (c == '\'') q += "'\\''"; else q += c; }
+    return q + "'";
+}
+
+// --- Main Function ---
+int main(int argc, char* argv[]) {
+    std::string tac_file, asm_file = "asm_output.s", exe_file, cc = "cc";
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        if (arg == "-o" && a + 1 < argc) asm_file = argv[++a];
+        else if (arg == "--link" && a + 1 < argc) exe_file = argv[++a];
+        else if (arg == "--cc" && a + 1 < argc) cc = argv[++a];
+        else if (tac_file.empty()) tac_file = arg;
+        else { tac_file.clear(); break; }
+    }
+    if (tac_file.empty()) {
+        std::cerr << "Usage: tac_x86 <3ac_file> [-o FILE.s] [--link EXECUTABLE] [--cc COMPILER]\n"
+                     "  Writes x86-64 assembly (default asm_output.s); --link also assembles and links it with COMPILER (default cc).\n";
+        return 1;
+    }
+
+    std::vector<std::string> lines = read3AC(tac_file);
+    if (lines.empty() && !std::ifstream(tac_file)) { std::cerr << "X86: Cannot open 3AC file " << tac_file << "\n"; return 1; }
+    TacProgram program = parseTacText(lines);
+
+    std::string text, error;
+    X86Stats stats;
+    auto start = std::chrono::steady_clock::now();
+    if (!compileX86Program(program, text, error, &stats)) { std::cerr << "X86: " << error << "\n"; return 1; }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::ofstream out(asm_file, std::ios::binary);
+    if (!out) { std::cerr << "X86: Cannot open output file " << asm_file << "\n"; return 1; }
+    out << text;
+    out.close();
+    std::cout << "X86: Wrote " << stats.functions << " function(s), " << stats.instructions << " instructions to " << asm_file
+              << " (" << stats.in_registers << " of " << stats.variables << " variables in registers, "
+              << stats.fused_branches << " compare(s) fused into branches, " << ms << " ms)\n";
+    if (stats.skipped_lines) std::cout << "X86: Warning: " << stats.skipped_lines << " line(s) of 3AC are not instructions and were kept as comments\n";
+
+    if (!exe_file.empty()) {
+        std::string command = cc + " -o " + shellQuote(exe_file) + " " + shellQuote(asm_file);
+        if (std::system(command.c_str()) != 0) { std::cerr << "X86: Linking failed: " << command << "\n"; return 1; }
+        std::cout << "X86: Linked " << exe_file << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,650 @@
+// File: tac_x86.h - Lowers 3AC to x86-64 assembly (System V ABI, GNU as syntax) with a small read/write runtime
+#ifndef TAC_X86_H
+#define TAC_X86_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "tac_ir.h"
+#include "tac_cfg.h"
+#include "tac_dataflow.h"
+
+// --- Output layout ---
+// Values are 32-bit ints with wrap-around, exactly as in the VM. Every function keeps a frame pointer; its most
+// used variables (weighted by loop nesting) live in callee-saved registers, and in functions that call nothing
+// also in free caller-saved ones; everything else gets a 4-byte stack slot. Labels are numbered program-wide in
+// the 3AC, so Ln becomes .LLn. User functions are emitted as tac_fn_NAME and globals as tac_gv_NAME so they can
+// not collide with libc; the exported "main" is a startup routine that runs the file-scope code and returns
+// whatever tac_fn_main returns. read/write go through tac_rt_* routines built on scanf/printf.
+struct X86Stats {
+    uint32_t functions = 0;         // Including the startup routine
+    uint32_t instructions = 0;      // Machine instructions emitted for the program (runtime excluded)
+    uint32_t variables = 0;         // Locals and temps over all functions
+    uint32_t in_registers = 0;
+    uint32_t fused_branches = 0;    // Compare + branch pairs emitted as cmp/jcc
+    size_t skipped_lines = 0;       // Comment lines the generator could not lower (kept as assembly comments)
+};
+
+namespace tac_x86_detail {
+struct Register { const char* r32; const char* r64; };
+inline const std::vector<Register>& calleeSaved() {
+    static const std::vector<Register> regs = {{"%ebx", "%rbx"}, {"%r12d", "%r12"}, {"%r13d", "%r13"}, {"%r14d", "%r14"}, {"%r15d", "%r15"}};
+    return regs;
+}
+inline const std::vector<Register>& argumentRegs() {
+    static const std::vector<Register> regs = {{"%edi", "%rdi"}, {"%esi", "%rsi"}, {"%edx", "%rdx"}, {"%ecx", "%rcx"}, {"%r8d", "%r8"}, {"%r9d", "%r9"}};
+    return regs;
+}
+
+// Where a value lives: a register, a memory operand, or an immediate
+struct Loc {
+    enum Kind : uint8_t { Reg, Mem, Imm } kind = Imm;
+    std::string text;      // As written in an instruction ("%ebx", "-12(%rbp)", "$5")
+    std::string text64;    // 64-bit register name (Reg only)
+    int32_t value = 0;     // Imm only
+    static Loc reg(const Register& r) { Loc l; l.kind = Reg; l.text = r.r32; l.text64 = r.r64; return l; }
+    static Loc mem(std::string t) { Loc l; l.kind = Mem; l.text = std::move(t); return l; }
+    static Loc imm(int32_t v) { Loc l; l.kind = Imm; l.value = v; l.text = "$" + std::to_string(v); return l; }
+};
+
+// Condition-code suffix of a comparison opcode, or of its negation
+inline const char* conditionCode(TacOp op, bool negate) {
+    switch (op) {
+        case TacOp::Lt: return negate ? "ge" : "l";
+        case TacOp::Le: return negate ? "g" : "le";
+        case TacOp::Gt: return negate ? "le" : "g";
+        case TacOp::Ge: return negate ? "l" : "ge";
+        case TacOp::Eq: return negate ? "ne" : "e";
+        default: return negate ? "e" : "ne";
+    }
+}
+inline bool isComparison(TacOp op) { return op >= TacOp::Lt && op <= TacOp::Ne; }
+
+inline void appendAsmString(const std::string& s, std::string& out) {
+    static const char digits[] = "01234567";
+    out += '"';
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\') { out += '\\'; out += static_cast<char>(c); }
+        else if (c >= 0x20 && c < 0x7f) out += static_cast<char>(c);
+        else { out += '\\'; out += digits[c >> 6]; out += digits[(c >> 3) & 7]; out += digits[c & 7]; }
+    }
+    out += '"';
+}
+
+// --- Per-program state shared by the function lowerings ---
+struct ProgramLowering {
+    const TacProgram& prog;
+    std::string& out;
+    X86Stats& stats;
+    std::string& error;
+    std::unordered_map<uint32_t, uint32_t> defined;  // Function symbol -> parameter count
+    std::vector<std::string> strings;                // .rodata literals, referenced as .LstrN
+    std::string tables;                              // .rodata jump tables (.LjtN: offsets of the targets from .LjtN)
+    uint32_t table_count = 0;
+
+    void ins(const char* op, const std::string& args = std::string()) {
+        out += "    "; out += op;
+        if (!args.empty()) { size_t len = std::strlen(op); out.append(len < 8 ? 8 - len : 1, ' '); out += args; }
+        out += '\n';
+        stats.instructions++;
+    }
+    int32_t stringIndex(const std::string& s) { strings.push_back(s); return static_cast<int32_t>(strings.size() - 1); }
+};
+
+// --- One function ---
+// The startup routine goes through the same path as a TacFunction made of all file-scope segments plus the call
+// to main, so globals initialised by expressions (and the temps those need) behave like any other code.
+class FunctionLowering {
+public:
+    FunctionLowering(ProgramLowering& p, const TacFunction& f, const std::string& asm_name) : P(p), fn(f), name(asm_name) {}
+
+    bool run() {
+        assignHomes();
+        cfg = buildCFG(fn);
+        live = computeLiveness(P.prog, fn, cfg);
+        block_of.assign(fn.code.size(), 0);
+        for (uint32_t b = 0; b < cfg.size(); ++b)
+            for (uint32_t k = cfg.blocks[b].begin; k < cfg.blocks[b].end; ++k) block_of[k] = b;
+
+        prologue();
+        bool ends_in_return = false;
+        for (size_t k = 0; k < fn.code.size(); ++k) {
+            const TacInstr& in = fn.code[k];
+            where = "'" + instrToString(P.prog, in, &fn.jump_tables) + "' in " + (fn.isTopLevel() ? std::string("file-scope code") : P.prog.symbols[fn.name]);
+            if (!lower(k)) return false;
+            if (in.op != TacOp::Nop && in.op != TacOp::Comment) ends_in_return = in.op == TacOp::Return;
+        }
+        if (!ends_in_return) P.ins("xorl", "%eax, %eax"); // Falling off the end returns 0 (what main does in C++)
+        epilogue();
+        return true;
+    }
+
+private:
+    ProgramLowering& P;
+    const TacFunction& fn;
+    std::string name;
+    std::string where;
+    std::unordered_map<uint32_t, Loc> home;   // Operand bits -> location (non-global variables)
+    std::vector<const Register*> saved;            // Callee-saved registers pushed by the prologue
+    uint32_t slots = 0;
+    ControlFlowGraph cfg;
+    LivenessInfo live;
+    std::vector<uint32_t> block_of;
+    uint32_t pending = 0;                     // 8-byte params pushed and not yet consumed by a call
+
+    // --- Homes: the heaviest variables get registers, the rest stack slots ---
+    void assignHomes() {
+        const std::vector<TacInstr>& code = fn.code;
+        bool leaf = true;
+        std::unordered_map<uint32_t, size_t> label_at;
+        for (size_t k = 0; k < code.size(); ++k) {
+            if (code[k].op == TacOp::Call || code[k].op == TacOp::Read || code[k].op == TacOp::Write) leaf = false;
+            if (code[k].op == TacOp::Label) label_at[code[k].arg1.bits] = k;
+        }
+        // Loop depth from backward jumps: the generator lays every loop out contiguously
+        std::vector<int32_t> depth(code.size() + 1, 0);
+        for (size_t k = 0; k < code.size(); ++k) {
+            Operand target = code[k].op == TacOp::Goto ? code[k].arg1 : isBranch(code[k].op) ? code[k].arg2 : Operand();
+            if (target.isNone()) continue;
+            auto it = label_at.find(target.bits);
+            if (it != label_at.end() && it->second <= k) { depth[it->second]++; depth[k + 1]--; }
+        }
+        VariableIndex vars = VariableIndex::build(fn);
+        std::vector<uint64_t> weight(vars.size(), 0);
+        for (uint32_t v = 0; v < fn.params.size() && v < vars.size(); ++v) weight[v] = 1;
+        int32_t d = 0;
+        Operand uses[2];
+        for (size_t k = 0; k < code.size(); ++k) {
+            d += depth[k];
+            uint64_t w = uint64_t(1) << (3 * std::min(d, 5));
+            for (int u = 0, n = usedOperands(code[k], uses); u < n; ++u) weight[vars.of(uses[u])] += w;
+            Operand def = definedOperand(code[k]);
+            if (isVariable(def)) weight[vars.of(def)] += w;
+        }
+
+        // Caller-saved registers cost nothing to use but die at calls, so only leaf functions get them; the
+        // argument registers of the function's own parameters stay out, as do %eax/%ecx/%edx (scratch)
+        std::vector<std::pair<const Register*, bool>> pool; // (register, callee-saved)
+        if (leaf) {
+            static const Register extra[] = {{"%r10d", "%r10"}, {"%r11d", "%r11"}};
+            for (const Register& r : extra) pool.push_back({&r, false});
+            for (size_t a : {size_t(0), size_t(1), size_t(4), size_t(5)})
+                if (a >= fn.params.size()) pool.push_back({&argumentRegs()[a], false});
+        }
+        for (const Register& r : calleeSaved()) pool.push_back({&r, true});
+
+        std::vector<uint32_t> order;
+        for (uint32_t v = 0; v < vars.size(); ++v) if (!P.prog.isGlobal(vars.vars[v])) order.push_back(v);
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return weight[a] > weight[b]; });
+        size_t next_reg = 0;
+        std::vector<uint32_t> in_memory;
+        for (uint32_t v : order) {
+            if (next_reg < pool.size() && weight[v] > 0) {
+                const auto& r = pool[next_reg++];
+                home[vars.vars[v].bits] = Loc::reg(*r.first);
+                if (r.second) saved.push_back(r.first);
+                P.stats.in_registers++;
+            } else {
+                in_memory.push_back(v);
+            }
+        }
+        for (uint32_t v : in_memory) {
+            slots++;
+            home[vars.vars[v].bits] = Loc::mem(std::to_string(-static_cast<int32_t>(8 * saved.size() + 4 * slots)) + "(%rbp)");
+        }
+        P.stats.variables += static_cast<uint32_t>(order.size());
+    }
+
+    // Stack after the prologue: saved %rbp, the callee-saved pushes, then the slots, padded to 16 bytes
+    uint32_t frameBytes() const {
+        uint32_t used = static_cast<uint32_t>(8 * saved.size()) + 4 * slots;
+        return ((used + 15) & ~15u) - static_cast<uint32_t>(8 * saved.size());
+    }
+
+    void prologue() {
+        P.out += "\n";
+        if (name == "main") P.out += "    .globl  main\n";
+        P.out += "    .type   " + name + ", @function\n" + name + ":\n";
+        P.ins("pushq", "%rbp");
+        P.ins("movq", "%rsp, %rbp");
+        for (const Register* r : saved) P.ins("pushq", r->r64);
+        if (uint32_t bytes = frameBytes()) P.ins("subq", "$" + std::to_string(bytes) + ", %rsp");
+        for (size_t i = 0; i < fn.params.size(); ++i) {
+            auto it = home.find(Operand::symbol(fn.params[i]).bits);
+            if (it == home.end()) continue;
+            if (i < argumentRegs().size()) move(Loc::reg(argumentRegs()[i]), it->second);
+            else move(Loc::mem(std::to_string(16 + 8 * (i - argumentRegs().size())) + "(%rbp)"), it->second);
+        }
+    }
+
+    void epilogue() {
+        P.out += ".Lret_" + name + ":\n";
+        if (saved.empty()) {
+            P.ins("leave");
+        } else {
+            P.ins("leaq", std::to_string(-static_cast<int32_t>(8 * saved.size())) + "(%rbp), %rsp");
+            for (size_t i = saved.size(); i-- > 0;) P.ins("popq", saved[i]->r64);
+            P.ins("popq", "%rbp");
+        }
+        P.ins("ret");
+        P.out += "    .size   " + name + ", .-" + name + "\n";
+    }
+
+    // --- Operands ---
+    bool loc(Operand o, Loc& l) {
+        // Global by name, as in the VM: the ICG renames a local that hides a global (g.1), so this never catches one
+        if (o.isSymbol() && P.prog.isGlobal(o)) { l = Loc::mem("tac_gv_" + P.prog.symbols[o.id()] + "(%rip)"); return true; }
+        if (o.isImm()) { l = Loc::imm(o.immValue()); return true; }
+        int32_t v;
+        if (o.isConst() && integerLiteral(P.prog.constants[o.id()], v)) { l = Loc::imm(v); return true; }
+        auto it = home.find(o.bits);
+        if (it != home.end()) { l = it->second; return true; }
+        P.error = "unsupported operand '" + operandName(P.prog, o) + "' in " + where;
+        return false;
+    }
+
+    void load(const Loc& src, const char* reg) {
+        if (src.text == reg) return;
+        if (src.kind == Loc::Imm && src.value == 0) P.ins("xorl", std::string(reg) + ", " + reg);
+        else P.ins("movl", src.text + ", " + reg);
+    }
+    void move(const Loc& src, const Loc& dst) {
+        if (src.text == dst.text) return;
+        if (dst.kind == Loc::Reg) { load(src, dst.text.c_str()); return; }
+        if (src.kind == Loc::Mem) { P.ins("movl", src.text + ", %eax"); P.ins("movl", "%eax, " + dst.text); return; }
+        P.ins("movl", src.text + ", " + dst.text);
+    }
+    // Register to compute into: the destination itself when it is one, %eax otherwise
+    const char* work(const Loc& dst) const { return dst.kind == Loc::Reg ? dst.text.c_str() : "%eax"; }
+    void store(const char* reg, const Loc& dst) { if (dst.text != reg) P.ins("movl", std::string(reg) + ", " + dst.text); }
+
+    // cmpl with the operand order AT&T wants; needs a register or memory on the left
+    void compare(const Loc& a, const Loc& b) {
+        if (a.kind == Loc::Imm || (a.kind == Loc::Mem && b.kind == Loc::Mem)) { load(a, "%eax"); P.ins("cmpl", b.text + ", %eax"); }
+        else P.ins("cmpl", b.text + ", " + a.text);
+    }
+    void testZero(const Loc& a) {
+        if (a.kind == Loc::Reg) P.ins("testl", a.text + ", " + a.text);
+        else P.ins("cmpl", "$0, " + a.text);
+    }
+    void nonZeroByte(const Loc& a, const char* reg8) {
+        if (a.kind == Loc::Imm) { P.ins("movb", std::string(a.value != 0 ? "$1, " : "$0, ") + reg8); return; }
+        testZero(a);
+        P.ins("setne", reg8);
+    }
+
+    // Runtime and libc calls need %rsp 16-byte aligned; pending params may have left it 8 bytes off
+    void alignedCall(const std::string& target) {
+        if (pending & 1) P.ins("subq", "$8, %rsp");
+        P.ins("call", target);
+        if (pending & 1) P.ins("addq", "$8, %rsp");
+    }
+
+    const TacInstr* nextReal(size_t k) const {
+        for (size_t j = k + 1; j < fn.code.size(); ++j)
+            if (fn.code[j].op != TacOp::Nop && fn.code[j].op != TacOp::Comment) return &fn.code[j];
+        return nullptr;
+    }
+    std::string label(Operand l) const { return l.isLabel() ? ".LL" + std::to_string(l.id()) : ".LS_" + P.prog.symbols[l.id()]; }
+
+    // A comparison whose temp only feeds the branch right after it becomes cmp + jcc
+    bool fusesWithNext(size_t k) const {
+        const TacInstr& in = fn.code[k];
+        if (!isComparison(in.op) || !in.result.isTemp() || k + 1 >= fn.code.size()) return false;
+        const TacInstr& br = fn.code[k + 1];
+        if (!isBranch(br.op) || br.arg1 != in.result) return false;
+        uint32_t v = live.vars.of(in.result);
+        return v == VariableIndex::kNone || !live.result.out[block_of[k + 1]].test(v);
+    }
+
+    // --- Instructions ---
+    bool lower(size_t& k) {
+        const TacInstr& in = fn.code[k];
+        Loc r, a, b;
+        switch (in.op) {
+            case TacOp::Nop: return true;
+            case TacOp::Comment: P.out += "    # " + instrToString(P.prog, in) + "\n"; P.stats.skipped_lines++; return true;
+            case TacOp::Label: P.out += label(in.arg1) + ":\n"; return true;
+            case TacOp::Goto: {
+                const TacInstr* next = nextReal(k);
+                if (!(next && next->op == TacOp::Label && next->arg1 == in.arg1)) P.ins("jmp", label(in.arg1));
+                return true;
+            }
+            case TacOp::IfFalse: case TacOp::IfTrue:
+                if (!loc(in.arg1, a)) return false;
+                if (a.kind == Loc::Imm) { if ((a.value != 0) == (in.op == TacOp::IfTrue)) P.ins("jmp", label(in.arg2)); return true; }
+                testZero(a);
+                P.ins(in.op == TacOp::IfFalse ? "je" : "jne", label(in.arg2));
+                return true;
+            case TacOp::JumpTable: { // Bounds check (unsigned, so negative indexes fail too), then an indirect jump
+                const JumpTable& table = fn.jumpTable(in);
+                if (!loc(in.arg1, a)) return false;
+                if (a.kind == Loc::Imm) { P.ins("jmp", label(table.target(a.value))); return true; }
+                const std::string jt = ".Ljt" + std::to_string(P.table_count++);
+                load(a, "%eax");
+                P.ins("cmpl", "$" + std::to_string(table.targets.size()) + ", %eax");
+                P.ins("jae", label(table.fallback));
+                P.ins("leaq", jt + "(%rip), %rdx");
+                P.ins("movslq", "(%rdx,%rax,4), %rax");
+                P.ins("addq", "%rdx, %rax");
+                P.ins("jmp", "*%rax");
+                P.tables += "    .p2align 2\n" + jt + ":\n";
+                for (Operand target : table.targets) P.tables += "    .long   " + label(target) + "-" + jt + "\n";
+                return true;
+            }
+            case TacOp::Copy:
+                if (!loc(in.result, r) || !loc(in.arg1, a)) return false;
+                move(a, r);
+                return true;
+            case TacOp::Param:
+                {
+                    bool done = false;
+                    if (!lowerDirectCall(k, done)) return false;
+                    if (done) return true;
+                }
+                if (!loc(in.arg1, a)) return false;
+                if (a.kind == Loc::Reg) P.ins("pushq", a.text64);
+                else if (a.kind == Loc::Imm) P.ins("pushq", a.text);
+                else { P.ins("movl", a.text + ", %eax"); P.ins("pushq", "%rax"); }
+                pending++;
+                return true;
+            case TacOp::Call: return lowerCall(in);
+            case TacOp::Return:
+                if (!in.arg1.isNone()) { if (!loc(in.arg1, a)) return false; load(a, "%eax"); }
+                if (nextReal(k)) P.ins("jmp", ".Lret_" + name);
+                return true;
+            case TacOp::Read:
+                if (!loc(in.arg1, r)) return false;
+                load(r, "%edi");                      // The old value survives a failed read, as with cin
+                alignedCall("tac_rt_read");
+                store("%eax", r);
+                return true;
+            case TacOp::Write: {
+                int32_t v;
+                const std::string* text = in.arg1.isConst() ? &P.prog.constants[in.arg1.id()] : nullptr;
+                if (text && !integerLiteral(*text, v)) { // Strings print decoded; other literals (3.5) print as written
+                    int32_t s = P.stringIndex(text->front() == '"' ? decodeStringLiteral(*text) : *text);
+                    P.ins("leaq", ".Lstr" + std::to_string(s) + "(%rip), %rdi");
+                    alignedCall("tac_rt_write_str");
+                    return true;
+                }
+                if (!loc(in.arg1, a)) return false;
+                load(a, "%edi");                      // 'x' and char variables print the character, not its code
+                alignedCall(isCharWrite(in) || (text && text->front() == '\'') ? "tac_rt_write_char" : "tac_rt_write_int");
+                return true;
+            }
+            default: break;
+        }
+
+        if (!loc(in.result, r) || !loc(in.arg1, a) || (isBinaryOp(in.op) && !loc(in.arg2, b))) return false;
+        const char* w = work(r);
+        switch (in.op) {
+            case TacOp::Add: case TacOp::Sub: case TacOp::Mul: case TacOp::BitAnd: case TacOp::BitOr: case TacOp::BitXor: {
+                const char* mnemonic = in.op == TacOp::Add ? "addl" : in.op == TacOp::Sub ? "subl" : in.op == TacOp::Mul ? "imull"
+                                     : in.op == TacOp::BitAnd ? "andl" : in.op == TacOp::BitOr ? "orl" : "xorl";
+                if (r.kind == Loc::Reg && r.text == b.text) w = "%eax"; // r = a - r: do not overwrite b before using it
+                load(a, w);
+                P.ins(mnemonic, b.text + ", " + w);
+                store(w, r);
+                return true;
+            }
+            case TacOp::Div: case TacOp::Mod:
+                load(a, "%eax");
+                P.ins("cltd");
+                if (b.kind == Loc::Imm) { P.ins("movl", b.text + ", %ecx"); P.ins("idivl", "%ecx"); }
+                else P.ins("idivl", b.text);
+                store(in.op == TacOp::Div ? "%eax" : "%edx", r);
+                return true;
+            case TacOp::Shl: case TacOp::Shr: { // >> on a signed int is arithmetic; counts use the low 5 bits like the hardware
+                const char* mnemonic = in.op == TacOp::Shl ? "sall" : "sarl";
+                if (b.kind == Loc::Imm) { load(a, w); P.ins(mnemonic, "$" + std::to_string(b.value & 31) + ", " + w); }
+                else { load(b, "%ecx"); load(a, w); P.ins(mnemonic, std::string("%cl, ") + w); }
+                store(w, r);
+                return true;
+            }
+            case TacOp::Lt: case TacOp::Le: case TacOp::Gt: case TacOp::Ge: case TacOp::Eq: case TacOp::Ne:
+                compare(a, b);
+                if (fusesWithNext(k)) {
+                    const TacInstr& br = fn.code[++k];
+                    P.ins((std::string("j") + conditionCode(in.op, br.op == TacOp::IfFalse)).c_str(), label(br.arg2));
+                    P.stats.fused_branches++;
+                    return true;
+                }
+                P.ins((std::string("set") + conditionCode(in.op, false)).c_str(), "%al");
+                P.ins("movzbl", std::string("%al, ") + w);
+                store(w, r);
+                return true;
+            case TacOp::LogAnd: case TacOp::LogOr:
+                nonZeroByte(a, "%al");
+                nonZeroByte(b, "%cl");
+                P.ins(in.op == TacOp::LogAnd ? "andb" : "orb", "%cl, %al");
+                P.ins("movzbl", std::string("%al, ") + w);
+                store(w, r);
+                return true;
+            case TacOp::Neg: case TacOp::BitNot:
+                load(a, w);
+                P.ins(in.op == TacOp::Neg ? "negl" : "notl", w);
+                store(w, r);
+                return true;
+            case TacOp::Not:
+                if (a.kind == Loc::Imm) { move(Loc::imm(a.value == 0), r); return true; }
+                testZero(a);
+                P.ins("sete", "%al");
+                P.ins("movzbl", std::string("%al, ") + w);
+                store(w, r);
+                return true;
+            default:
+                P.error = "cannot lower " + where;
+                return false;
+        }
+    }
+
+    // The usual shape, params straight before a call with at most six arguments, loads the argument registers
+    // directly instead of going through the stack. Leaves done false (having emitted nothing) for any other shape.
+    bool lowerDirectCall(size_t& k, bool& done) {
+        size_t e = k;
+        while (e < fn.code.size() && fn.code[e].op == TacOp::Param) ++e;
+        if (e == fn.code.size() || fn.code[e].op != TacOp::Call) return true;
+        const TacInstr& call = fn.code[e];
+        int32_t n = -1;
+        if (call.arg2.isImm()) n = call.arg2.immValue();
+        else if (call.arg2.isConst()) integerLiteral(P.prog.constants[call.arg2.id()], n);
+        if (n != static_cast<int32_t>(e - k) || static_cast<size_t>(n) > argumentRegs().size() || !P.defined.count(call.arg1.id())) return true;
+        for (size_t i = k; i < e; ++i) {
+            Loc a;
+            where = "'" + instrToString(P.prog, fn.code[i]) + "'";
+            if (!loc(fn.code[i].arg1, a)) return false;
+            load(a, argumentRegs()[i - k].r32);
+        }
+        k = e;
+        done = true;
+        where = "'" + instrToString(P.prog, call) + "'";
+        alignedCall("tac_fn_" + P.prog.symbols[call.arg1.id()]);
+        if (!call.result.isNone()) {
+            Loc r;
+            if (!loc(call.result, r)) return false;
+            store("%eax", r);
+        }
+        return true;
+    }
+
+    // Params were pushed one by one, so argument i sits at 8*(n-1-i)(%rsp). The first six go to registers; any
+    // others are copied into a fresh outgoing area in the order the ABI wants, padded to keep %rsp aligned.
+    bool lowerCall(const TacInstr& in) {
+        int32_t n = 0;
+        if (in.arg2.isImm()) n = in.arg2.immValue();
+        else if (!in.arg2.isConst() || !integerLiteral(P.prog.constants[in.arg2.id()], n) || n < 0) { P.error = "bad argument count in " + where; return false; }
+        if (static_cast<uint32_t>(n) > pending) { P.error = "call with fewer params than arguments in " + where; return false; }
+        auto callee = P.defined.find(in.arg1.id());
+        if (callee == P.defined.end()) { // Fails only if the call is reached, like the VM's trap
+            int32_t s = P.stringIndex("call to undefined function '" + P.prog.symbols[in.arg1.id()] + "'");
+            P.ins("leaq", ".Lstr" + std::to_string(s) + "(%rip), %rdi");
+            P.ins("andq", "$-16, %rsp");
+            P.ins("call", "tac_rt_fail");
+            pending -= static_cast<uint32_t>(n);
+            return true;
+        }
+        const uint32_t count = static_cast<uint32_t>(n);
+        const uint32_t in_regs = std::min<uint32_t>(count, static_cast<uint32_t>(argumentRegs().size()));
+        const uint32_t on_stack = count - in_regs;
+        const uint32_t pad = ((pending + on_stack) & 1) ? 8 : 0;
+        for (uint32_t i = 0; i < in_regs; ++i) P.ins("movl", std::to_string(8 * (count - 1 - i)) + "(%rsp), " + argumentRegs()[i].r32);
+        if (on_stack || pad) P.ins("subq", "$" + std::to_string(8 * on_stack + pad) + ", %rsp");
+        for (uint32_t j = 0; j < on_stack; ++j) {
+            P.ins("movq", std::to_string(8 * (count - 1 - (in_regs + j)) + 8 * on_stack + pad) + "(%rsp), %rax");
+            P.ins("movq", "%rax, " + std::to_string(8 * j) + "(%rsp)");
+        }
+        P.ins("call", "tac_fn_" + P.prog.symbols[in.arg1.id()]);
+        if (uint32_t drop = 8 * (on_stack + count) + pad) P.ins("addq", "$" + std::to_string(drop) + ", %rsp");
+        pending -= count;
+        if (!in.result.isNone()) {
+            Loc r;
+            if (!loc(in.result, r)) return false;
+            store("%eax", r);
+        }
+        return true;
+    }
+};
+
+// scanf/printf wrappers. tac_rt_read(old) returns the next integer, or 0 on the first failure and old after
+// that, which is what cin >> x does to x. Each routine realigns %rsp before calling into libc.
+inline const char* runtimeText() {
+    return R"(
+# --- Runtime ---
+    .type   tac_rt_read, @function
+tac_rt_read:
+    pushq   %rbx
+    subq    $16, %rsp
+    movl    %edi, %ebx
+    cmpb    $0, tac_rt_read_failed(%rip)
+    jne     .Lread_done
+    leaq    12(%rsp), %rsi
+    leaq    .Lfmt_int(%rip), %rdi
+    xorl    %eax, %eax
+    call    scanf@PLT
+    cmpl    $1, %eax
+    je      .Lread_ok
+    movb    $1, tac_rt_read_failed(%rip)
+    xorl    %ebx, %ebx
+    jmp     .Lread_done
+.Lread_ok:
+    movl    12(%rsp), %ebx
+.Lread_done:
+    movl    %ebx, %eax
+    addq    $16, %rsp
+    popq    %rbx
+    ret
+    .size   tac_rt_read, .-tac_rt_read
+
+    .type   tac_rt_write_int, @function
+tac_rt_write_int:
+    subq    $8, %rsp
+    movl    %edi, %esi
+    leaq    .Lfmt_int(%rip), %rdi
+    xorl    %eax, %eax
+    call    printf@PLT
+    addq    $8, %rsp
+    ret
+    .size   tac_rt_write_int, .-tac_rt_write_int
+
+    .type   tac_rt_write_char, @function
+tac_rt_write_char:
+    subq    $8, %rsp
+    call    putchar@PLT
+    addq    $8, %rsp
+    ret
+    .size   tac_rt_write_char, .-tac_rt_write_char
+
+    .type   tac_rt_write_str, @function
+tac_rt_write_str:
+    subq    $8, %rsp
+    movq    %rdi, %rsi
+    leaq    .Lfmt_str(%rip), %rdi
+    xorl    %eax, %eax
+    call    printf@PLT
+    addq    $8, %rsp
+    ret
+    .size   tac_rt_write_str, .-tac_rt_write_str
+
+    .type   tac_rt_fail, @function
+tac_rt_fail:
+    subq    $8, %rsp
+    movq    %rdi, %rbx
+    movq    stdout@GOTPCREL(%rip), %rax
+    movq    (%rax), %rdi
+    call    fflush@PLT
+    leaq    .Lfmt_fail(%rip), %rsi
+    movq    stderr@GOTPCREL(%rip), %rax
+    movq    (%rax), %rdi
+    movq    %rbx, %rdx
+    xorl    %eax, %eax
+    call    fprintf@PLT
+    movl    $1, %edi
+    call    exit@PLT
+    .size   tac_rt_fail, .-tac_rt_fail
+)";
+}
+} // namespace tac_x86_detail
+
+// --- Program ---
+// Returns false with a message when the 3AC uses something the backend cannot represent (a non-integer
+// constant in arithmetic, no main, a call without its params).
+inline bool compileX86Program(const TacProgram& prog, std::string& out, std::string& error, X86Stats* stats_out = nullptr) {
+    using namespace tac_x86_detail;
+    X86Stats stats;
+    out.clear();
+    ProgramLowering P{prog, out, stats, error, {}, {}, {}, 0};
+    for (const TacFunction& f : prog.functions) {
+        if (f.isTopLevel()) continue;
+        if (!P.defined.emplace(f.name, static_cast<uint32_t>(f.params.size())).second) { error = "function '" + prog.symbols[f.name] + "' is defined twice"; return false; }
+    }
+    auto main_it = prog.symbols.index.find("main");
+    if (main_it == prog.symbols.index.end() || !P.defined.count(main_it->second)) { error = "the program has no function 'main'"; return false; }
+
+    out += "# Generated by tac_x86 from 3AC (x86-64 System V, GNU as). Link with: cc -o program FILE.s\n";
+    out += "    .text\n";
+
+    TacFunction startup;
+    for (const TacFunction& f : prog.functions) {
+        if (!f.isTopLevel()) continue;
+        for (TacInstr in : f.code) {
+            if (in.op == TacOp::JumpTable) in.arg2 = Operand::immediate(startup.addJumpTable(f.jumpTable(in)));
+            startup.code.push_back(in);
+        }
+    }
+    Operand result = Operand::temp(prog.temp_count);
+    for (const TacInstr& in : startup.code) { // Any temp number not used by the file-scope code will do
+        Operand uses[2];
+        for (int u = 0, n = usedOperands(in, uses); u < n; ++u) if (uses[u].isTemp() && uses[u].id() >= result.id()) result = Operand::temp(uses[u].id() + 1);
+        Operand d = definedOperand(in);
+        if (d.isTemp() && d.id() >= result.id()) result = Operand::temp(d.id() + 1);
+    }
+    startup.code.emplace_back(TacOp::Call, result, Operand::symbol(main_it->second), Operand::immediate(0));
+    startup.code.emplace_back(TacOp::Return, Operand(), result);
+    if (!FunctionLowering(P, startup, "main").run()) return false;
+    stats.functions++;
+    for (const TacFunction& f : prog.functions) {
+        if (f.isTopLevel()) continue;
+        if (!FunctionLowering(P, f, "tac_fn_" + prog.symbols[f.name]).run()) return false;
+        stats.functions++;
+    }
+    out += runtimeText();
+
+    out += "\n    .section .rodata\n.Lfmt_int:\n    .string \"%d\"\n.Lfmt_str:\n    .string \"%s\"\n.Lfmt_fail:\n    .string \"runtime error: %s\\n\"\n";
+    for (size_t s = 0; s < P.strings.size(); ++s) {
+        out += ".Lstr" + std::to_string(s) + ":\n    .string ";
+        appendAsmString(P.strings[s], out);
+        out += '\n';
+    }
+    out += P.tables;
+    out += "\n    .bss\ntac_rt_read_failed:\n    .zero   1\n    .p2align 2\n";
+    for (uint32_t g : prog.globals) out += "tac_gv_" + prog.symbols[g] + ":\n    .zero   4\n";
+    out += "\n    .section .note.GNU-stack,\"\",@progbits\n";
+    if (stats_out) *stats_out = stats;
+    return true;
+}
+
+#endif // TAC_X86_H
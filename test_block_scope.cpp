@@ -0,0 +1,18 @@
+#include<bits/stdc++.h>
+using namespace std;
+// A declaration in an inner block or a for header hides the outer variable only until the block ends.
+// Expected output for input "3": "1 5" then "50 60 1 5"
+int main(){
+    int x = 1, y;
+    cin >> y;
+    {
+        int x = 2;
+        y = y + x;
+    }
+    cout<<x<<" "<<y<<endl;
+    for(int x = 5; x < 7; x++){
+        int y = x * 10;
+        cout<<y<<" ";
+    }
+    cout<<x<<" "<<y<<endl;
+}
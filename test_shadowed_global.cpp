@@ -0,0 +1,19 @@
+#include<bits/stdc++.h>
+using namespace std;
+// f's local g hides the global g, so only h changes the global.
+// Expected output for input "3": "7 5" then "65 11"
+int g = 5;
+int f(int x){
+    int g = x * 2;
+    return g + 1;
+}
+int h(int x){
+    g = g + x;
+    return g;
+}
+int main(){
+    int n;
+    cin >> n;
+    cout<<f(n)<<" "<<h(0)<<endl;
+    cout<<f(h(n) * 4)<<" "<<h(n)<<endl;
+}
@@ -0,0 +1,18 @@
+#include<bits/stdc++.h>
+using namespace std;
+// && and || must not evaluate their right side when the left decides: with input "0 5" the divisions
+// below would divide by zero. Expected output: "002" for input "0 5", "102" for "3 7"
+int main(){
+    int x , y;
+    cin >> x >> y;
+    if(x != 0 && y / x > 1)
+        cout<<1;
+    else
+        cout<<0;
+    int q = (x != 0 && y % x == 0);
+    cout<<q;
+    int r = (x == 0 || y / x > 1);
+    if(x == 0 || y % x == 1)
+        r = r + 1;
+    cout<<r;
+}
@@ -0,0 +1,95 @@
+// File: thread_pool.h - Small fixed-size worker pool for running independent per-function/per-block work in parallel
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    // thread_count includes the calling thread; 1 means "run everything inline"
+    explicit ThreadPool(unsigned thread_count) {
+        if (thread_count == 0) thread_count = defaultThreadCount();
+        for (unsigned k = 1; k < thread_count; ++k) workers_.emplace_back([this] { workerLoop(); });
+    }
+
+    ~ThreadPool() {
+        { std::lock_guard<std::mutex> lock(mutex_); stopping_ = true; }
+        wake_.notify_all();
+        for (std::thread& t : workers_) t.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(workers_.size()) + 1; }
+
+    static unsigned defaultThreadCount() {
+        unsigned n = std::thread::hardware_concurrency();
+        return n == 0 ? 1 : n;
+    }
+
+    // Runs fn(0) .. fn(count-1) across the pool (the caller helps); returns once every index is done.
+    // Indices are handed out dynamically, so uneven work items balance themselves.
+    void parallelFor(size_t count, const std::function<void(size_t)>& fn) {
+        if (count == 0) return;
+        if (workers_.empty() || count == 1) { for (size_t k = 0; k < count; ++k) fn(k); return; }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            job_ = &fn; job_count_ = count; next_index_ = 0; finished_ = 0;
+            generation_++;
+        }
+        wake_.notify_all();
+        runItems(fn, count, false);
+        std::unique_lock<std::mutex> lock(mutex_);
+        // Workers that joined this job must have left it before fn goes out of scope
+        done_.wait(lock, [&] { return finished_ == count && active_workers_ == 0; });
+        job_ = nullptr;
+    }
+
+private:
+    void runItems(const std::function<void(size_t)>& fn, size_t count, bool is_worker) {
+        size_t completed = 0;
+        for (size_t k = next_index_.fetch_add(1); k < count; k = next_index_.fetch_add(1)) { fn(k); completed++; }
+        std::lock_guard<std::mutex> lock(mutex_);
+        finished_ += completed;
+        if (is_worker) active_workers_--;
+        if (finished_ == count && active_workers_ == 0) done_.notify_all();
+    }
+
+    void workerLoop() {
+        size_t seen_generation = 0;
+        while (true) {
+            const std::function<void(size_t)>* fn = nullptr;
+            size_t count = 0;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stopping_ || (job_ != nullptr && generation_ != seen_generation); });
+                if (stopping_) return;
+                seen_generation = generation_;
+                fn = job_; count = job_count_;
+                active_workers_++;
+            }
+            runItems(*fn, count, true);
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(size_t)>* job_ = nullptr;
+    size_t job_count_ = 0;
+    std::atomic<size_t> next_index_{0};
+    size_t finished_ = 0;
+    unsigned active_workers_ = 0;
+    size_t generation_ = 0;
+    bool stopping_ = false;
+};
+
+#endif // THREAD_POOL_H